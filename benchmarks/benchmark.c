@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "sonLib.h"
+#include "benchmark.h"
+
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+
+/*
+ * Allocation counting. The benchmark executables define malloc, calloc, realloc and free themselves, forwarding to
+ * glibc's __libc_ entry points. Definitions in the executable take precedence over libc's for every object in the
+ * process, so allocations made inside shared libraries (libMarginCore.so, with the sonLib and cPecan code) are
+ * counted too, which link time wrapping of the executable's own calls would miss.
+ */
+
+static int64_t allocationCount = 0;
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    __atomic_add_fetch(&allocationCount, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&allocationCount, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&allocationCount, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+int64_t benchmark_allocationCount() {
+    return __atomic_load_n(&allocationCount, __ATOMIC_RELAXED);
+}
+
+#else
+
+int64_t benchmark_allocationCount() {
+    return -1;
+}
+
+#endif
+
+void benchmark_checkAllocationCounting() {
+    if (benchmark_allocationCount() < 0) {
+        return;
+    }
+    // st_malloc and stList_construct are in sonLib, so allocations inside the libraries must be seen
+    int64_t start = benchmark_allocationCount();
+    free(st_malloc(1));
+    stList_destruct(stList_construct());
+    if (benchmark_allocationCount() - start < 3) {
+        st_errAbort("Allocation counting misses allocations made by sonLib, allocs/op would be wrong\n");
+    }
+}
+
+uint64_t benchmark_timeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+static int cmpDouble(const void *a, const void *b) {
+    double i = *(double *) a, j = *(double *) b;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
+
+void benchmark_printHeader(FILE *fh) {
+    fprintf(fh, "%-45s %12s %14s %14s %14s\n", "benchmark", "ops", "median_ns/op", "min_ns/op", "allocs/op");
+}
+
+void benchmark_run(FILE *fh, char *name, BenchmarkFn fn, void *state, int64_t repeats) {
+    benchmark_runWithSetup(fh, name, NULL, fn, state, repeats);
+}
+
+void benchmark_runWithSetup(FILE *fh, char *name, BenchmarkSetupFn setup, BenchmarkFn fn, void *state,
+                            int64_t repeats) {
+    // warm up caches and any lazily built state
+    if (setup != NULL) {
+        setup(state);
+    }
+    fn(state);
+
+    double *nsPerOp = calloc(repeats, sizeof(double));
+    int64_t totalOps = 0, totalAllocations = 0;
+    for (int64_t i = 0; i < repeats; i++) {
+        if (setup != NULL) {
+            setup(state);
+        }
+        int64_t allocationsStart = benchmark_allocationCount();
+        uint64_t start = benchmark_timeNs();
+        int64_t ops = fn(state);
+        uint64_t end = benchmark_timeNs();
+        totalAllocations += benchmark_allocationCount() - allocationsStart;
+        totalOps += ops;
+        nsPerOp[i] = ops == 0 ? 0.0 : (double) (end - start) / ops;
+    }
+    qsort(nsPerOp, repeats, sizeof(double), cmpDouble);
+
+    if (benchmark_allocationCount() < 0) {
+        fprintf(fh, "%-45s %12"PRId64" %14.1f %14.1f %14s\n", name, totalOps / repeats, nsPerOp[repeats / 2],
+                nsPerOp[0], "n/a");
+    } else {
+        fprintf(fh, "%-45s %12"PRId64" %14.1f %14.1f %14.2f\n", name, totalOps / repeats, nsPerOp[repeats / 2],
+                nsPerOp[0], totalOps == 0 ? 0.0 : (double) totalAllocations / totalOps);
+    }
+    fflush(fh);
+
+    free(nsPerOp);
+}
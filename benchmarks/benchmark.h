@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef MARGIN_BENCHMARK_H
+#define MARGIN_BENCHMARK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+/*
+ * A benchmarked operation. Runs the operation some number of times and returns that number, so cheap operations can
+ * be batched to get a measurable time.
+ */
+typedef int64_t (*BenchmarkFn)(void *state);
+
+/*
+ * Untimed preparation run before each call of a BenchmarkFn, for operations that consume or mutate their input.
+ */
+typedef void (*BenchmarkSetupFn)(void *state);
+
+/*
+ * Returns a monotonic time in nanoseconds.
+ */
+uint64_t benchmark_timeNs();
+
+/*
+ * Returns the number of malloc, calloc and realloc calls made so far, or -1 if the benchmark was built without
+ * allocation counting (see BENCHMARK_COUNT_ALLOCATIONS).
+ */
+int64_t benchmark_allocationCount();
+
+/*
+ * Exits with an error if allocation counting is built in but does not see allocations made inside the libraries
+ * (st_malloc, stList_construct), so a broken counter can't report too few allocs/op.
+ */
+void benchmark_checkAllocationCounting();
+
+/*
+ * Prints the column headers for benchmark_run.
+ */
+void benchmark_printHeader(FILE *fh);
+
+/*
+ * Runs fn once to warm up, then the given number of repeats, and prints the median and minimum ns/op over the repeats
+ * and the mean allocations/op.
+ */
+void benchmark_run(FILE *fh, char *name, BenchmarkFn fn, void *state, int64_t repeats);
+
+/*
+ * As benchmark_run, but calls setup (untimed) before every call of fn, including the warm up.
+ */
+void benchmark_runWithSetup(FILE *fh, char *name, BenchmarkSetupFn setup, BenchmarkFn fn, void *state,
+                            int64_t repeats);
+
+#endif // MARGIN_BENCHMARK_H
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "margin.h"
+#include "callConsensus.h"
+#include "readSimulator.h"
+#include "benchmark.h"
+
+/*
+ * Compares the callConsensus POA backbones: the first read of each cluster (as callConsensus used before
+ * getConsensusBackboneIndex) against the read getConsensusBackboneIndex picks. Each cluster is reads simulated from
+ * its own random true sequence, some of them truncated, and each backbone choice is scored by the identity of the
+ * consensus to the truth and the time to call it.
+ */
+
+typedef struct _consensusCluster {
+    char *truth;
+    int64_t readCount;
+    char **nucleotides; // run length encoded reads
+    uint8_t **runLengths;
+    uint8_t *strands;
+} ConsensusCluster;
+
+static ConsensusCluster *consensusCluster_construct(int64_t length, int64_t readCount, SimulatorErrorModel *readErrors,
+                                                    double truncatedFraction) {
+    ConsensusCluster *cluster = st_calloc(1, sizeof(ConsensusCluster));
+    cluster->truth = simulator_getRandomReference(length);
+    cluster->readCount = readCount;
+    cluster->nucleotides = st_calloc(readCount, sizeof(char *));
+    cluster->runLengths = st_calloc(readCount, sizeof(uint8_t *));
+    cluster->strands = st_calloc(readCount, sizeof(uint8_t));
+    for (int64_t i = 0; i < readCount; i++) {
+        char *read = simulator_evolve(cluster->truth, readErrors, NULL);
+        if (st_random() < truncatedFraction) {
+            // keep a prefix or a suffix of 30 to 90 percent of the read
+            int64_t readLength = strlen(read);
+            int64_t keptLength = (int64_t) (readLength * (0.3 + 0.6 * st_random()));
+            int64_t start = st_random() < 0.5 ? 0 : readLength - keptLength;
+            char *truncated = stString_getSubString(read, start, keptLength);
+            free(read);
+            read = truncated;
+        }
+        RleString *rleString = rleString_construct(read);
+        cluster->nucleotides[i] = stString_copy(rleString->rleString);
+        cluster->runLengths[i] = st_malloc(rleString->length * sizeof(uint8_t));
+        for (int64_t j = 0; j < rleString->length; j++) {
+            cluster->runLengths[i][j] = (uint8_t) rleString->repeatCounts[j];
+        }
+        cluster->strands[i] = (uint8_t) (st_random() < 0.5 ? 0 : 1);
+        rleString_destruct(rleString);
+        free(read);
+    }
+    return cluster;
+}
+
+static void consensusCluster_destruct(ConsensusCluster *cluster) {
+    for (int64_t i = 0; i < cluster->readCount; i++) {
+        free(cluster->nucleotides[i]);
+        free(cluster->runLengths[i]);
+    }
+    free(cluster->nucleotides);
+    free(cluster->runLengths);
+    free(cluster->strands);
+    free(cluster->truth);
+    free(cluster);
+}
+
+typedef struct _backboneResult {
+    double identity; // sum over clusters of the identity of the consensus to the truth
+    int64_t exact; // clusters whose consensus is the truth
+    uint64_t ns; // total time calling consensus, including picking the backbone
+} BackboneResult;
+
+static void scoreBackbone(ConsensusCluster *cluster, bool pickBackbone, PolishParams *params,
+                          BackboneResult *result) {
+    uint64_t start = benchmark_timeNs();
+    int64_t backboneIndex = pickBackbone ? getConsensusBackboneIndex(cluster->readCount, cluster->nucleotides) : 0;
+    RleString *consensus = callConsensusWithBackbone(cluster->readCount, cluster->nucleotides, cluster->runLengths,
+                                                     cluster->strands, backboneIndex, params);
+    result->ns += benchmark_timeNs() - start;
+
+    char *expanded = rleString_expand(consensus);
+    result->identity += simulator_identity(cluster->truth, expanded);
+    result->exact += stString_eq(cluster->truth, expanded) ? 1 : 0;
+    free(expanded);
+    rleString_destruct(consensus);
+}
+
+void usage() {
+    fprintf(stderr, "usage: consensusBenchmark [options]\n");
+    fprintf(stderr, "Compares callConsensus started from the first read of each simulated cluster with callConsensus\n");
+    fprintf(stderr, "started from the read getConsensusBackboneIndex picks, reporting mean identity of the consensus\n");
+    fprintf(stderr, "to the truth and mean time per cluster as tab separated values.\n");
+
+    fprintf(stderr, "\nDefault options:\n");
+    fprintf(stderr, "    -h --help                     : Print this help screen\n");
+    fprintf(stderr, "    -p --params                   : Parameters file [default = ../params/allParams.np.json]\n");
+    fprintf(stderr, "    -c --clusters                 : Number of clusters [default = 100]\n");
+    fprintf(stderr, "    -l --length                   : Length of the true sequence of each cluster [default = 1000]\n");
+    fprintf(stderr, "    -d --depth                    : Reads per cluster [default = 10]\n");
+    fprintf(stderr, "    -f --truncatedFraction        : Fraction of reads truncated to 30-90%% [default = 0.1]\n");
+    fprintf(stderr, "    -s --substitutionRate         : Read substitution rate [default = 0.02]\n");
+    fprintf(stderr, "    -i --homopolymerIndelRate     : Read homopolymer indel rate, per run [default = 0.05]\n");
+    fprintf(stderr, "    -e --seed                     : Random seed [default = 1]\n");
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    // Parameters / arguments
+    char *paramsFile = stString_copy("../params/allParams.np.json");
+    int64_t clusterCount = 100;
+    int64_t length = 1000;
+    int64_t depth = 10;
+    double truncatedFraction = 0.1;
+    SimulatorErrorModel readErrors = { 0.02, 0.05 };
+    int64_t seed = 1;
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "help", no_argument, 0, 'h' },
+                { "params", required_argument, 0, 'p' },
+                { "clusters", required_argument, 0, 'c' },
+                { "length", required_argument, 0, 'l' },
+                { "depth", required_argument, 0, 'd' },
+                { "truncatedFraction", required_argument, 0, 'f' },
+                { "substitutionRate", required_argument, 0, 's' },
+                { "homopolymerIndelRate", required_argument, 0, 'i' },
+                { "seed", required_argument, 0, 'e' },
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "hp:c:l:d:f:s:i:e:", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+        case 'p':
+            free(paramsFile);
+            paramsFile = stString_copy(optarg);
+            break;
+        case 'c':
+            clusterCount = atol(optarg);
+            break;
+        case 'l':
+            length = atol(optarg);
+            break;
+        case 'd':
+            depth = atol(optarg);
+            break;
+        case 'f':
+            truncatedFraction = atof(optarg);
+            break;
+        case 's':
+            readErrors.substitutionRate = atof(optarg);
+            break;
+        case 'i':
+            readErrors.homopolymerIndelRate = atof(optarg);
+            break;
+        case 'e':
+            seed = atol(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            free(paramsFile);
+            return 0;
+        }
+    }
+    if (clusterCount <= 0 || length <= 0 || depth <= 0) {
+        st_errAbort("Clusters, length and depth must be greater than zero\n");
+    }
+    if (access(paramsFile, R_OK ) != 0) {
+        st_errAbort("Could not read from file: %s\n", paramsFile);
+    }
+
+    // Both backbones are scored on the same clusters, in alternating order so neither gets warmer caches
+    PolishParams *params = getConsensusParameters(paramsFile);
+    st_randomSeed(seed);
+    BackboneResult firstRead = { 0.0, 0, 0 }, picked = { 0.0, 0, 0 };
+    for (int64_t i = 0; i < clusterCount; i++) {
+        ConsensusCluster *cluster = consensusCluster_construct(length, depth, &readErrors, truncatedFraction);
+        scoreBackbone(cluster, i % 2 == 1, params, i % 2 == 1 ? &picked : &firstRead);
+        scoreBackbone(cluster, i % 2 == 0, params, i % 2 == 0 ? &picked : &firstRead);
+        consensusCluster_destruct(cluster);
+    }
+
+    // Report
+    fprintf(stdout, "# clusters: %" PRId64 ", length: %" PRId64 ", depth: %" PRId64 ", truncated fraction: %.2f, "
+                    "seed: %" PRId64 ", params: %s\n", clusterCount, length, depth, truncatedFraction, seed, paramsFile);
+    fprintf(stdout, "backbone\tmean_identity\texact_clusters\tmean_ms_per_cluster\n");
+    fprintf(stdout, "first_read\t%f\t%" PRId64 "\t%.3f\n", firstRead.identity / clusterCount, firstRead.exact,
+            firstRead.ns / 1.0e6 / clusterCount);
+    fprintf(stdout, "picked\t%f\t%" PRId64 "\t%.3f\n", picked.identity / clusterCount, picked.exact,
+            picked.ns / 1.0e6 / clusterCount);
+
+    // Cleanup
+    destroyConsensusParameters(params);
+    free(paramsFile);
+
+    return 0;
+}
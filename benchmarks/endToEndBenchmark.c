@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "margin.h"
+#include "readSimulator.h"
+#include "benchmark.h"
+
+/*
+ * End to end benchmark: simulates a data set, polishes it with marginPolish as a child process and reports the wall
+ * time and peak RSS of the polish, and the identity of the draft and the polished sequence to the truth.
+ */
+
+static char *readFirstSequence(char *fastaFile) {
+    FILE *fh = fopen(fastaFile, "r");
+    if (fh == NULL) {
+        st_errAbort("Could not read from file: %s\n", fastaFile);
+    }
+    struct List *seqs = constructEmptyList(0, free);
+    struct List *seqLengths = constructEmptyList(0, free);
+    struct List *headers = constructEmptyList(0, free);
+    fastaRead(fh, seqs, seqLengths, headers);
+    fclose(fh);
+    char *seq = seqs->length == 0 ? stString_copy("") : stString_copy(seqs->list[0]);
+    destructList(seqs);
+    destructList(seqLengths);
+    destructList(headers);
+    return seq;
+}
+
+void usage() {
+    fprintf(stderr, "usage: endToEndBenchmark <MARGIN_POLISH> <PARAMS> <WORK_DIR> [options]\n");
+    fprintf(stderr, "Simulates a draft and reads into WORK_DIR, polishes them with the MARGIN_POLISH executable and\n");
+    fprintf(stderr, "reports wall time, peak RSS and identity to the truth as tab separated values.\n");
+
+    fprintf(stderr, "\nDefault options:\n");
+    fprintf(stderr, "    -h --help                     : Print this help screen\n");
+    fprintf(stderr, "    -l --length                   : Length of the random true sequence [default = 100000]\n");
+    fprintf(stderr, "    -d --depth                    : Read coverage depth [default = 30]\n");
+    fprintf(stderr, "    -L --readLength               : Mean read length [default = 10000]\n");
+    fprintf(stderr, "    -s --substitutionRate         : Read substitution rate [default = 0.02]\n");
+    fprintf(stderr, "    -i --homopolymerIndelRate     : Read homopolymer indel rate, per run [default = 0.05]\n");
+    fprintf(stderr, "    -S --draftSubstitutionRate    : Draft substitution rate [default = 0.002]\n");
+    fprintf(stderr, "    -I --draftHomopolymerIndelRate: Draft homopolymer indel rate, per run [default = 0.01]\n");
+    fprintf(stderr, "    -t --threads                  : Threads given to marginPolish [default = 1]\n");
+    fprintf(stderr, "    -e --seed                     : Random seed [default = 1]\n");
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 4) {
+        usage();
+        return 0;
+    }
+
+    // Parameters / arguments
+    char *marginPolish = stString_copy(argv[1]);
+    char *paramsFile = stString_copy(argv[2]);
+    char *workDir = stString_copy(argv[3]);
+    int64_t referenceLength = 100000;
+    int64_t threads = 1;
+    int64_t seed = 1;
+    SimulatorParams params;
+    params.depth = 30;
+    params.readLength = 10000;
+    params.readErrors.substitutionRate = 0.02;
+    params.readErrors.homopolymerIndelRate = 0.05;
+    params.draftErrors.substitutionRate = 0.002;
+    params.draftErrors.homopolymerIndelRate = 0.01;
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "help", no_argument, 0, 'h' },
+                { "length", required_argument, 0, 'l' },
+                { "depth", required_argument, 0, 'd' },
+                { "readLength", required_argument, 0, 'L' },
+                { "substitutionRate", required_argument, 0, 's' },
+                { "homopolymerIndelRate", required_argument, 0, 'i' },
+                { "draftSubstitutionRate", required_argument, 0, 'S' },
+                { "draftHomopolymerIndelRate", required_argument, 0, 'I' },
+                { "threads", required_argument, 0, 't' },
+                { "seed", required_argument, 0, 'e' },
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int key = getopt_long(argc - 3, &argv[3], "hl:d:L:s:i:S:I:t:e:", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+        case 'l':
+            referenceLength = atol(optarg);
+            break;
+        case 'd':
+            params.depth = atol(optarg);
+            break;
+        case 'L':
+            params.readLength = atol(optarg);
+            break;
+        case 's':
+            params.readErrors.substitutionRate = atof(optarg);
+            break;
+        case 'i':
+            params.readErrors.homopolymerIndelRate = atof(optarg);
+            break;
+        case 'S':
+            params.draftErrors.substitutionRate = atof(optarg);
+            break;
+        case 'I':
+            params.draftErrors.homopolymerIndelRate = atof(optarg);
+            break;
+        case 't':
+            threads = atol(optarg);
+            break;
+        case 'e':
+            seed = atol(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+    if (referenceLength <= 0 || params.depth <= 0 || params.readLength <= 0 || threads <= 0) {
+        st_errAbort("Length, depth, read length and threads must be greater than zero\n");
+    }
+    if (access(marginPolish, X_OK) != 0) {
+        st_errAbort("Could not execute: %s\n", marginPolish);
+    }
+    if (access(paramsFile, R_OK) != 0) {
+        st_errAbort("Could not read from file: %s\n", paramsFile);
+    }
+
+    // Simulate
+    st_randomSeed(seed);
+    char *truth = simulator_getRandomReference(referenceLength);
+    SimulatedReads *simulatedReads = simulatedReads_construct("contig", truth, &params);
+    char *truthFile = stString_print("%s/truth.fa", workDir);
+    char *draftFile = stString_print("%s/draft.fa", workDir);
+    char *bamFile = stString_print("%s/reads.bam", workDir);
+    char *outputBase = stString_print("%s/polished", workDir);
+    char *polishedFile = stString_print("%s.fa", outputBase);
+    simulatedReads_writeFasta(simulatedReads->truth, simulatedReads->contigName, truthFile);
+    simulatedReads_writeFasta(simulatedReads->draft, simulatedReads->contigName, draftFile);
+    simulatedReads_writeBam(simulatedReads, bamFile);
+
+    // Polish
+    char *threadsString = stString_print("%" PRId64, threads);
+    uint64_t start = benchmark_timeNs();
+    pid_t pid = fork();
+    if (pid < 0) {
+        st_errAbort("Could not fork to run %s\n", marginPolish);
+    }
+    if (pid == 0) {
+        execl(marginPolish, marginPolish, bamFile, draftFile, paramsFile, "-t", threadsString, "-o", outputBase,
+              (char *) NULL);
+        fprintf(stderr, "Could not execute %s\n", marginPolish);
+        _exit(127);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid) {
+        st_errAbort("Could not wait for %s\n", marginPolish);
+    }
+    uint64_t end = benchmark_timeNs();
+    // marginPolish is the only child, so its usage is the children's usage
+    struct rusage resourceUsage;
+    getrusage(RUSAGE_CHILDREN, &resourceUsage);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        st_errAbort("%s failed with status %d\n", marginPolish, status);
+    }
+
+    // Report, ru_maxrss is in kilobytes on Linux
+    char *polished = readFirstSequence(polishedFile);
+    fprintf(stdout, "length\tdepth\treadLength\treads\tthreads\twall_s\tuser_s\tsys_s\tpeak_rss_mb\t"
+                    "draft_identity\tpolished_identity\n");
+    fprintf(stdout, "%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%.3f\t%.3f\t%.3f\t%.1f\t%f\t%f\n",
+            referenceLength, params.depth, params.readLength, stList_length(simulatedReads->reads), threads,
+            (double) (end - start) / 1.0e9,
+            resourceUsage.ru_utime.tv_sec + resourceUsage.ru_utime.tv_usec / 1.0e6,
+            resourceUsage.ru_stime.tv_sec + resourceUsage.ru_stime.tv_usec / 1.0e6,
+            resourceUsage.ru_maxrss / 1024.0,
+            simulator_identity(simulatedReads->truth, simulatedReads->draft),
+            simulator_identity(simulatedReads->truth, polished));
+
+    // Cleanup
+    simulatedReads_destruct(simulatedReads);
+    free(polished);
+    free(threadsString);
+    free(truthFile);
+    free(draftFile);
+    free(bamFile);
+    free(outputBase);
+    free(polishedFile);
+    free(truth);
+    free(marginPolish);
+    free(paramsFile);
+    free(workDir);
+
+    return 0;
+}
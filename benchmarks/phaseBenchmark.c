@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "margin.h"
+#include "benchmark.h"
+
+/*
+ * Microbenchmarks for the read partitioning hmm kernels at controlled read depth.
+ *
+ * Reads are simulated as full length profile sequences from one of two haplotypes of a random reference, so every hmm
+ * built from them has exactly the requested depth. For the hmm kernels an op is a column-cell, that is one cell of a
+ * column at one of its active reference positions; for calculateCountBitVectors, which does not depend on the cells,
+ * an op is one active reference position.
+ */
+
+static int64_t benchmarkDepths[] = { 8, 16, 32, 64 };
+#define BENCHMARK_DEPTH_NUMBER 4
+
+typedef struct _phaseBenchmarkState {
+    stRPHmmParameters *params;
+    stList *profileSeqs; // all the simulated reads
+    stList *profileSeqs1, *profileSeqs2; // the first and second halves of profileSeqs
+    stHash *referenceNamesToReferencePriors;
+    stRPHmm *hmm; // hmm of all the reads
+    stList *bitCountVectors; // bit count vectors of each column of hmm, in order
+    stRPHmm *hmm1, *hmm2; // aligned hmms of the two halves of the reads, rebuilt for each cross product
+    stRPHmm *crossProductHmm;
+} PhaseBenchmarkState;
+
+static int64_t getRandomBase() {
+    // the phasing alphabet includes the gap character
+    return st_randomInt(0, ALPHABET_SIZE);
+}
+
+static stRPHmm *getHmm(stList *profileSeqs, stHash *referenceNamesToReferencePriors, stRPHmmParameters *params) {
+    stList *hmms = getRPHmms(profileSeqs, referenceNamesToReferencePriors, params);
+    assert(stList_length(hmms) == 1);
+    stRPHmm *hmm = stList_pop(hmms);
+    stList_destruct(hmms);
+    return hmm;
+}
+
+static int64_t getColumnCells(stRPHmm *hmm) {
+    int64_t columnCells = 0;
+    stRPColumn *column = hmm->firstColumn;
+    while (1) {
+        stRPCell *cell = column->head;
+        do {
+            columnCells += column->totalActivePositions;
+        } while ((cell = cell->nCell) != NULL);
+        if (column->nColumn == NULL) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+    return columnCells;
+}
+
+static PhaseBenchmarkState *phaseBenchmarkState_construct(stRPHmmParameters *params, int64_t referenceLength,
+                                                          int64_t depth, double hetRate, double readErrorRate) {
+    PhaseBenchmarkState *state = st_calloc(1, sizeof(PhaseBenchmarkState));
+    state->params = params;
+
+    // two haplotypes of a random reference
+    uint8_t *haplotypes[2];
+    for (int64_t i = 0; i < 2; i++) {
+        haplotypes[i] = st_malloc(referenceLength * sizeof(uint8_t));
+    }
+    for (int64_t i = 0; i < referenceLength; i++) {
+        haplotypes[0][i] = getRandomBase();
+        haplotypes[1][i] = st_random() < hetRate ? getRandomBase() : haplotypes[0][i];
+    }
+
+    // full length reads, alternating between the haplotypes
+    state->profileSeqs = stList_construct3(0, (void (*)(void *)) stProfileSeq_destruct);
+    state->profileSeqs1 = stList_construct();
+    state->profileSeqs2 = stList_construct();
+    for (int64_t i = 0; i < depth; i++) {
+        char *readId = stString_print("read_%" PRIi64, i);
+        stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile("ref", readId, 0, referenceLength);
+        for (int64_t j = 0; j < referenceLength; j++) {
+            int64_t base = st_random() < readErrorRate ? getRandomBase() : haplotypes[i % 2][j];
+            pSeq->profileProbs[j * ALPHABET_SIZE + base] = ALPHABET_MAX_PROB;
+        }
+        stList_append(state->profileSeqs, pSeq);
+        stList_append(i < depth / 2 ? state->profileSeqs1 : state->profileSeqs2, pSeq);
+        free(readId);
+    }
+
+    // the hmm of all the reads, and the bit count vectors of its columns
+    state->referenceNamesToReferencePriors = createEmptyReferencePriorProbabilities(state->profileSeqs);
+    state->hmm = getHmm(state->profileSeqs, state->referenceNamesToReferencePriors, params);
+    state->bitCountVectors = stList_construct3(0, free);
+    stRPColumn *column = state->hmm->firstColumn;
+    while (1) {
+        stList_append(state->bitCountVectors, calculateCountBitVectors(column->seqs, column->depth,
+                                                                        column->activePositions,
+                                                                        column->totalActivePositions));
+        if (column->nColumn == NULL) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+
+    // Cleanup
+    free(haplotypes[0]);
+    free(haplotypes[1]);
+
+    return state;
+}
+
+static void phaseBenchmarkState_destructCrossProduct(PhaseBenchmarkState *state) {
+    if (state->hmm1 != NULL) {
+        stRPHmm_destruct(state->hmm1, 1);
+        stRPHmm_destruct(state->hmm2, 1);
+        state->hmm1 = NULL;
+        state->hmm2 = NULL;
+    }
+    if (state->crossProductHmm != NULL) {
+        stRPHmm_destruct(state->crossProductHmm, 1);
+        state->crossProductHmm = NULL;
+    }
+}
+
+static void phaseBenchmarkState_destruct(PhaseBenchmarkState *state) {
+    phaseBenchmarkState_destructCrossProduct(state);
+    stList_destruct(state->bitCountVectors);
+    stRPHmm_destruct(state->hmm, 1);
+    stHash_destruct(state->referenceNamesToReferencePriors);
+    stList_destruct(state->profileSeqs1);
+    stList_destruct(state->profileSeqs2);
+    stList_destruct(state->profileSeqs);
+    free(state);
+}
+
+/*
+ * Benchmarked operations
+ */
+
+static void setup_forward(void *s) {
+    PhaseBenchmarkState *state = s;
+    stRPHmm_initialiseProbs(state->hmm);
+}
+
+static int64_t benchmark_forward(void *s) {
+    PhaseBenchmarkState *state = s;
+    stRPHmm_forward(state->hmm);
+    return getColumnCells(state->hmm);
+}
+
+static void setup_backward(void *s) {
+    PhaseBenchmarkState *state = s;
+    stRPHmm_initialiseProbs(state->hmm);
+    stRPHmm_forward(state->hmm);
+}
+
+static int64_t benchmark_backward(void *s) {
+    PhaseBenchmarkState *state = s;
+    stRPHmm_backward(state->hmm);
+    return getColumnCells(state->hmm);
+}
+
+static int64_t benchmark_calculateCountBitVectors(void *s) {
+    PhaseBenchmarkState *state = s;
+    int64_t positions = 0;
+    stRPColumn *column = state->hmm->firstColumn;
+    while (1) {
+        free(calculateCountBitVectors(column->seqs, column->depth, column->activePositions,
+                                      column->totalActivePositions));
+        positions += column->totalActivePositions;
+        if (column->nColumn == NULL) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+    return positions;
+}
+
+static int64_t benchmark_emissionLogProbability(void *s) {
+    PhaseBenchmarkState *state = s;
+    volatile double totalLogProb = 0.0; // keeps the calls from being optimised away
+    stRPColumn *column = state->hmm->firstColumn;
+    for (int64_t i = 0;; i++) {
+        uint64_t *bitCountVectors = stList_get(state->bitCountVectors, i);
+        stRPCell *cell = column->head;
+        do {
+            totalLogProb += emissionLogProbability(column, cell, bitCountVectors, state->hmm->referencePriorProbs,
+                                                   state->params);
+        } while ((cell = cell->nCell) != NULL);
+        if (column->nColumn == NULL) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+    return getColumnCells(state->hmm);
+}
+
+static void setup_createCrossProductOfTwoAlignedHmm(void *s) {
+    PhaseBenchmarkState *state = s;
+    phaseBenchmarkState_destructCrossProduct(state);
+    state->hmm1 = getHmm(state->profileSeqs1, state->referenceNamesToReferencePriors, state->params);
+    state->hmm2 = getHmm(state->profileSeqs2, state->referenceNamesToReferencePriors, state->params);
+    stRPHmm_alignColumns(state->hmm1, state->hmm2);
+}
+
+static int64_t benchmark_createCrossProductOfTwoAlignedHmm(void *s) {
+    PhaseBenchmarkState *state = s;
+    state->crossProductHmm = stRPHmm_createCrossProductOfTwoAlignedHmm(state->hmm1, state->hmm2);
+    return getColumnCells(state->crossProductHmm);
+}
+
+/*
+ * Main functions
+ */
+
+void usage() {
+    fprintf(stderr, "usage: phaseBenchmark [options]\n");
+    fprintf(stderr, "Times the read partitioning hmm kernels on synthetic reads at depths 8, 16, 32 and 64, reporting\n");
+    fprintf(stderr, "ns per column-cell (one cell of a column at one reference position).\n");
+
+    fprintf(stderr, "\nDefault options:\n");
+    fprintf(stderr, "    -h --help                : Print this help screen\n");
+    fprintf(stderr, "    -p --params              : Parameters file [default = ../params/allParams.np.json]\n");
+    fprintf(stderr, "    -l --length              : Column length, the length of the synthetic reference [default = 1000]\n");
+    fprintf(stderr, "    -d --depth               : Run only this depth (at most %d) [default = all]\n",
+            MAX_READ_PARTITIONING_DEPTH);
+    fprintf(stderr, "    -r --repeats             : Number of timed repeats of each benchmark [default = 5]\n");
+    fprintf(stderr, "    -s --seed                : Random seed for the synthetic inputs [default = 1]\n");
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    // Parameters / arguments
+    char *paramsFile = stString_copy("../params/allParams.np.json");
+    int64_t referenceLength = 1000;
+    int64_t onlyDepth = -1;
+    int64_t repeats = 5;
+    int64_t seed = 1;
+    double hetRate = 0.01;
+    double readErrorRate = 0.05;
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "help", no_argument, 0, 'h' },
+                { "params", required_argument, 0, 'p' },
+                { "length", required_argument, 0, 'l' },
+                { "depth", required_argument, 0, 'd' },
+                { "repeats", required_argument, 0, 'r' },
+                { "seed", required_argument, 0, 's' },
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "hp:l:d:r:s:", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+        case 'p':
+            free(paramsFile);
+            paramsFile = stString_copy(optarg);
+            break;
+        case 'l':
+            referenceLength = atol(optarg);
+            break;
+        case 'd':
+            onlyDepth = atol(optarg);
+            break;
+        case 'r':
+            repeats = atol(optarg);
+            break;
+        case 's':
+            seed = atol(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            free(paramsFile);
+            return 0;
+        }
+    }
+    if (referenceLength <= 0 || repeats <= 0) {
+        st_errAbort("Length and repeats must be greater than zero\n");
+    }
+    if (onlyDepth != -1 && (onlyDepth < 2 || onlyDepth > MAX_READ_PARTITIONING_DEPTH)) {
+        st_errAbort("Depth must be between 2 and %d\n", MAX_READ_PARTITIONING_DEPTH);
+    }
+    if (access(paramsFile, R_OK ) != 0) {
+        st_errAbort("Could not read from file: %s\n", paramsFile);
+    }
+
+    // Setup
+    Params *params = params_readParams2(paramsFile, FALSE, TRUE);
+
+    fprintf(stdout, "# column length: %"PRId64", repeats: %"PRId64", seed: %"PRId64", params: %s\n",
+            referenceLength, repeats, seed, paramsFile);
+    benchmark_checkAllocationCounting();
+    benchmark_printHeader(stdout);
+    for (int64_t i = 0; i < BENCHMARK_DEPTH_NUMBER; i++) {
+        int64_t depth = onlyDepth == -1 ? benchmarkDepths[i] : onlyDepth;
+
+        st_randomSeed(seed);
+        PhaseBenchmarkState *state = phaseBenchmarkState_construct(params->phaseParams, referenceLength, depth,
+                                                                   hetRate, readErrorRate);
+
+        char *name = stString_print("stRPHmm_forward/depth=%" PRIi64, depth);
+        benchmark_runWithSetup(stdout, name, setup_forward, benchmark_forward, state, repeats);
+        free(name);
+        name = stString_print("stRPHmm_backward/depth=%" PRIi64, depth);
+        benchmark_runWithSetup(stdout, name, setup_backward, benchmark_backward, state, repeats);
+        free(name);
+        name = stString_print("calculateCountBitVectors/depth=%" PRIi64, depth);
+        benchmark_run(stdout, name, benchmark_calculateCountBitVectors, state, repeats);
+        free(name);
+        name = stString_print("emissionLogProbability/depth=%" PRIi64, depth);
+        benchmark_run(stdout, name, benchmark_emissionLogProbability, state, repeats);
+        free(name);
+        name = stString_print("stRPHmm_createCrossProduct/depth=%" PRIi64, depth);
+        benchmark_runWithSetup(stdout, name, setup_createCrossProductOfTwoAlignedHmm,
+                               benchmark_createCrossProductOfTwoAlignedHmm, state, repeats);
+        free(name);
+
+        phaseBenchmarkState_destruct(state);
+        if (onlyDepth != -1) {
+            break;
+        }
+    }
+
+    // Cleanup
+    params_destruct(params);
+    free(paramsFile);
+
+    return 0;
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "margin.h"
+#include "benchmark.h"
+
+/*
+ * Microbenchmarks for the polishing hot paths. Inputs are synthetic and generated from a fixed seed, so timings are
+ * comparable between runs and builds.
+ */
+
+typedef struct _polishBenchmarkState {
+    PolishParams *params;
+    stList *reads; // raw read sequences
+    RleString *rleReference; // run length encoded draft
+    stList *rleStrings; // run length encoded reads, as RleStrings
+    stList *rleReads; // run length encoded reads, as BamChunkReads
+    stList *anchorAlignments; // anchors of the rle reads to the rle draft
+    stList *matches, *inserts, *deletes; // pair hmm output for each rle read
+    Poa *poa; // poa of the rle reads to the rle draft
+} PolishBenchmarkState;
+
+static PolishBenchmarkState *polishBenchmarkState_construct(PolishParams *params, int64_t referenceLength,
+                                                            int64_t depth) {
+    PolishBenchmarkState *state = st_calloc(1, sizeof(PolishBenchmarkState));
+    state->params = params;
+
+    // a true sequence, a draft of it and reads sampled from it, all with the cPecan error model
+    char *trueReference = getRandomSequence(referenceLength);
+    char *draft = evolveSequence(trueReference);
+    state->rleReference = rleString_construct(draft);
+    state->reads = stList_construct3(0, free);
+    state->rleStrings = stList_construct3(0, (void (*)(void *)) rleString_destruct);
+    state->rleReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
+    for (int64_t i = 0; i < depth; i++) {
+        char *read = evolveSequence(trueReference);
+        RleString *rleString = rleString_construct(read);
+        stList_append(state->reads, read);
+        stList_append(state->rleStrings, rleString);
+        stList_append(state->rleReads, bamChunkRead_construct2(NULL, stString_copy(rleString->rleString), NULL,
+                                                               i % 2 == 0, NULL));
+    }
+
+    // anchors as used by poa_realignIterative, from an unanchored first round
+    Poa *initialPoa = poa_realign(state->rleReads, NULL, state->rleReference->rleString, params);
+    state->anchorAlignments = poa_getAnchorAlignments(initialPoa, NULL, depth, params);
+    poa_destruct(initialPoa);
+
+    // pair hmm output and the poa built from it
+    state->matches = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    state->inserts = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    state->deletes = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    state->poa = poa_getReferenceGraph(state->rleReference->rleString);
+    for (int64_t i = 0; i < depth; i++) {
+        BamChunkRead *read = stList_get(state->rleReads, i);
+        stList *matches = NULL, *inserts = NULL, *deletes = NULL;
+        getAlignedPairsWithIndelsUsingAnchors(params->sM, state->rleReference->rleString, read->nucleotides,
+                                              stList_get(state->anchorAlignments, i), params->p,
+                                              &matches, &deletes, &inserts, 0, 0);
+        poa_augment(state->poa, read->nucleotides, read->forwardStrand, i, matches, inserts, deletes);
+        stList_append(state->matches, matches);
+        stList_append(state->inserts, inserts);
+        stList_append(state->deletes, deletes);
+    }
+
+    // Cleanup
+    free(trueReference);
+    free(draft);
+
+    return state;
+}
+
+static void polishBenchmarkState_destruct(PolishBenchmarkState *state) {
+    stList_destruct(state->reads);
+    rleString_destruct(state->rleReference);
+    stList_destruct(state->rleStrings);
+    stList_destruct(state->rleReads);
+    stList_destruct(state->anchorAlignments);
+    stList_destruct(state->matches);
+    stList_destruct(state->inserts);
+    stList_destruct(state->deletes);
+    poa_destruct(state->poa);
+    free(state);
+}
+
+/*
+ * Benchmarked operations
+ */
+
+static int64_t benchmark_rleStringConstruct(void *s) {
+    // op: run length encode one read
+    PolishBenchmarkState *state = s;
+    for (int64_t i = 0; i < stList_length(state->reads); i++) {
+        rleString_destruct(rleString_construct(stList_get(state->reads, i)));
+    }
+    return stList_length(state->reads);
+}
+
+static int64_t benchmark_getAlignedPairsWithIndelsUsingAnchors(void *s) {
+    // op: pair hmm posterior alignment of one read to the draft
+    PolishBenchmarkState *state = s;
+    for (int64_t i = 0; i < stList_length(state->rleReads); i++) {
+        BamChunkRead *read = stList_get(state->rleReads, i);
+        stList *matches = NULL, *inserts = NULL, *deletes = NULL;
+        getAlignedPairsWithIndelsUsingAnchors(state->params->sM, state->rleReference->rleString, read->nucleotides,
+                                              stList_get(state->anchorAlignments, i), state->params->p,
+                                              &matches, &deletes, &inserts, 0, 0);
+        stList_destruct(matches);
+        stList_destruct(inserts);
+        stList_destruct(deletes);
+    }
+    return stList_length(state->rleReads);
+}
+
+static int64_t benchmark_poaGetAnchorAlignments(void *s) {
+    // op: the anchor alignment of one read, each pair its own stIntTuple
+    PolishBenchmarkState *state = s;
+    int64_t readCount = stList_length(state->rleReads);
+    stList_destruct(poa_getAnchorAlignments(state->poa, NULL, readCount, state->params));
+    return readCount;
+}
+
+static int64_t benchmark_poaGetAnchorAlignmentsFromArena(void *s) {
+    // op: the anchor alignment of one read, the pairs made from an arena
+    PolishBenchmarkState *state = s;
+    int64_t readCount = stList_length(state->rleReads);
+    TupleArena *arena = tupleArena_construct();
+    stList_destruct(poa_getAnchorAlignments2(state->poa, NULL, readCount, state->params, arena));
+    tupleArena_destruct(arena);
+    return readCount;
+}
+
+static int64_t benchmark_poaAugment(void *s) {
+    // op: add one read's alignment to a poa, includes building the reference graph once per batch
+    PolishBenchmarkState *state = s;
+    Poa *poa = poa_getReferenceGraph(state->rleReference->rleString);
+    for (int64_t i = 0; i < stList_length(state->rleReads); i++) {
+        BamChunkRead *read = stList_get(state->rleReads, i);
+        poa_augment(poa, read->nucleotides, read->forwardStrand, i, stList_get(state->matches, i),
+                    stList_get(state->inserts, i), stList_get(state->deletes, i));
+    }
+    poa_destruct(poa);
+    return stList_length(state->rleReads);
+}
+
+static int64_t benchmark_poaGetConsensus(void *s) {
+    // op: one consensus of the poa
+    PolishBenchmarkState *state = s;
+    int64_t *poaToConsensusMap = NULL;
+    char *consensus = poa_getConsensus(state->poa, &poaToConsensusMap, state->params);
+    free(consensus);
+    free(poaToConsensusMap);
+    return 1;
+}
+
+static int64_t benchmark_repeatSubMatrixGetMLRepeatCount(void *s) {
+    // op: the ml repeat count of one poa node
+    PolishBenchmarkState *state = s;
+    int64_t ops = 0;
+    for (int64_t i = 1; i < stList_length(state->poa->nodes); i++) {
+        PoaNode *node = stList_get(state->poa->nodes, i);
+        if (stList_length(node->observations) == 0) {
+            continue;
+        }
+        double logProbability;
+        repeatSubMatrix_getMLRepeatCount(state->params->repeatSubMatrix, symbol_convertCharToSymbol(node->base),
+                                         node->observations, state->rleStrings, state->rleReads, &logProbability);
+        ops++;
+    }
+    return ops;
+}
+
+static int64_t benchmark_expandRLEConsensus(void *s) {
+    // op: one expansion of the poa consensus
+    PolishBenchmarkState *state = s;
+    rleString_destruct(expandRLEConsensus(state->poa, state->rleStrings, state->rleReads,
+                                          state->params->repeatSubMatrix));
+    return 1;
+}
+
+/*
+ * Main functions
+ */
+
+void usage() {
+    fprintf(stderr, "usage: polishBenchmark [options]\n");
+    fprintf(stderr, "Times the polishing hot paths on synthetic inputs, reporting ns/op and allocations/op.\n");
+
+    fprintf(stderr, "\nDefault options:\n");
+    fprintf(stderr, "    -h --help                : Print this help screen\n");
+    fprintf(stderr, "    -p --params              : Parameters file [default = ../params/allParams.np.json]\n");
+    fprintf(stderr, "    -l --length              : Length of the synthetic reference [default = 2000]\n");
+    fprintf(stderr, "    -d --depth               : Number of synthetic reads [default = 20]\n");
+    fprintf(stderr, "    -r --repeats             : Number of timed repeats of each benchmark [default = 5]\n");
+    fprintf(stderr, "    -s --seed                : Random seed for the synthetic inputs [default = 1]\n");
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    // Parameters / arguments
+    char *paramsFile = stString_copy("../params/allParams.np.json");
+    int64_t referenceLength = 2000;
+    int64_t depth = 20;
+    int64_t repeats = 5;
+    int64_t seed = 1;
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "help", no_argument, 0, 'h' },
+                { "params", required_argument, 0, 'p' },
+                { "length", required_argument, 0, 'l' },
+                { "depth", required_argument, 0, 'd' },
+                { "repeats", required_argument, 0, 'r' },
+                { "seed", required_argument, 0, 's' },
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int key = getopt_long(argc, argv, "hp:l:d:r:s:", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+        case 'p':
+            free(paramsFile);
+            paramsFile = stString_copy(optarg);
+            break;
+        case 'l':
+            referenceLength = atol(optarg);
+            break;
+        case 'd':
+            depth = atol(optarg);
+            break;
+        case 'r':
+            repeats = atol(optarg);
+            break;
+        case 's':
+            seed = atol(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            free(paramsFile);
+            return 0;
+        }
+    }
+    if (referenceLength <= 0 || depth <= 0 || repeats <= 0) {
+        st_errAbort("Length, depth and repeats must be greater than zero\n");
+    }
+    if (access(paramsFile, R_OK ) != 0) {
+        st_errAbort("Could not read from file: %s\n", paramsFile);
+    }
+
+    // Setup
+    Params *params = params_readParams2(paramsFile, TRUE, FALSE);
+    if (params->polishParams->repeatSubMatrix == NULL) {
+        st_errAbort("Parameters file has no repeat count matrix: %s\n", paramsFile);
+    }
+    st_randomSeed(seed);
+    PolishBenchmarkState *state = polishBenchmarkState_construct(params->polishParams, referenceLength, depth);
+
+    fprintf(stdout, "# reference length: %"PRId64", depth: %"PRId64", repeats: %"PRId64", seed: %"PRId64", params: %s\n",
+            referenceLength, depth, repeats, seed, paramsFile);
+    benchmark_checkAllocationCounting();
+    benchmark_printHeader(stdout);
+    benchmark_run(stdout, "rleString_construct", benchmark_rleStringConstruct, state, repeats);
+    benchmark_run(stdout, "getAlignedPairsWithIndelsUsingAnchors", benchmark_getAlignedPairsWithIndelsUsingAnchors,
+                  state, repeats);
+    benchmark_run(stdout, "poa_getAnchorAlignments", benchmark_poaGetAnchorAlignments, state, repeats);
+    benchmark_run(stdout, "poa_getAnchorAlignments_arena", benchmark_poaGetAnchorAlignmentsFromArena, state,
+                  repeats);
+    benchmark_run(stdout, "poa_augment", benchmark_poaAugment, state, repeats);
+    benchmark_run(stdout, "poa_getConsensus", benchmark_poaGetConsensus, state, repeats);
+    benchmark_run(stdout, "repeatSubMatrix_getMLRepeatCount", benchmark_repeatSubMatrixGetMLRepeatCount, state,
+                  repeats);
+    benchmark_run(stdout, "expandRLEConsensus", benchmark_expandRLEConsensus, state, repeats);
+
+    // Cleanup
+    polishBenchmarkState_destruct(state);
+    params_destruct(params);
+    free(paramsFile);
+
+    return 0;
+}
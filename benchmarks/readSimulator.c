@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "htsIntegration.h"
+#include "readSimulator.h"
+
+static const char *simulatorBases = "ACGT";
+
+char *simulator_getRandomReference(int64_t length) {
+    char *reference = st_malloc((length + 1) * sizeof(char));
+    for (int64_t i = 0; i < length; i++) {
+        reference[i] = simulatorBases[st_randomInt(0, 4)];
+    }
+    reference[length] = '\0';
+    return reference;
+}
+
+static char substituteBase(char base) {
+    char newBase;
+    do {
+        newBase = simulatorBases[st_randomInt(0, 4)];
+    } while (newBase == toupper(base));
+    return newBase;
+}
+
+char *simulator_evolve(char *seq, SimulatorErrorModel *errorModel, int64_t *seqToEvolvedMap) {
+    int64_t length = strlen(seq);
+    // each homopolymer run gains at most one base
+    char *evolved = st_malloc((2 * length + 1) * sizeof(char));
+    int64_t j = 0;
+    for (int64_t i = 0; i < length;) {
+        // find the homopolymer run starting at i
+        int64_t runEnd = i + 1;
+        while (runEnd < length && toupper(seq[runEnd]) == toupper(seq[i])) {
+            runEnd++;
+        }
+
+        // lengthen or shorten the run by one
+        int64_t runLengthChange = 0;
+        if (st_random() < errorModel->homopolymerIndelRate) {
+            runLengthChange = st_random() < 0.5 ? -1 : 1;
+        }
+
+        for (int64_t k = i; k < runEnd; k++) {
+            if (runLengthChange == -1 && k == runEnd - 1) {
+                if (seqToEvolvedMap != NULL) {
+                    seqToEvolvedMap[k] = -1;
+                }
+                continue;
+            }
+            if (seqToEvolvedMap != NULL) {
+                seqToEvolvedMap[k] = j;
+            }
+            evolved[j++] = st_random() < errorModel->substitutionRate ? substituteBase(seq[k]) : seq[k];
+        }
+        if (runLengthChange == 1) {
+            evolved[j++] = seq[i];
+        }
+
+        i = runEnd;
+    }
+    evolved[j] = '\0';
+    return evolved;
+}
+
+static char *getCigar(int64_t *fragmentToDraftMap, int64_t *fragmentToReadMap, int64_t fragmentLength,
+                      int64_t readLength, int64_t *draftStart) {
+    /*
+     * Composes the histories of the draft and a read, both derived from a fragment of the truth, into an alignment
+     * of the read to the draft. Returns NULL if no base of the fragment survives in both.
+     */
+    // one op per read base and per draft base in the aligned interval, which is at most twice the fragment
+    char *ops = st_malloc((readLength + 2 * fragmentLength + 1) * sizeof(char));
+    int64_t opNumber = 0, previousReadPosition = -1, previousDraftPosition = -1;
+    for (int64_t i = 0; i < fragmentLength; i++) {
+        int64_t draftPosition = fragmentToDraftMap[i], readPosition = fragmentToReadMap[i];
+        if (draftPosition == -1 || readPosition == -1) {
+            continue;
+        }
+        if (previousDraftPosition == -1) {
+            // read bases before the first aligned base are soft clipped
+            *draftStart = draftPosition;
+            for (int64_t k = 0; k < readPosition; k++) {
+                ops[opNumber++] = 'S';
+            }
+        } else {
+            // bases between this and the previous aligned pair are insertions and deletions
+            for (int64_t k = previousReadPosition + 1; k < readPosition; k++) {
+                ops[opNumber++] = 'I';
+            }
+            for (int64_t k = previousDraftPosition + 1; k < draftPosition; k++) {
+                ops[opNumber++] = 'D';
+            }
+        }
+        ops[opNumber++] = 'M';
+        previousReadPosition = readPosition;
+        previousDraftPosition = draftPosition;
+    }
+    if (previousDraftPosition == -1) {
+        free(ops);
+        return NULL;
+    }
+    for (int64_t k = previousReadPosition + 1; k < readLength; k++) {
+        ops[opNumber++] = 'S';
+    }
+
+    // run length encode the ops
+    char *cigar = st_malloc((12 * opNumber + 1) * sizeof(char));
+    int64_t cigarLength = 0;
+    for (int64_t i = 0; i < opNumber;) {
+        int64_t j = i + 1;
+        while (j < opNumber && ops[j] == ops[i]) {
+            j++;
+        }
+        cigarLength += sprintf(cigar + cigarLength, "%" PRId64 "%c", j - i, ops[i]);
+        i = j;
+    }
+    cigar[cigarLength] = '\0';
+
+    free(ops);
+    return cigar;
+}
+
+SimulatedReads *simulatedReads_construct(char *contigName, char *truth, SimulatorParams *params) {
+    SimulatedReads *simulatedReads = st_calloc(1, sizeof(SimulatedReads));
+    simulatedReads->contigName = stString_copy(contigName);
+    simulatedReads->truth = stString_copy(truth);
+    simulatedReads->readNames = stList_construct3(0, free);
+    simulatedReads->reads = stList_construct3(0, free);
+    simulatedReads->readStrands = stList_construct();
+    simulatedReads->readStarts = stList_construct();
+    simulatedReads->readCigars = stList_construct3(0, free);
+
+    // the draft
+    int64_t truthLength = strlen(truth);
+    int64_t *truthToDraftMap = st_malloc(truthLength * sizeof(int64_t));
+    simulatedReads->draft = simulator_evolve(truth, &params->draftErrors, truthToDraftMap);
+
+    // reads from the truth until the depth is reached
+    int64_t basesToSimulate = params->depth * truthLength;
+    int64_t minReadLength = params->readLength / 2 < 1 ? 1 : params->readLength / 2;
+    while (basesToSimulate > 0) {
+        int64_t fragmentLength = st_randomInt(minReadLength, 3 * params->readLength / 2 + 1);
+        if (fragmentLength > truthLength) {
+            fragmentLength = truthLength;
+        }
+        int64_t fragmentStart = st_randomInt(0, truthLength - fragmentLength + 1);
+        basesToSimulate -= fragmentLength;
+
+        char *fragment = stString_getSubString(truth, fragmentStart, fragmentLength);
+        int64_t *fragmentToReadMap = st_malloc(fragmentLength * sizeof(int64_t));
+        char *read = simulator_evolve(fragment, &params->readErrors, fragmentToReadMap);
+        int64_t draftStart = -1;
+        char *cigar = getCigar(&truthToDraftMap[fragmentStart], fragmentToReadMap, fragmentLength, strlen(read),
+                               &draftStart);
+        if (cigar == NULL) {
+            free(read);
+        } else {
+            stList_append(simulatedReads->readNames, stString_print("read_%" PRId64,
+                                                                    stList_length(simulatedReads->reads)));
+            stList_append(simulatedReads->reads, read);
+            stList_append(simulatedReads->readStrands, st_random() < 0.5 ? (void *) 1 : NULL);
+            stList_append(simulatedReads->readStarts, (void *) draftStart);
+            stList_append(simulatedReads->readCigars, cigar);
+        }
+
+        // Cleanup
+        free(fragment);
+        free(fragmentToReadMap);
+    }
+
+    // Cleanup
+    free(truthToDraftMap);
+
+    return simulatedReads;
+}
+
+void simulatedReads_destruct(SimulatedReads *simulatedReads) {
+    free(simulatedReads->contigName);
+    free(simulatedReads->truth);
+    free(simulatedReads->draft);
+    stList_destruct(simulatedReads->readNames);
+    stList_destruct(simulatedReads->reads);
+    stList_destruct(simulatedReads->readStrands);
+    stList_destruct(simulatedReads->readStarts);
+    stList_destruct(simulatedReads->readCigars);
+    free(simulatedReads);
+}
+
+void simulatedReads_writeFasta(char *sequence, char *contigName, char *fastaFile) {
+    FILE *fh = fopen(fastaFile, "w");
+    if (fh == NULL) {
+        st_errAbort("Could not open %s for writing\n", fastaFile);
+    }
+    fastaWrite(sequence, contigName, fh);
+    fclose(fh);
+}
+
+typedef struct _readStart {
+    int64_t start;
+    int64_t readIndex;
+} ReadStart;
+
+static int readStart_cmp(const void *a, const void *b) {
+    const ReadStart *i = a, *j = b;
+    if (i->start != j->start) {
+        return i->start < j->start ? -1 : 1;
+    }
+    return i->readIndex < j->readIndex ? -1 : (i->readIndex > j->readIndex ? 1 : 0);
+}
+
+void simulatedReads_writeBam(SimulatedReads *simulatedReads, char *bamFile) {
+    // header
+    char *headerText = stString_print("@HD\tVN:1.5\tSO:coordinate\n@SQ\tSN:%s\tLN:%" PRId64 "\n",
+                                      simulatedReads->contigName, (int64_t) strlen(simulatedReads->draft));
+    bam_hdr_t *bamHdr = sam_hdr_parse(strlen(headerText), headerText);
+    if (bamHdr == NULL) {
+        st_errAbort("Could not create BAM header for %s\n", bamFile);
+    }
+    if (bamHdr->l_text == 0) {
+        // the header owns its text
+        bamHdr->l_text = strlen(headerText);
+        bamHdr->text = headerText;
+    } else {
+        free(headerText);
+    }
+
+    samFile *out = hts_open(bamFile, "wb");
+    if (out == NULL) {
+        st_errAbort("Could not open %s for writing\n", bamFile);
+    }
+    if (sam_hdr_write(out, bamHdr) != 0) {
+        st_errAbort("Could not write header to %s\n", bamFile);
+    }
+
+    // reads, in coordinate order
+    int64_t readNumber = stList_length(simulatedReads->reads);
+    ReadStart *readStarts = st_malloc(readNumber * sizeof(ReadStart));
+    for (int64_t i = 0; i < readNumber; i++) {
+        readStarts[i].start = (int64_t) stList_get(simulatedReads->readStarts, i);
+        readStarts[i].readIndex = i;
+    }
+    qsort(readStarts, readNumber, sizeof(ReadStart), readStart_cmp);
+
+    bam1_t *aln = bam_init1();
+    kstring_t line = { 0, 0, NULL };
+    for (int64_t i = 0; i < readNumber; i++) {
+        int64_t j = readStarts[i].readIndex;
+        line.l = 0;
+        ksprintf(&line, "%s\t%d\t%s\t%" PRId64 "\t60\t%s\t*\t0\t0\t%s\t*",
+                 (char *) stList_get(simulatedReads->readNames, j),
+                 stList_get(simulatedReads->readStrands, j) != NULL ? 0 : BAM_FREVERSE,
+                 simulatedReads->contigName, readStarts[i].start + 1,
+                 (char *) stList_get(simulatedReads->readCigars, j), (char *) stList_get(simulatedReads->reads, j));
+        if (sam_parse1(&line, bamHdr, aln) < 0) {
+            st_errAbort("Could not encode simulated read %s\n", (char *) stList_get(simulatedReads->readNames, j));
+        }
+        if (sam_write1(out, bamHdr, aln) < 0) {
+            st_errAbort("Could not write to %s\n", bamFile);
+        }
+    }
+
+    // Cleanup
+    free(line.s);
+    free(readStarts);
+    bam_destroy1(aln);
+    bam_hdr_destroy(bamHdr);
+    hts_close(out);
+
+    if (sam_index_build(bamFile, 0) != 0) {
+        st_errAbort("Could not index %s\n", bamFile);
+    }
+}
+
+static int64_t bandedEditDistance(char *seq1, int64_t length1, char *seq2, int64_t length2, int64_t band) {
+    /*
+     * Edit distance restricted to cells within band of the diagonal, so the result is exact if it is at most band.
+     * Returns band + 1 if the distance exceeds the band.
+     */
+    int64_t width = 2 * band + 1, outOfBand = band + 1;
+    int64_t *previousRow = st_malloc(width * sizeof(int64_t));
+    int64_t *row = st_malloc(width * sizeof(int64_t));
+
+    // row i holds columns j = i - band ... i + band, at offset j - i + band
+    for (int64_t k = 0; k < width; k++) {
+        int64_t j = k - band;
+        previousRow[k] = j >= 0 && j <= length2 ? j : outOfBand;
+    }
+    for (int64_t i = 1; i <= length1; i++) {
+        for (int64_t k = 0; k < width; k++) {
+            int64_t j = i + k - band;
+            if (j < 0 || j > length2) {
+                row[k] = outOfBand;
+                continue;
+            }
+            if (j == 0) {
+                row[k] = i;
+                continue;
+            }
+            // diagonal is previousRow[k], up is previousRow[k + 1], left is row[k - 1]
+            int64_t d = previousRow[k] + (toupper(seq1[i - 1]) == toupper(seq2[j - 1]) ? 0 : 1);
+            if (k + 1 < width && previousRow[k + 1] + 1 < d) {
+                d = previousRow[k + 1] + 1;
+            }
+            if (k > 0 && row[k - 1] + 1 < d) {
+                d = row[k - 1] + 1;
+            }
+            row[k] = d > outOfBand ? outOfBand : d;
+        }
+        int64_t *swap = previousRow;
+        previousRow = row;
+        row = swap;
+    }
+
+    int64_t k = length2 - length1 + band;
+    int64_t distance = k >= 0 && k < width ? previousRow[k] : outOfBand;
+
+    free(previousRow);
+    free(row);
+    return distance;
+}
+
+int64_t simulator_editDistance(char *seq1, char *seq2) {
+    int64_t length1 = strlen(seq1), length2 = strlen(seq2);
+    int64_t band = llabs(length1 - length2) + 16;
+    while (1) {
+        int64_t distance = bandedEditDistance(seq1, length1, seq2, length2, band);
+        if (distance <= band) {
+            return distance;
+        }
+        band *= 2;
+    }
+}
+
+double simulator_identity(char *truth, char *seq) {
+    int64_t truthLength = strlen(truth);
+    if (truthLength == 0) {
+        return strlen(seq) == 0 ? 1.0 : 0.0;
+    }
+    return 1.0 - (double) simulator_editDistance(truth, seq) / truthLength;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef MARGIN_READ_SIMULATOR_H
+#define MARGIN_READ_SIMULATOR_H
+
+#include "margin.h"
+
+/*
+ * Error model used to derive the draft assembly and the reads from the true sequence.
+ */
+typedef struct _simulatorErrorModel {
+    double substitutionRate; // probability a base is replaced by a different base
+    double homopolymerIndelRate; // probability a homopolymer run (of any length) is lengthened or shortened by one
+} SimulatorErrorModel;
+
+typedef struct _simulatorParams {
+    SimulatorErrorModel draftErrors;
+    SimulatorErrorModel readErrors;
+    int64_t depth; // mean coverage of the truth by reads
+    int64_t readLength; // mean read length, lengths are uniform in [readLength/2, 3*readLength/2]
+} SimulatorParams;
+
+/*
+ * A simulated data set: the truth, a draft assembly of it and reads aligned to the draft.
+ */
+typedef struct _simulatedReads {
+    char *contigName;
+    char *truth;
+    char *draft;
+    stList *readNames;
+    stList *reads; // read sequences, in draft orientation
+    stList *readStrands; // (void *) 1 for forward strand, NULL for reverse
+    stList *readStarts; // 0-based start of each alignment on the draft, as (void *) int64_t
+    stList *readCigars; // cigar string of each alignment to the draft
+} SimulatedReads;
+
+/*
+ * Returns a random ACGT sequence of the given length.
+ */
+char *simulator_getRandomReference(int64_t length);
+
+/*
+ * Returns a copy of seq with errors applied according to errorModel. If seqToEvolvedMap is not NULL it is filled in
+ * with, for each position in seq, its position in the returned sequence, or -1 if it was deleted.
+ */
+char *simulator_evolve(char *seq, SimulatorErrorModel *errorModel, int64_t *seqToEvolvedMap);
+
+/*
+ * Simulates a draft of the truth and reads from the truth, aligned to the draft through their known histories.
+ * The truth is copied.
+ */
+SimulatedReads *simulatedReads_construct(char *contigName, char *truth, SimulatorParams *params);
+
+void simulatedReads_destruct(SimulatedReads *simulatedReads);
+
+/*
+ * Writes the truth or draft as a single contig fasta file.
+ */
+void simulatedReads_writeFasta(char *sequence, char *contigName, char *fastaFile);
+
+/*
+ * Writes the reads as a sorted and indexed BAM aligned to the draft.
+ */
+void simulatedReads_writeBam(SimulatedReads *simulatedReads, char *bamFile);
+
+/*
+ * Returns the edit distance between two sequences, using a band that is doubled until the result is exact.
+ */
+int64_t simulator_editDistance(char *seq1, char *seq2);
+
+/*
+ * Returns 1 - editDistance(truth, seq) / length(truth).
+ */
+double simulator_identity(char *truth, char *seq);
+
+#endif // MARGIN_READ_SIMULATOR_H
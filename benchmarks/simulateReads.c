@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "margin.h"
+#include "readSimulator.h"
+
+/*
+ * Simulates a marginPolish input: a draft assembly of a true sequence and reads aligned to the draft.
+ */
+
+void usage() {
+    fprintf(stderr, "usage: simulateReads <OUTPUT_BASE> [options]\n");
+    fprintf(stderr, "Simulates a draft assembly and reads from a true sequence, writing OUTPUT_BASE.truth.fa,\n");
+    fprintf(stderr, "OUTPUT_BASE.draft.fa and OUTPUT_BASE.bam (indexed, the reads aligned to the draft).\n");
+
+    fprintf(stderr, "\nDefault options:\n");
+    fprintf(stderr, "    -h --help                     : Print this help screen\n");
+    fprintf(stderr, "    -r --reference                : True sequence, the first contig of this fasta [default = random]\n");
+    fprintf(stderr, "    -l --length                   : Length of the random true sequence [default = 100000]\n");
+    fprintf(stderr, "    -d --depth                    : Read coverage depth [default = 30]\n");
+    fprintf(stderr, "    -L --readLength               : Mean read length [default = 10000]\n");
+    fprintf(stderr, "    -s --substitutionRate         : Read substitution rate [default = 0.02]\n");
+    fprintf(stderr, "    -i --homopolymerIndelRate     : Read homopolymer indel rate, per run [default = 0.05]\n");
+    fprintf(stderr, "    -S --draftSubstitutionRate    : Draft substitution rate [default = 0.002]\n");
+    fprintf(stderr, "    -I --draftHomopolymerIndelRate: Draft homopolymer indel rate, per run [default = 0.01]\n");
+    fprintf(stderr, "    -e --seed                     : Random seed [default = 1]\n");
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 2) {
+        usage();
+        return 0;
+    }
+    if (stString_eq(argv[1], "-h") || stString_eq(argv[1], "--help")) {
+        usage();
+        return 0;
+    }
+
+    // Parameters / arguments
+    char *outputBase = stString_copy(argv[1]);
+    char *referenceFile = NULL;
+    int64_t referenceLength = 100000;
+    int64_t seed = 1;
+    SimulatorParams params;
+    params.depth = 30;
+    params.readLength = 10000;
+    params.readErrors.substitutionRate = 0.02;
+    params.readErrors.homopolymerIndelRate = 0.05;
+    params.draftErrors.substitutionRate = 0.002;
+    params.draftErrors.homopolymerIndelRate = 0.01;
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "help", no_argument, 0, 'h' },
+                { "reference", required_argument, 0, 'r' },
+                { "length", required_argument, 0, 'l' },
+                { "depth", required_argument, 0, 'd' },
+                { "readLength", required_argument, 0, 'L' },
+                { "substitutionRate", required_argument, 0, 's' },
+                { "homopolymerIndelRate", required_argument, 0, 'i' },
+                { "draftSubstitutionRate", required_argument, 0, 'S' },
+                { "draftHomopolymerIndelRate", required_argument, 0, 'I' },
+                { "seed", required_argument, 0, 'e' },
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int key = getopt_long(argc - 1, &argv[1], "hr:l:d:L:s:i:S:I:e:", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+        case 'r':
+            referenceFile = stString_copy(optarg);
+            break;
+        case 'l':
+            referenceLength = atol(optarg);
+            break;
+        case 'd':
+            params.depth = atol(optarg);
+            break;
+        case 'L':
+            params.readLength = atol(optarg);
+            break;
+        case 's':
+            params.readErrors.substitutionRate = atof(optarg);
+            break;
+        case 'i':
+            params.readErrors.homopolymerIndelRate = atof(optarg);
+            break;
+        case 'S':
+            params.draftErrors.substitutionRate = atof(optarg);
+            break;
+        case 'I':
+            params.draftErrors.homopolymerIndelRate = atof(optarg);
+            break;
+        case 'e':
+            seed = atol(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            free(outputBase);
+            return 0;
+        }
+    }
+    if (referenceLength <= 0 || params.depth <= 0 || params.readLength <= 0) {
+        st_errAbort("Length, depth and read length must be greater than zero\n");
+    }
+
+    // Setup
+    st_randomSeed(seed);
+    char *contigName = stString_copy("contig");
+    char *truth = NULL;
+    if (referenceFile != NULL) {
+        if (access(referenceFile, R_OK) != 0) {
+            st_errAbort("Could not read from file: %s\n", referenceFile);
+        }
+        struct List *seqs = constructEmptyList(0, free);
+        struct List *seqLengths = constructEmptyList(0, free);
+        struct List *headers = constructEmptyList(0, free);
+        FILE *fh = fopen(referenceFile, "r");
+        fastaRead(fh, seqs, seqLengths, headers);
+        fclose(fh);
+        if (seqs->length == 0) {
+            st_errAbort("No sequences in %s\n", referenceFile);
+        }
+        truth = stString_copy(seqs->list[0]);
+        char name[128] = "";
+        if (sscanf(headers->list[0], "%127s", name) == 1) {
+            free(contigName);
+            contigName = stString_copy(name);
+        }
+        // the simulator works on ACGT, anything else is replaced at random
+        for (int64_t i = 0; truth[i] != '\0'; i++) {
+            truth[i] = toupper(truth[i]);
+            if (strchr("ACGT", truth[i]) == NULL) {
+                truth[i] = "ACGT"[st_randomInt(0, 4)];
+            }
+        }
+        destructList(seqs);
+        destructList(seqLengths);
+        destructList(headers);
+    } else {
+        truth = simulator_getRandomReference(referenceLength);
+    }
+
+    // Simulate and write
+    SimulatedReads *simulatedReads = simulatedReads_construct(contigName, truth, &params);
+    char *truthFile = stString_print("%s.truth.fa", outputBase);
+    char *draftFile = stString_print("%s.draft.fa", outputBase);
+    char *bamFile = stString_print("%s.bam", outputBase);
+    simulatedReads_writeFasta(simulatedReads->truth, contigName, truthFile);
+    simulatedReads_writeFasta(simulatedReads->draft, contigName, draftFile);
+    simulatedReads_writeBam(simulatedReads, bamFile);
+    fprintf(stderr, "Simulated %" PRId64 " reads from a %" PRId64 "bp truth, draft identity %f\n",
+            stList_length(simulatedReads->reads), (int64_t) strlen(truth),
+            simulator_identity(simulatedReads->truth, simulatedReads->draft));
+
+    // Cleanup
+    simulatedReads_destruct(simulatedReads);
+    free(truthFile);
+    free(draftFile);
+    free(bamFile);
+    free(truth);
+    free(contigName);
+    free(outputBase);
+    if (referenceFile != NULL) {
+        free(referenceFile);
+    }
+
+    return 0;
+}
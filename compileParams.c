@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "marginVersion.h"
+#include "margin.h"
+
+
+/*
+ * Main functions
+ */
+
+void usage() {
+    fprintf(stderr, "usage: compileParams <JSON_PARAMS> <BINARY_PARAMS> [options]\n");
+    fprintf(stderr, "Version: %s \n\n", MARGIN_POLISH_VERSION_H);
+    fprintf(stderr, "Compiles a json parameters file into a binary parameters file which loads faster.  The binary\n");
+    fprintf(stderr, "file may be given to marginPolish and marginPhase in place of the json file.  It is specific\n");
+    fprintf(stderr, "to the build which compiled it and should be recompiled after upgrading.\n");
+
+    fprintf(stderr, "\nRequired arguments:\n");
+    fprintf(stderr, "    JSON_PARAMS is the file with marginPolish and/or marginPhase parameters.\n");
+    fprintf(stderr, "    BINARY_PARAMS is the output file.\n");
+
+    fprintf(stderr, "\nDefault options:\n");
+    fprintf(stderr, "    -h --help                : Print this help screen\n");
+    fprintf(stderr, "    -a --logLevel            : Set the log level [default = info]\n");
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+
+    // Parameters / arguments
+    char *logLevelString = stString_copy("info");
+
+    if(argc < 3) {
+        free(logLevelString);
+        usage();
+        return 0;
+    }
+
+    char *jsonParamsFile = stString_copy(argv[1]);
+    char *binaryParamsFile = stString_copy(argv[2]);
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "logLevel", required_argument, 0, 'a' },
+                { "help", no_argument, 0, 'h' },
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int key = getopt_long(argc-1, &argv[1], "a:h", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+        case 'a':
+            free(logLevelString);
+            logLevelString = stString_copy(optarg);
+            break;
+        case 'h':
+        default:
+            usage();
+            free(logLevelString);
+            free(jsonParamsFile);
+            free(binaryParamsFile);
+            return 0;
+        }
+    }
+
+    // sanity check (verify files exist)
+    if (access(jsonParamsFile, R_OK ) != 0) {
+        st_errAbort("Could not read from file: %s\n", jsonParamsFile);
+    } else if (params_isBinary(jsonParamsFile)) {
+        st_errAbort("Parameters file is already compiled: %s\n", jsonParamsFile);
+    }
+
+    // Initialization from arguments
+    st_setLogLevelFromString(logLevelString);
+    free(logLevelString);
+
+    st_logInfo("> Compiling parameters from %s into %s\n", jsonParamsFile, binaryParamsFile);
+    params_compileBinary(jsonParamsFile, binaryParamsFile);
+    st_logInfo("> Finished compiling parameters.\n");
+
+    // Cleanup
+    free(jsonParamsFile);
+    free(binaryParamsFile);
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "margin.h"
+#include "alignmentCache.h"
+
+#define ALIGNMENT_CACHE_MAGIC "MPAC0001"
+#define ALIGNMENT_CACHE_MAGIC_LENGTH 8
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/*
+ * The posteriors of one read, as flat (prob, refPos, readPos) triples for the matches, inserts and deletes.
+ */
+typedef struct _alignmentCacheEntry {
+    int64_t lengths[3];
+    int64_t *pairs[3];
+    bool used; // looked up or added in this run, so written back
+} AlignmentCacheEntry;
+
+static void alignmentCacheEntry_destruct(AlignmentCacheEntry *entry) {
+    for (int64_t i = 0; i < 3; i++) {
+        free(entry->pairs[i]);
+    }
+    free(entry);
+}
+
+static char *getEntryName(char *readId, uint64_t key) {
+    return stString_print("%s:%016" PRIx64, readId, key);
+}
+
+static bool readEntries(AlignmentCache *cache, FILE *fh) {
+    // Returns FALSE if the file is truncated or malformed
+    int64_t nameLength;
+    while (fread(&nameLength, sizeof(int64_t), 1, fh) == 1) {
+        if (nameLength <= 0) {
+            return FALSE;
+        }
+        char *name = st_malloc(nameLength + 1);
+        AlignmentCacheEntry *entry = st_calloc(1, sizeof(AlignmentCacheEntry));
+        bool ok = fread(name, sizeof(char), nameLength, fh) == nameLength &&
+                  fread(entry->lengths, sizeof(int64_t), 3, fh) == 3;
+        name[nameLength] = '\0';
+        for (int64_t i = 0; ok && i < 3; i++) {
+            ok = entry->lengths[i] >= 0;
+            if (ok) {
+                entry->pairs[i] = st_malloc(3 * entry->lengths[i] * sizeof(int64_t) + 1);
+                ok = fread(entry->pairs[i], sizeof(int64_t), 3 * entry->lengths[i], fh) == 3 * entry->lengths[i];
+            }
+        }
+        if (!ok) {
+            free(name);
+            alignmentCacheEntry_destruct(entry);
+            return FALSE;
+        }
+        stHash_insert(cache->entries, name, entry);
+    }
+    return feof(fh);
+}
+
+AlignmentCache *alignmentCache_construct(char *cacheFile, uint64_t paramsFingerprint) {
+    AlignmentCache *cache = st_calloc(1, sizeof(AlignmentCache));
+    cache->cacheFile = stString_copy(cacheFile);
+    cache->paramsFingerprint = paramsFingerprint;
+    cache->entries = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free,
+                                       (void (*)(void *)) alignmentCacheEntry_destruct);
+
+    FILE *fh = fopen(cacheFile, "rb");
+    if (fh == NULL) {
+        return cache;
+    }
+    char magic[ALIGNMENT_CACHE_MAGIC_LENGTH];
+    uint64_t fingerprint;
+    if (fread(magic, sizeof(char), ALIGNMENT_CACHE_MAGIC_LENGTH, fh) != ALIGNMENT_CACHE_MAGIC_LENGTH ||
+        memcmp(magic, ALIGNMENT_CACHE_MAGIC, ALIGNMENT_CACHE_MAGIC_LENGTH) != 0 ||
+        fread(&fingerprint, sizeof(uint64_t), 1, fh) != 1) {
+        st_logInfo("  Ignoring alignment cache file with an unrecognised format: %s\n", cacheFile);
+    } else if (fingerprint != paramsFingerprint) {
+        st_logInfo("  Ignoring alignment cache file written with different parameters: %s\n", cacheFile);
+    } else if (!readEntries(cache, fh)) {
+        st_logInfo("  Ignoring truncated alignment cache file: %s\n", cacheFile);
+        stHash_destruct(cache->entries);
+        cache->entries = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free,
+                                           (void (*)(void *)) alignmentCacheEntry_destruct);
+    }
+    fclose(fh);
+    return cache;
+}
+
+void alignmentCache_destruct(AlignmentCache *cache) {
+    stHash_destruct(cache->entries);
+    free(cache->cacheFile);
+    free(cache);
+}
+
+void alignmentCache_write(AlignmentCache *cache) {
+    // Write to a temporary file and rename, so an interrupted run leaves the previous cache file intact. The
+    // temporary file is made unique by mkstemp, so concurrent writers of the same cache file can't interleave
+    char *tempFile = stString_print("%s.XXXXXX", cache->cacheFile);
+    int fd = mkstemp(tempFile);
+    FILE *fh = fd == -1 ? NULL : fdopen(fd, "wb");
+    if (fh == NULL) {
+        st_errAbort("Could not write alignment cache file: %s\n", tempFile);
+    }
+    fwrite(ALIGNMENT_CACHE_MAGIC, sizeof(char), ALIGNMENT_CACHE_MAGIC_LENGTH, fh);
+    fwrite(&cache->paramsFingerprint, sizeof(uint64_t), 1, fh);
+
+    stHashIterator *it = stHash_getIterator(cache->entries);
+    char *name;
+    while ((name = stHash_getNext(it)) != NULL) {
+        AlignmentCacheEntry *entry = stHash_search(cache->entries, name);
+        if (!entry->used) {
+            continue;
+        }
+        int64_t nameLength = strlen(name);
+        fwrite(&nameLength, sizeof(int64_t), 1, fh);
+        fwrite(name, sizeof(char), nameLength, fh);
+        fwrite(entry->lengths, sizeof(int64_t), 3, fh);
+        for (int64_t i = 0; i < 3; i++) {
+            fwrite(entry->pairs[i], sizeof(int64_t), 3 * entry->lengths[i], fh);
+        }
+    }
+    stHash_destructIterator(it);
+
+    if (fclose(fh) != 0 || rename(tempFile, cache->cacheFile) != 0) {
+        remove(tempFile);
+        st_errAbort("Could not write alignment cache file: %s\n", cache->cacheFile);
+    }
+    free(tempFile);
+}
+
+static uint64_t fnvHash(uint64_t hash, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t alignmentCache_getKey(char *refWindow, char *read, stList *anchorPairs) {
+    // The strings are hashed with their terminating null, so the boundary between them is part of the key
+    uint64_t hash = fnvHash(FNV_OFFSET_BASIS, refWindow, strlen(refWindow) + 1);
+    hash = fnvHash(hash, read, strlen(read) + 1);
+    for (int64_t i = 0; i < stList_length(anchorPairs); i++) {
+        stIntTuple *anchorPair = stList_get(anchorPairs, i);
+        int64_t anchor[3] = { stIntTuple_get(anchorPair, 0), stIntTuple_get(anchorPair, 1),
+                              stIntTuple_get(anchorPair, 2) };
+        hash = fnvHash(hash, anchor, sizeof(anchor));
+    }
+    return hash;
+}
+
+bool alignmentCache_get(AlignmentCache *cache, char *readId, uint64_t key,
+                        stList **matches, stList **inserts, stList **deletes) {
+    char *name = getEntryName(readId, key);
+    AlignmentCacheEntry *entry = stHash_search(cache->entries, name);
+    free(name);
+    if (entry == NULL) {
+        cache->misses++;
+        return FALSE;
+    }
+    cache->hits++;
+    entry->used = TRUE;
+
+    stList **lists[3] = { matches, inserts, deletes };
+    for (int64_t i = 0; i < 3; i++) {
+        *lists[i] = stList_construct3(entry->lengths[i], (void (*)(void *)) stIntTuple_destruct);
+        for (int64_t j = 0; j < entry->lengths[i]; j++) {
+            int64_t *pair = &entry->pairs[i][3 * j];
+            stList_set(*lists[i], j, stIntTuple_construct3(pair[0], pair[1], pair[2]));
+        }
+    }
+    return TRUE;
+}
+
+void alignmentCache_put(AlignmentCache *cache, char *readId, uint64_t key,
+                        stList *matches, stList *inserts, stList *deletes) {
+    // An entry of the same name, e.g. for a read appearing twice in the chunk, has the same inputs so is kept
+    char *name = getEntryName(readId, key);
+    AlignmentCacheEntry *existingEntry = stHash_search(cache->entries, name);
+    if (existingEntry != NULL) {
+        existingEntry->used = TRUE;
+        free(name);
+        return;
+    }
+
+    AlignmentCacheEntry *entry = st_calloc(1, sizeof(AlignmentCacheEntry));
+    entry->used = TRUE;
+    stList *lists[3] = { matches, inserts, deletes };
+    for (int64_t i = 0; i < 3; i++) {
+        entry->lengths[i] = stList_length(lists[i]);
+        entry->pairs[i] = st_malloc(3 * entry->lengths[i] * sizeof(int64_t) + 1);
+        for (int64_t j = 0; j < entry->lengths[i]; j++) {
+            stIntTuple *pair = stList_get(lists[i], j);
+            for (int64_t k = 0; k < 3; k++) {
+                entry->pairs[i][3 * j + k] = stIntTuple_get(pair, k);
+            }
+        }
+    }
+    stHash_insert(cache->entries, name, entry);
+}
+
+uint64_t alignmentCache_getParamsFingerprint(char *paramsFile) {
+    FILE *fh = fopen(paramsFile, "rb");
+    if (fh == NULL) {
+        st_errAbort("Could not read from file: %s\n", paramsFile);
+    }
+    uint64_t hash = FNV_OFFSET_BASIS;
+    char buffer[65536];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, sizeof(char), sizeof(buffer), fh)) > 0) {
+        hash = fnvHash(hash, buffer, bytesRead);
+    }
+    fclose(fh);
+    return hash;
+}
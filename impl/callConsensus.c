@@ -1,5 +1,8 @@
 #include <multipleAligner.h>
 #include "margin.h"
+#include "callConsensus.h"
+
+#define CONSENSUS_BACKBONE_KMER_SIZE 7
 
 
 // Make RLEStrings representing reads and list of the RLE strings
@@ -18,19 +21,188 @@ void destroyConsensusParameters(PolishParams *params) {
     polishParams_destruct(params);
 }
 
-RleString* callConsensus(int64_t readCount, char *nucleotides[], uint8_t *runLengths[], uint8_t strands[], PolishParams *params) {
-    stList *rleReads = stList_construct3(0, (void (*)(void*)) bamChunkRead_destruct);
-    stList *rleStrings = stList_construct3(0, (void (*)(void *)) rleString_destruct);
+/*
+ * Per-thread scratch space for consensus calling. The rle strings and reads are owned by the scratch and their
+ * buffers are only grown, so a thread calling consensus on many read sets allocates close to nothing after the
+ * first few sets.
+ */
+typedef struct _consensusScratch {
+    int64_t capacity;           // number of reads the scratch can currently hold
+    RleString *rleStrings;      // rle strings of the reads
+    int64_t *rleCapacities;     // allocated length of the rle buffers of each rle string
+    int64_t *nonRleCapacities;  // allocated length of the nonRleToRleCoordinateMap of each rle string
+    BamChunkRead *reads;        // reads, nucleotides are shared with the matching rle string
+} ConsensusScratch;
+
+static ConsensusScratch *consensusScratch_construct() {
+    return st_calloc(1, sizeof(ConsensusScratch));
+}
+
+static void consensusScratch_destruct(ConsensusScratch *scratch) {
+    for (int64_t i = 0; i < scratch->capacity; i++) {
+        RleString *rleString = &scratch->rleStrings[i];
+        free(rleString->rleString);
+        free(rleString->repeatCounts);
+        free(rleString->rleToNonRleCoordinateMap);
+        free(rleString->nonRleToRleCoordinateMap);
+    }
+    free(scratch->rleStrings);
+    free(scratch->rleCapacities);
+    free(scratch->nonRleCapacities);
+    free(scratch->reads);
+    free(scratch);
+}
+
+static void *consensusScratch_grow(void *buffer, int64_t oldLength, int64_t newLength, size_t elementSize) {
+    buffer = realloc(buffer, newLength * elementSize);
+    if (buffer == NULL) {
+        st_errAbort("Failed to allocate consensus scratch space");
+    }
+    memset(((char *) buffer) + oldLength * elementSize, 0, (newLength - oldLength) * elementSize);
+    return buffer;
+}
+
+static void consensusScratch_ensureCapacity(ConsensusScratch *scratch, int64_t readCount) {
+    if (readCount <= scratch->capacity) {
+        return;
+    }
+    scratch->rleStrings = consensusScratch_grow(scratch->rleStrings, scratch->capacity, readCount, sizeof(RleString));
+    scratch->rleCapacities = consensusScratch_grow(scratch->rleCapacities, scratch->capacity, readCount, sizeof(int64_t));
+    scratch->nonRleCapacities = consensusScratch_grow(scratch->nonRleCapacities, scratch->capacity, readCount, sizeof(int64_t));
+    scratch->reads = consensusScratch_grow(scratch->reads, scratch->capacity, readCount, sizeof(BamChunkRead));
+    scratch->capacity = readCount;
+}
+
+/*
+ * Fills the i-th rle string and read of the scratch, reusing the buffers of the previous read set.
+ */
+static void consensusScratch_fillRead(ConsensusScratch *scratch, int64_t i, char *rleChars, uint8_t *rleCounts,
+                                      bool forwardStrand) {
+    RleString *rleString = &scratch->rleStrings[i];
+    rleString_refillPreComputed(rleString, rleChars, rleCounts, &scratch->rleCapacities[i],
+                                &scratch->nonRleCapacities[i]);
+    // Reads are not named, the polisher only needs the nucleotides and strand
+    bamChunkRead_refill(&scratch->reads[i], NULL, rleString->rleString, NULL, forwardStrand, NULL);
+}
+
+static int cmpInt64(const void *a, const void *b) {
+    int64_t i = *(int64_t *) a, j = *(int64_t *) b;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
+
+/*
+ * Calls fn on the 2-bit encoding of every k-mer of the given string, skipping k-mers containing non-ACGT characters.
+ */
+static void forEachBackboneKmer(char *nucleotides, void (*fn)(uint64_t kmer, void *extra), void *extra) {
+    uint64_t kmer = 0, mask = (((uint64_t) 1) << (2 * CONSENSUS_BACKBONE_KMER_SIZE)) - 1;
+    int64_t validLength = 0;
+    for (int64_t i = 0; nucleotides[i] != '\0'; i++) {
+        uint64_t code;
+        switch (toupper(nucleotides[i])) {
+            case 'A': code = 0; break;
+            case 'C': code = 1; break;
+            case 'G': code = 2; break;
+            case 'T': code = 3; break;
+            default: validLength = 0; continue;
+        }
+        kmer = ((kmer << 2) | code) & mask;
+        if (++validLength >= CONSENSUS_BACKBONE_KMER_SIZE) {
+            fn(kmer, extra);
+        }
+    }
+}
+
+static void countBackboneKmer(uint64_t kmer, void *extra) {
+    stHash *kmerCounts = extra;
+    // keys are offset by one so the all-A k-mer is not stored as a NULL key
+    int64_t count = (int64_t) stHash_remove(kmerCounts, (void *) (kmer + 1)) + 1;
+    stHash_insert(kmerCounts, (void *) (kmer + 1), (void *) count);
+}
+
+typedef struct _backboneScore {
+    stHash *kmerCounts;
+    int64_t kmers;
+    int64_t support;
+} BackboneScore;
+
+static void scoreBackboneKmer(uint64_t kmer, void *extra) {
+    BackboneScore *score = extra;
+    score->kmers++;
+    // discount the read's own occurrence
+    score->support += (int64_t) stHash_search(score->kmerCounts, (void *) (kmer + 1)) - 1;
+}
+
+int64_t getConsensusBackboneIndex(int64_t readCount, char *nucleotides[]) {
+    /*
+     * Only reads with a length within the interquartile range of read lengths are candidates, so truncated or
+     * chimeric reads are never used. Of these, the read whose k-mers are shared with the most other reads is picked,
+     * as it is likely to have the fewest errors. Ties go to the read closest to the median length, then to the
+     * earliest read.
+     */
+    if (readCount <= 2) {
+        return 0;
+    }
 
+    int64_t *lengths = st_calloc(readCount, sizeof(int64_t));
+    int64_t *sortedLengths = st_calloc(readCount, sizeof(int64_t));
+    stHash *kmerCounts = stHash_construct();
     for (int64_t i = 0; i < readCount; i++) {
-        RleString *rleString = rleString_constructPreComputed(stString_copy(nucleotides[i]), runLengths[i]);
-        stList_append(rleStrings, rleString);
-        stList_append(rleReads, bamChunkRead_construct2(stString_print("read_%d", i), stString_copy(rleString->rleString),
-                NULL, (strands[i] == 0 ? TRUE : FALSE), NULL)); // strands defined as 0 -> forward, 1 -> backward
+        lengths[i] = strlen(nucleotides[i]);
+        sortedLengths[i] = lengths[i];
+        forEachBackboneKmer(nucleotides[i], countBackboneKmer, kmerCounts);
     }
+    qsort(sortedLengths, readCount, sizeof(int64_t), cmpInt64);
+    int64_t minLength = sortedLengths[(readCount - 1) / 4];
+    int64_t maxLength = sortedLengths[(3 * (readCount - 1)) / 4];
+    int64_t medianLength = sortedLengths[(readCount - 1) / 2];
 
-    // RLE reference starts as one of the input string
-    RleString *rleReference = stList_get(rleStrings, 0);
+    int64_t bestIndex = -1;
+    double bestScore = -1.0;
+    int64_t bestDistance = 0;
+    for (int64_t i = 0; i < readCount; i++) {
+        if (lengths[i] < minLength || lengths[i] > maxLength) {
+            continue;
+        }
+        BackboneScore score = { kmerCounts, 0, 0 };
+        forEachBackboneKmer(nucleotides[i], scoreBackboneKmer, &score);
+        double meanSupport = score.kmers == 0 ? 0.0 : (double) score.support / score.kmers;
+        int64_t distance = llabs(lengths[i] - medianLength);
+        if (meanSupport > bestScore || (meanSupport == bestScore && distance < bestDistance)) {
+            bestIndex = i;
+            bestScore = meanSupport;
+            bestDistance = distance;
+        }
+    }
+    assert(bestIndex >= 0);
+
+    // cleanup
+    free(lengths);
+    free(sortedLengths);
+    stHash_destruct(kmerCounts);
+
+    return bestIndex;
+}
+
+static RleString* callConsensus2(ConsensusScratch *scratch, int64_t readCount, char *nucleotides[],
+                                 uint8_t *runLengths[], uint8_t strands[], int64_t backboneIndex,
+                                 PolishParams *params) {
+    consensusScratch_ensureCapacity(scratch, readCount);
+
+    // the lists are views onto the scratch space, so have no destructors
+    stList *rleReads = stList_construct();
+    stList *rleStrings = stList_construct();
+    for (int64_t i = 0; i < readCount; i++) {
+        // strands defined as 0 -> forward, 1 -> backward
+        consensusScratch_fillRead(scratch, i, nucleotides[i], runLengths[i], strands[i] == 0 ? TRUE : FALSE);
+        stList_append(rleStrings, &scratch->rleStrings[i]);
+        stList_append(rleReads, &scratch->reads[i]);
+    }
+
+    // RLE reference starts as the input string most likely to be close to the consensus, unless one is given
+    if (backboneIndex < 0) {
+        backboneIndex = getConsensusBackboneIndex(readCount, nucleotides);
+    }
+    RleString *rleReference = stList_get(rleStrings, backboneIndex);
 
     // run poa
     Poa *poa = poa_realignAll(rleReads, NULL, rleReference->rleString, params);
@@ -46,7 +218,53 @@ RleString* callConsensus(int64_t readCount, char *nucleotides[], uint8_t *runLen
     return consensusRleString;
 }
 
+RleString* callConsensus(int64_t readCount, char *nucleotides[], uint8_t *runLengths[], uint8_t strands[], PolishParams *params) {
+    ConsensusScratch *scratch = consensusScratch_construct();
+    RleString *consensusRleString = callConsensus2(scratch, readCount, nucleotides, runLengths, strands, -1, params);
+    consensusScratch_destruct(scratch);
+    return consensusRleString;
+}
+
+RleString* callConsensusWithBackbone(int64_t readCount, char *nucleotides[], uint8_t *runLengths[], uint8_t strands[],
+                                     int64_t backboneIndex, PolishParams *params) {
+    assert(backboneIndex >= 0 && backboneIndex < readCount);
+    ConsensusScratch *scratch = consensusScratch_construct();
+    RleString *consensusRleString = callConsensus2(scratch, readCount, nucleotides, runLengths, strands,
+                                                   backboneIndex, params);
+    consensusScratch_destruct(scratch);
+    return consensusRleString;
+}
+
+RleString** callConsensusBatch(int64_t setCount, int64_t readCounts[], char **nucleotides[], uint8_t **runLengths[],
+                               uint8_t *strands[], PolishParams *params, int64_t numThreads) {
+    RleString **consensusRleStrings = st_calloc(setCount, sizeof(RleString*));
+
+    // each thread gets its own scratch space, the params are only read so may be shared
+    #pragma omp parallel num_threads(numThreads > 0 ? numThreads : 1)
+    {
+        ConsensusScratch *scratch = consensusScratch_construct();
+
+        #pragma omp for schedule(dynamic,1)
+        for (int64_t i = 0; i < setCount; i++) {
+            consensusRleStrings[i] = callConsensus2(scratch, readCounts[i], nucleotides[i], runLengths[i], strands[i],
+                                                    -1, params);
+        }
+
+        consensusScratch_destruct(scratch);
+    }
+
+    return consensusRleStrings;
+}
+
 void destroyRleString(RleString *r) {
     rleString_destruct(r);
 }
 
+void destroyRleStringBatch(int64_t setCount, RleString **r) {
+    for (int64_t i = 0; i < setCount; i++) {
+        if (r[i] != NULL) {
+            rleString_destruct(r[i]);
+        }
+    }
+    free(r);
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <sys/resource.h>
+
+#include "margin.h"
+#include "chunkReport.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static char *chunkStageNames[CHUNK_STAGE_COUNT] = {
+        "convertToReadsAndAlignments",
+        "poorMansDownsample",
+        "runLengthEncode",
+        "poa_realignAll",
+        "expandRLEConsensus",
+        "helenFeatures"
+};
+
+char *chunkStage_getName(ChunkStage stage) {
+    assert(stage >= 0 && stage < CHUNK_STAGE_COUNT);
+    return chunkStageNames[stage];
+}
+
+static double secondsSince(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1.0e9;
+}
+
+static int64_t getPeakRssKb() {
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+static int64_t getRssKb() {
+    FILE *fh = fopen("/proc/self/statm", "r");
+    if (fh == NULL) {
+        return -1;
+    }
+    long size, resident;
+    int64_t rssKb = -1;
+    if (fscanf(fh, "%ld %ld", &size, &resident) == 2) {
+        rssKb = (int64_t) resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    fclose(fh);
+    return rssKb;
+}
+
+void chunkReport_start(ChunkReport *report, int64_t chunkIdx, BamChunk *bamChunk) {
+    memset(report, 0, sizeof(ChunkReport));
+    report->chunkIdx = chunkIdx;
+    report->bamChunk = bamChunk;
+    report->readsIn = -1;
+    report->readsKept = -1;
+    report->poaNodes = -1;
+    report->poaObservations = 0;
+    #ifdef _OPENMP
+    report->threadIdx = omp_get_thread_num();
+    #endif
+    report->peakRssStartKb = getPeakRssKb();
+    clock_gettime(CLOCK_MONOTONIC, &report->chunkStartTime);
+}
+
+void chunkReport_setPoa(ChunkReport *report, Poa *poa) {
+    report->poaNodes = stList_length(poa->nodes);
+    report->poaObservations = 0;
+    for (int64_t i = 0; i < stList_length(poa->nodes); i++) {
+        PoaNode *node = stList_get(poa->nodes, i);
+        report->poaObservations += stList_length(node->observations);
+    }
+}
+
+void chunkReport_startStage(ChunkReport *report, ChunkStage stage) {
+    clock_gettime(CLOCK_MONOTONIC, &report->stageStartTime);
+}
+
+void chunkReport_endStage(ChunkReport *report, ChunkStage stage) {
+    report->stageSeconds[stage] += secondsSince(&report->stageStartTime);
+}
+
+struct _chunkReportWriter {
+    FILE *fh;
+};
+
+ChunkReportWriter *chunkReportWriter_construct(char *reportFile) {
+    ChunkReportWriter *writer = st_calloc(1, sizeof(ChunkReportWriter));
+    writer->fh = fopen(reportFile, "w");
+    if (writer->fh == NULL) {
+        st_errAbort("Could not open chunk report for writing: %s\n", reportFile);
+    }
+    fprintf(writer->fh, "chunk\tevent\tcontig\tstart\tend\tthread\treads_in\treads_kept\tpoa_nodes\tpoa_observations");
+    for (int64_t i = 0; i < CHUNK_STAGE_COUNT; i++) {
+        fprintf(writer->fh, "\t%s_s", chunkStageNames[i]);
+    }
+    fprintf(writer->fh, "\ttotal_s\tpeak_rss_start_kb\tpeak_rss_kb\trss_kb\n");
+    fflush(writer->fh);
+    return writer;
+}
+
+void chunkReportWriter_destruct(ChunkReportWriter *writer) {
+    if (writer == NULL) {
+        return;
+    }
+    fclose(writer->fh);
+    free(writer);
+}
+
+void chunkReportWriter_write(ChunkReportWriter *writer, ChunkReport *report, char *event) {
+    report->totalSeconds = secondsSince(&report->chunkStartTime);
+    report->peakRssKb = getPeakRssKb();
+    report->rssKb = getRssKb();
+    #pragma omp critical (chunkReportWriter)
+    {
+        fprintf(writer->fh, "%"PRId64"\t%s\t%s\t%"PRId64"\t%"PRId64"\t%d\t%"PRId64"\t%"PRId64"\t%"PRId64"\t%"PRId64,
+                report->chunkIdx, event, report->bamChunk->refSeqName, report->bamChunk->chunkBoundaryStart,
+                report->bamChunk->chunkBoundaryEnd, report->threadIdx, report->readsIn, report->readsKept,
+                report->poaNodes, report->poaObservations);
+        for (int64_t i = 0; i < CHUNK_STAGE_COUNT; i++) {
+            fprintf(writer->fh, "\t%.3f", report->stageSeconds[i]);
+        }
+        fprintf(writer->fh, "\t%.3f\t%"PRId64"\t%"PRId64"\t%"PRId64"\n", report->totalSeconds,
+                report->peakRssStartKb, report->peakRssKb, report->rssKb);
+        fflush(writer->fh);
+    }
+}
@@ -6,25 +6,140 @@
 
 #include "margin.h"
 
+static int64_t packedNucleotides_getCode(char c) {
+    switch (c) {
+        case 'A':
+            return 0;
+        case 'C':
+            return 1;
+        case 'G':
+            return 2;
+        case 'T':
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+PackedNucleotides *packedNucleotides_construct(char *nucleotides) {
+    PackedNucleotides *packed = st_calloc(1, sizeof(PackedNucleotides));
+    packed->length = strlen(nucleotides);
+    packed->bases = st_calloc((packed->length + 3) / 4, sizeof(uint8_t));
+    for (int64_t i = 0; i < packed->length; i++) {
+        int64_t code = packedNucleotides_getCode(nucleotides[i]);
+        if (code < 0) {
+            packed->maskedLength++;
+            code = 0;
+        }
+        packed->bases[i >> 2] |= (uint8_t) (code << ((i & 3) << 1));
+    }
+
+    // Masked bases are rare, so the mask is only made if there are any
+    if (packed->maskedLength > 0) {
+        packed->mask = st_calloc((packed->length + 63) / 64, sizeof(uint64_t));
+        packed->maskedPositions = st_malloc(packed->maskedLength * sizeof(int64_t));
+        packed->maskedBases = st_malloc(packed->maskedLength * sizeof(char));
+        int64_t j = 0;
+        for (int64_t i = 0; i < packed->length; i++) {
+            if (packedNucleotides_getCode(nucleotides[i]) < 0) {
+                packed->mask[i >> 6] |= ((uint64_t) 1) << (i & 63);
+                packed->maskedPositions[j] = i;
+                packed->maskedBases[j++] = nucleotides[i];
+            }
+        }
+    }
+
+    return packed;
+}
+
+void packedNucleotides_destruct(PackedNucleotides *packed) {
+    free(packed->bases);
+    if (packed->mask != NULL) {
+        free(packed->mask);
+        free(packed->maskedPositions);
+        free(packed->maskedBases);
+    }
+    free(packed);
+}
+
+static char packedNucleotides_getMasked(PackedNucleotides *packed, int64_t i) {
+    int64_t lo = 0, hi = packed->maskedLength - 1;
+    while (lo < hi) {
+        int64_t mid = (lo + hi) / 2;
+        if (packed->maskedPositions[mid] < i) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    assert(packed->maskedPositions[lo] == i);
+    return packed->maskedBases[lo];
+}
+
+char packedNucleotides_get(PackedNucleotides *packed, int64_t i) {
+    assert(i >= 0 && i < packed->length);
+    if (packed->mask != NULL && ((packed->mask[i >> 6] >> (i & 63)) & 1) != 0) {
+        return packedNucleotides_getMasked(packed, i);
+    }
+    return "ACGT"[(packed->bases[i >> 2] >> ((i & 3) << 1)) & 3];
+}
+
+char *packedNucleotides_getSubstring(PackedNucleotides *packed, int64_t start, int64_t length) {
+    assert(start >= 0 && length >= 0 && start + length <= packed->length);
+    char *nucleotides = st_malloc((length + 1) * sizeof(char));
+    for (int64_t i = 0; i < length; i++) {
+        nucleotides[i] = "ACGT"[(packed->bases[(start + i) >> 2] >> (((start + i) & 3) << 1)) & 3];
+    }
+    for (int64_t j = 0; j < packed->maskedLength; j++) {
+        int64_t i = packed->maskedPositions[j] - start;
+        if (i >= 0 && i < length) {
+            nucleotides[i] = packed->maskedBases[j];
+        }
+    }
+    nucleotides[length] = '\0';
+    return nucleotides;
+}
+
+char *packedNucleotides_unpack(PackedNucleotides *packed) {
+    return packedNucleotides_getSubstring(packed, 0, packed->length);
+}
+
+int64_t packedNucleotides_getMemory(PackedNucleotides *packed) {
+    int64_t memory = sizeof(PackedNucleotides) + (packed->length + 3) / 4;
+    if (packed->mask != NULL) {
+        memory += (packed->length + 63) / 64 * sizeof(uint64_t) +
+                  packed->maskedLength * (sizeof(int64_t) + sizeof(char));
+    }
+    return memory;
+}
+
 BamChunkRead *bamChunkRead_construct() {
     return bamChunkRead_construct2(NULL, NULL, NULL, TRUE, NULL);
 }
 BamChunkRead *bamChunkRead_construct2(char *readName, char *nucleotides, uint8_t *qualities, bool forwardStrand,
                                       BamChunk *parent) {
     BamChunkRead *r = malloc(sizeof(BamChunkRead));
+    bamChunkRead_refill(r, readName, nucleotides, qualities, forwardStrand, parent);
+    return r;
+}
+void bamChunkRead_refill(BamChunkRead *r, char *readName, char *nucleotides, uint8_t *qualities, bool forwardStrand,
+                         BamChunk *parent) {
     r->readName = readName;
     r->nucleotides = nucleotides;
+    r->packedNucleotides = NULL;
     r->readLength = (nucleotides == NULL ? 0 : strlen(nucleotides));
     r->qualities = qualities;
     r->forwardStrand = forwardStrand;
     r->parent = parent;
-
-    return r;
 }
 BamChunkRead *bamChunkRead_constructRLECopy(BamChunkRead  *read, RleString *rle) {
     BamChunkRead *r = st_calloc(1, sizeof(BamChunkRead));
     r->readName = read->readName ==  NULL ? NULL : stString_copy(read->readName);
-    r->nucleotides = stString_copy(rle->rleString);
+    if (read->packedNucleotides != NULL) {
+        r->packedNucleotides = packedNucleotides_construct(rle->rleString);
+    } else {
+        r->nucleotides = stString_copy(rle->rleString);
+    }
     r->readLength = rle->length;
     r->forwardStrand = read->forwardStrand;
     r->parent = read->parent;
@@ -61,7 +176,31 @@ BamChunkRead *bamChunkRead_constructRLECopy(BamChunkRead  *read, RleString *rle)
 void bamChunkRead_destruct(BamChunkRead *r) {
     if (r->readName != NULL) free(r->readName);
     if (r->nucleotides != NULL) free(r->nucleotides);
+    if (r->packedNucleotides != NULL) packedNucleotides_destruct(r->packedNucleotides);
     if (r->qualities != NULL) free(r->qualities);
     free(r);
 }
 
+void bamChunkRead_pack(BamChunkRead *read) {
+    if (read->packedNucleotides != NULL || read->nucleotides == NULL) {
+        return;
+    }
+    read->packedNucleotides = packedNucleotides_construct(read->nucleotides);
+    free(read->nucleotides);
+    read->nucleotides = NULL;
+}
+
+char *bamChunkRead_getNucleotides(BamChunkRead *read) {
+    return read->packedNucleotides == NULL ? read->nucleotides : packedNucleotides_unpack(read->packedNucleotides);
+}
+
+void bamChunkRead_releaseNucleotides(BamChunkRead *read, char *nucleotides) {
+    if (read->packedNucleotides != NULL) {
+        free(nucleotides);
+    }
+}
+
+char bamChunkRead_getBase(BamChunkRead *read, int64_t i) {
+    return read->packedNucleotides == NULL ? read->nucleotides[i] : packedNucleotides_get(read->packedNucleotides, i);
+}
+
@@ -472,6 +472,9 @@ stList *getRPHmms(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
     return finalTilingPath;
 }
 
+static void phaseProfileSeqs(stList *reads, stList *profileSeqs, stHash *readToProfileSeq,
+							 stList **readsPartition1, stList **readsPartition2, Params *params);
+
 void phaseReads(char *reference, int64_t referenceLength, stList *reads, stList *anchorAlignments,
 				stList **readsPartition1, stList **readsPartition2, Params *params) {
 	/*
@@ -483,14 +486,47 @@ void phaseReads(char *reference, int64_t referenceLength, stList *reads, stList
 	stHash *readToProfileSeq = stHash_construct();
 	for(int64_t i=0; i<stList_length(reads); i++) {
 		BamChunkRead *read = stList_get(reads, i);
-        char *nucleotides = read->nucleotides;
+        char *nucleotides = bamChunkRead_getNucleotides(read);
 		char *readName = (read->readName == NULL ? stString_print("%i", i) : stString_copy(read->readName));
 		stList_append(profileSeqs, stProfileSeq_constructFromPosteriorProbs("ref", reference, referenceLength,
 				readName, nucleotides, stList_get(anchorAlignments, i), params));
 		free(readName);
-		stHash_insert(readToProfileSeq, nucleotides, stList_peek(profileSeqs));
+		bamChunkRead_releaseNucleotides(read, nucleotides);
+		stHash_insert(readToProfileSeq, read, stList_peek(profileSeqs));
+	}
+
+	phaseProfileSeqs(reads, profileSeqs, readToProfileSeq, readsPartition1, readsPartition2, params);
+}
+
+void phaseReadsFromPosteriors(int64_t referenceLength, stList *reads, stList *readMatches, stList *readDeletes,
+							  stList **readsPartition1, stList **readsPartition2, Params *params) {
+	/*
+	 * As phaseReads, but builds the profile sequences from the match and delete posteriors recorded for each read
+	 * while polishing (see poa_realign2), instead of realigning every read to the reference.
+	 */
+
+	// Generate profile sequences
+	stList *profileSeqs = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+	stHash *readToProfileSeq = stHash_construct();
+	for(int64_t i=0; i<stList_length(reads); i++) {
+		BamChunkRead *read = stList_get(reads, i);
+		char *readName = (read->readName == NULL ? stString_print("%i", i) : stString_copy(read->readName));
+		stList_append(profileSeqs, stProfileSeq_constructFromAlignedPairs("ref", referenceLength, readName,
+				read, stList_get(readMatches, i), stList_get(readDeletes, i), params));
+		free(readName);
+		stHash_insert(readToProfileSeq, read, stList_peek(profileSeqs));
 	}
 
+	phaseProfileSeqs(reads, profileSeqs, readToProfileSeq, readsPartition1, readsPartition2, params);
+}
+
+static void phaseProfileSeqs(stList *reads, stList *profileSeqs, stHash *readToProfileSeq,
+							 stList **readsPartition1, stList **readsPartition2, Params *params) {
+	/*
+	 * Partitions the reads given their profile sequences, readToProfileSeq maps each read to its
+	 * profile sequence. Takes ownership of profileSeqs and readToProfileSeq.
+	 */
+
 	// Get flat reference priors
 	//TODO: consider using more informative priors
 	stHash *referenceNamesToReferencePriors = createEmptyReferencePriorProbabilities(profileSeqs);
@@ -566,8 +602,7 @@ void phaseReads(char *reference, int64_t referenceLength, stList *reads, stList
 	for(int64_t i=0; i<stList_length(reads); i++) {
 
         BamChunkRead *read = stList_get(reads, i);
-        char *nucleotides = read->nucleotides;
-		stProfileSeq *pSeq = stHash_search(readToProfileSeq, nucleotides);
+		stProfileSeq *pSeq = stHash_search(readToProfileSeq, read);
 		stList_append(stSet_search(reads1, pSeq) ? *readsPartition1 : *readsPartition2, read);
 	}
 
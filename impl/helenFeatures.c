@@ -2,15 +2,16 @@
 // Created by tpesout on 3/29/19.
 //
 
-#ifdef _HDF5
-
 #include "margin.h"
 #include "htsIntegration.h"
 #include "helenFeatures.h"
 #include "ssw.h"
-#include <hdf5.h>
 #include <omp.h>
 
+#ifdef _HDF5
+#include <hdf5.h>
+#endif
+
 #define INSERT_NORMALIZATION_FROM_BASE_NODE_WEIGHT TRUE
 //#define INSERT_NORMALIZATION_FROM_BASE_NODE_WEIGHT FALSE
 
@@ -53,7 +54,9 @@ void PoaFeature_RleWeight_destruct(PoaFeatureRleWeight *feature) {
 
 PoaFeatureSplitRleWeight *PoaFeature_SplitRleWeight_construct(int64_t refPos, int64_t insPos, int64_t rlPos,
         int64_t maxRunLength) {
-    PoaFeatureSplitRleWeight *feature = st_calloc(1, sizeof(PoaFeatureSplitRleWeight));
+    // the weights are allocated with the feature, straight after it
+    int64_t weightCount = ((SYMBOL_NUMBER - 1) * (1 + maxRunLength) + 1) * 2;
+    PoaFeatureSplitRleWeight *feature = st_calloc(1, sizeof(PoaFeatureSplitRleWeight) + weightCount * sizeof(double));
     feature->refPosition = refPos;
     feature->insertPosition = insPos;
     feature->runLengthPosition = rlPos;
@@ -62,7 +65,7 @@ PoaFeatureSplitRleWeight *PoaFeature_SplitRleWeight_construct(int64_t refPos, in
     feature->nextRunLength = NULL;
     feature->nextInsert = NULL;
     feature->maxRunLength = maxRunLength;
-    feature->weights = st_calloc(((SYMBOL_NUMBER - 1) * (1 + maxRunLength) + 1) * 2, sizeof(double));
+    feature->weights = (double *) (feature + 1);
     return feature;
 }
 void PoaFeature_SplitRleWeight_destruct(PoaFeatureSplitRleWeight *feature) {
@@ -72,7 +75,6 @@ void PoaFeature_SplitRleWeight_destruct(PoaFeatureSplitRleWeight *feature) {
     if (feature->nextInsert != NULL) {
         PoaFeature_SplitRleWeight_destruct(feature->nextInsert);
     }
-    free(feature->weights);
     free(feature);
 }
 
@@ -112,11 +114,11 @@ int PoaFeature_SplitRleWeight_gapIndex(int64_t maxRunLength, bool forward) {
 }
 
 
-void handleHelenFeatures(
+bool handleHelenFeatures(
         // global params
         char *outputBase, HelenFeatureType helenFeatureType, BamChunker *trueReferenceBamChunker,
-        int64_t splitWeightMaxRunLength, void **splitWeightHDF5Files, bool fullFeatureOutput,
-        char *trueReferenceBam, Params *params,
+        int64_t splitWeightMaxRunLength, void **splitWeightHDF5Files, void *splitWeightHDF5Writer,
+        char *splitWeightNpyDir, bool fullFeatureOutput, char *trueReferenceBam, Params *params,
 
         // chunk params
         char *logIdentifier, int64_t chunkIdx, BamChunk *bamChunk, Poa *poa, stList *rleReads, stList *rleNucleotides,
@@ -146,6 +148,7 @@ void handleHelenFeatures(
     stList *trueRefAlignment = NULL;
     RleString *trueRefRleString = NULL;
     bool validReferenceAlignment = FALSE;
+    bool written = TRUE;
 
     // get reference chunk
     if (trueReferenceBam != NULL) {
@@ -161,18 +164,19 @@ void handleHelenFeatures(
         // poor man's "do we have a unique alignment"
         if (trueAlignmentCount == 1) {
             BamChunkRead *trueRefRead = stList_get(trueRefReads, 0);
+            char *trueRefNucleotides = bamChunkRead_getNucleotides(trueRefRead);
 
-            stList *trueRefAlignmentRawSpace = alignConsensusAndTruth(polishedConsensusString, trueRefRead->nucleotides);
+            stList *trueRefAlignmentRawSpace = alignConsensusAndTruth(polishedConsensusString, trueRefNucleotides);
             if (st_getLogLevel() == debug) {
-                printMEAAlignment(polishedConsensusString, trueRefRead->nucleotides,
-                                  strlen(polishedConsensusString), strlen(trueRefRead->nucleotides),
+                printMEAAlignment(polishedConsensusString, trueRefNucleotides,
+                                  strlen(polishedConsensusString), strlen(trueRefNucleotides),
                                   trueRefAlignmentRawSpace, NULL, NULL);
             }
 
 
             // convert to rleSpace if appropriate
             if (params->polishParams->useRunLengthEncoding) {
-                trueRefRleString = rleString_construct(trueRefRead->nucleotides);
+                trueRefRleString = rleString_construct(trueRefNucleotides);
                 trueRefAlignment = runLengthEncodeAlignment2(trueRefAlignmentRawSpace, polishedRleConsensus,
                                                              trueRefRleString, 1, 2, 0);
                 if (st_getLogLevel() == debug) {
@@ -184,9 +188,10 @@ void handleHelenFeatures(
                 }
                 stList_destruct(trueRefAlignmentRawSpace);
             } else {
-                trueRefRleString = rleString_constructNoRLE(trueRefRead->nucleotides);
+                trueRefRleString = rleString_constructNoRLE(trueRefNucleotides);
                 trueRefAlignment = trueRefAlignmentRawSpace;
             }
+            bamChunkRead_releaseNucleotides(trueRefRead, trueRefNucleotides);
 
 
             // we found a single alignment of reference
@@ -216,9 +221,10 @@ void handleHelenFeatures(
         st_logInfo(" %s Writing HELEN features with filename base: %s\n", logIdentifier, helenFeatureOutfileBase);
 
         // write the actual features (type dependent)
-        poa_writeHelenFeatures(helenFeatureType, poa, rleReads, rleNucleotides, helenFeatureOutfileBase,
+        written = poa_writeHelenFeatures(helenFeatureType, poa, rleReads, rleNucleotides, helenFeatureOutfileBase,
                                bamChunk, trueRefAlignment, polishedRleConsensus, trueRefRleString, fullFeatureOutput,
-                               splitWeightMaxRunLength, (SplitRleFeatureHDF5FileInfo**) splitWeightHDF5Files);
+                               splitWeightMaxRunLength, (SplitRleFeatureHDF5FileInfo**) splitWeightHDF5Files,
+                               (SplitRleFeatureHDF5Writer*) splitWeightHDF5Writer, splitWeightNpyDir);
 
         // write the polished chunk in fasta format
         if (fullFeatureOutput) {
@@ -240,6 +246,7 @@ void handleHelenFeatures(
     free(helenFeatureOutfileBase);
     if (trueRefAlignment != NULL) stList_destruct(trueRefAlignment);
     if (trueRefRleString != NULL) rleString_destruct(trueRefRleString);
+    return written;
 }
 
 
@@ -871,15 +878,17 @@ void poa_annotateHelenFeaturesWithTruth(stList *features, HelenFeatureType featu
     free(logIdentifier);
 }
 
-void poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkReads, stList *rleStrings,
+bool poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkReads, stList *rleStrings,
         char *outputFileBase, BamChunk *bamChunk, stList *trueRefAlignment, RleString *consensusRleString,
         RleString *trueRefRleString, bool fullFeatureOutput, int64_t maxRunLength,
-        SplitRleFeatureHDF5FileInfo** splitWeightHDF5Files) {
+        SplitRleFeatureHDF5FileInfo** splitWeightHDF5Files, SplitRleFeatureHDF5Writer *splitWeightHDF5Writer,
+        char *splitWeightNpyDir) {
     // prep
     int64_t firstMatchedFeature = -1;
     int64_t lastMatchedFeature = -1;
     stList *features = NULL;
     bool outputLabels = trueRefAlignment != NULL && trueRefRleString != NULL;
+    bool written = TRUE;
 
     // handle differently based on type
     switch (type) {
@@ -895,8 +904,12 @@ void poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkRea
                                                    &firstMatchedFeature, &lastMatchedFeature);
             }
 
+            #ifdef _HDF5
             writeSimpleWeightHelenFeaturesHDF5(outputFileBase, bamChunk, outputLabels, features,
                                                             firstMatchedFeature, lastMatchedFeature);
+            #else
+            st_errAbort("Writing simpleWeight HELEN features needs HDF5\n");
+            #endif
 
             break;
 
@@ -912,10 +925,25 @@ void poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkRea
                                                    &firstMatchedFeature, &lastMatchedFeature);
             }
 
-            int64_t threadIdx = omp_get_thread_num();
-            writeSplitRleWeightHelenFeaturesHDF5(splitWeightHDF5Files[threadIdx],
-                    outputFileBase, bamChunk, outputLabels, features, firstMatchedFeature, lastMatchedFeature,
-                    maxRunLength);
+            // to NumPy files of the chunk, to the single file through its writer thread, or to this thread's file
+            if (splitWeightNpyDir != NULL) {
+                written = writeSplitRleWeightHelenFeaturesNpy(splitWeightNpyDir, outputFileBase, bamChunk,
+                        outputLabels, features, firstMatchedFeature, lastMatchedFeature, maxRunLength);
+            } else {
+                #ifdef _HDF5
+                if (splitWeightHDF5Writer != NULL) {
+                    splitRleFeatureHDF5Writer_addChunk(splitWeightHDF5Writer, outputFileBase, bamChunk, outputLabels,
+                            features, firstMatchedFeature, lastMatchedFeature);
+                } else {
+                    int64_t threadIdx = omp_get_thread_num();
+                    writeSplitRleWeightHelenFeaturesHDF5(splitWeightHDF5Files[threadIdx],
+                            outputFileBase, bamChunk, outputLabels, features, firstMatchedFeature, lastMatchedFeature,
+                            maxRunLength);
+                }
+                #else
+                st_errAbort("Writing splitRleWeight HELEN features to HDF5 needs HDF5\n");
+                #endif
+            }
             break;
         default:
             st_errAbort("Unhandled HELEN feature type!\n");
@@ -923,6 +951,7 @@ void poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkRea
 
     //cleanup
     stList_destruct(features);
+    return written;
 }
 
 // this function taken from https://github.com/mengyao/Complete-Striped-Smith-Waterman-Library/blob/master/src/example.c
@@ -1008,56 +1037,7 @@ stList *alignConsensusAndTruth(char *consensusStr, char *truthStr) {
 
 #define HDF5_FEATURE_SIZE 1000
 
-double **getTwoDArrayDouble(int64_t rowCount, int64_t columnCount, bool zeroValues) {
-    double **array  = st_calloc(rowCount, sizeof(double*));
-    array[0] = (double*) st_calloc(columnCount * rowCount, sizeof(double) );
-    if (zeroValues) {
-        for (int64_t i = 0; i < columnCount * rowCount; i++) {
-            (*array)[i] = 0.0;
-        }
-    }
-    for (int64_t i=1; i < rowCount; i++) {
-        array[i] = array[0] + i*columnCount;
-    }
-    return array;
-}
-
-float **getTwoDArrayFloat(int64_t rowCount, int64_t columnCount) {
-    float **array  = st_calloc(rowCount, sizeof(float*));
-    array[0] = (float*) st_calloc(columnCount * rowCount, sizeof(float) );
-    for (int64_t i=1; i < rowCount; i++) {
-        array[i] = array[0] + i*columnCount;
-    }
-    return array;
-}
-
-uint32_t **getTwoDArrayUInt32(int64_t rowCount, int64_t columnCount) {
-    uint32_t **array  = st_calloc(rowCount, sizeof(uint32_t*));
-    array[0] = (uint32_t*) st_calloc(columnCount * rowCount, sizeof(uint32_t) );
-    for (int64_t i=1; i < rowCount; i++) {
-        array[i] = array[0] + i*columnCount;
-    }
-    return array;
-}
-
-uint8_t **getTwoDArrayUInt8(int64_t rowCount, int64_t columnCount) {
-    uint8_t **array  = st_calloc(rowCount, sizeof(uint8_t*));
-    array[0] = (uint8_t*) st_calloc(columnCount * rowCount, sizeof(uint8_t) );
-    for (int64_t i=1; i < rowCount; i++) {
-        array[i] = array[0] + i*columnCount;
-    }
-    return array;
-}
-
-char **getTwoDArrayChar(int64_t rowCount, int64_t columnCount) {
-    char **array  = st_calloc(rowCount, sizeof(char*));
-    array[0] = (char*) st_calloc(columnCount * rowCount, sizeof(char) );
-    for (int64_t i=1; i < rowCount; i++) {
-        array[i] = array[0] + i*columnCount;
-    }
-    return array;
-}
-
+#ifdef _HDF5
 void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, bool outputLabels, stList *features,
                                         int64_t featureStartIdx, int64_t featureEndIdxInclusive) {
 
@@ -1085,12 +1065,12 @@ void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk
 
 
     // get all feature data into an array
-    uint32_t **positionData = getTwoDArrayUInt32(featureCount, 2);
+    uint32_t *positionData = st_calloc(featureCount * 2, sizeof(uint32_t));
     int64_t columnCount = SYMBOL_NUMBER * 2; //{A, C, T, G, Gap} x {fwd, rev}
-    float **rleWeightData = getTwoDArrayFloat(featureCount, columnCount);
-    char **labelCharacterData = NULL;
+    float *rleWeightData = st_calloc(featureCount * columnCount, sizeof(float));
+    char *labelCharacterData = NULL;
     if (outputLabels) {
-        labelCharacterData = getTwoDArrayChar(featureCount, 1);
+        labelCharacterData = st_calloc(featureCount, sizeof(char));
     }
 
     // add all data to features
@@ -1098,24 +1078,24 @@ void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk
     for (int64_t i = featureStartIdx; i <= featureEndIdxInclusive; i++) {
         PoaFeatureSimpleWeight *feature = stList_get(features, i);
         while (feature != NULL) {
-            positionData[featureCount][0] = (uint32_t) feature->refPosition;
-            positionData[featureCount][1] = (uint32_t) feature->insertPosition;
+            positionData[featureCount * 2 + 0] = (uint32_t) feature->refPosition;
+            positionData[featureCount * 2 + 1] = (uint32_t) feature->insertPosition;
 
             for (int64_t symbol = 0; symbol < SYMBOL_NUMBER_NO_N; symbol++) {
                 int64_t pos = PoaFeature_SimpleWeight_charIndex((Symbol) symbol, TRUE);
-                rleWeightData[featureCount][pos] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
+                rleWeightData[featureCount * columnCount + pos] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
                 pos = PoaFeature_SimpleWeight_charIndex((Symbol) symbol, FALSE);
-                rleWeightData[featureCount][pos] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
+                rleWeightData[featureCount * columnCount + pos] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
             }
 
             // weights include 'N' index which is not included in features
             int64_t pos = PoaFeature_SimpleWeight_gapIndex(TRUE);
-            rleWeightData[featureCount][pos - 2] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
+            rleWeightData[featureCount * columnCount + pos - 2] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
             pos = PoaFeature_SimpleWeight_gapIndex(FALSE);
-            rleWeightData[featureCount][pos - 2] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
+            rleWeightData[featureCount * columnCount + pos - 2] = (float) (feature->weights[pos] / PAIR_ALIGNMENT_PROB_1);
 
             if (outputLabels) {
-                labelCharacterData[featureCount][0] = feature->label;
+                labelCharacterData[featureCount] = feature->label;
             }
 
             featureCount++;
@@ -1185,19 +1165,19 @@ void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk
 
         // write position info
         hid_t positionDataset = H5Dcreate (file, "position", uint32Type, positionSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-        status |= H5Dwrite (positionDataset, uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, positionData[chunkFeatureStartIdx]);
+        status |= H5Dwrite (positionDataset, uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &positionData[chunkFeatureStartIdx * 2]);
 
         // write rle data
         hid_t rleWeightDataset = H5Dcreate (file, "image", floatType, rleWeightSpace, H5P_DEFAULT, H5P_DEFAULT,
                                             H5P_DEFAULT);
-        status |= H5Dwrite (rleWeightDataset, floatType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rleWeightData[chunkFeatureStartIdx]);
+        status |= H5Dwrite (rleWeightDataset, floatType, H5S_ALL, H5S_ALL, H5P_DEFAULT, &rleWeightData[chunkFeatureStartIdx * columnCount]);
 
         // if labels, add all these too
         if (outputLabels) {
             hid_t labelCharacterDataset = H5Dcreate (file, "label_base", uint8Type, labelCharacterSpace, H5P_DEFAULT,
                                                      H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelCharacterDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelCharacterData[chunkFeatureStartIdx]);
+                                &labelCharacterData[chunkFeatureStartIdx]);
             status |= H5Dclose (labelCharacterDataset);
         }
 
@@ -1213,9 +1193,7 @@ void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk
     }
 
     // cleanup
-    free(rleWeightData[0]);
     free(rleWeightData);
-    free(positionData[0]);
     free(positionData);
     status |= H5Tclose (int64Type);
     status |= H5Tclose (uint32Type);
@@ -1227,7 +1205,6 @@ void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk
     status |= H5Sclose (positionSpace);
     status |= H5Sclose (labelCharacterSpace);
     if (outputLabels) {
-        free(labelCharacterData[0]);
         free(labelCharacterData);
     }
 
@@ -1238,6 +1215,8 @@ void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk
     }
 }
 
+#endif
+
 #define MAX_TOTAL_WEIGHT 64.0
 uint8_t convertTotalWeightToUInt8(double totalWeight) {
     // convert to "depth space"
@@ -1251,6 +1230,7 @@ uint8_t normalizeWeightToUInt8(double totalWeight, double weight) {
     return (uint8_t) (weight / totalWeight * (UINT8_MAX - 1));
 }
 
+#ifdef _HDF5
 void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, bool outputLabels, stList *features,
                                      int64_t featureStartIdx, int64_t featureEndIdxInclusive) {
 
@@ -1277,16 +1257,16 @@ void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, b
     }
 
     // get all feature data into an array
-    uint32_t **positionData = getTwoDArrayUInt32(featureCount, 2);
-    uint8_t **predictedRunLengthData = getTwoDArrayUInt8(featureCount, 1);
+    uint32_t *positionData = st_calloc(featureCount * 2, sizeof(uint32_t));
+    uint8_t *predictedRunLengthData = st_calloc(featureCount, sizeof(uint8_t));
     int64_t rleNucleotideColumnCount = POAFEATURE_RLE_WEIGHT_TOTAL_SIZE - POAFEATURE_MAX_RUN_LENGTH * 2; // don't output 'N' chars
-    uint8_t **normalizationData = getTwoDArrayUInt8(featureCount, 1);
-    uint8_t **normalizedRleNucleotideWeights = getTwoDArrayUInt8(featureCount, rleNucleotideColumnCount);
-    char **labelCharacterData = NULL;
-    uint8_t **labelRunLengthData = NULL;
+    uint8_t *normalizationData = st_calloc(featureCount, sizeof(uint8_t));
+    uint8_t *normalizedRleNucleotideWeights = st_calloc(featureCount * rleNucleotideColumnCount, sizeof(uint8_t));
+    char *labelCharacterData = NULL;
+    uint8_t *labelRunLengthData = NULL;
     if (outputLabels) {
-        labelCharacterData = getTwoDArrayChar(featureCount, 1);
-        labelRunLengthData = getTwoDArrayUInt8(featureCount, 1);
+        labelCharacterData = st_calloc(featureCount, sizeof(char));
+        labelRunLengthData = st_calloc(featureCount, sizeof(uint8_t));
     }
 
     // add all data to features
@@ -1294,9 +1274,9 @@ void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, b
     for (int64_t i = featureStartIdx; i <= featureEndIdxInclusive; i++) {
         PoaFeatureRleWeight *feature = stList_get(features, i);
         while (feature != NULL) {
-            positionData[featureCount][0] = (uint32_t) feature->refPosition;
-            positionData[featureCount][1] = (uint32_t) feature->insertPosition;
-            predictedRunLengthData[featureCount][0] = (uint8_t) feature->predictedRunLength;
+            positionData[featureCount * 2 + 0] = (uint32_t) feature->refPosition;
+            positionData[featureCount * 2 + 1] = (uint32_t) feature->insertPosition;
+            predictedRunLengthData[featureCount] = (uint8_t) feature->predictedRunLength;
 
             // get total weight
             double totalWeight = 0;
@@ -1313,26 +1293,26 @@ void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, b
             totalWeight += feature->weights[pos];
             pos = PoaFeature_RleWeight_gapIndex(FALSE);
             totalWeight += feature->weights[pos];
-            normalizationData[featureCount][0] = convertTotalWeightToUInt8(totalWeight);
+            normalizationData[featureCount] = convertTotalWeightToUInt8(totalWeight);
 
             for (int64_t symbol = 0; symbol < SYMBOL_NUMBER_NO_N; symbol++) {
                 for (int64_t runLength = 1; runLength <= POAFEATURE_MAX_RUN_LENGTH; runLength++) {
                     pos = PoaFeature_RleWeight_charIndex((Symbol) symbol, runLength, TRUE);
-                    normalizedRleNucleotideWeights[featureCount][pos] = normalizeWeightToUInt8(totalWeight, feature->weights[pos]);
+                    normalizedRleNucleotideWeights[featureCount * rleNucleotideColumnCount + pos] = normalizeWeightToUInt8(totalWeight, feature->weights[pos]);
                     pos = PoaFeature_RleWeight_charIndex((Symbol) symbol, runLength, FALSE);
-                    normalizedRleNucleotideWeights[featureCount][pos] = normalizeWeightToUInt8(totalWeight, feature->weights[pos]);
+                    normalizedRleNucleotideWeights[featureCount * rleNucleotideColumnCount + pos] = normalizeWeightToUInt8(totalWeight, feature->weights[pos]);
                 }
             }
             pos = PoaFeature_RleWeight_gapIndex(TRUE);
-            normalizedRleNucleotideWeights[featureCount][pos - POAFEATURE_MAX_RUN_LENGTH * 2] =
+            normalizedRleNucleotideWeights[featureCount * rleNucleotideColumnCount + pos - POAFEATURE_MAX_RUN_LENGTH * 2] =
                     normalizeWeightToUInt8(totalWeight, feature->weights[pos]);
             pos = PoaFeature_RleWeight_gapIndex(FALSE);
-            normalizedRleNucleotideWeights[featureCount][pos - POAFEATURE_MAX_RUN_LENGTH * 2] =
+            normalizedRleNucleotideWeights[featureCount * rleNucleotideColumnCount + pos - POAFEATURE_MAX_RUN_LENGTH * 2] =
                     normalizeWeightToUInt8(totalWeight, feature->weights[pos]);
 
             if (outputLabels) {
-                labelCharacterData[featureCount][0] = feature->labelChar;
-                labelRunLengthData[featureCount][0] = (uint8_t) feature->labelRunLength;
+                labelCharacterData[featureCount] = feature->labelChar;
+                labelRunLengthData[featureCount] = (uint8_t) feature->labelRunLength;
             }
 
             featureCount++;
@@ -1407,30 +1387,30 @@ void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, b
 
         // write position info
         hid_t positionDataset = H5Dcreate (file, "position", uint32Type, positionSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-        status |= H5Dwrite (positionDataset, uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, positionData[chunkFeatureStartIdx]);
+        status |= H5Dwrite (positionDataset, uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &positionData[chunkFeatureStartIdx * 2]);
 
         // write rle data
         hid_t predictedRunLengthDataset = H5Dcreate (file, "bayesian_run_length_prediction", uint8Type,
                                                      predictedRunLengthSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (predictedRunLengthDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            predictedRunLengthData[chunkFeatureStartIdx]);
+                            &predictedRunLengthData[chunkFeatureStartIdx]);
         hid_t rleWeightDataset = H5Dcreate (file, "image", uint8Type, rleNucleotideSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (rleWeightDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            normalizedRleNucleotideWeights[chunkFeatureStartIdx]);
+                            &normalizedRleNucleotideWeights[chunkFeatureStartIdx * rleNucleotideColumnCount]);
         hid_t rleNormalizationDataset = H5Dcreate (file, "normalization", uint8Type, normalizationSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (rleNormalizationDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            normalizationData[chunkFeatureStartIdx]);
+                            &normalizationData[chunkFeatureStartIdx]);
 
         // if labels, add all these too
         if (outputLabels) {
             hid_t labelCharacterDataset = H5Dcreate (file, "label_base", uint8Type, labelCharacterSpace, H5P_DEFAULT,
                                                      H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelCharacterDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelCharacterData[chunkFeatureStartIdx]);
+                                &labelCharacterData[chunkFeatureStartIdx]);
             hid_t labelRunLengthDataset = H5Dcreate (file, "label_run_length", uint8Type, labelRunLengthSpace,
                                                      H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelRunLengthDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelRunLengthData[chunkFeatureStartIdx]);
+                                &labelRunLengthData[chunkFeatureStartIdx]);
 
             status |= H5Dclose (labelCharacterDataset);
             status |= H5Dclose (labelRunLengthDataset);
@@ -1450,13 +1430,9 @@ void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, b
     }
 
     // cleanup
-    free(predictedRunLengthData[0]);
     free(predictedRunLengthData);
-    free(normalizedRleNucleotideWeights[0]);
     free(normalizedRleNucleotideWeights);
-    free(normalizationData[0]);
     free(normalizationData);
-    free(positionData[0]);
     free(positionData);
     status |= H5Tclose (int64Type);
     status |= H5Tclose (uint32Type);
@@ -1470,9 +1446,7 @@ void writeRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, b
     status |= H5Sclose (labelRunLengthSpace);
     status |= H5Sclose (labelCharacterSpace);
     if (outputLabels) {
-        free(labelCharacterData[0]);
         free(labelCharacterData);
-        free(labelRunLengthData[0]);
         free(labelRunLengthData);
     }
 
@@ -1510,19 +1484,19 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
     }
 
     // get all feature data into an array
-    uint32_t **positionData = getTwoDArrayUInt32(featureCount, 2);
-    uint8_t **predictedRunLengthData = getTwoDArrayUInt8(featureCount, 1);
+    uint32_t *positionData = st_calloc(featureCount * 2, sizeof(uint32_t));
+    uint8_t *predictedRunLengthData = st_calloc(featureCount, sizeof(uint8_t));
     int64_t runLengthColumnCount = (POAFEATURE_MAX_RUN_LENGTH + 1) * 2; // gaps are rl 0, fwd/rev
     int64_t nucleotideColumnCount = (SYMBOL_NUMBER) * 2; // actg gap, fwd/rev
-    uint8_t **normalizationData = getTwoDArrayUInt8(featureCount, 1);
-    double **normalizedNucleotidePrep = getTwoDArrayDouble(featureCount, nucleotideColumnCount, TRUE);
-    double **normalizedRunLengthPrep = getTwoDArrayDouble(featureCount, runLengthColumnCount, TRUE);
-    uint8_t **normalizedNucleotideAndRunLengthData = getTwoDArrayUInt8(featureCount, nucleotideColumnCount + runLengthColumnCount);
-    char **labelCharacterData = NULL;
-    uint8_t **labelRunLengthData = NULL;
+    uint8_t *normalizationData = st_calloc(featureCount, sizeof(uint8_t));
+    double *normalizedNucleotidePrep = st_calloc(nucleotideColumnCount, sizeof(double)); // of the current feature
+    double *normalizedRunLengthPrep = st_calloc(runLengthColumnCount, sizeof(double));
+    uint8_t *normalizedNucleotideAndRunLengthData = st_calloc(featureCount * (nucleotideColumnCount + runLengthColumnCount), sizeof(uint8_t));
+    char *labelCharacterData = NULL;
+    uint8_t *labelRunLengthData = NULL;
     if (outputLabels) {
-        labelCharacterData = getTwoDArrayChar(featureCount, 1);
-        labelRunLengthData = getTwoDArrayUInt8(featureCount, 1);
+        labelCharacterData = st_calloc(featureCount, sizeof(char));
+        labelRunLengthData = st_calloc(featureCount, sizeof(uint8_t));
     }
 
     // add all data to features
@@ -1530,56 +1504,58 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
     for (int64_t i = featureStartIdx; i <= featureEndIdxInclusive; i++) {
         PoaFeatureRleWeight *feature = stList_get(features, i);
         while (feature != NULL) {
-            positionData[featureCount][0] = (uint32_t) feature->refPosition;
-            positionData[featureCount][1] = (uint32_t) feature->insertPosition;
-            predictedRunLengthData[featureCount][0] = (uint8_t) feature->predictedRunLength;
+            positionData[featureCount * 2 + 0] = (uint32_t) feature->refPosition;
+            positionData[featureCount * 2 + 1] = (uint32_t) feature->insertPosition;
+            predictedRunLengthData[featureCount] = (uint8_t) feature->predictedRunLength;
 
             // get total weight
             double totalWeight = 0;
             int64_t pos;
+            memset(normalizedNucleotidePrep, 0, nucleotideColumnCount * sizeof(double));
+            memset(normalizedRunLengthPrep, 0, runLengthColumnCount * sizeof(double));
 
             for (int64_t symbol = 0; symbol < SYMBOL_NUMBER_NO_N; symbol++) {
                 for (int64_t runLength = 1; runLength <= POAFEATURE_MAX_RUN_LENGTH; runLength++) {
                     //fwd
                     pos = PoaFeature_RleWeight_charIndex((Symbol) symbol, runLength, TRUE);
                     totalWeight += feature->weights[pos];
-                    normalizedNucleotidePrep[featureCount][symbol * 2 + POS_STRAND_IDX] += feature->weights[pos];
-                    normalizedRunLengthPrep[featureCount][runLength * 2 + POS_STRAND_IDX] += feature->weights[pos];
+                    normalizedNucleotidePrep[symbol * 2 + POS_STRAND_IDX] += feature->weights[pos];
+                    normalizedRunLengthPrep[runLength * 2 + POS_STRAND_IDX] += feature->weights[pos];
                     // rev
                     pos = PoaFeature_RleWeight_charIndex((Symbol) symbol, runLength, FALSE);
                     totalWeight += feature->weights[pos];
-                    normalizedNucleotidePrep[featureCount][symbol * 2 + NEG_STRAND_IDX] += feature->weights[pos];
-                    normalizedRunLengthPrep[featureCount][runLength * 2 + NEG_STRAND_IDX] += feature->weights[pos];
+                    normalizedNucleotidePrep[symbol * 2 + NEG_STRAND_IDX] += feature->weights[pos];
+                    normalizedRunLengthPrep[runLength * 2 + NEG_STRAND_IDX] += feature->weights[pos];
                 }
             }
             // fwd gap
             pos = PoaFeature_RleWeight_gapIndex(TRUE);
             totalWeight += feature->weights[pos];
-            normalizedNucleotidePrep[featureCount][SYMBOL_NUMBER_NO_N * 2 + POS_STRAND_IDX] += feature->weights[pos];
-            normalizedRunLengthPrep[featureCount][POS_STRAND_IDX] += feature->weights[pos];
+            normalizedNucleotidePrep[SYMBOL_NUMBER_NO_N * 2 + POS_STRAND_IDX] += feature->weights[pos];
+            normalizedRunLengthPrep[POS_STRAND_IDX] += feature->weights[pos];
             // rev gap
             pos = PoaFeature_RleWeight_gapIndex(FALSE);
             totalWeight += feature->weights[pos];
-            normalizedNucleotidePrep[featureCount][SYMBOL_NUMBER_NO_N * 2 + NEG_STRAND_IDX] += feature->weights[pos];
-            normalizedRunLengthPrep[featureCount][NEG_STRAND_IDX] += feature->weights[pos];
+            normalizedNucleotidePrep[SYMBOL_NUMBER_NO_N * 2 + NEG_STRAND_IDX] += feature->weights[pos];
+            normalizedRunLengthPrep[NEG_STRAND_IDX] += feature->weights[pos];
 
             // save total weight
-            normalizationData[featureCount][0] = convertTotalWeightToUInt8(totalWeight);
+            normalizationData[featureCount] = convertTotalWeightToUInt8(totalWeight);
 
             // covert to total weight and save
             for (int64_t normNuclPos = 0; normNuclPos < nucleotideColumnCount; normNuclPos++) {
-                normalizedNucleotideAndRunLengthData[featureCount][normNuclPos] =
-                        normalizeWeightToUInt8(totalWeight, normalizedNucleotidePrep[featureCount][normNuclPos]);
+                normalizedNucleotideAndRunLengthData[featureCount * (nucleotideColumnCount + runLengthColumnCount) + normNuclPos] =
+                        normalizeWeightToUInt8(totalWeight, normalizedNucleotidePrep[normNuclPos]);
             }
             for (int64_t normRunLenPos = 0; normRunLenPos < runLengthColumnCount; normRunLenPos++) {
-                normalizedNucleotideAndRunLengthData[featureCount][nucleotideColumnCount + normRunLenPos] =
-                        normalizeWeightToUInt8(totalWeight, normalizedRunLengthPrep[featureCount][normRunLenPos]);
+                normalizedNucleotideAndRunLengthData[featureCount * (nucleotideColumnCount + runLengthColumnCount) + nucleotideColumnCount + normRunLenPos] =
+                        normalizeWeightToUInt8(totalWeight, normalizedRunLengthPrep[normRunLenPos]);
             }
 
             // save labels if appropriate
             if (outputLabels) {
-                labelCharacterData[featureCount][0] = feature->labelChar;
-                labelRunLengthData[featureCount][0] = (uint8_t) feature->labelRunLength;
+                labelCharacterData[featureCount] = feature->labelChar;
+                labelRunLengthData[featureCount] = (uint8_t) feature->labelRunLength;
             }
 
             featureCount++;
@@ -1654,30 +1630,30 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
 
         // write position info
         hid_t positionDataset = H5Dcreate (file, "position", uint32Type, positionSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-        status |= H5Dwrite (positionDataset, uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, positionData[chunkFeatureStartIdx]);
+        status |= H5Dwrite (positionDataset, uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &positionData[chunkFeatureStartIdx * 2]);
 
         // write rle data
         hid_t predictedRunLengthDataset = H5Dcreate (file, "bayesian_run_length_prediction", uint8Type,
                                                      predictedRunLengthSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (predictedRunLengthDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            predictedRunLengthData[chunkFeatureStartIdx]);
+                            &predictedRunLengthData[chunkFeatureStartIdx]);
         hid_t nucleotideAndRunLengthDataset = H5Dcreate (file, "image", uint8Type, nucleotideAndRunLengthSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (nucleotideAndRunLengthDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            normalizedNucleotideAndRunLengthData[chunkFeatureStartIdx]);
+                            &normalizedNucleotideAndRunLengthData[chunkFeatureStartIdx * (nucleotideColumnCount + runLengthColumnCount)]);
         hid_t normalizationDataset = H5Dcreate (file, "normalization", uint8Type, normalizationSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (normalizationDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            normalizationData[chunkFeatureStartIdx]);
+                            &normalizationData[chunkFeatureStartIdx]);
 
         // if labels, add all these too
         if (outputLabels) {
             hid_t labelCharacterDataset = H5Dcreate (file, "label_base", uint8Type, labelCharacterSpace, H5P_DEFAULT,
                                                      H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelCharacterDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelCharacterData[chunkFeatureStartIdx]);
+                                &labelCharacterData[chunkFeatureStartIdx]);
             hid_t labelRunLengthDataset = H5Dcreate (file, "label_run_length", uint8Type, labelRunLengthSpace,
                                                      H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelRunLengthDataset, uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelRunLengthData[chunkFeatureStartIdx]);
+                                &labelRunLengthData[chunkFeatureStartIdx]);
 
             status |= H5Dclose (labelCharacterDataset);
             status |= H5Dclose (labelRunLengthDataset);
@@ -1697,16 +1673,11 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
     }
 
     // cleanup
-    free(predictedRunLengthData[0]);
     free(predictedRunLengthData);
-    free(normalizedNucleotidePrep[0]);
     free(normalizedNucleotidePrep);
-    free(normalizedNucleotideAndRunLengthData[0]);
-    free(normalizedRunLengthPrep[0]);
     free(normalizedRunLengthPrep);
-    free(normalizationData[0]);
+    free(normalizedNucleotideAndRunLengthData);
     free(normalizationData);
-    free(positionData[0]);
     free(positionData);
     status |= H5Tclose (int64Type);
     status |= H5Tclose (uint32Type);
@@ -1720,9 +1691,7 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
     status |= H5Sclose (labelRunLengthSpace);
     status |= H5Sclose (labelCharacterSpace);
     if (outputLabels) {
-        free(labelCharacterData[0]);
         free(labelCharacterData);
-        free(labelRunLengthData[0]);
         free(labelRunLengthData);
     }
 
@@ -1733,15 +1702,33 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
     }
 }
 
-void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileInfo, char *outputFileBase, BamChunk *bamChunk,
-        bool outputLabels, stList *features, int64_t featureStartIdx, int64_t featureEndIdxInclusive,
-        const int64_t maxRunLength) {
-
-    herr_t      status = 0;
+#endif
+
+/*
+ * The features of a chunk as the rows of the split RLE weight datasets
+ */
+typedef struct _splitRleFeatureData {
+    uint64_t featureCount;
+    int64_t imageColumnCount;
+    uint32_t *positionData; // featureCount rows of 3 columns
+    uint8_t *normalizationData;
+    uint8_t *imageData; // featureCount rows of imageColumnCount columns
+    uint8_t *labelCharacterData; // NULL without labels
+    uint8_t *labelRunLengthData;
+} SplitRleFeatureData;
+
+static void splitRleFeatureData_destruct(SplitRleFeatureData *data) {
+    free(data->imageData);
+    free(data->normalizationData);
+    free(data->positionData);
+    free(data->labelCharacterData);
+    free(data->labelRunLengthData);
+    free(data);
+}
 
-    /*
-     * Get feature data set up
-     */
+static SplitRleFeatureData *splitRleFeatureData_construct(BamChunk *bamChunk, bool outputLabels, stList *features,
+        int64_t featureStartIdx, int64_t featureEndIdxInclusive, const int64_t maxRunLength) {
+    // Returns NULL if there are too few features to label
 
     // count features, create feature array
     uint64_t featureCount = 0;
@@ -1760,19 +1747,19 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
         char *logIdentifier = getLogIdentifier();
         st_logInfo(" %s Feature count %"PRId64" less than minimum of %d\n", logIdentifier, featureCount, HDF5_FEATURE_SIZE);
         free(logIdentifier);
-        return;
+        return NULL;
     }
 
     // get all feature data into an array
-    uint32_t **positionData = getTwoDArrayUInt32(featureCount, 3);
+    uint32_t *positionData = st_calloc(featureCount * 3, sizeof(uint32_t));
     int64_t rleNucleotideColumnCount = ((SYMBOL_NUMBER - 1) * (maxRunLength + 1) + 1) * 2;
-    uint8_t **normalizationData = getTwoDArrayUInt8(featureCount, 1);
-    uint8_t **imageData = getTwoDArrayUInt8(featureCount, rleNucleotideColumnCount);
-    uint8_t **labelCharacterData = NULL;
-    uint8_t **labelRunLengthData = NULL;
+    uint8_t *normalizationData = st_calloc(featureCount, sizeof(uint8_t));
+    uint8_t *imageData = st_calloc(featureCount * rleNucleotideColumnCount, sizeof(uint8_t));
+    uint8_t *labelCharacterData = NULL;
+    uint8_t *labelRunLengthData = NULL;
     if (outputLabels) {
-        labelCharacterData = getTwoDArrayUInt8(featureCount, 1);
-        labelRunLengthData = getTwoDArrayUInt8(featureCount, 1);
+        labelCharacterData = st_calloc(featureCount, sizeof(uint8_t));
+        labelRunLengthData = st_calloc(featureCount, sizeof(uint8_t));
     }
 
     // add all data to features
@@ -1802,27 +1789,27 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
             PoaFeatureSplitRleWeight *rlFeature = insFeature;
             while (rlFeature != NULL) {
                 // position
-                positionData[featureCount][0] = (uint32_t) rlFeature->refPosition;
-                positionData[featureCount][1] = (uint32_t) rlFeature->insertPosition;
-                positionData[featureCount][2] = (uint32_t) rlFeature->runLengthPosition;
+                positionData[featureCount * 3 + 0] = (uint32_t) rlFeature->refPosition;
+                positionData[featureCount * 3 + 1] = (uint32_t) rlFeature->insertPosition;
+                positionData[featureCount * 3 + 2] = (uint32_t) rlFeature->runLengthPosition;
 
                 // normalization
-                normalizationData[featureCount][0] = convertTotalWeightToUInt8(totalWeight);
+                normalizationData[featureCount] = convertTotalWeightToUInt8(totalWeight);
 
                 // copy weights over (into normalized uint8 space)
                 for (int64_t j = 0; j < rleNucleotideColumnCount; j++) {
-                    imageData[featureCount][j] =
+                    imageData[featureCount * rleNucleotideColumnCount + j] =
                             normalizeWeightToUInt8(totalWeight, rlFeature->weights[j]);
                 }
 
                 // labels
                 if (outputLabels) {
                     Symbol label = symbol_convertCharToSymbol(rlFeature->labelChar);
-                    labelCharacterData[featureCount][0] = (uint8_t) (label == n ? 0 : label + 1);
-                    labelRunLengthData[featureCount][0] = (uint8_t) (label == n ? 0 : rlFeature->labelRunLength);
-                    if (labelRunLengthData[featureCount][0] > maxRunLength) {
+                    labelCharacterData[featureCount] = (uint8_t) (label == n ? 0 : label + 1);
+                    labelRunLengthData[featureCount] = (uint8_t) (label == n ? 0 : rlFeature->labelRunLength);
+                    if (labelRunLengthData[featureCount] > maxRunLength) {
                         st_errAbort("Encountered run length of %d (max %"PRId64") in chunk %s:%"PRId64"-%"PRId64,
-                                    labelRunLengthData[featureCount][0], maxRunLength, bamChunk->refSeqName,
+                                    labelRunLengthData[featureCount], maxRunLength, bamChunk->refSeqName,
                                     bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
                     }
                 }
@@ -1835,6 +1822,193 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
         }
     }
 
+    SplitRleFeatureData *data = st_calloc(1, sizeof(SplitRleFeatureData));
+    data->featureCount = featureCount;
+    data->imageColumnCount = rleNucleotideColumnCount;
+    data->positionData = positionData;
+    data->normalizationData = normalizationData;
+    data->imageData = imageData;
+    data->labelCharacterData = labelCharacterData;
+    data->labelRunLengthData = labelRunLengthData;
+    return data;
+}
+
+/*
+ * Windows of HDF5_FEATURE_SIZE features (or all of them, if fewer) covering the features of a chunk, spread evenly
+ * with the last window ending at the last feature
+ */
+static int64_t getFeatureWindowCount(uint64_t featureCount) {
+    return (int64_t) (featureCount / HDF5_FEATURE_SIZE) + (featureCount % HDF5_FEATURE_SIZE == 0 ? 0 : 1);
+}
+
+static int64_t getFeatureWindowStart(uint64_t featureCount, int64_t featureIndex) {
+    int64_t totalFeatureFiles = getFeatureWindowCount(featureCount);
+    int64_t featureOffset = 0;
+    if (featureCount >= HDF5_FEATURE_SIZE) {
+        featureOffset = (int64_t) ((HDF5_FEATURE_SIZE * totalFeatureFiles - featureCount) / (int64_t) (featureCount / HDF5_FEATURE_SIZE));
+    }
+    int64_t chunkFeatureStartIdx = (HDF5_FEATURE_SIZE * featureIndex) - (featureOffset * featureIndex);
+    if (featureIndex + 1 == totalFeatureFiles && featureCount >= HDF5_FEATURE_SIZE) {
+        chunkFeatureStartIdx = featureCount - HDF5_FEATURE_SIZE;
+    }
+    return chunkFeatureStartIdx;
+}
+
+/*
+ * NumPy array and JSON manifest output, needing no HDF5
+ */
+
+#define NPY_MAGIC "\x93NUMPY"
+#define NPY_MAGIC_LENGTH 6
+#define NPY_HEADER_ALIGNMENT 64
+
+static bool isLittleEndian() {
+    uint16_t one = 1;
+    return *((uint8_t *) &one) == 1;
+}
+
+static bool writeNpyArray(char *filename, char typeKind, size_t typeSize, void *data, int64_t rowCount,
+                          int64_t columnCount) {
+    // version 1.0 of the format: magic, version, header length and a python dict literal describing the array,
+    // padded with spaces and ended with a newline so the data that follows is aligned
+    FILE *fh = fopen(filename, "wb");
+    if (fh == NULL) {
+        return FALSE;
+    }
+    char byteOrder = typeSize == 1 ? '|' : (isLittleEndian() ? '<' : '>');
+    char *header = stString_print("{'descr': '%c%c%d', 'fortran_order': False, 'shape': (%"PRId64", %"PRId64"), }",
+                                  byteOrder, typeKind, (int) typeSize, rowCount, columnCount);
+    int64_t headerLength = strlen(header) + 1;
+    headerLength += (NPY_HEADER_ALIGNMENT - (NPY_MAGIC_LENGTH + 4 + headerLength) % NPY_HEADER_ALIGNMENT)
+            % NPY_HEADER_ALIGNMENT;
+    uint8_t version[4] = {1, 0, (uint8_t) (headerLength & 0xff), (uint8_t) (headerLength >> 8)};
+
+    fwrite(NPY_MAGIC, sizeof(char), NPY_MAGIC_LENGTH, fh);
+    fwrite(version, sizeof(uint8_t), 4, fh);
+    fputs(header, fh);
+    for (int64_t i = strlen(header) + 1; i < headerLength; i++) {
+        fputc(' ', fh);
+    }
+    fputc('\n', fh);
+    bool ok = fwrite(data, typeSize, rowCount * columnCount, fh) == (size_t) (rowCount * columnCount);
+    ok = fclose(fh) == 0 && ok;
+    free(header);
+    return ok;
+}
+
+static bool writeSplitRleFeatureNpyArray(char *arrayBase, char *arrayName, char typeKind, size_t typeSize,
+                                         void *data, int64_t rowCount, int64_t columnCount) {
+    char *filename = stString_print("%s.%s.npy", arrayBase, arrayName);
+    bool ok = writeNpyArray(filename, typeKind, typeSize, data, rowCount, columnCount);
+    free(filename);
+    return ok;
+}
+
+static void writeJsonString(FILE *fh, char *string) {
+    fputc('"', fh);
+    for (char *c = string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', fh);
+        }
+        fputc(*c, fh);
+    }
+    fputc('"', fh);
+}
+
+bool writeSplitRleWeightHelenFeaturesNpy(char *outputDir, char *outputFileBase, BamChunk *bamChunk,
+        bool outputLabels, stList *features, int64_t featureStartIdx, int64_t featureEndIdxInclusive,
+        const int64_t maxRunLength) {
+
+    SplitRleFeatureData *data = splitRleFeatureData_construct(bamChunk, outputLabels, features, featureStartIdx,
+                                                              featureEndIdxInclusive, maxRunLength);
+    if (data == NULL) {
+        return TRUE;
+    }
+    int64_t featureCount = (int64_t) data->featureCount;
+
+    // the rows of the chunk
+    char *arrayBase = stString_print("%s/%s", outputDir, outputFileBase);
+    bool ok = writeSplitRleFeatureNpyArray(arrayBase, "position", 'u', sizeof(uint32_t), data->positionData,
+                                           featureCount, 3);
+    ok = writeSplitRleFeatureNpyArray(arrayBase, "image", 'u', sizeof(uint8_t), data->imageData, featureCount,
+                                      data->imageColumnCount) && ok;
+    ok = writeSplitRleFeatureNpyArray(arrayBase, "normalization", 'u', sizeof(uint8_t), data->normalizationData,
+                                      featureCount, 1) && ok;
+    if (outputLabels) {
+        ok = writeSplitRleFeatureNpyArray(arrayBase, "label_base", 'u', sizeof(uint8_t), data->labelCharacterData,
+                                          featureCount, 1) && ok;
+        ok = writeSplitRleFeatureNpyArray(arrayBase, "label_run_length", 'u', sizeof(uint8_t),
+                                          data->labelRunLengthData, featureCount, 1) && ok;
+    }
+
+    // the manifest, with its windows, is written last and renamed into place so it only exists for complete chunks
+    char *manifestFile = stString_print("%s.json", arrayBase);
+    char *tempManifestFile = stString_print("%s.tmp", manifestFile);
+    FILE *fh = ok ? fopen(tempManifestFile, "w") : NULL;
+    if (fh != NULL) {
+        fprintf(fh, "{\n  \"name\": ");
+        writeJsonString(fh, outputFileBase);
+        fprintf(fh, ",\n  \"contig\": ");
+        writeJsonString(fh, bamChunk->refSeqName);
+        fprintf(fh, ",\n  \"contig_start\": %"PRId64",\n  \"contig_end\": %"PRId64",\n", bamChunk->chunkBoundaryStart,
+                bamChunk->chunkBoundaryEnd);
+        fprintf(fh, "  \"row_count\": %"PRId64",\n  \"image_column_count\": %"PRId64",\n  \"labels\": %s,\n",
+                featureCount, data->imageColumnCount, outputLabels ? "true" : "false");
+        fprintf(fh, "  \"windows\": [");
+        int64_t windowCount = getFeatureWindowCount(data->featureCount);
+        int64_t windowSize = featureCount < HDF5_FEATURE_SIZE ? featureCount : HDF5_FEATURE_SIZE;
+        for (int64_t featureIndex = 0; featureIndex < windowCount; featureIndex++) {
+            fprintf(fh, "%s\n    {\"name\": ", featureIndex == 0 ? "" : ",");
+            char *windowName = stString_print("%s.%"PRId64, outputFileBase, featureIndex);
+            writeJsonString(fh, windowName);
+            fprintf(fh, ", \"feature_chunk_idx\": %"PRId64", \"row_start\": %"PRId64", \"row_count\": %"PRId64"}",
+                    featureIndex, getFeatureWindowStart(data->featureCount, featureIndex), windowSize);
+            free(windowName);
+        }
+        fprintf(fh, "%s]\n}\n", windowCount == 0 ? "" : "\n  ");
+        ok = fclose(fh) == 0 && rename(tempManifestFile, manifestFile) == 0 && ok;
+    } else {
+        ok = FALSE;
+    }
+
+    if (!ok) {
+        char *logIdentifier = getLogIdentifier();
+        st_logCritical(" %s Error writing HELEN features to NumPy files: %s\n", logIdentifier, arrayBase);
+        free(logIdentifier);
+    }
+
+    // cleanup
+    splitRleFeatureData_destruct(data);
+    free(manifestFile);
+    free(tempManifestFile);
+    free(arrayBase);
+    return ok;
+}
+
+#ifdef _HDF5
+void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileInfo, char *outputFileBase, BamChunk *bamChunk,
+        bool outputLabels, stList *features, int64_t featureStartIdx, int64_t featureEndIdxInclusive,
+        const int64_t maxRunLength) {
+
+    herr_t      status = 0;
+
+    /*
+     * Get feature data set up
+     */
+
+    SplitRleFeatureData *data = splitRleFeatureData_construct(bamChunk, outputLabels, features, featureStartIdx,
+                                                              featureEndIdxInclusive, maxRunLength);
+    if (data == NULL) {
+        return;
+    }
+    uint64_t featureCount = data->featureCount;
+    int64_t rleNucleotideColumnCount = data->imageColumnCount;
+    uint32_t *positionData = data->positionData;
+    uint8_t *normalizationData = data->normalizationData;
+    uint8_t *imageData = data->imageData;
+    uint8_t *labelCharacterData = data->labelCharacterData;
+    uint8_t *labelRunLengthData = data->labelRunLengthData;
+
     /*
      * Get hdf5 data set up
      */
@@ -1866,17 +2040,10 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
      */
 
     // each file must have exactly 1000 features
-    int64_t totalFeatureFiles = (int64_t) (featureCount / HDF5_FEATURE_SIZE) + (featureCount % HDF5_FEATURE_SIZE == 0 ? 0 : 1);
-    int64_t featureOffset = 0;
-    if (featureCount >= HDF5_FEATURE_SIZE) {
-        featureOffset = (int64_t) ((HDF5_FEATURE_SIZE * totalFeatureFiles - featureCount) / (int64_t) (featureCount / HDF5_FEATURE_SIZE));
-    }
+    int64_t totalFeatureFiles = getFeatureWindowCount(featureCount);
     for (int64_t featureIndex = 0; featureIndex < totalFeatureFiles; featureIndex++) {
         // get start pos
-        int64_t chunkFeatureStartIdx = (HDF5_FEATURE_SIZE * featureIndex) - (featureOffset * featureIndex);
-        if (featureIndex + 1 == totalFeatureFiles && featureCount >= HDF5_FEATURE_SIZE) {
-            chunkFeatureStartIdx = featureCount - HDF5_FEATURE_SIZE;
-        }
+        int64_t chunkFeatureStartIdx = getFeatureWindowStart(featureCount, featureIndex);
 
         // create group
         char *outputGroup = stString_print("images/%s.%"PRId64, outputFileBase, featureIndex);
@@ -1894,26 +2061,26 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
 
         // write position info
         hid_t positionDataset = H5Dcreate (group, "position", hdf5FileInfo->uint32Type, positionSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-        status |= H5Dwrite (positionDataset, hdf5FileInfo->uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, positionData[chunkFeatureStartIdx]);
+        status |= H5Dwrite (positionDataset, hdf5FileInfo->uint32Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, &positionData[chunkFeatureStartIdx * 3]);
 
         // write rle data
         hid_t imageDataset = H5Dcreate (group, "image", hdf5FileInfo->uint8Type, imageSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (imageDataset, hdf5FileInfo->uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            imageData[chunkFeatureStartIdx]);
+                            &imageData[chunkFeatureStartIdx * rleNucleotideColumnCount]);
         hid_t normalizationDataset = H5Dcreate (group, "normalization", hdf5FileInfo->uint8Type, normalizationSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
         status |= H5Dwrite (normalizationDataset, hdf5FileInfo->uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                            normalizationData[chunkFeatureStartIdx]);
+                            &normalizationData[chunkFeatureStartIdx]);
 
         // if labels, add all these too
         if (outputLabels) {
             hid_t labelCharacterDataset = H5Dcreate (group, "label_base", hdf5FileInfo->uint8Type, labelCharacterSpace, H5P_DEFAULT,
                                                      H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelCharacterDataset, hdf5FileInfo->uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelCharacterData[chunkFeatureStartIdx]);
+                                &labelCharacterData[chunkFeatureStartIdx]);
             hid_t labelRunLengthDataset = H5Dcreate (group, "label_run_length", hdf5FileInfo->uint8Type, labelRunLengthSpace,
                                                      H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
             status |= H5Dwrite (labelRunLengthDataset, hdf5FileInfo->uint8Type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-                                labelRunLengthData[chunkFeatureStartIdx]);
+                                &labelRunLengthData[chunkFeatureStartIdx]);
 
             status |= H5Dclose (labelCharacterDataset);
             status |= H5Dclose (labelRunLengthDataset);
@@ -1932,12 +2099,7 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
     }
 
     // cleanup
-    free(imageData[0]);
-    free(imageData);
-    free(normalizationData[0]);
-    free(normalizationData);
-    free(positionData[0]);
-    free(positionData);
+    splitRleFeatureData_destruct(data);
     status |= H5Sclose (metadataSpace);
     status |= H5Sclose (positionSpace);
     status |= H5Sclose (imageSpace);
@@ -1945,12 +2107,6 @@ void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileI
     status |= H5Sclose (labelRunLengthSpace);
     status |= H5Sclose (labelCharacterSpace);
     status |= H5Tclose (stringType);
-    if (outputLabels) {
-        free(labelCharacterData[0]);
-        free(labelCharacterData);
-        free(labelRunLengthData[0]);
-        free(labelRunLengthData);
-    }
 
     if (status) {
         char *logIdentifier = getLogIdentifier();
@@ -1995,4 +2151,291 @@ SplitRleFeatureHDF5FileInfo** openSplitRleFeatureHDF5FilesByThreadCount(char *fi
     return infoArray;
 }
 
-#endif
\ No newline at end of file
+
+/*
+ * Single file writer
+ */
+
+#define HDF5_FEATURE_COMPRESSION_LEVEL 4
+#define HDF5_WINDOW_INDEX_CHUNK_SIZE 1024
+
+typedef struct _splitRleFeatureHDF5WriterJob {
+    char *name;
+    char *contig;
+    int64_t contigStart;
+    int64_t contigEnd;
+    SplitRleFeatureData *data;
+} SplitRleFeatureHDF5WriterJob;
+
+static void splitRleFeatureHDF5WriterJob_destruct(SplitRleFeatureHDF5WriterJob *job) {
+    free(job->name);
+    free(job->contig);
+    splitRleFeatureData_destruct(job->data);
+    free(job);
+}
+
+static hid_t createExtendableDataset(hid_t location, char *name, hid_t type, int rank, hsize_t columnCount,
+                                     hsize_t chunkRows) {
+    // rows are appended along the first dimension, a rank 2 dataset has columnCount columns
+    hsize_t dimension[2] = {0, columnCount};
+    hsize_t maxDimension[2] = {H5S_UNLIMITED, columnCount};
+    hsize_t chunkDimension[2] = {chunkRows, columnCount};
+    hid_t space = H5Screate_simple(rank, dimension, maxDimension);
+    hid_t properties = H5Pcreate (H5P_DATASET_CREATE);
+    H5Pset_chunk (properties, rank, chunkDimension);
+    H5Pset_deflate (properties, HDF5_FEATURE_COMPRESSION_LEVEL);
+    hid_t dataset = H5Dcreate (location, name, type, space, H5P_DEFAULT, properties, H5P_DEFAULT);
+    H5Pclose (properties);
+    H5Sclose (space);
+    if (dataset < 0) {
+        st_errAbort("Could not create HDF5 dataset %s\n", name);
+    }
+    return dataset;
+}
+
+static herr_t appendRows(hid_t dataset, hid_t type, int rank, hsize_t rowStart, hsize_t rowCount,
+                         hsize_t columnCount, const void *rows) {
+    if (rowCount == 0) {
+        return 0;
+    }
+    herr_t status = 0;
+    hsize_t dimension[2] = {rowStart + rowCount, columnCount};
+    status |= H5Dset_extent (dataset, dimension);
+    hid_t fileSpace = H5Dget_space (dataset);
+    hsize_t start[2] = {rowStart, 0};
+    hsize_t count[2] = {rowCount, columnCount};
+    status |= H5Sselect_hyperslab (fileSpace, H5S_SELECT_SET, start, NULL, count, NULL);
+    hid_t memorySpace = H5Screate_simple(rank, count, NULL);
+    status |= H5Dwrite (dataset, type, memorySpace, fileSpace, H5P_DEFAULT, rows);
+    status |= H5Sclose (memorySpace);
+    status |= H5Sclose (fileSpace);
+    return status;
+}
+
+static void splitRleFeatureHDF5Writer_write(SplitRleFeatureHDF5Writer *writer, SplitRleFeatureHDF5WriterJob *job) {
+    herr_t status = 0;
+    SplitRleFeatureData *data = job->data;
+
+    // the rows of the chunk
+    hsize_t rowStart = (hsize_t) writer->rowCount;
+    status |= appendRows(writer->positionDataset, H5T_NATIVE_UINT32, 2, rowStart, data->featureCount, 3,
+                         data->positionData);
+    status |= appendRows(writer->imageDataset, H5T_NATIVE_UINT8, 2, rowStart, data->featureCount,
+                         writer->imageColumnCount, data->imageData);
+    status |= appendRows(writer->normalizationDataset, H5T_NATIVE_UINT8, 2, rowStart, data->featureCount, 1,
+                         data->normalizationData);
+    if (writer->outputLabels) {
+        status |= appendRows(writer->labelCharacterDataset, H5T_NATIVE_UINT8, 2, rowStart, data->featureCount, 1,
+                             data->labelCharacterData);
+        status |= appendRows(writer->labelRunLengthDataset, H5T_NATIVE_UINT8, 2, rowStart, data->featureCount, 1,
+                             data->labelRunLengthData);
+    }
+    writer->rowCount += data->featureCount;
+
+    // its windows, a row of each window index dataset per window, appended together
+    int64_t windowCount = getFeatureWindowCount(data->featureCount);
+    int64_t windowSize = data->featureCount < HDF5_FEATURE_SIZE ? data->featureCount : HDF5_FEATURE_SIZE;
+    char **windowNames = st_malloc(windowCount * sizeof(char *));
+    char **windowContigs = st_malloc(windowCount * sizeof(char *));
+    int64_t *windowContigStarts = st_malloc(windowCount * sizeof(int64_t));
+    int64_t *windowContigEnds = st_malloc(windowCount * sizeof(int64_t));
+    int64_t *windowChunkIndexes = st_malloc(windowCount * sizeof(int64_t));
+    int64_t *windowRowStarts = st_malloc(windowCount * sizeof(int64_t));
+    int64_t *windowRowCounts = st_malloc(windowCount * sizeof(int64_t));
+    for (int64_t featureIndex = 0; featureIndex < windowCount; featureIndex++) {
+        windowNames[featureIndex] = stString_print("%s.%"PRId64, job->name, featureIndex);
+        windowContigs[featureIndex] = job->contig;
+        windowContigStarts[featureIndex] = job->contigStart;
+        windowContigEnds[featureIndex] = job->contigEnd;
+        windowChunkIndexes[featureIndex] = featureIndex;
+        windowRowStarts[featureIndex] = rowStart + getFeatureWindowStart(data->featureCount, featureIndex);
+        windowRowCounts[featureIndex] = windowSize;
+    }
+    hsize_t windowStart = (hsize_t) writer->windowCount;
+    status |= appendRows(writer->windowNameDataset, writer->stringType, 1, windowStart, windowCount, 1,
+                         windowNames);
+    status |= appendRows(writer->windowContigDataset, writer->stringType, 1, windowStart, windowCount, 1,
+                         windowContigs);
+    status |= appendRows(writer->windowContigStartDataset, H5T_NATIVE_INT64, 1, windowStart, windowCount, 1,
+                         windowContigStarts);
+    status |= appendRows(writer->windowContigEndDataset, H5T_NATIVE_INT64, 1, windowStart, windowCount, 1,
+                         windowContigEnds);
+    status |= appendRows(writer->windowChunkIndexDataset, H5T_NATIVE_INT64, 1, windowStart, windowCount, 1,
+                         windowChunkIndexes);
+    status |= appendRows(writer->windowRowStartDataset, H5T_NATIVE_INT64, 1, windowStart, windowCount, 1,
+                         windowRowStarts);
+    status |= appendRows(writer->windowRowCountDataset, H5T_NATIVE_INT64, 1, windowStart, windowCount, 1,
+                         windowRowCounts);
+    writer->windowCount += windowCount;
+
+    if (status) {
+        writer->failed = TRUE;
+        st_logCritical(" Error writing HELEN features to HDF5 file %s: %s\n", writer->filename, job->name);
+    }
+
+    // cleanup
+    for (int64_t featureIndex = 0; featureIndex < windowCount; featureIndex++) {
+        free(windowNames[featureIndex]);
+    }
+    free(windowNames);
+    free(windowContigs);
+    free(windowContigStarts);
+    free(windowContigEnds);
+    free(windowChunkIndexes);
+    free(windowRowStarts);
+    free(windowRowCounts);
+}
+
+static void *splitRleFeatureHDF5Writer_run(void *arg) {
+    // the writer thread, the only one to touch the file once it is open
+    SplitRleFeatureHDF5Writer *writer = arg;
+    while (TRUE) {
+        pthread_mutex_lock(&writer->mutex);
+        while (stList_length(writer->queue) == 0 && !writer->finished) {
+            pthread_cond_wait(&writer->queueNotEmpty, &writer->mutex);
+        }
+        if (stList_length(writer->queue) == 0) {
+            pthread_mutex_unlock(&writer->mutex);
+            break;
+        }
+        SplitRleFeatureHDF5WriterJob *job = stList_remove(writer->queue, 0);
+        pthread_cond_signal(&writer->queueNotFull);
+        pthread_mutex_unlock(&writer->mutex);
+
+        splitRleFeatureHDF5Writer_write(writer, job);
+        splitRleFeatureHDF5WriterJob_destruct(job);
+    }
+    return NULL;
+}
+
+SplitRleFeatureHDF5Writer *splitRleFeatureHDF5Writer_construct(char *filename, int64_t maxRunLength,
+                                                               bool outputLabels, int64_t maxQueueLength) {
+    SplitRleFeatureHDF5Writer *writer = st_calloc(1, sizeof(SplitRleFeatureHDF5Writer));
+    writer->filename = stString_copy(filename);
+    writer->maxRunLength = maxRunLength;
+    writer->imageColumnCount = ((SYMBOL_NUMBER - 1) * (maxRunLength + 1) + 1) * 2;
+    writer->outputLabels = outputLabels;
+    writer->maxQueueLength = maxQueueLength < 1 ? 1 : maxQueueLength;
+
+    // file and datasets
+    writer->file = H5Fcreate (filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (writer->file < 0) {
+        st_errAbort("Could not create HDF5 file: %s\n", filename);
+    }
+    writer->stringType = H5Tcopy (H5T_C_S1);
+    H5Tset_size (writer->stringType, H5T_VARIABLE);
+    writer->positionDataset = createExtendableDataset(writer->file, "position", H5T_STD_U32LE, 2, 3,
+                                                      HDF5_FEATURE_SIZE);
+    writer->imageDataset = createExtendableDataset(writer->file, "image", H5T_STD_U8LE, 2,
+                                                   writer->imageColumnCount, HDF5_FEATURE_SIZE);
+    writer->normalizationDataset = createExtendableDataset(writer->file, "normalization", H5T_STD_U8LE, 2, 1,
+                                                           HDF5_FEATURE_SIZE);
+    writer->labelCharacterDataset = -1;
+    writer->labelRunLengthDataset = -1;
+    if (outputLabels) {
+        writer->labelCharacterDataset = createExtendableDataset(writer->file, "label_base", H5T_STD_U8LE, 2, 1,
+                                                                HDF5_FEATURE_SIZE);
+        writer->labelRunLengthDataset = createExtendableDataset(writer->file, "label_run_length", H5T_STD_U8LE, 2,
+                                                                1, HDF5_FEATURE_SIZE);
+    }
+    hid_t windows = H5Gcreate (writer->file, "windows", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    writer->windowNameDataset = createExtendableDataset(windows, "name", writer->stringType, 1, 1,
+                                                        HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    writer->windowContigDataset = createExtendableDataset(windows, "contig", writer->stringType, 1, 1,
+                                                          HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    writer->windowContigStartDataset = createExtendableDataset(windows, "contig_start", H5T_STD_I64LE, 1, 1,
+                                                               HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    writer->windowContigEndDataset = createExtendableDataset(windows, "contig_end", H5T_STD_I64LE, 1, 1,
+                                                             HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    writer->windowChunkIndexDataset = createExtendableDataset(windows, "feature_chunk_idx", H5T_STD_I64LE, 1, 1,
+                                                              HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    writer->windowRowStartDataset = createExtendableDataset(windows, "row_start", H5T_STD_I64LE, 1, 1,
+                                                            HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    writer->windowRowCountDataset = createExtendableDataset(windows, "row_count", H5T_STD_I64LE, 1, 1,
+                                                            HDF5_WINDOW_INDEX_CHUNK_SIZE);
+    H5Gclose (windows);
+
+    // writer thread
+    writer->queue = stList_construct();
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->queueNotEmpty, NULL);
+    pthread_cond_init(&writer->queueNotFull, NULL);
+    if (pthread_create(&writer->thread, NULL, splitRleFeatureHDF5Writer_run, writer) != 0) {
+        st_errAbort("Could not start the HDF5 writer thread for %s\n", filename);
+    }
+    return writer;
+}
+
+bool splitRleFeatureHDF5Writer_destruct(SplitRleFeatureHDF5Writer *writer) {
+    // let the writer thread finish the queue
+    pthread_mutex_lock(&writer->mutex);
+    writer->finished = TRUE;
+    pthread_cond_broadcast(&writer->queueNotEmpty);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    st_logInfo("> Wrote %"PRId64" HELEN feature windows of %"PRId64" rows to %s\n", writer->windowCount,
+               writer->rowCount, writer->filename);
+
+    // closing the file flushes what the writes left buffered, so can fail too
+    herr_t status = 0;
+    status |= H5Dclose (writer->positionDataset);
+    status |= H5Dclose (writer->imageDataset);
+    status |= H5Dclose (writer->normalizationDataset);
+    if (writer->outputLabels) {
+        status |= H5Dclose (writer->labelCharacterDataset);
+        status |= H5Dclose (writer->labelRunLengthDataset);
+    }
+    status |= H5Dclose (writer->windowNameDataset);
+    status |= H5Dclose (writer->windowContigDataset);
+    status |= H5Dclose (writer->windowContigStartDataset);
+    status |= H5Dclose (writer->windowContigEndDataset);
+    status |= H5Dclose (writer->windowChunkIndexDataset);
+    status |= H5Dclose (writer->windowRowStartDataset);
+    status |= H5Dclose (writer->windowRowCountDataset);
+    status |= H5Tclose (writer->stringType);
+    status |= H5Fclose (writer->file);
+    bool written = !writer->failed && !status;
+    if (!written) {
+        st_logCritical("> Errors writing HELEN features to %s\n", writer->filename);
+    }
+
+    stList_destruct(writer->queue);
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->queueNotEmpty);
+    pthread_cond_destroy(&writer->queueNotFull);
+    free(writer->filename);
+    free(writer);
+    return written;
+}
+
+void splitRleFeatureHDF5Writer_addChunk(SplitRleFeatureHDF5Writer *writer, char *outputFileBase, BamChunk *bamChunk,
+                                        bool outputLabels, stList *features, int64_t featureStartIdx,
+                                        int64_t featureEndIdxInclusive) {
+    if (outputLabels != writer->outputLabels) {
+        st_errAbort("HELEN features of chunk %s %s labels but the HDF5 file %s %s\n", outputFileBase,
+                    outputLabels ? "have" : "do not have", writer->filename,
+                    writer->outputLabels ? "does" : "does not");
+    }
+    SplitRleFeatureData *data = splitRleFeatureData_construct(bamChunk, outputLabels, features, featureStartIdx,
+                                                              featureEndIdxInclusive, writer->maxRunLength);
+    if (data == NULL) {
+        return;
+    }
+    SplitRleFeatureHDF5WriterJob *job = st_calloc(1, sizeof(SplitRleFeatureHDF5WriterJob));
+    job->name = stString_copy(outputFileBase);
+    job->contig = stString_copy(bamChunk->refSeqName);
+    job->contigStart = bamChunk->chunkBoundaryStart;
+    job->contigEnd = bamChunk->chunkBoundaryEnd;
+    job->data = data;
+
+    pthread_mutex_lock(&writer->mutex);
+    while (stList_length(writer->queue) >= writer->maxQueueLength) {
+        pthread_cond_wait(&writer->queueNotFull, &writer->mutex);
+    }
+    stList_append(writer->queue, job);
+    pthread_cond_signal(&writer->queueNotEmpty);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+#endif
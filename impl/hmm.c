@@ -944,7 +944,7 @@ stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2)
     return hmm;
 }
 
-static void stRPHmm_initialiseProbs(stRPHmm *hmm) {
+void stRPHmm_initialiseProbs(stRPHmm *hmm) {
     /*
      * Initialize the forward and backward matrices.
      */
@@ -1019,7 +1019,7 @@ static inline void forwardCellCalc2(stRPHmm *hmm, stRPColumn *column, stRPCell *
     }
 }
 
-static void stRPHmm_forward(stRPHmm *hmm) {
+void stRPHmm_forward(stRPHmm *hmm) {
     /*
      * Forward algorithm for hmm.
      */
@@ -1105,7 +1105,7 @@ static inline void backwardCellCalc(stRPHmm *hmm, stRPColumn *column, stRPCell *
                  cell->forwardLogProb + cell->backwardLogProb, hmm->parameters->maxNotSumTransitions);
 }
 
-static void stRPHmm_backward(stRPHmm *hmm) {
+void stRPHmm_backward(stRPHmm *hmm) {
     /*
      * Backward algorithm for hmm.
      */
@@ -2,9 +2,163 @@
 // Created by tpesout on 1/8/19.
 //
 
+#include <omp.h>
+#include <sys/stat.h>
+
 #include "htsIntegration.h"
 #include "margin.h"
 
+/*
+ * Opening of alignment files, which may be BAM or CRAM. CRAM is decoded against a local reference fasta, never a
+ * reference fetched over the network.
+ */
+
+// An htslib template for REF_PATH that never matches a file, so no reference is looked up by its MD5 checksum
+#define NO_REF_PATH "/dev/null/%s"
+
+static char *cramReferenceFasta = NULL;
+
+void setCramReferenceFasta(char *referenceFasta) {
+    free(cramReferenceFasta);
+    cramReferenceFasta = referenceFasta == NULL ? NULL : stString_copy(referenceFasta);
+    // With REF_PATH unset htslib fetches a contig missing from the fasta from the EBI server. A REF_PATH set by the
+    // user is their choice, and is left alone
+    if (getenv("REF_PATH") == NULL) {
+        st_logInfo("> REF_PATH is not set, setting it to %s so cram references are not fetched from the network\n",
+                   NO_REF_PATH);
+        setenv("REF_PATH", NO_REF_PATH, 1);
+    }
+}
+
+static samFile *openAlignmentFile2(char *alignmentFile, char **error) {
+    // Returns NULL and sets error to a message, which the caller frees, if the file cannot be opened
+    samFile *in = hts_open(alignmentFile, "r");
+    if (in == NULL) {
+        *error = stString_print("Cannot open bam file %s", alignmentFile);
+        return NULL;
+    }
+    if (hts_get_format(in)->format == cram) {
+        if (cramReferenceFasta == NULL) {
+            *error = stString_print("No reference fasta to decode cram file %s", alignmentFile);
+        } else if (hts_set_fai_filename(in, cramReferenceFasta) != 0) {
+            *error = stString_print("Cannot use %s as the reference of cram file %s", cramReferenceFasta,
+                                    alignmentFile);
+        }
+        if (*error != NULL) {
+            sam_close(in);
+            return NULL;
+        }
+    }
+    return in;
+}
+
+samFile *openAlignmentFile(char *alignmentFile) {
+    char *error = NULL;
+    samFile *in = openAlignmentFile2(alignmentFile, &error);
+    if (in == NULL) {
+        st_errAbort("ERROR: %s\n", error);
+    }
+    return in;
+}
+
+/*
+ * Alignment files opened by the chunker and convertToReadsAndAlignments are kept open, per thread, until
+ * closeCachedAlignmentFiles is called. A thread polishing consecutive chunks then loads the index once, and for a CRAM
+ * decodes against the reference sequence it has already loaded. A file is reopened if it has been modified or the
+ * CRAM reference has changed since it was opened. Files are cached by their position in the chunker's list of bams
+ * too, so a bam listed twice has a handle per position and the iterators reading a chunk never share one. The server
+ * polishes each request in its own process, so nothing cached here outlives a request.
+ */
+typedef struct _cachedAlignmentFile {
+    samFile *in;
+    hts_idx_t *idx;
+    bam_hdr_t *bamHdr;
+    time_t modificationTime;
+    char *cramReferenceFasta; // NULL if none was set when opened
+} CachedAlignmentFile;
+
+static stHash *cachedAlignmentFiles = NULL; // "thread:position:file" to CachedAlignmentFile
+
+static void cachedAlignmentFile_destruct(CachedAlignmentFile *file) {
+    if (file->idx != NULL) hts_idx_destroy(file->idx);
+    if (file->bamHdr != NULL) bam_hdr_destroy(file->bamHdr);
+    if (file->in != NULL) sam_close(file->in);
+    free(file->cramReferenceFasta);
+    free(file);
+}
+
+static bool cachedAlignmentFile_isCurrent(CachedAlignmentFile *file, time_t modificationTime) {
+    return file->modificationTime == modificationTime &&
+           (file->cramReferenceFasta == NULL ? cramReferenceFasta == NULL :
+            cramReferenceFasta != NULL && stString_eq(file->cramReferenceFasta, cramReferenceFasta));
+}
+
+static CachedAlignmentFile *getCachedAlignmentFile2(char *alignmentFile, int64_t bamIdx, char **error) {
+    // Returns NULL and sets error to a message, which the caller frees, if the file, its index or header cannot be read
+    struct stat fileStat;
+    if (stat(alignmentFile, &fileStat) != 0) {
+        *error = stString_print("Cannot open bam file %s", alignmentFile);
+        return NULL;
+    }
+    char *key = stString_print("%d:%"PRId64":%s", omp_get_thread_num(), bamIdx, alignmentFile);
+    CachedAlignmentFile *file;
+    #pragma omp critical(cachedAlignmentFiles)
+    {
+        if (cachedAlignmentFiles == NULL) {
+            cachedAlignmentFiles = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free,
+                                                     (void (*)(void *)) cachedAlignmentFile_destruct);
+        }
+        file = stHash_search(cachedAlignmentFiles, key);
+        if (file != NULL && !cachedAlignmentFile_isCurrent(file, fileStat.st_mtime)) {
+            stHash_remove(cachedAlignmentFiles, key);
+            cachedAlignmentFile_destruct(file);
+            file = NULL;
+        }
+    }
+    if (file != NULL) {
+        free(key);
+        return file;
+    }
+
+    // only this thread uses the key, so the file can be opened outside the critical section
+    file = st_calloc(1, sizeof(CachedAlignmentFile));
+    file->modificationTime = fileStat.st_mtime;
+    file->cramReferenceFasta = cramReferenceFasta == NULL ? NULL : stString_copy(cramReferenceFasta);
+    if ((file->in = openAlignmentFile2(alignmentFile, error)) == NULL) {
+        // error is set
+    } else if ((file->idx = sam_index_load(file->in, alignmentFile)) == NULL) {
+        *error = stString_print("Cannot open index for bam file %s", alignmentFile);
+    } else if ((file->bamHdr = sam_hdr_read(file->in)) == NULL) {
+        *error = stString_print("Cannot read the header of bam file %s", alignmentFile);
+    }
+    if (*error != NULL) {
+        cachedAlignmentFile_destruct(file);
+        free(key);
+        return NULL;
+    }
+    #pragma omp critical(cachedAlignmentFiles)
+    {
+        stHash_insert(cachedAlignmentFiles, key, file);
+    }
+    return file;
+}
+
+static CachedAlignmentFile *getCachedAlignmentFile(char *alignmentFile, int64_t bamIdx) {
+    char *error = NULL;
+    CachedAlignmentFile *file = getCachedAlignmentFile2(alignmentFile, bamIdx, &error);
+    if (file == NULL) {
+        st_errAbort("ERROR: %s\n", error);
+    }
+    return file;
+}
+
+void closeCachedAlignmentFiles() {
+    if (cachedAlignmentFiles != NULL) {
+        stHash_destruct(cachedAlignmentFiles);
+        cachedAlignmentFiles = NULL;
+    }
+}
+
 /*
  * getAlignedReadLength computes the length of the read sequence which is aligned to the reference.  Hard-clipped bases
  * are never included in this calculation.  Soft-clipped bases are similarly not included, but will be returned via
@@ -139,64 +293,40 @@ int64_t saveContigChunks(stList *dest, BamChunker *parent, char *contig, int64_t
 
 
 /*
- * These handle construction of the BamChunk object, by iterating through the bam (must be sorted), and finds the
- * first and last aligned location on each contig.  Then it generates a list of chunks based off of these positions,
- * with sizes determined by the parameters.
+ * Finds the first and last aligned position on each contig of the reads in a bam, widening the extents in
+ * contigStartPos and contigEndPos (indexed by the contig's id in the header of the chunker's first bam, -1 where no
+ * read was seen). If regionTid is not -1 only reads overlapping regionStart to regionEnd on that contig are counted.
+ * Reads are found with the index, from the file cached for this thread and the bam's position (bamIdx) in the list.
  */
-BamChunker *bamChunker_construct(char *bamFile, PolishParams *params) {
-    return bamChunker_construct2(bamFile, NULL, params);
-}
-BamChunker *bamChunker_construct2(char *bamFile, char *region, PolishParams *params) {
-
-    // are we doing region filtering?
-    bool filterByRegion = false;
-    char regionContig[128] = "";
-    int regionStart = 0;
-    int regionEnd = 0;
-    if (region != NULL) {
-        int scanRet = sscanf(region, "%[^:]:%d-%d", regionContig, &regionStart, &regionEnd);
-        if (scanRet != 3 || strlen(regionContig) == 0) {
-            st_errAbort("Region in unexpected format (expected %%s:%%d-%%d): %s", region);
-        } else if (regionStart < 0 || regionEnd <= 0 || regionEnd <= regionStart) {
-            st_errAbort("Start and end locations in region must be positive, start must be less than end: %s", region);
+static void getAlignedExtents(char *bamFile, int64_t bamIdx, bam_hdr_t *primaryHdr, int regionTid,
+                              int64_t regionStart, int64_t regionEnd, int64_t *contigStartPos,
+                              int64_t *contigEndPos) {
+    // open bamfile
+    CachedAlignmentFile *file = getCachedAlignmentFile(bamFile, bamIdx);
+    samFile *in = file->in;
+    bam_hdr_t *bamHdr = file->bamHdr;
+
+    // iterate over the region, or over all reads
+    hts_itr_t *iter = NULL;
+    if (regionTid != -1) {
+        int tid = bam_name2id(bamHdr, primaryHdr->target_name[regionTid]);
+        if (tid < 0) {
+            // no reads on the region's contig in this bam
+            return;
         }
-        filterByRegion = true;
+        if ((iter = sam_itr_queryi(file->idx, tid, regionStart, regionEnd)) == NULL) {
+            st_errAbort("ERROR: Cannot open iterator for %s:%" PRId64 "-%" PRId64 " for bam file %s\n",
+                        primaryHdr->target_name[regionTid], regionStart, regionEnd, bamFile);
+        }
+    } else if ((iter = sam_itr_queryi(file->idx, HTS_IDX_START, 0, 0)) == NULL) {
+        st_errAbort("ERROR: Cannot open iterator for bam file %s\n", bamFile);
     }
-
-    // standard parameters
-    uint64_t chunkSize = params->chunkSize;
-    uint64_t chunkBoundary = params->chunkBoundary;
-    bool includeSoftClip = params->includeSoftClipping;
-
-    // the chunker we're building
-    BamChunker *chunker = malloc(sizeof(BamChunker));
-    chunker->bamFile = stString_copy(bamFile);
-    chunker->chunkSize = chunkSize;
-    chunker->chunkBoundary = chunkBoundary;
-    chunker->includeSoftClip = includeSoftClip;
-    chunker->params = params;
-    chunker->chunks = stList_construct3(0,(void*)bamChunk_destruct);
-    chunker->chunkCount = 0;
-
-    // open bamfile
-    samFile *in = hts_open(bamFile, "r");
-    if (in == NULL)
-        st_errAbort("ERROR: Cannot open bam file %s\n", bamFile);
-    hts_idx_t *idx = sam_index_load(in, bamFile); // load index (just to verify early that it exists)
-    if (idx == NULL)
-        st_errAbort("ERROR: Missing index for bam file %s\n", bamFile);
-    hts_idx_destroy(idx);
-    bam_hdr_t *bamHdr = sam_hdr_read(in);
     bam1_t *aln = bam_init1();
 
-    // list of chunk boundaries
-    char *currentContig = NULL;
-    int64_t contigStartPos = 0;
-    int64_t contigEndPos = 0;
-
-    // get all reads
     // there is probably a better way (bai?) to find min and max aligned positions (which we need for chunk divisions)
-    while(sam_read1(in,bamHdr,aln) > 0) {
+    int64_t tidInPrimary = -1;
+    int32_t lastTid = -1;
+    while(sam_itr_next(in, iter, aln) >= 0) {
 
         // basic filtering (no read length, no cigar)
         if (aln->core.l_qseq <= 0) continue;
@@ -204,7 +334,6 @@ BamChunker *bamChunker_construct2(char *bamFile, char *region, PolishParams *par
         if ((aln->core.flag & (uint16_t) 0x4) != 0) continue; //unaligned
 
         //data
-        char *chr = bamHdr->target_name[aln->core.tid];
         int64_t start_softclip = 0;
         int64_t end_softclip = 0;
         int64_t alnReadLength = getAlignedReadLength3(aln, &start_softclip, &end_softclip, FALSE);
@@ -213,63 +342,264 @@ BamChunker *bamChunker_construct2(char *bamFile, char *region, PolishParams *par
 
         // does this belong in our chunk?
         if (alnReadLength <= 0) continue;
-        if (filterByRegion && (!stString_eq(regionContig, chr) || alnStartPos >= regionEnd || alnEndPos <= regionStart))
-            continue;
+        if (regionTid != -1 && (alnStartPos >= regionEnd || alnEndPos <= regionStart)) continue;
+
+        // get contig, by name in the first bam's header so the bams need not share contig ids
+        if (aln->core.tid != lastTid) {
+            lastTid = aln->core.tid;
+            tidInPrimary = bam_name2id(primaryHdr, bamHdr->target_name[aln->core.tid]);
+        }
+        if (tidInPrimary < 0) {
+            st_errAbort("ERROR: Contig %s of bam file %s is not in the first bam file\n",
+                        bamHdr->target_name[aln->core.tid], bamFile);
+        }
 
         // get start and stop position
-        int64_t readStartPos = aln->core.pos;           // Left most position of alignment
-        int64_t readEndPos = readStartPos + alnReadLength;
-
-        // get contig
-        char *contig = bamHdr->target_name[aln->core.tid];     // Contig name
-
-        if (currentContig == NULL) {
-            // first read
-            currentContig = stString_copy(contig);
-            contigStartPos = readStartPos;
-            contigEndPos = readEndPos;
-        } else if (stString_eq(currentContig, contig)) {
-            // continue this contig's reads
-            contigStartPos = readStartPos < contigStartPos ? readStartPos : contigStartPos;
-            contigEndPos = readEndPos > contigEndPos ? readEndPos : contigEndPos;
+        if (contigStartPos[tidInPrimary] == -1) {
+            contigStartPos[tidInPrimary] = alnStartPos;
+            contigEndPos[tidInPrimary] = alnEndPos;
         } else {
-            // new contig (this should never happen if we're filtering by region)
-            assert(!filterByRegion);
-            int64_t savedChunkCount = saveContigChunks(chunker->chunks, chunker, currentContig,
-                                                       contigStartPos, contigEndPos, chunkSize, chunkBoundary);
-            chunker->chunkCount += savedChunkCount;
-            free(currentContig);
-            currentContig = stString_copy(contig);
-            contigStartPos = readStartPos;
-            contigEndPos = readEndPos;
+            contigStartPos[tidInPrimary] = alnStartPos < contigStartPos[tidInPrimary] ? alnStartPos :
+                                           contigStartPos[tidInPrimary];
+            contigEndPos[tidInPrimary] = alnEndPos > contigEndPos[tidInPrimary] ? alnEndPos :
+                                         contigEndPos[tidInPrimary];
         }
     }
-    // save last contig's chunks
-    if (currentContig != NULL) {
-        if (filterByRegion) {
-            contigStartPos = (contigStartPos < regionStart ? regionStart : contigStartPos);
-            contigEndPos = (contigEndPos > regionEnd ? regionEnd : contigEndPos);
+
+    // shut everything down, the file stays cached
+    hts_itr_destroy(iter);
+    bam_destroy1(aln);
+}
+
+static BamChunker *bamChunker_constructEmpty(stList *bamFiles, PolishParams *params) {
+    if (stList_length(bamFiles) == 0) {
+        st_errAbort("ERROR: No bam files given to chunk\n");
+    }
+    BamChunker *chunker = malloc(sizeof(BamChunker));
+    chunker->bamFile = stString_copy(stList_get(bamFiles, 0));
+    chunker->extraBamFiles = stList_construct3(0, free);
+    for (int64_t i = 1; i < stList_length(bamFiles); i++) {
+        stList_append(chunker->extraBamFiles, stString_copy(stList_get(bamFiles, i)));
+    }
+    chunker->chunkSize = params->chunkSize;
+    chunker->chunkBoundary = params->chunkBoundary;
+    chunker->includeSoftClip = params->includeSoftClipping;
+    chunker->params = params;
+    chunker->chunks = stList_construct3(0,(void*)bamChunk_destruct);
+    chunker->chunkCount = 0;
+    return chunker;
+}
+
+static bam_hdr_t *readBamHeader(char *bamFile) {
+    samFile *in = openAlignmentFile(bamFile);
+    bam_hdr_t *bamHdr = sam_hdr_read(in);
+    sam_close(in);
+    return bamHdr;
+}
+
+static int64_t saveRegionChunks(BamChunker *chunker, stList *bamFiles, bam_hdr_t *primaryHdr, int regionTid,
+                                int64_t regionStart, int64_t regionEnd, char *regionName) {
+    /*
+     * Chunks the extent of the reads of all the bams on the region's contig (all contigs if regionTid is -1), cropped
+     * to the region, returning the number of chunks made.
+     */
+    int64_t *contigStartPos = st_malloc(primaryHdr->n_targets * sizeof(int64_t));
+    int64_t *contigEndPos = st_malloc(primaryHdr->n_targets * sizeof(int64_t));
+    for (int64_t tid = 0; tid < primaryHdr->n_targets; tid++) {
+        contigStartPos[tid] = -1;
+        contigEndPos[tid] = -1;
+    }
+    for (int64_t i = 0; i < stList_length(bamFiles); i++) {
+        getAlignedExtents(stList_get(bamFiles, i), i, primaryHdr, regionTid, regionStart, regionEnd,
+                          contigStartPos, contigEndPos);
+    }
+
+    // save the contigs' chunks, in the order of the (sorted) bam
+    int64_t chunkCount = 0;
+    for (int64_t tid = 0; tid < primaryHdr->n_targets; tid++) {
+        if (contigStartPos[tid] == -1) continue;
+        if (regionTid != -1) {
+            contigStartPos[tid] = (contigStartPos[tid] < regionStart ? regionStart : contigStartPos[tid]);
+            contigEndPos[tid] = (contigEndPos[tid] > regionEnd ? regionEnd : contigEndPos[tid]);
+        }
+        int64_t savedChunkCount = saveContigChunks(chunker->chunks, chunker, primaryHdr->target_name[tid],
+                                                   contigStartPos[tid], contigEndPos[tid], chunker->chunkSize,
+                                                   chunker->chunkBoundary);
+        for (int64_t i = chunker->chunkCount; regionName != NULL && i < chunker->chunkCount + savedChunkCount; i++) {
+            bamChunker_getChunk(chunker, i)->regionName = stString_copy(regionName);
         }
-        int64_t savedChunkCount = saveContigChunks(chunker->chunks, chunker, currentContig,
-                                                   contigStartPos, contigEndPos, chunkSize, chunkBoundary);
         chunker->chunkCount += savedChunkCount;
-        free(currentContig);
+        chunkCount += savedChunkCount;
+    }
+    free(contigStartPos);
+    free(contigEndPos);
+    return chunkCount;
+}
+
+/*
+ * These handle construction of the BamChunk object, by iterating through the bam (must be sorted), and finds the
+ * first and last aligned location on each contig.  Then it generates a list of chunks based off of these positions,
+ * with sizes determined by the parameters.  Given several bams, the extents are those of all their reads, as if
+ * the bams were merged.
+ */
+BamChunker *bamChunker_construct(char *bamFile, PolishParams *params) {
+    return bamChunker_construct2(bamFile, NULL, params);
+}
+BamChunker *bamChunker_construct2(char *bamFile, char *region, PolishParams *params) {
+    stList *bamFiles = stList_construct();
+    stList_append(bamFiles, bamFile);
+    BamChunker *chunker = bamChunker_construct3(bamFiles, region, params);
+    stList_destruct(bamFiles);
+    return chunker;
+}
+static char *parseRegion(char *region, char *regionContig, int *regionStart, int *regionEnd) {
+    // Returns NULL, or a message which the caller frees if the region is malformed. regionContig holds 128 chars.
+    int scanRet = sscanf(region, "%127[^:]:%d-%d", regionContig, regionStart, regionEnd);
+    if (scanRet != 3 || strlen(regionContig) == 0) {
+        return stString_print("Region in unexpected format (expected %%s:%%d-%%d): %s", region);
+    } else if (*regionStart < 0 || *regionEnd <= 0 || *regionEnd <= *regionStart) {
+        return stString_print("Start and end locations in region must be positive, start must be less than end: %s",
+                              region);
+    }
+    return NULL;
+}
+
+BamChunker *bamChunker_construct3(stList *bamFiles, char *region, PolishParams *params) {
+
+    // are we doing region filtering?
+    char regionContig[128] = "";
+    int regionStart = 0;
+    int regionEnd = 0;
+    char *regionError = region == NULL ? NULL : parseRegion(region, regionContig, &regionStart, &regionEnd);
+    if (regionError != NULL) {
+        st_errAbort("%s", regionError);
+    }
+
+    // the chunker we're building
+    BamChunker *chunker = bamChunker_constructEmpty(bamFiles, params);
+    bam_hdr_t *primaryHdr = readBamHeader(chunker->bamFile);
+    int regionTid = -1;
+    if (region != NULL && (regionTid = bam_name2id(primaryHdr, regionContig)) < 0) {
+        // no reads can be in the region
+        bam_hdr_destroy(primaryHdr);
+        return chunker;
     }
+    saveRegionChunks(chunker, bamFiles, primaryHdr, regionTid, regionStart, regionEnd, NULL);
 
     // sanity check
     assert(stList_length(chunker->chunks) == chunker->chunkCount);
 
-    // shut everything down
-    bam_hdr_destroy(bamHdr);
-    bam_destroy1(aln);
-    sam_close(in);
+    bam_hdr_destroy(primaryHdr);
+    return chunker;
+}
 
+char *bamChunker_checkInputs(stList *bamFiles, char *region) {
+    char regionContig[128] = "";
+    int regionStart = 0;
+    int regionEnd = 0;
+    char *error = NULL;
+    if (stList_length(bamFiles) == 0) {
+        return stString_print("No bam files given");
+    }
+    if (region != NULL && (error = parseRegion(region, regionContig, &regionStart, &regionEnd)) != NULL) {
+        return error;
+    }
+
+    // each file opens with an index and a header, and is kept open for the chunker and the chunks
+    bam_hdr_t *primaryHdr = NULL;
+    for (int64_t i = 0; i < stList_length(bamFiles); i++) {
+        char *bamFile = stList_get(bamFiles, i);
+        CachedAlignmentFile *file = getCachedAlignmentFile2(bamFile, i, &error);
+        if (file == NULL) {
+            return error;
+        }
+        if (i == 0) {
+            primaryHdr = file->bamHdr;
+            if (region != NULL && bam_name2id(primaryHdr, regionContig) < 0) {
+                return stString_print("Contig %s of region %s is not in bam file %s", regionContig, region, bamFile);
+            }
+            continue;
+        }
+        // the contigs with reads must be in the first bam, as the chunker requires
+        for (int tid = 0; tid < file->bamHdr->n_targets; tid++) {
+            uint64_t mapped = 0, unmapped = 0;
+            if (hts_idx_get_stat(file->idx, tid, &mapped, &unmapped) == 0 && mapped > 0 &&
+                bam_name2id(primaryHdr, file->bamHdr->target_name[tid]) < 0) {
+                return stString_print("Contig %s of bam file %s is not in the first bam file",
+                                      file->bamHdr->target_name[tid], bamFile);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Constructs a chunker over the intervals of a BED file (zero based, end exclusive), in the order they are listed.
+ * Each interval is chunked as a region given to bamChunker_construct2 would be: from the first to the last aligned
+ * position of the reads overlapping it, cropped to the interval. The chunks of an interval have its "contig:start-end"
+ * as their regionName, so each interval is polished into its own sequence. Reads are found with the BAM index, so
+ * only the reads of the intervals are scanned.
+ */
+BamChunker *bamChunker_constructFromBed(char *bamFile, char *bedFile, PolishParams *params) {
+    stList *bamFiles = stList_construct();
+    stList_append(bamFiles, bamFile);
+    BamChunker *chunker = bamChunker_constructFromBed2(bamFiles, bedFile, params);
+    stList_destruct(bamFiles);
+    return chunker;
+}
+BamChunker *bamChunker_constructFromBed2(stList *bamFiles, char *bedFile, PolishParams *params) {
+
+    // the chunker we're building
+    BamChunker *chunker = bamChunker_constructEmpty(bamFiles, params);
+    bam_hdr_t *primaryHdr = readBamHeader(chunker->bamFile);
+
+    FILE *fh = fopen(bedFile, "r");
+    if (fh == NULL) {
+        st_errAbort("ERROR: Cannot open bed file %s\n", bedFile);
+    }
+    char *line;
+    int64_t lineNo = 0;
+    while ((line = stFile_getLineFromFile(fh)) != NULL) {
+        lineNo++;
+        stList *tokens = stString_split(line);
+        if (stList_length(tokens) == 0 || ((char *) stList_get(tokens, 0))[0] == '#' ||
+            stString_eq(stList_get(tokens, 0), "track") || stString_eq(stList_get(tokens, 0), "browser")) {
+            stList_destruct(tokens);
+            free(line);
+            continue;
+        }
+        char *contig = stList_get(tokens, 0);
+        int64_t regionStart, regionEnd;
+        if (stList_length(tokens) < 3 || sscanf(stList_get(tokens, 1), "%" SCNd64, &regionStart) != 1 ||
+            sscanf(stList_get(tokens, 2), "%" SCNd64, &regionEnd) != 1 || regionStart < 0 || regionEnd <= regionStart) {
+            st_errAbort("Malformed interval on line %" PRId64 " of %s: %s\n", lineNo, bedFile, line);
+        }
+        int tid = bam_name2id(primaryHdr, contig);
+        if (tid < 0) {
+            st_logInfo("  Skipping interval on a contig not in %s: %s\n", chunker->bamFile, line);
+        } else {
+            char *regionName = stString_print("%s:%" PRId64 "-%" PRId64, contig, regionStart, regionEnd);
+            if (saveRegionChunks(chunker, bamFiles, primaryHdr, tid, regionStart, regionEnd, regionName) == 0) {
+                st_logInfo("  No reads aligned to interval: %s\n", line);
+            }
+            free(regionName);
+        }
+        stList_destruct(tokens);
+        free(line);
+    }
+    fclose(fh);
+
+    bam_hdr_destroy(primaryHdr);
     return chunker;
 }
 
 BamChunker *bamChunker_copyConstruct(BamChunker *toCopy) {
     BamChunker *chunker = malloc(sizeof(BamChunker));
     chunker->bamFile = stString_copy(toCopy->bamFile);
+    chunker->extraBamFiles = stList_construct3(0, free);
+    for (int64_t i = 0; i < stList_length(toCopy->extraBamFiles); i++) {
+        stList_append(chunker->extraBamFiles, stString_copy(stList_get(toCopy->extraBamFiles, i)));
+    }
     chunker->chunkSize = toCopy->chunkSize;
     chunker->chunkBoundary = toCopy->chunkBoundary;
     chunker->includeSoftClip = toCopy->includeSoftClip;
@@ -281,6 +611,7 @@ BamChunker *bamChunker_copyConstruct(BamChunker *toCopy) {
 
 void bamChunker_destruct(BamChunker *bamChunker) {
     free(bamChunker->bamFile);
+    stList_destruct(bamChunker->extraBamFiles);
     stList_destruct(bamChunker->chunks);
     free(bamChunker);
 }
@@ -303,6 +634,7 @@ BamChunk *bamChunk_construct2(char *refSeqName, int64_t chunkBoundaryStart, int6
     c->chunkEnd = chunkEnd;
     c->chunkBoundaryEnd = chunkBoundaryEnd;
     c->parent = parent;
+    c->regionName = NULL;
     return c;
 }
 
@@ -314,11 +646,13 @@ BamChunk *bamChunk_copyConstruct(BamChunk *toCopy) {
     c->chunkEnd = toCopy->chunkEnd;
     c->chunkBoundaryEnd = toCopy->chunkBoundaryEnd;
     c->parent = toCopy->parent;
+    c->regionName = toCopy->regionName == NULL ? NULL : stString_copy(toCopy->regionName);
     return c;
 }
 
 void bamChunk_destruct(BamChunk *bamChunk) {
     free(bamChunk->refSeqName);
+    if (bamChunk->regionName != NULL) free(bamChunk->regionName);
     free(bamChunk);
 }
 
@@ -332,13 +666,105 @@ typedef struct samview_settings {
 
 #define DEFAULT_ALIGNMENT_SCORE 10
 
+/*
+ * An iterator over the reads of one bam in a chunk's region, holding the next read of the bam.
+ */
+typedef struct _bamReadIterator {
+    char *bamFile;
+    samFile *in;       // these three are cached, see getCachedAlignmentFile
+    hts_idx_t *idx;
+    bam_hdr_t *bamHdr;
+    hts_itr_multi_t *iter;
+    void *bed;
+    bam1_t *aln;
+    bool hasNext;
+} BamReadIterator;
+
+static void bamReadIterator_advance(BamReadIterator *it) {
+    int result = sam_itr_multi_next(it->in, it->iter, it->aln);
+    // the status from "get reads from iterator"
+    if (result < -1) {
+        st_errAbort("ERROR: Retrieval of region %d failed due to truncated file or corrupt BAM index file %s\n",
+                    it->iter->curr_tid, it->bamFile);
+    }
+    it->hasNext = result >= 0;
+}
+
+static void bamReadIterator_init(BamReadIterator *it, char *bamFile, int64_t bamIdx, char *region) {
+    // prep for index (not entirely sure what all this does.  see samtools/sam_view.c
+    int filter_state = ALL, filter_op = 0;
+    char* regions[1] = { region };
+    it->bamFile = bamFile;
+    it->bed = bed_hash_regions(NULL, regions, 0, 1, &filter_op); //insert(1) or filter out(0) the regions from the command line in the same hash table as the bed file
+    if (!filter_op) filter_state = FILTERED;
+    int regcount = 0;
+    hts_reglist_t *reglist = bed_reglist(it->bed, filter_state, &regcount);
+    if(!reglist) {
+        st_errAbort("ERROR: Could not create list of regions for read conversion");
+    }
+
+    // bam file, index and header
+    CachedAlignmentFile *file = getCachedAlignmentFile(bamFile, bamIdx);
+    it->in = file->in;
+    it->idx = file->idx;
+    it->bamHdr = file->bamHdr;
+    // read object
+    it->aln = bam_init1();
+    // iterator for region
+    if ((it->iter = sam_itr_regions(it->idx, it->bamHdr, reglist, regcount)) == 0) {
+        st_errAbort("ERROR: Cannot open iterator for region %s for bam file %s\n", region, bamFile);
+    }
+    bamReadIterator_advance(it);
+}
+
+static void bamReadIterator_destroy(BamReadIterator *it) {
+    hts_itr_multi_destroy(it->iter);
+    bed_destroy(it->bed);
+    bam_destroy1(it->aln);
+}
+
+static bool bamReadIterator_isBefore(BamReadIterator *it1, BamReadIterator *it2) {
+    // As samtools merge orders coordinate sorted reads: by position, then forward strand first, then by read name
+    bam1_core_t *core1 = &it1->aln->core, *core2 = &it2->aln->core;
+    if (core1->pos != core2->pos) {
+        return core1->pos < core2->pos;
+    }
+    if (bam_is_rev(it1->aln) != bam_is_rev(it2->aln)) {
+        return !bam_is_rev(it1->aln);
+    }
+    return strcmp(bam_get_qname(it1->aln), bam_get_qname(it2->aln)) < 0;
+}
+
+static BamReadIterator *bamReadIterators_next(BamReadIterator *its, int64_t itCount, BamReadIterator *previous) {
+    /*
+     * Moves past the previously returned read and returns the iterator holding the next read over all the bams, or
+     * NULL when all are finished. Reads are returned in the order samtools merge would put them in (see
+     * bamReadIterator_isBefore), and reads that tie on all of that in the order the bams were given.
+     */
+    if (previous != NULL) {
+        bamReadIterator_advance(previous);
+    }
+    BamReadIterator *next = NULL;
+    for (int64_t i = 0; i < itCount; i++) {
+        if (its[i].hasNext && (next == NULL || bamReadIterator_isBefore(&its[i], next))) {
+            next = &its[i];
+        }
+    }
+    return next;
+}
+
 /*
  * This generates a set of BamChunkReads (and alignments to the reference) from a BamChunk.  The BamChunk describes
  * positional information within the bam, from which the reads should be extracted.  The bam must be indexed.  Reads
  * which overlap the ends of the chunk are truncated.  A parameter in the BamChunk's parameters determines whether
- * softclipped portions of the reads should be included.
+ * softclipped portions of the reads should be included.  If the chunker has several bams their reads are merged by
+ * position, strand and name, so the reads are the same, and in the same order, as from the merged bam.
  */
 uint32_t convertToReadsAndAlignments(BamChunk *bamChunk, stList *reads, stList *alignments) {
+    return convertToReadsAndAlignments2(bamChunk, reads, alignments, NULL);
+}
+
+uint32_t convertToReadsAndAlignments2(BamChunk *bamChunk, stList *reads, stList *alignments, TupleArena *arena) {
 
     // sanity check
     assert(stList_length(reads) == 0);
@@ -348,47 +774,23 @@ uint32_t convertToReadsAndAlignments(BamChunk *bamChunk, stList *reads, stList *
     int64_t chunkStart = bamChunk->chunkBoundaryStart;
     int64_t chunkEnd = bamChunk->chunkBoundaryEnd;
     bool includeSoftClip = bamChunk->parent->params->includeSoftClipping;
-    char *bamFile = bamChunk->parent->bamFile;
     char *contig = bamChunk->refSeqName;
     uint32_t savedAlignments = 0;
-
-    // prep for index (not entirely sure what all this does.  see samtools/sam_view.c
-    int filter_state = ALL, filter_op = 0;
-    int result;
-    samview_settings_t settings = { .bed = NULL };
-    char* region[1] = {};
-    region[0] = stString_print("%s:%d-%d", bamChunk->refSeqName, bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
-    settings.bed = bed_hash_regions(settings.bed, region, 0, 1, &filter_op); //insert(1) or filter out(0) the regions from the command line in the same hash table as the bed file
-    if (!filter_op) filter_state = FILTERED;
-    int regcount = 0;
-    hts_reglist_t *reglist = bed_reglist(settings.bed, filter_state, &regcount);
-    if(!reglist) {
-        st_errAbort("ERROR: Could not create list of regions for read conversion");
-    }
-
-    // file initialization
-    samFile *in = NULL;
-    hts_idx_t *idx = NULL;
-    hts_itr_multi_t *iter = NULL;
-    // bam file
-    if ((in = hts_open(bamFile, "r")) == 0) {
-        st_errAbort("ERROR: Cannot open bam file %s\n", bamFile);
-    }
-    // bam index
-    if ((idx = sam_index_load(in, bamFile)) == 0) {
-        st_errAbort("ERROR: Cannot open index for bam file %s\n", bamFile);
-    }
-    // header  //todo samFile *in = hts_open(bamFile, "r");
-    bam_hdr_t *bamHdr = sam_hdr_read(in);
-    // read object
-    bam1_t *aln = bam_init1();
-    // iterator for region
-    if ((iter = sam_itr_regions(idx, bamHdr, reglist, regcount)) == 0) {
-        st_errAbort("ERROR: Cannot open iterator for region %s for bam file %s\n", region[0], bamFile);
+    char *region = stString_print("%s:%d-%d", bamChunk->refSeqName, bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
+
+    // file initialization, an iterator per bam
+    int64_t bamFileCount = 1 + stList_length(bamChunk->parent->extraBamFiles);
+    BamReadIterator *bamReadIterators = st_calloc(bamFileCount, sizeof(BamReadIterator));
+    bamReadIterator_init(&bamReadIterators[0], bamChunk->parent->bamFile, 0, region);
+    for (int64_t i = 1; i < bamFileCount; i++) {
+        bamReadIterator_init(&bamReadIterators[i], stList_get(bamChunk->parent->extraBamFiles, i - 1), i, region);
     }
 
-    // fetch alignments //todo while(sam_read1(in,bamHdr,aln) > 0) {
-    while ((result = sam_itr_multi_next(in, iter, aln)) >= 0) {
+    // fetch alignments
+    BamReadIterator *current = NULL;
+    while ((current = bamReadIterators_next(bamReadIterators, bamFileCount, current)) != NULL) {
+        bam1_t *aln = current->aln;
+        bam_hdr_t *bamHdr = current->bamHdr;
         // basic filtering (no read length, no cigar)
         if (aln->core.l_qseq <= 0) continue;
         if (aln->core.n_cigar == 0) continue;
@@ -410,7 +812,8 @@ uint32_t convertToReadsAndAlignments(BamChunk *bamChunk, stList *reads, stList *
 
         // get cigar and rep
         uint32_t *cigar = bam_get_cigar(aln);
-        stList *cigRepr = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
+        stList *cigRepr = arena == NULL ? stList_construct3(0, (void (*)(void *))stIntTuple_destruct) :
+                          stList_construct();
 
         // Variables to keep track of position in sequence / cigar operations
         int64_t cig_idx = 0;
@@ -477,9 +880,11 @@ uint32_t convertToReadsAndAlignments(BamChunk *bamChunk, stList *reads, stList *
             // handle current character
             if (cigarOp == BAM_CMATCH || cigarOp == BAM_CEQUAL || cigarOp == BAM_CDIFF) {
                 if (cigarIdxInRef >= chunkStart && cigarIdxInRef < chunkEnd) {
-                    stList_append(cigRepr, stIntTuple_construct3(cigarIdxInRef + refCigarModification,
-                                                                 cigarIdxInSeq + seqCigarModification,
-                                                                 DEFAULT_ALIGNMENT_SCORE));
+                    int64_t refPos = cigarIdxInRef + refCigarModification;
+                    int64_t seqPos = cigarIdxInSeq + seqCigarModification;
+                    stList_append(cigRepr, arena == NULL ?
+                                           stIntTuple_construct3(refPos, seqPos, DEFAULT_ALIGNMENT_SCORE) :
+                                           tupleArena_getTuple3(arena, refPos, seqPos, DEFAULT_ALIGNMENT_SCORE));
                     alignedReadLength++;
                 }
                 cigarIdxInSeq++;
@@ -603,53 +1008,161 @@ uint32_t convertToReadsAndAlignments(BamChunk *bamChunk, stList *reads, stList *
         // save to read
         bool forwardStrand = !bam_is_rev(aln);
         BamChunkRead *chunkRead = bamChunkRead_construct2(readName, seq, qual, forwardStrand, bamChunk);
+        if (bamChunk->parent->params->packReadNucleotides) {
+            bamChunkRead_pack(chunkRead);
+        }
         stList_append(reads, chunkRead);
         stList_append(alignments, cigRepr);
         savedAlignments++;
     }
-    // the status from "get reads from iterator"
-    if (result < -1) {
-        st_errAbort("ERROR: Retrieval of region %d failed due to truncated file or corrupt BAM index file\n", iter->curr_tid);
-    }
-
     // close it all down
-    hts_itr_multi_destroy(iter);
-    hts_idx_destroy(idx);
-    free(region[0]);
-    bed_destroy(settings.bed);
-    bam_hdr_destroy(bamHdr);
-    bam_destroy1(aln);
-    sam_close(in);
+    for (int64_t i = 0; i < bamFileCount; i++) {
+        bamReadIterator_destroy(&bamReadIterators[i]);
+    }
+    free(bamReadIterators);
+    free(region);
 
     return savedAlignments;
 }
 
 
-bool poorMansDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *reads, stList *alignments,
-        stList *filteredReads, stList *filteredAlignments, stList *discardedReads, stList *discardedAlignments) {
+/*
+ * Downsampling draws from a generator seeded from the downsample seed and the chunk's coordinates, not from the
+ * global generator, so the reads kept in a chunk do not depend on the order chunks are run in or the thread count.
+ */
+static uint64_t downsampleRandom(uint64_t *state) {
+    // splitmix64
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double downsampleRandomUnit(uint64_t *state) {
+    // uniform in [0, 1), from the top 53 bits
+    return (downsampleRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
 
+static uint64_t getDownsampleState(BamChunk *bamChunk, int64_t seed) {
+    // FNV-1a over the seed and the chunk's contig and boundaries
+    uint64_t hash = 14695981039346656037ULL;
+    int64_t values[3] = { seed, bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd };
+    unsigned char *bytes = (unsigned char *) values;
+    for (size_t i = 0; i < sizeof(values); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    for (char *c = bamChunk->refSeqName; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int64_t getUniformDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *reads, uint64_t *state,
+                                    bool *keep) {
     // calculate depth
     int64_t totalNucleotides = 0;
     for (int64_t i = 0; i < stList_length(reads); i++) {
         BamChunkRead *bcr = stList_get(reads,i);
-        totalNucleotides += strlen(bcr->nucleotides);
+        totalNucleotides += bcr->readLength;
     }
     double averageDepth = 1.0 * totalNucleotides / (bamChunk->chunkBoundaryEnd - bamChunk->chunkBoundaryStart);
 
     // do we need to downsample?
     if (averageDepth < intendedDepth) {
-        return FALSE;
+        return 0;
     }
 
     // we do need to downsample
     char *logIdentifier = getLogIdentifier();
-    st_logInfo(" %s Downsampling chunk with average depth %.2fx to %dx \n", logIdentifier, averageDepth, intendedDepth);
+    st_logInfo(" %s Downsampling chunk with average depth %.2fx to %"PRId64"x \n", logIdentifier, averageDepth,
+               intendedDepth);
     free(logIdentifier);
 
     // keep some ratio of reads
     double ratioToKeep = intendedDepth / averageDepth;
+    int64_t discarded = 0;
+    for (int64_t i = 0; i < stList_length(reads); i++) {
+        keep[i] = downsampleRandomUnit(state) < ratioToKeep;
+        discarded += keep[i] ? 0 : 1;
+    }
+    return discarded;
+}
+
+static int64_t getLocalDepthDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *alignments,
+                                       uint64_t *state, bool *keep) {
+    /*
+     * Takes the reads in a random order, keeping a read if any reference position it spans is covered by fewer than
+     * intendedDepth of the reads kept before it. Coverage spikes are evened out, and no position falls below
+     * intendedDepth that was at or above it.
+     */
+    int64_t readNo = stList_length(alignments);
+    int64_t chunkLength = bamChunk->chunkBoundaryEnd - bamChunk->chunkBoundaryStart;
+    int64_t *depths = st_calloc(chunkLength > 0 ? chunkLength : 1, sizeof(int64_t));
+    int64_t *order = st_malloc((readNo > 0 ? readNo : 1) * sizeof(int64_t));
+    for (int64_t i = 0; i < readNo; i++) {
+        order[i] = i;
+    }
+    for (int64_t i = readNo - 1; i > 0; i--) {
+        int64_t j = (int64_t) (downsampleRandom(state) % (uint64_t) (i + 1));
+        int64_t k = order[i];
+        order[i] = order[j];
+        order[j] = k;
+    }
+
+    int64_t discarded = 0;
+    for (int64_t i = 0; i < readNo; i++) {
+        // the span of the read, from the aligned pairs' chunk relative reference positions
+        stList *alignment = stList_get(alignments, order[i]);
+        int64_t start = stIntTuple_get(stList_get(alignment, 0), 0);
+        int64_t end = stIntTuple_get(stList_peek(alignment), 0) + 1;
+        start = start < 0 ? 0 : start;
+        end = end > chunkLength ? chunkLength : end;
+
+        keep[order[i]] = FALSE;
+        for (int64_t j = start; j < end; j++) {
+            if (depths[j] < intendedDepth) {
+                keep[order[i]] = TRUE;
+                break;
+            }
+        }
+        if (keep[order[i]]) {
+            for (int64_t j = start; j < end; j++) {
+                depths[j]++;
+            }
+        } else {
+            discarded++;
+        }
+    }
+
+    if (discarded > 0) {
+        char *logIdentifier = getLogIdentifier();
+        st_logInfo(" %s Downsampling chunk to a local depth of %"PRId64"x\n", logIdentifier, intendedDepth);
+        free(logIdentifier);
+    }
+
+    free(depths);
+    free(order);
+    return discarded;
+}
+
+bool poorMansDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *reads, stList *alignments,
+        stList *filteredReads, stList *filteredAlignments, stList *discardedReads, stList *discardedAlignments) {
+
+    // decide which reads to keep
+    PolishParams *params = bamChunk->parent->params;
+    uint64_t state = getDownsampleState(bamChunk, params->downsampleSeed);
+    bool *keep = st_calloc(stList_length(reads) > 0 ? stList_length(reads) : 1, sizeof(bool));
+    int64_t discarded = params->downsampleByLocalDepth ?
+                        getLocalDepthDownsample(intendedDepth, bamChunk, alignments, &state, keep) :
+                        getUniformDownsample(intendedDepth, bamChunk, reads, &state, keep);
+    if (discarded == 0) {
+        free(keep);
+        return FALSE;
+    }
+
+    // split the reads, keeping their order
     for (int64_t i = 0; i < stList_length(reads); i++) {
-        if (st_random() < ratioToKeep) {
+        if (keep[i]) {
             stList_append(filteredReads, stList_get(reads, i));
             stList_append(filteredAlignments, stList_get(alignments, i));
         } else {
@@ -657,6 +1170,7 @@ bool poorMansDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *reads
             stList_append(discardedAlignments, stList_get(alignments, i));
         }
     }
+    free(keep);
 
     return TRUE;
 }
@@ -668,22 +1182,26 @@ bool poorMansDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *reads
  */
 
 
-void appendProbsToList(stList *probabilityList, uint8_t pA, uint8_t pC, uint8_t pG, uint8_t pT, uint8_t pGap) {
-    uint8_t *aPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *cPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *gPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *tPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *gapPtr = calloc(1, sizeof(uint8_t));
-    *aPtr = pA;
-    *cPtr = pC;
-    *gPtr = pG;
-    *tPtr = pT;
-    *gapPtr = pGap;
-    stList_append(probabilityList, aPtr);
-    stList_append(probabilityList, cPtr);
-    stList_append(probabilityList, gPtr);
-    stList_append(probabilityList, tPtr);
-    stList_append(probabilityList, gapPtr);
+/*
+ * Probabilities of a read are kept in one buffer of SINGLE_NUCL_PROB_FIELDS values (A, C, G, T, gap) per position,
+ * doubled in size as the read grows, instead of one allocation per value.
+ */
+#define SINGLE_NUCL_PROB_FIELDS 5
+#define SINGLE_NUCL_PROB_INITIAL_POSITIONS 4096
+
+static void appendProbs(uint8_t **probs, int64_t *capacity, int64_t *length,
+                        uint8_t pA, uint8_t pC, uint8_t pG, uint8_t pT, uint8_t pGap) {
+    if (*length == *capacity) {
+        *capacity = *capacity == 0 ? SINGLE_NUCL_PROB_INITIAL_POSITIONS : 2 * *capacity;
+        *probs = st_realloc(*probs, *capacity * SINGLE_NUCL_PROB_FIELDS * sizeof(uint8_t));
+    }
+    uint8_t *p = &(*probs)[*length * SINGLE_NUCL_PROB_FIELDS];
+    p[0] = pA;
+    p[1] = pC;
+    p[2] = pG;
+    p[3] = pT;
+    p[4] = pGap;
+    (*length)++;
 }
 
 stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLocation, char *readName,
@@ -709,11 +1227,6 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
     uint8_t pG;
     uint8_t pT;
     uint8_t pGap;
-    uint8_t *aPtr;
-    uint8_t *cPtr;
-    uint8_t *gPtr;
-    uint8_t *tPtr;
-    uint8_t *gapPtr;
 
     // parse header
     while(!feof(fp)) {
@@ -731,7 +1244,9 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
     }
 
     // get probabilities
-    stList* probabilityList = stList_construct3(0, free);
+    uint8_t *probs = NULL;
+    int64_t probsCapacity = 0;
+    int64_t probsLength = 0;
     uint64_t firstReadPos = 0;
     uint64_t lastReadPos = 0;
     int64_t randomSeed = st_randomInt64(0,3);
@@ -740,15 +1255,15 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
         int ret = fscanf( fp, "%[^\t]\t%[^\t]\t%[^\t]\t%[^\t]\t%[^\t]\t%[^\t]\t%[^\n]\n",
                 chromStr, refPosStr, pAStr, pCStr, pGStr, pTStr, pGapStr);
         if (ret != 7) st_errAbort("Failed to parse line ~%"PRId64" in %s",
-                (int64_t ) stList_length(probabilityList) / 5, signalAlignReadLocation);
+                probsLength, signalAlignReadLocation);
 
         // Get reference position
         refPos = atoi(refPosStr);
 
         // Check for gaps todo this might actually be a bug or something in signalAlign
         while (firstReadPos != 0 && refPos > lastReadPos + 1) {
-            appendProbsToList(probabilityList, ALPHABET_MIN_PROB, ALPHABET_MIN_PROB, ALPHABET_MIN_PROB,
-                              ALPHABET_MIN_PROB, ALPHABET_MAX_PROB);
+            appendProbs(&probs, &probsCapacity, &probsLength, ALPHABET_MIN_PROB, ALPHABET_MIN_PROB,
+                        ALPHABET_MIN_PROB, ALPHABET_MIN_PROB, ALPHABET_MAX_PROB);
             lastReadPos++;
         }
 
@@ -794,8 +1309,8 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
             }
         }
 
-        // Save the values in a list todo this is not particularly efficient
-        appendProbsToList(probabilityList, pA, pC, pG, pT, pGap);
+        // Save the values
+        appendProbs(&probs, &probsCapacity, &probsLength, pA, pC, pG, pT, pGap);
     }
     // Now we're done with the file
     fclose(fp);
@@ -804,37 +1319,27 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
     uint64_t readLength = lastReadPos - firstReadPos + 1;
     stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile(chromStr, readName, firstReadPos + 1, readLength);
 
-    // Copy probabilities over
-    uint64_t position = 0;
-    stListIterator *itor = stList_getIterator(probabilityList);
-    while (position < readLength) {
-
-        // Get the locations of the probabilities
-        aPtr = stList_getNext(itor);
-        cPtr = stList_getNext(itor);
-        gPtr = stList_getNext(itor);
-        tPtr = stList_getNext(itor);
-        gapPtr = stList_getNext(itor);
-
-        // Assign the probabilities
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'A')] =  *aPtr;
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'C')] =  *cPtr;
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'G')] =  *gPtr;
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'T')] =  *tPtr;
-
-        if (params->gapCharactersForDeletions) {
-            // This assumes gap character is the last character in the alphabet given
-            pSeq->profileProbs[position * ALPHABET_SIZE + (ALPHABET_SIZE - 1)] = *gapPtr;
-        } else {
-            pSeq->profileProbs[position * ALPHABET_SIZE + (ALPHABET_SIZE - 1)] = ALPHABET_MIN_PROB;
-        }
-
-        position++;
+    // We should have exactly one set of probabilities per position
+    if (probsLength != readLength) {
+        st_errAbort("Probability list has %" PRId64 " positions, with read length %" PRId64 " for file %s",
+                    probsLength, (int64_t) readLength, signalAlignReadLocation);
     }
-    // We should have nothing left over in the list
-    if (stList_getNext(itor) != NULL) {
-        st_errAbort("Probability list has %d extra elements, with read length %d for file %s",
-                    stList_length(probabilityList) - 5 * position, readLength, signalAlignReadLocation);
+
+    // Copy probabilities over
+    int64_t aIndex = stBaseMapper_getValueForChar(baseMapper, 'A');
+    int64_t cIndex = stBaseMapper_getValueForChar(baseMapper, 'C');
+    int64_t gIndex = stBaseMapper_getValueForChar(baseMapper, 'G');
+    int64_t tIndex = stBaseMapper_getValueForChar(baseMapper, 'T');
+    for (uint64_t position = 0; position < readLength; position++) {
+        uint8_t *p = &probs[position * SINGLE_NUCL_PROB_FIELDS];
+        uint8_t *profileProbs = &pSeq->profileProbs[position * ALPHABET_SIZE];
+        profileProbs[aIndex] = p[0];
+        profileProbs[cIndex] = p[1];
+        profileProbs[gIndex] = p[2];
+        profileProbs[tIndex] = p[3];
+
+        // This assumes gap character is the last character in the alphabet given
+        profileProbs[ALPHABET_SIZE - 1] = params->gapCharactersForDeletions ? p[4] : ALPHABET_MIN_PROB;
     }
     // Sanity check on the number of modifications to the probabilities
     // We only modify probability of bases with some probability, so to fix a rounding error, we should at worst have
@@ -844,8 +1349,7 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
                     (1.0 * randomSeed / readLength), readName);
     }
 
-    stList_destructIterator(itor);
-    stList_destruct(probabilityList);
+    free(probs);
     free(line);
     free(chromStr);
     free(refPosStr);
@@ -877,11 +1381,7 @@ int64_t parseReadsWithSingleNucleotideProbs(stList *profileSequences, char *bamF
                    singleNuclProbDirectory);
     }
 
-    samFile *in = hts_open(bamFile, "r");
-    if (in == NULL) {
-        st_errAbort("ERROR: Cannot open bam file %s\n", bamFile);
-        return -1;
-    }
+    samFile *in = openAlignmentFile(bamFile);
     bam_hdr_t *bamHdr = sam_hdr_read(in);
     bam1_t *aln = bam_init1();
 
@@ -1065,11 +1565,8 @@ void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartit
     char *haplotypedSamFile = stString_print("%s.sam", bamOutBase);
 
     // File management
-    samFile *in = hts_open(bamInFile, "r");
-    if (in == NULL) {
-        st_errAbort("ERROR: Cannot open bam file %s\n", bamInFile);
-    }
-    bam_hdr_t *bamHdr = bam_hdr_read(in->fp.bgzf);
+    samFile *in = openAlignmentFile(bamInFile);
+    bam_hdr_t *bamHdr = sam_hdr_read(in);
     bam1_t *aln = bam_init1();
 
     int r;
@@ -1132,10 +1629,7 @@ void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionT
     char *unmatchedSamOutFile = stString_print("%s.0.sam", bamOutBase);
 
     // File management
-    samFile *in = hts_open(bamInFile, "r");
-    if (in == NULL) {
-        st_errAbort("ERROR: Cannot open bam file %s\n", bamInFile);
-    }
+    samFile *in = openAlignmentFile(bamInFile);
     bam_hdr_t *bamHdr = sam_hdr_read(in);
     bam1_t *aln = bam_init1();
 
@@ -5,6 +5,8 @@
  */
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include "margin.h"
 
 /*
@@ -368,6 +370,9 @@ PolishParams *polishParams_jsonParse(char *buf, size_t r) {
     params->columnAnchorTrim = 5;
     params->maxConsensusStrings = 100;
     params->repeatSubMatrix = NULL;
+    params->packReadNucleotides = FALSE;
+    params->downsampleSeed = 0;
+    params->downsampleByLocalDepth = FALSE;
 
 	// Parse tokens, starting at token 1
     // (token 0 is entire object)
@@ -500,6 +505,12 @@ PolishParams *polishParams_jsonParse(char *buf, size_t r) {
 				st_errAbort("ERROR: minAvgBaseQuality parameter must zero or greater\n");
 			}
 			params->minAvgBaseQuality = stJson_parseFloat(js, tokens, tokenIndex);
+		} else if (strcmp(keyString, "packReadNucleotides") == 0) {
+			params->packReadNucleotides = stJson_parseBool(js, tokens, ++tokenIndex);
+		} else if (strcmp(keyString, "downsampleSeed") == 0) {
+			params->downsampleSeed = stJson_parseInt(js, tokens, ++tokenIndex);
+		} else if (strcmp(keyString, "downsampleByLocalDepth") == 0) {
+			params->downsampleByLocalDepth = stJson_parseBool(js, tokens, ++tokenIndex);
 		}
         else {
             st_errAbort("ERROR: Unrecognised key in polish params json: %s\n", keyString);
@@ -608,10 +619,7 @@ Params *params_jsonParse(char *buf, size_t r, bool requirePolish, bool requirePh
 	return params;
 }
 
-Params *params_readParams(char *paramsFile) {
-    return params_readParams2(paramsFile, TRUE, TRUE);
-}
-Params *params_readParams2(char *paramsFile, bool requirePolish, bool requirePhase) {
+static char *params_readFile(char *paramsFile, size_t *length) {
     // open file and check for existence
     FILE *fh = fopen(paramsFile, "rb");
     if (fh == NULL) {
@@ -622,16 +630,34 @@ Params *params_readParams2(char *paramsFile, bool requirePolish, bool requirePha
     struct stat st;
     fstat(fileno(fh), &st);
 
-    // read file and parse json
+    // read file
     char *buf = st_calloc(st.st_size + 1, sizeof(char));
-    size_t readLen = fread(buf, sizeof(char), st.st_size , fh);
+    *length = fread(buf, sizeof(char), st.st_size , fh);
     buf[st.st_size] = '\0';
-    Params *params = params_jsonParse(buf, readLen, requirePolish, requirePhase);
 
     // close
-    free(buf);
     fclose(fh);
 
+    return buf;
+}
+
+Params *params_readParams(char *paramsFile) {
+    return params_readParams2(paramsFile, TRUE, TRUE);
+}
+Params *params_readParams2(char *paramsFile, bool requirePolish, bool requirePhase) {
+    // precompiled parameters are loaded directly
+    if (params_isBinary(paramsFile)) {
+        return params_readBinary(paramsFile, requirePolish, requirePhase);
+    }
+
+    // read file and parse json
+    size_t readLen;
+    char *buf = params_readFile(paramsFile, &readLen);
+    Params *params = params_jsonParse(buf, readLen, requirePolish, requirePhase);
+
+    // cleanup
+    free(buf);
+
     return params;
 }
 
@@ -648,3 +674,423 @@ void params_printParameters(Params *params, FILE *fh) {
 	fprintf(fh, "Phase parameters:\n");
 	stRPHmmParameters_printParameters(params->phaseParams, fh);
 }
+
+/*
+ * Binary params files.
+ *
+ * A binary params file holds the fully parsed parameters, so loading it skips tokenising the json and, in particular,
+ * parsing the repeat count matrices. Values are stored in native byte order, and the header records the format version
+ * and the compile time constants the layout depends on, so a file is only loaded by a build that can read it. The hmm
+ * and pairwise alignment parameters are owned by cPecan, so are stored as their (small) json objects.
+ */
+
+#define BINARY_PARAMS_MAGIC "MARGINPB"
+#define BINARY_PARAMS_MAGIC_LENGTH 8
+#define BINARY_PARAMS_VERSION 3
+#define BINARY_PARAMS_BYTE_ORDER_MARK 0x0102030405060708
+
+static void binaryParams_write(FILE *fh, void *src, size_t size) {
+    if (size > 0 && fwrite(src, size, 1, fh) != 1) {
+        st_errAbort("ERROR: Failed writing binary params file\n");
+    }
+}
+
+static void binaryParams_writeInt(FILE *fh, int64_t i) {
+    binaryParams_write(fh, &i, sizeof(int64_t));
+}
+
+static void binaryParams_writeDouble(FILE *fh, double d) {
+    binaryParams_write(fh, &d, sizeof(double));
+}
+
+static void binaryParams_writeBool(FILE *fh, bool b) {
+    uint8_t i = b ? 1 : 0;
+    binaryParams_write(fh, &i, sizeof(uint8_t));
+}
+
+static void binaryParams_writeString(FILE *fh, char *string) {
+    int64_t length = strlen(string);
+    binaryParams_writeInt(fh, length);
+    binaryParams_write(fh, string, length);
+}
+
+typedef struct _binaryParamsReader {
+    char *fileName;
+    char *data;
+    int64_t length;
+    int64_t offset;
+} BinaryParamsReader;
+
+static void binaryParams_read(BinaryParamsReader *reader, void *dest, size_t size) {
+    if (reader->offset + (int64_t) size > reader->length) {
+        st_errAbort("ERROR: Binary params file %s is truncated\n", reader->fileName);
+    }
+    memcpy(dest, reader->data + reader->offset, size);
+    reader->offset += size;
+}
+
+static int64_t binaryParams_readInt(BinaryParamsReader *reader) {
+    int64_t i;
+    binaryParams_read(reader, &i, sizeof(int64_t));
+    return i;
+}
+
+static double binaryParams_readDouble(BinaryParamsReader *reader) {
+    double d;
+    binaryParams_read(reader, &d, sizeof(double));
+    return d;
+}
+
+static bool binaryParams_readBool(BinaryParamsReader *reader) {
+    uint8_t i;
+    binaryParams_read(reader, &i, sizeof(uint8_t));
+    return i != 0;
+}
+
+static char *binaryParams_readString(BinaryParamsReader *reader) {
+    int64_t length = binaryParams_readInt(reader);
+    if (length < 0) {
+        st_errAbort("ERROR: Binary params file %s is corrupt\n", reader->fileName);
+    }
+    char *string = st_calloc(length + 1, sizeof(char));
+    binaryParams_read(reader, string, length);
+    return string;
+}
+
+static char *params_getJsonValue(char *buf, size_t r, char *key) {
+    /*
+     * Returns a copy of the json value of the given top level key, or NULL if the key is not present.
+     */
+    jsmntok_t *tokens;
+    char *js;
+    int64_t tokenNumber = stJson_setupParser(buf, r, &tokens, &js);
+
+    char *value = NULL;
+    for (int64_t tokenIndex=1; tokenIndex < tokenNumber; tokenIndex++) {
+        jsmntok_t keyTok = tokens[tokenIndex];
+        char *keyString = stJson_token_tostr(js, &keyTok);
+        if (strcmp(keyString, key) == 0) {
+            jsmntok_t tok = tokens[tokenIndex + 1];
+            value = stString_copy(stJson_token_tostr(js, &tok));
+            break;
+        }
+        tokenIndex += stJson_getNestedTokenCount(tokens, tokenIndex+1);
+    }
+
+    // Cleanup
+    free(js);
+    free(tokens);
+
+    return value;
+}
+
+static void polishParams_writeBinary(PolishParams *params, char *hmmJson, char *pairwiseAlignmentParametersJson,
+                                     FILE *fh) {
+    binaryParams_writeBool(fh, params->useRunLengthEncoding);
+    binaryParams_writeDouble(fh, params->referenceBasePenalty);
+    binaryParams_writeInt(fh, params->minPosteriorProbForAlignmentAnchorsLength);
+    binaryParams_write(fh, params->minPosteriorProbForAlignmentAnchors,
+                       params->minPosteriorProbForAlignmentAnchorsLength * sizeof(double));
+    binaryParams_writeString(fh, hmmJson);
+    binaryParams_writeString(fh, pairwiseAlignmentParametersJson);
+    binaryParams_writeBool(fh, params->repeatSubMatrix != NULL);
+    if (params->repeatSubMatrix != NULL) {
+        binaryParams_writeInt(fh, params->repeatSubMatrix->maximumRepeatLength);
+        binaryParams_writeInt(fh, params->repeatSubMatrix->maxEntry);
+        binaryParams_write(fh, params->repeatSubMatrix->logProbabilities,
+                           params->repeatSubMatrix->maxEntry * sizeof(double));
+    }
+    binaryParams_writeBool(fh, params->includeSoftClipping);
+    binaryParams_writeInt(fh, params->chunkSize);
+    binaryParams_writeInt(fh, params->chunkBoundary);
+    binaryParams_writeInt(fh, params->maxDepth);
+    binaryParams_writeDouble(fh, params->candidateVariantWeight);
+    binaryParams_writeInt(fh, params->columnAnchorTrim);
+    binaryParams_writeInt(fh, params->maxConsensusStrings);
+    binaryParams_writeInt(fh, params->maxPoaConsensusIterations);
+    binaryParams_writeInt(fh, params->minPoaConsensusIterations);
+    binaryParams_writeInt(fh, params->maxRealignmentPolishIterations);
+    binaryParams_writeInt(fh, params->minRealignmentPolishIterations);
+    binaryParams_writeInt(fh, params->minReadsToCallConsensus);
+    binaryParams_writeInt(fh, params->filterReadsWhileHaveAtLeastThisCoverage);
+    binaryParams_writeDouble(fh, params->minAvgBaseQuality);
+    binaryParams_writeBool(fh, params->packReadNucleotides);
+    binaryParams_writeInt(fh, params->downsampleSeed);
+    binaryParams_writeBool(fh, params->downsampleByLocalDepth);
+}
+
+static PolishParams *polishParams_readBinary(BinaryParamsReader *reader) {
+    PolishParams *params = st_calloc(1, sizeof(PolishParams));
+
+    params->useRunLengthEncoding = binaryParams_readBool(reader);
+    params->referenceBasePenalty = binaryParams_readDouble(reader);
+    params->minPosteriorProbForAlignmentAnchorsLength = binaryParams_readInt(reader);
+    params->minPosteriorProbForAlignmentAnchors = st_calloc(params->minPosteriorProbForAlignmentAnchorsLength,
+                                                            sizeof(double));
+    binaryParams_read(reader, params->minPosteriorProbForAlignmentAnchors,
+                      params->minPosteriorProbForAlignmentAnchorsLength * sizeof(double));
+
+    char *hmmJson = binaryParams_readString(reader);
+    params->hmm = hmm_jsonParse(hmmJson, strlen(hmmJson));
+    params->sM = hmm_getStateMachine(params->hmm);
+    free(hmmJson);
+    char *pairwiseAlignmentParametersJson = binaryParams_readString(reader);
+    params->p = pairwiseAlignmentParameters_jsonParse(pairwiseAlignmentParametersJson,
+                                                      strlen(pairwiseAlignmentParametersJson));
+    free(pairwiseAlignmentParametersJson);
+
+    if (binaryParams_readBool(reader)) {
+        params->repeatSubMatrix = repeatSubMatrix_constructEmpty();
+        if (binaryParams_readInt(reader) != params->repeatSubMatrix->maximumRepeatLength ||
+            binaryParams_readInt(reader) != params->repeatSubMatrix->maxEntry) {
+            st_errAbort("ERROR: Repeat count matrix in binary params file %s does not match this build\n",
+                        reader->fileName);
+        }
+        binaryParams_read(reader, params->repeatSubMatrix->logProbabilities,
+                          params->repeatSubMatrix->maxEntry * sizeof(double));
+    } else {
+        st_logCritical("ERROR: Did not find repeat counts specified in binary polish params! Will default to MODE estimation\n");
+    }
+
+    params->includeSoftClipping = binaryParams_readBool(reader);
+    params->chunkSize = (uint64_t) binaryParams_readInt(reader);
+    params->chunkBoundary = (uint64_t) binaryParams_readInt(reader);
+    params->maxDepth = (uint64_t) binaryParams_readInt(reader);
+    params->candidateVariantWeight = binaryParams_readDouble(reader);
+    params->columnAnchorTrim = (uint64_t) binaryParams_readInt(reader);
+    params->maxConsensusStrings = (uint64_t) binaryParams_readInt(reader);
+    params->maxPoaConsensusIterations = (uint64_t) binaryParams_readInt(reader);
+    params->minPoaConsensusIterations = (uint64_t) binaryParams_readInt(reader);
+    params->maxRealignmentPolishIterations = (uint64_t) binaryParams_readInt(reader);
+    params->minRealignmentPolishIterations = (uint64_t) binaryParams_readInt(reader);
+    params->minReadsToCallConsensus = (uint64_t) binaryParams_readInt(reader);
+    params->filterReadsWhileHaveAtLeastThisCoverage = (uint64_t) binaryParams_readInt(reader);
+    params->minAvgBaseQuality = binaryParams_readDouble(reader);
+    params->packReadNucleotides = binaryParams_readBool(reader);
+    params->downsampleSeed = binaryParams_readInt(reader);
+    params->downsampleByLocalDepth = binaryParams_readBool(reader);
+
+    return params;
+}
+
+static void phaseParams_writeBinary(stRPHmmParameters *params, stBaseMapper *baseMapper, FILE *fh) {
+    // base mapper
+    binaryParams_write(fh, baseMapper->charToNum, 256 * sizeof(uint8_t));
+    binaryParams_write(fh, baseMapper->numToChar, ALPHABET_SIZE * sizeof(char));
+    binaryParams_writeString(fh, baseMapper->wildcard);
+    binaryParams_writeInt(fh, baseMapper->size);
+
+    // hmm parameters
+    binaryParams_write(fh, params->hetSubModel, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(uint16_t));
+    binaryParams_write(fh, params->readErrorSubModel, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(uint16_t));
+    binaryParams_write(fh, params->hetSubModelSlow, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(double));
+    binaryParams_write(fh, params->readErrorSubModelSlow, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(double));
+    binaryParams_writeBool(fh, params->maxNotSumTransitions);
+    binaryParams_writeInt(fh, params->minPartitionsInAColumn);
+    binaryParams_writeInt(fh, params->maxPartitionsInAColumn);
+    binaryParams_writeDouble(fh, params->minPosteriorProbabilityForPartition);
+    binaryParams_writeInt(fh, params->maxCoverageDepth);
+    binaryParams_writeInt(fh, params->minReadCoverageToSupportPhasingBetweenHeterozygousSites);
+    binaryParams_writeInt(fh, params->trainingIterations);
+    binaryParams_writeDouble(fh, params->offDiagonalReadErrorPseudoCount);
+    binaryParams_writeDouble(fh, params->onDiagonalReadErrorPseudoCount);
+    binaryParams_writeBool(fh, params->estimateReadErrorProbsEmpirically);
+    binaryParams_writeBool(fh, params->filterBadReads);
+    binaryParams_writeDouble(fh, params->filterMatchThreshold);
+    binaryParams_writeBool(fh, params->useReferencePrior);
+    binaryParams_writeBool(fh, params->verboseTruePositives);
+    binaryParams_writeBool(fh, params->verboseFalsePositives);
+    binaryParams_writeBool(fh, params->verboseFalseNegatives);
+    binaryParams_writeBool(fh, params->includeInvertedPartitions);
+    binaryParams_writeBool(fh, params->filterLikelyHomozygousSites);
+    binaryParams_writeDouble(fh, params->minSecondMostFrequentBaseFilter);
+    binaryParams_writeDouble(fh, params->minSecondMostFrequentBaseLogProbFilter);
+    binaryParams_writeBool(fh, params->gapCharactersForDeletions);
+    binaryParams_writeInt(fh, params->filterAReadWithAnyOneOfTheseSamFlagsSet);
+    binaryParams_writeInt(fh, params->mapqFilter);
+    binaryParams_writeInt(fh, params->roundsOfIterativeRefinement);
+    binaryParams_writeBool(fh, params->writeGVCF);
+    binaryParams_writeBool(fh, params->writeSplitSams);
+    binaryParams_writeBool(fh, params->writeUnifiedSam);
+}
+
+static stRPHmmParameters *phaseParams_readBinary(BinaryParamsReader *reader, stBaseMapper *baseMapper) {
+    // base mapper
+    binaryParams_read(reader, baseMapper->charToNum, 256 * sizeof(uint8_t));
+    binaryParams_read(reader, baseMapper->numToChar, ALPHABET_SIZE * sizeof(char));
+    free(baseMapper->wildcard);
+    baseMapper->wildcard = binaryParams_readString(reader);
+    baseMapper->size = (uint8_t) binaryParams_readInt(reader);
+
+    // hmm parameters
+    stRPHmmParameters *params = stRPHmmParameters_construct();
+    binaryParams_read(reader, params->hetSubModel, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(uint16_t));
+    binaryParams_read(reader, params->readErrorSubModel, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(uint16_t));
+    binaryParams_read(reader, params->hetSubModelSlow, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(double));
+    binaryParams_read(reader, params->readErrorSubModelSlow, ALPHABET_SIZE * ALPHABET_SIZE * sizeof(double));
+    params->maxNotSumTransitions = binaryParams_readBool(reader);
+    params->minPartitionsInAColumn = binaryParams_readInt(reader);
+    params->maxPartitionsInAColumn = binaryParams_readInt(reader);
+    params->minPosteriorProbabilityForPartition = binaryParams_readDouble(reader);
+    params->maxCoverageDepth = binaryParams_readInt(reader);
+    params->minReadCoverageToSupportPhasingBetweenHeterozygousSites = binaryParams_readInt(reader);
+    params->trainingIterations = binaryParams_readInt(reader);
+    params->offDiagonalReadErrorPseudoCount = binaryParams_readDouble(reader);
+    params->onDiagonalReadErrorPseudoCount = binaryParams_readDouble(reader);
+    params->estimateReadErrorProbsEmpirically = binaryParams_readBool(reader);
+    params->filterBadReads = binaryParams_readBool(reader);
+    params->filterMatchThreshold = binaryParams_readDouble(reader);
+    params->useReferencePrior = binaryParams_readBool(reader);
+    params->verboseTruePositives = binaryParams_readBool(reader);
+    params->verboseFalsePositives = binaryParams_readBool(reader);
+    params->verboseFalseNegatives = binaryParams_readBool(reader);
+    params->includeInvertedPartitions = binaryParams_readBool(reader);
+    params->filterLikelyHomozygousSites = binaryParams_readBool(reader);
+    params->minSecondMostFrequentBaseFilter = binaryParams_readDouble(reader);
+    params->minSecondMostFrequentBaseLogProbFilter = binaryParams_readDouble(reader);
+    params->gapCharactersForDeletions = binaryParams_readBool(reader);
+    params->filterAReadWithAnyOneOfTheseSamFlagsSet = (uint16_t) binaryParams_readInt(reader);
+    params->mapqFilter = binaryParams_readInt(reader);
+    params->roundsOfIterativeRefinement = binaryParams_readInt(reader);
+    params->writeGVCF = binaryParams_readBool(reader);
+    params->writeSplitSams = binaryParams_readBool(reader);
+    params->writeUnifiedSam = binaryParams_readBool(reader);
+
+    return params;
+}
+
+bool params_isBinary(char *paramsFile) {
+    FILE *fh = fopen(paramsFile, "rb");
+    if (fh == NULL) {
+        return FALSE;
+    }
+    char magic[BINARY_PARAMS_MAGIC_LENGTH];
+    bool isBinary = fread(magic, sizeof(char), BINARY_PARAMS_MAGIC_LENGTH, fh) == BINARY_PARAMS_MAGIC_LENGTH &&
+                    memcmp(magic, BINARY_PARAMS_MAGIC, BINARY_PARAMS_MAGIC_LENGTH) == 0;
+    fclose(fh);
+    return isBinary;
+}
+
+void params_compileBinary(char *jsonParamsFile, char *binaryParamsFile) {
+    size_t readLen;
+    char *buf = params_readFile(jsonParamsFile, &readLen);
+
+    // find the polish and phase objects, files without these top level entries hold only one of them
+    char *polishJson = params_getJsonValue(buf, readLen, "polish");
+    char *phaseJson = params_getJsonValue(buf, readLen, "phase");
+    if (polishJson == NULL && phaseJson == NULL) {
+        char *hmmJson = params_getJsonValue(buf, readLen, "hmm");
+        if (hmmJson != NULL) {
+            polishJson = stString_copy(buf);
+            free(hmmJson);
+        } else {
+            phaseJson = stString_copy(buf);
+        }
+    }
+
+    FILE *fh = fopen(binaryParamsFile, "wb");
+    if (fh == NULL) {
+        st_errAbort("ERROR: Cannot open binary parameters file %s for writing\n", binaryParamsFile);
+    }
+
+    // header
+    binaryParams_write(fh, BINARY_PARAMS_MAGIC, BINARY_PARAMS_MAGIC_LENGTH);
+    binaryParams_writeInt(fh, BINARY_PARAMS_VERSION);
+    binaryParams_writeInt(fh, BINARY_PARAMS_BYTE_ORDER_MARK);
+    binaryParams_writeInt(fh, ALPHABET_SIZE);
+    binaryParams_writeInt(fh, MAXIMUM_REPEAT_LENGTH);
+
+    // polish parameters
+    binaryParams_writeBool(fh, polishJson != NULL);
+    if (polishJson != NULL) {
+        PolishParams *polishParams = polishParams_jsonParse(polishJson, strlen(polishJson));
+        char *hmmJson = params_getJsonValue(polishJson, strlen(polishJson), "hmm");
+        char *pairwiseAlignmentParametersJson = params_getJsonValue(polishJson, strlen(polishJson),
+                                                                    "pairwiseAlignmentParameters");
+        polishParams_writeBinary(polishParams, hmmJson, pairwiseAlignmentParametersJson, fh);
+        polishParams_destruct(polishParams);
+        free(hmmJson);
+        free(pairwiseAlignmentParametersJson);
+    }
+
+    // phase parameters
+    binaryParams_writeBool(fh, phaseJson != NULL);
+    if (phaseJson != NULL) {
+        stBaseMapper *baseMapper = stBaseMapper_construct();
+        stRPHmmParameters *phaseParams = phaseParams_fromJson(phaseJson, strlen(phaseJson), baseMapper);
+        phaseParams_writeBinary(phaseParams, baseMapper, fh);
+        stRPHmmParameters_destruct(phaseParams);
+        stBaseMapper_destruct(baseMapper);
+    }
+
+    // Cleanup
+    fclose(fh);
+    free(buf);
+    if (polishJson != NULL) free(polishJson);
+    if (phaseJson != NULL) free(phaseJson);
+}
+
+Params *params_readBinary(char *paramsFile, bool requirePolish, bool requirePhase) {
+    // map the file
+    int fd = open(paramsFile, O_RDONLY);
+    if (fd < 0) {
+        st_errAbort("ERROR: Cannot open parameters file %s\n", paramsFile);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        st_errAbort("ERROR: Cannot map parameters file %s\n", paramsFile);
+    }
+    BinaryParamsReader reader = { paramsFile, data, st.st_size, BINARY_PARAMS_MAGIC_LENGTH };
+
+    // check the file was compiled for this build
+    if (binaryParams_readInt(&reader) != BINARY_PARAMS_VERSION) {
+        st_errAbort("ERROR: Binary params file %s has an unsupported version, recompile it from json\n", paramsFile);
+    }
+    if (binaryParams_readInt(&reader) != BINARY_PARAMS_BYTE_ORDER_MARK ||
+        binaryParams_readInt(&reader) != ALPHABET_SIZE ||
+        binaryParams_readInt(&reader) != MAXIMUM_REPEAT_LENGTH) {
+        st_errAbort("ERROR: Binary params file %s was compiled for a different build, recompile it from json\n",
+                    paramsFile);
+    }
+
+    // Make empty params object
+    Params *params = st_calloc(1, sizeof(Params));
+
+    // sections are always read, so the reader moves past those that are not required
+    bool gotPolish = binaryParams_readBool(&reader);
+    if (gotPolish) {
+        PolishParams *polishParams = polishParams_readBinary(&reader);
+        if (requirePolish) {
+            params->polishParams = polishParams;
+        } else {
+            polishParams_destruct(polishParams);
+        }
+    }
+    bool gotPhase = binaryParams_readBool(&reader);
+    if (gotPhase) {
+        stBaseMapper *baseMapper = stBaseMapper_construct();
+        stRPHmmParameters *phaseParams = phaseParams_readBinary(&reader, baseMapper);
+        if (requirePhase) {
+            params->baseMapper = baseMapper;
+            params->phaseParams = phaseParams;
+        } else {
+            stRPHmmParameters_destruct(phaseParams);
+            stBaseMapper_destruct(baseMapper);
+        }
+    }
+
+    if(!gotPolish && requirePolish) {
+        st_errAbort("ERROR: Did not find polish parameters in binary params\n");
+    }
+    if(!gotPhase && requirePhase) {
+        st_errAbort("ERROR: Did not find phase parameters in binary params\n");
+    }
+
+    // Cleanup
+    munmap(data, st.st_size);
+    close(fd);
+
+    return params;
+}
@@ -5,6 +5,7 @@
  */
 
 #include "margin.h"
+#include "alignmentCache.h"
 #include <omp.h>
 #include <htsIntegration.h>
 
@@ -536,11 +537,22 @@ void poa_augment(Poa *poa, char *read, bool readStrand, int64_t readNo, stList *
 }
 
 stList *poa_getAnchorAlignments(Poa *poa, int64_t *poaToConsensusMap, int64_t noOfReads, PolishParams *pp) {
+	return poa_getAnchorAlignments2(poa, poaToConsensusMap, noOfReads, pp, NULL);
+}
+
+static stIntTuple *getTuple3(TupleArena *arena, int64_t value1, int64_t value2, int64_t value3) {
+	return arena == NULL ? stIntTuple_construct3(value1, value2, value3) :
+			tupleArena_getTuple3(arena, value1, value2, value3);
+}
+
+stList *poa_getAnchorAlignments2(Poa *poa, int64_t *poaToConsensusMap, int64_t noOfReads, PolishParams *pp,
+								 TupleArena *arena) {
 
 	// Allocate anchor alignments
 	stList *anchorAlignments = stList_construct3(0, (void (*)(void *))stList_destruct);
 	for(int64_t i=0; i<noOfReads; i++) {
-		stList_append(anchorAlignments, stList_construct3(0, (void (*)(void *))stIntTuple_destruct));
+		stList_append(anchorAlignments, arena == NULL ? stList_construct3(0, (void (*)(void *))stIntTuple_destruct) :
+				stList_construct());
 	}
 
 	// Walk through the weights of the POA to construct the anchor alignments
@@ -570,13 +582,13 @@ stList *poa_getAnchorAlignments(Poa *poa, int64_t *poaToConsensusMap, int64_t no
 					// The following is masking an underlying bug that allows for multiple high confidence
 					// alignments per position
 					if(stList_length(anchorPairs) == 0) {
-						stList_append(anchorPairs, stIntTuple_construct3(consensusIndex, obs->offset, expansion));
+						stList_append(anchorPairs, getTuple3(arena, consensusIndex, obs->offset, expansion));
 					}
 					else {
 						stIntTuple *pPair = stList_peek(anchorPairs);
 
 						if(stIntTuple_get(pPair, 0) < consensusIndex && stIntTuple_get(pPair, 1) < obs->offset) {
-							stList_append(anchorPairs, stIntTuple_construct3(consensusIndex, obs->offset, expansion));
+							stList_append(anchorPairs, getTuple3(arena, consensusIndex, obs->offset, expansion));
 						}
 						//else {
 						//	fprintf(stderr, "Ooops read: %i x1: %i y1: %i x2: %i y2: %i %f\n", (int)obs->readNo,
@@ -607,6 +619,14 @@ static void adjustAnchors(stList *anchorPairs, int64_t index, int64_t adjustment
 void getAlignedPairsWithIndelsCroppingReference(char *reference, int64_t refLength,
 		char *read, stList *anchorPairs,
 		stList **matches, stList **inserts, stList **deletes, PolishParams *polishParams) {
+	getAlignedPairsWithIndelsCroppingReference2(reference, refLength, read, anchorPairs, matches, inserts, deletes,
+												polishParams, NULL, NULL);
+}
+
+void getAlignedPairsWithIndelsCroppingReference2(char *reference, int64_t refLength,
+		char *read, stList *anchorPairs,
+		stList **matches, stList **inserts, stList **deletes, PolishParams *polishParams,
+		AlignmentCache *cache, char *readId) {
 	// Crop reference, to avoid long unaligned prefix and suffix
 	// that generates a lot of delete pairs
 
@@ -636,10 +656,20 @@ void getAlignedPairsWithIndelsCroppingReference(char *reference, int64_t refLeng
 	char c = reference[endRefPosition];
 	reference[endRefPosition] = '\0';
 
-	// Get alignment
-	getAlignedPairsWithIndelsUsingAnchors(polishParams->sM, &(reference[firstRefPosition]), read,
-										  anchorPairs, polishParams->p, matches, deletes, inserts, 0, 0);
-	//TODO are the delete and insert lists inverted here?
+	// Get alignment, from the cache if the read was aligned to the same window with the same anchors before
+	uint64_t cacheKey = 0;
+	bool useCache = cache != NULL && readId != NULL;
+	if(useCache) {
+		cacheKey = alignmentCache_getKey(&(reference[firstRefPosition]), read, anchorPairs);
+	}
+	if(!useCache || !alignmentCache_get(cache, readId, cacheKey, matches, inserts, deletes)) {
+		getAlignedPairsWithIndelsUsingAnchors(polishParams->sM, &(reference[firstRefPosition]), read,
+											  anchorPairs, polishParams->p, matches, deletes, inserts, 0, 0);
+		//TODO are the delete and insert lists inverted here?
+		if(useCache) {
+			alignmentCache_put(cache, readId, cacheKey, *matches, *inserts, *deletes);
+		}
+	}
 
 	// De-crop reference
 	reference[endRefPosition] = c;
@@ -653,7 +683,28 @@ void getAlignedPairsWithIndelsCroppingReference(char *reference, int64_t refLeng
 	adjustAnchors(*deletes, 1, firstRefPosition);
 }
 
+static Poa *poa_realign3(stList *bamChunkReads, stList *anchorAlignments, char *reference,
+						 PolishParams *polishParams, stList *readMatches, stList *readInserts, stList *readDeletes,
+						 AlignmentCache *cache);
+
 Poa *poa_realign(stList *bamChunkReads, stList *anchorAlignments, char *reference, PolishParams *polishParams) {
+	return poa_realign3(bamChunkReads, anchorAlignments, reference, polishParams, NULL, NULL, NULL, NULL);
+}
+
+Poa *poa_realign2(stList *bamChunkReads, stList *anchorAlignments, char *reference, PolishParams *polishParams,
+				  stList *readMatches, stList *readDeletes) {
+	return poa_realign3(bamChunkReads, anchorAlignments, reference, polishParams, readMatches, NULL, readDeletes,
+						NULL);
+}
+
+Poa *poa_realignCached(stList *bamChunkReads, stList *anchorAlignments, char *reference, PolishParams *polishParams,
+					   AlignmentCache *cache) {
+	return poa_realign3(bamChunkReads, anchorAlignments, reference, polishParams, NULL, NULL, NULL, cache);
+}
+
+static Poa *poa_realign3(stList *bamChunkReads, stList *anchorAlignments, char *reference,
+						 PolishParams *polishParams, stList *readMatches, stList *readInserts, stList *readDeletes,
+						 AlignmentCache *cache) {
 	// Build a reference graph with zero weights
 	Poa *poa = poa_getReferenceGraph(reference);
 	int64_t refLength = stList_length(poa->nodes)-1;
@@ -661,31 +712,63 @@ Poa *poa_realign(stList *bamChunkReads, stList *anchorAlignments, char *referenc
 	// For each read
 	for(int64_t i=0; i<stList_length(bamChunkReads); i++) {
         BamChunkRead *chunkRead = stList_get(bamChunkReads, i);
+        char *nucleotides = bamChunkRead_getNucleotides(chunkRead);
 
 		// Generate set of posterior probabilities for matches, deletes and inserts with respect to reference.
 		stList *matches = NULL, *inserts = NULL, *deletes = NULL;
 
 		if(anchorAlignments == NULL) {
-			getAlignedPairsWithIndels(polishParams->sM, reference, chunkRead->nucleotides, polishParams->p,
+			getAlignedPairsWithIndels(polishParams->sM, reference, nucleotides, polishParams->p,
                                       &matches, &deletes, &inserts, 0, 0);
 		}
 		else {
-			getAlignedPairsWithIndelsCroppingReference(reference, refLength, chunkRead->nucleotides, stList_get(anchorAlignments, i),
-                                                       &matches, &inserts, &deletes, polishParams);
+			getAlignedPairsWithIndelsCroppingReference2(reference, refLength, nucleotides,
+														stList_get(anchorAlignments, i), &matches, &inserts, &deletes,
+														polishParams, cache, chunkRead->readName);
 		}
 
 		// Add weights, edges and nodes to the poa
-		poa_augment(poa, chunkRead->nucleotides, chunkRead->forwardStrand, i, matches, inserts, deletes);
+		poa_augment(poa, nucleotides, chunkRead->forwardStrand, i, matches, inserts, deletes);
+		bamChunkRead_releaseNucleotides(chunkRead, nucleotides);
 
-		// Cleanup
-		stList_destruct(matches);
-		stList_destruct(inserts);
-		stList_destruct(deletes);
+		// Cleanup, handing the posteriors to the caller if it wants them
+		if(readMatches != NULL) {
+			stList_append(readMatches, matches);
+		}
+		else {
+			stList_destruct(matches);
+		}
+		if(readInserts != NULL) {
+			stList_append(readInserts, inserts);
+		}
+		else {
+			stList_destruct(inserts);
+		}
+		if(readDeletes != NULL) {
+			stList_append(readDeletes, deletes);
+		}
+		else {
+			stList_destruct(deletes);
+		}
 	}
 
 	return poa;
 }
 
+Poa *poa_constructFromPosteriors(char *reference, stList *bamChunkReads, stList *readMatches, stList *readInserts,
+								 stList *readDeletes) {
+	// As poa_realign3, but with the posteriors already computed
+	Poa *poa = poa_getReferenceGraph(reference);
+	for(int64_t i=0; i<stList_length(bamChunkReads); i++) {
+		BamChunkRead *chunkRead = stList_get(bamChunkReads, i);
+		char *nucleotides = bamChunkRead_getNucleotides(chunkRead);
+		poa_augment(poa, nucleotides, chunkRead->forwardStrand, i, stList_get(readMatches, i),
+					stList_get(readInserts, i), stList_get(readDeletes, i));
+		bamChunkRead_releaseNucleotides(chunkRead, nucleotides);
+	}
+	return poa;
+}
+
 static int cmpInsertsBySequence(const void *a, const void *b) {
 	/*
 	 * Compares PoaInserts by weight in ascending order.
@@ -774,7 +857,7 @@ double *poaNode_getStrandSpecificBaseWeights(PoaNode *node, stList *bamChunkRead
 		PoaBaseObservation *baseObs = stList_get(node->observations, i);
 		*totalWeight += baseObs->weight;
 		BamChunkRead *read = stList_get(bamChunkReads, baseObs->readNo);
-		char base = read->nucleotides[baseObs->offset];
+		char base = bamChunkRead_getBase(read, baseObs->offset);
 		baseWeights[symbol_convertCharToSymbol(base) * 2 + (read->forwardStrand ? POS_STRAND_IDX : NEG_STRAND_IDX)] += baseObs->weight;
 		if(read->forwardStrand) {
 			*totalPositiveWeight += baseObs->weight;
@@ -1324,7 +1407,9 @@ Poa *poa_checkMajorIndelEditsGreedily(Poa *poa, stList *bamChunkReads, PolishPar
 
 stList *poa_getReadAlignmentsToConsensus(Poa *poa, stList *bamChunkReads, PolishParams *polishParams) {
 	// Generate anchor alignments
-	stList *anchorAlignments = poa_getAnchorAlignments(poa, NULL, stList_length(bamChunkReads), polishParams);
+	TupleArena *anchorArena = tupleArena_construct();
+	stList *anchorAlignments = poa_getAnchorAlignments2(poa, NULL, stList_length(bamChunkReads), polishParams,
+														anchorArena);
 
 	// Alignments
 	stList *alignments = stList_construct3(0, (void (*)(void *))stList_destruct);
@@ -1333,7 +1418,7 @@ stList *poa_getReadAlignmentsToConsensus(Poa *poa, stList *bamChunkReads, Polish
 	int64_t refLength = stList_length(poa->nodes)-1;
 	for(int64_t i=0; i<stList_length(bamChunkReads); i++) {
 		BamChunkRead* read = stList_get(bamChunkReads, i);
-		char *nucleotides  = read->nucleotides;
+		char *nucleotides  = bamChunkRead_getNucleotides(read);
 		stList *anchorAlignment = stList_get(anchorAlignments, i);
 
 		// Generate the posterior alignment probabilities
@@ -1354,12 +1439,14 @@ stList *poa_getReadAlignmentsToConsensus(Poa *poa, stList *bamChunkReads, Polish
 		stList_destruct(deletes);
 		stList_destruct(matches);
 		stList_destruct(alignment);
+		bamChunkRead_releaseNucleotides(read, nucleotides);
 
 		stList_append(alignments, leftShiftedAlignment);
 	}
 
 	// Cleanup
 	stList_destruct(anchorAlignments);
+	tupleArena_destruct(anchorArena);
 
 	return alignments;
 }
@@ -1368,14 +1455,23 @@ stList *poa_getReadAlignmentsToConsensus(Poa *poa, stList *bamChunkReads, Polish
  * Functions for run-length encoding/decoding with POAs
  */
 
-RleString *rleString_construct(char *str) {
+static char rleString_getBase(char *str, BamChunkRead *read, int64_t i) {
+	return str != NULL ? str[i] : bamChunkRead_getBase(read, i);
+}
+
+static RleString *rleString_construct2(char *str, BamChunkRead *read, int64_t length, bool runLengthEncode) {
+	/*
+	 * Constructs the RLE string of str, or, if str is NULL, of the nucleotides of read, which are read a base at a
+	 * time so that a packed read is not unpacked. If runLengthEncode is false every base is its own run.
+	 */
 	RleString *rleString = st_calloc(1, sizeof(RleString));
 
-	rleString->nonRleLength = strlen(str);
+	rleString->nonRleLength = length;
 
 	// Calc length of rle'd str
 	for(int64_t i=0; i<rleString->nonRleLength; i++) {
-		if(i+1 == rleString->nonRleLength || str[i] != str[i+1]) {
+		if(!runLengthEncode || i+1 == rleString->nonRleLength ||
+		   rleString_getBase(str, read, i) != rleString_getBase(str, read, i+1)) {
 			rleString->length++;
 		}
 	}
@@ -1390,8 +1486,9 @@ RleString *rleString_construct(char *str) {
 	int64_t j=0, k=1;
 	for(int64_t i=0; i<rleString->nonRleLength; i++) {
 		rleString->nonRleToRleCoordinateMap[i] = j;
-		if(i+1 == rleString->nonRleLength || str[i] != str[i+1]) {
-			rleString->rleString[j] = str[i];
+		char base = rleString_getBase(str, read, i);
+		if(!runLengthEncode || i+1 == rleString->nonRleLength || base != rleString_getBase(str, read, i+1)) {
+			rleString->rleString[j] = base;
 			rleString->repeatCounts[j] = k;
 			rleString->rleToNonRleCoordinateMap[j++] = i - k + 1;
 			k=1;
@@ -1405,23 +1502,25 @@ RleString *rleString_construct(char *str) {
 	return rleString;
 }
 
-RleString *rleString_constructPreComputed(char *rleChars, uint8_t *rleCounts) {
-	RleString *rleString = st_calloc(1, sizeof(RleString));
+RleString *rleString_construct(char *str) {
+	return rleString_construct2(str, NULL, strlen(str), 1);
+}
 
+RleString *rleString_constructFromRead(BamChunkRead *read, bool runLengthEncode) {
+	return rleString_construct2(NULL, read, read->readLength, runLengthEncode);
+}
+
+static void rleString_setPreComputedLengths(RleString *rleString, char *rleChars, uint8_t *rleCounts) {
 	rleString->length = strlen(rleChars);
 	rleString->nonRleLength = 0;
 	for (int64_t i = 0; i < rleString->length; i++) {
 		rleString->nonRleLength += rleCounts[i];
 	}
+}
 
-	// Allocate
-	rleString->rleString = stString_copy(rleChars);
-	rleString->repeatCounts = st_calloc(rleString->length, sizeof(int64_t));
-	rleString->rleToNonRleCoordinateMap = st_calloc(rleString->length, sizeof(int64_t));
-	rleString->nonRleToRleCoordinateMap = st_calloc(rleString->nonRleLength, sizeof(int64_t));
-
-	// Fill out
-    //TODO verify this logic
+static void rleString_fillPreComputed(RleString *rleString, char *rleChars, uint8_t *rleCounts) {
+	// Fills out the buffers of the rle string, which must be large enough for the lengths already set
+	memcpy(rleString->rleString, rleChars, rleString->length + 1);
 	int64_t n=0;
 	for(int64_t r=0; r<rleString->length; r++) {
 		// counts
@@ -1433,32 +1532,58 @@ RleString *rleString_constructPreComputed(char *rleChars, uint8_t *rleCounts) {
 			n++;
 		}
 	}
-	assert(n == rleString->nonRleLength);
+	if(n != rleString->nonRleLength) {
+		st_errAbort("Expanded length %" PRId64 " of precomputed rle string does not match its length %" PRId64 "\n",
+					n, rleString->nonRleLength);
+	}
+}
 
+RleString *rleString_constructPreComputed(char *rleChars, uint8_t *rleCounts) {
+	RleString *rleString = st_calloc(1, sizeof(RleString));
+	rleString_setPreComputedLengths(rleString, rleChars, rleCounts);
+
+	// Allocate
+	rleString->rleString = st_calloc(rleString->length+1, sizeof(char));
+	rleString->repeatCounts = st_calloc(rleString->length, sizeof(int64_t));
+	rleString->rleToNonRleCoordinateMap = st_calloc(rleString->length, sizeof(int64_t));
+	rleString->nonRleToRleCoordinateMap = st_calloc(rleString->nonRleLength, sizeof(int64_t));
+
+	rleString_fillPreComputed(rleString, rleChars, rleCounts);
 	return rleString;
 }
 
+void rleString_refillPreComputed(RleString *rleString, char *rleChars, uint8_t *rleCounts,
+								 int64_t *rleCapacity, int64_t *nonRleCapacity) {
+	rleString_setPreComputedLengths(rleString, rleChars, rleCounts);
+
+	// Grow the buffers, if they are too small
+	if(rleString->length + 1 > *rleCapacity) {
+		*rleCapacity = 2 * (rleString->length + 1);
+		free(rleString->rleString);
+		free(rleString->repeatCounts);
+		free(rleString->rleToNonRleCoordinateMap);
+		rleString->rleString = st_calloc(*rleCapacity, sizeof(char));
+		rleString->repeatCounts = st_calloc(*rleCapacity, sizeof(int64_t));
+		rleString->rleToNonRleCoordinateMap = st_calloc(*rleCapacity, sizeof(int64_t));
+	}
+	if(rleString->nonRleLength + 1 > *nonRleCapacity) {
+		*nonRleCapacity = 2 * (rleString->nonRleLength + 1);
+		free(rleString->nonRleToRleCoordinateMap);
+		rleString->nonRleToRleCoordinateMap = st_calloc(*nonRleCapacity, sizeof(int64_t));
+	}
+
+	rleString_fillPreComputed(rleString, rleChars, rleCounts);
+}
+
 RleString *rleString_constructNoRLE(char *str) {
-    RleString *rleString = st_calloc(1, sizeof(RleString));
-
-    rleString->nonRleLength = strlen(str);
-    rleString->length = rleString->nonRleLength;
-
-    // Allocate
-    rleString->rleString = st_calloc(rleString->nonRleLength+1, sizeof(char));
-    rleString->repeatCounts = st_calloc(rleString->nonRleLength, sizeof(int64_t));
-    rleString->rleToNonRleCoordinateMap = st_calloc(rleString->nonRleLength, sizeof(int64_t));
-    rleString->nonRleToRleCoordinateMap = st_calloc(rleString->nonRleLength, sizeof(int64_t));
-
-    // Fill out
-    for(int64_t i=0; i<rleString->nonRleLength; i++) {
-        rleString->nonRleToRleCoordinateMap[i] = i;
-        rleString->rleToNonRleCoordinateMap[i] = i;
-        rleString->rleString[i] = str[i];
-        rleString->repeatCounts[i] = 1;
-    }
+	return rleString_construct2(str, NULL, strlen(str), 0);
+}
 
-    return rleString;
+void rleString_discardCoordinateMaps(RleString *rleString) {
+	free(rleString->rleToNonRleCoordinateMap);
+	free(rleString->nonRleToRleCoordinateMap);
+	rleString->rleToNonRleCoordinateMap = NULL;
+	rleString->nonRleToRleCoordinateMap = NULL;
 }
 
 void rleString_destruct(RleString *rleString) {
@@ -1556,7 +1681,12 @@ stList *runLengthEncodeAlignment(stList *alignment,
 }
 stList *runLengthEncodeAlignment2(stList *alignment, RleString *seqX, RleString *seqY,
         int64_t xIdx, int64_t yIdx, int64_t weightIdx) {
-    stList *rleAlignment = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
+    return runLengthEncodeAlignment3(alignment, seqX, seqY, xIdx, yIdx, weightIdx, NULL);
+}
+stList *runLengthEncodeAlignment3(stList *alignment, RleString *seqX, RleString *seqY,
+        int64_t xIdx, int64_t yIdx, int64_t weightIdx, TupleArena *arena) {
+    stList *rleAlignment = arena == NULL ? stList_construct3(0, (void (*)(void *))stIntTuple_destruct) :
+                           stList_construct();
 
     int64_t x=-1, y=-1;
     for(int64_t i=0; i<stList_length(alignment); i++) {
@@ -1566,7 +1696,7 @@ stList *runLengthEncodeAlignment2(stList *alignment, RleString *seqX, RleString
         int64_t y2 = seqY->nonRleToRleCoordinateMap[stIntTuple_get(alignedPair, yIdx)];
 
         if(x2 > x && y2 > y) {
-            stIntTuple *it = stIntTuple_construct3(-1, -1, -1);
+            stIntTuple *it = getTuple3(arena, -1, -1, -1);
             it[xIdx + 1] = x2;
             it[yIdx + 1] = y2;
             it[weightIdx + 1] = stIntTuple_get(alignedPair, weightIdx);
@@ -1937,11 +2067,15 @@ ReadSubstring *getReadSubstring(BamChunkRead *bamChunkRead, int64_t start, int64
 	}
 
 	// Add read substring
-	char *read = &(bamChunkRead->nucleotides[start]);
-	char c = read[length];
-	read[length] = '\0';
-	rs->readSubstring = stString_copy(read);
-	read[length] = c;
+	if (bamChunkRead->packedNucleotides != NULL) {
+		rs->readSubstring = packedNucleotides_getSubstring(bamChunkRead->packedNucleotides, start, length);
+	} else {
+		char *read = &(bamChunkRead->nucleotides[start]);
+		char c = read[length];
+		read[length] = '\0';
+		rs->readSubstring = stString_copy(read);
+		read[length] = c;
+	}
 
 	return rs;
 }
@@ -2449,7 +2583,9 @@ Poa *poa_polish(Poa *poa, stList *bamChunkReads, PolishParams *params) {
 	char *newConsensusString = poa_polish2(poa, bamChunkReads, params, &poaToConsensusMap);
 
 	// Get anchor alignments
-	stList *anchorAlignments = poa_getAnchorAlignments(poa, poaToConsensusMap, stList_length(bamChunkReads), params);
+	TupleArena *anchorArena = tupleArena_construct();
+	stList *anchorAlignments = poa_getAnchorAlignments2(poa, poaToConsensusMap, stList_length(bamChunkReads), params,
+														anchorArena);
 
 	// Generated updated poa
 	Poa *poa2 = poa_realign(bamChunkReads, anchorAlignments, newConsensusString, params);
@@ -2457,6 +2593,7 @@ Poa *poa_polish(Poa *poa, stList *bamChunkReads, PolishParams *params) {
 	// Cleanup
 	free(newConsensusString);
 	stList_destruct(anchorAlignments);
+	tupleArena_destruct(anchorArena);
 	free(poaToConsensusMap);
 
 	if(st_getLogLevel() >= info) {
@@ -2475,6 +2612,29 @@ Poa *poa_polish(Poa *poa, stList *bamChunkReads, PolishParams *params) {
 Poa *poa_realignIterative3(Poa *poa, stList *bamChunkReads,
 						   PolishParams *polishParams, bool hmmMNotRealign,
 						   int64_t minIterations, int64_t maxIterations) {
+	int64_t iterations;
+	return poa_realignIterative4(poa, bamChunkReads, polishParams, hmmMNotRealign, minIterations, maxIterations,
+			&iterations);
+}
+
+static void replacePosteriors(stList *readPosteriors, stList *newReadPosteriors) {
+	// Replaces the per read posteriors in readPosteriors with those in newReadPosteriors, which is destroyed
+	while(stList_length(readPosteriors) > 0) {
+		stList_destruct(stList_pop(readPosteriors));
+	}
+	stList_appendAll(readPosteriors, newReadPosteriors);
+	stList_setDestructor(newReadPosteriors, NULL);
+	stList_destruct(newReadPosteriors);
+}
+
+static Poa *poa_realignIterative5(Poa *poa, stList *bamChunkReads,
+								  PolishParams *polishParams, bool hmmMNotRealign,
+								  int64_t minIterations, int64_t maxIterations, int64_t *iterations,
+								  stList *readMatches, stList *readInserts, stList *readDeletes) {
+	/*
+	 * As poa_realignIterative4. If readMatches is not NULL the lists hold the posteriors of the reads to poa, as
+	 * recorded by poa_realign3, and are updated to those of the returned poa.
+	 */
 	assert(maxIterations >= 0);
 	assert(minIterations <= maxIterations);
 
@@ -2506,17 +2666,27 @@ Poa *poa_realignIterative3(Poa *poa, stList *bamChunkReads,
 		}
 
 		// Get anchor alignments
-		stList *anchorAlignments = poa_getAnchorAlignments(poa, poaToConsensusMap, stList_length(bamChunkReads), polishParams);
+		TupleArena *anchorArena = tupleArena_construct();
+		stList *anchorAlignments = poa_getAnchorAlignments2(poa, poaToConsensusMap, stList_length(bamChunkReads),
+															polishParams, anchorArena);
 
 		time_t realignStartTime = time(NULL);
 
-		// Generated updated poa
-		Poa *poa2 = poa_realign(bamChunkReads, anchorAlignments, reference, polishParams);
+		// Generated updated poa, recording its posteriors if they are wanted
+		stList *roundMatches = NULL, *roundInserts = NULL, *roundDeletes = NULL;
+		if(readMatches != NULL) {
+			roundMatches = stList_construct3(0, (void (*)(void *))stList_destruct);
+			roundInserts = stList_construct3(0, (void (*)(void *))stList_destruct);
+			roundDeletes = stList_construct3(0, (void (*)(void *))stList_destruct);
+		}
+		Poa *poa2 = poa_realign3(bamChunkReads, anchorAlignments, reference, polishParams,
+								 roundMatches, roundInserts, roundDeletes, NULL);
 
 		// Cleanup
 		free(reference);
 		free(poaToConsensusMap);
 		stList_destruct(anchorAlignments);
+		tupleArena_destruct(anchorArena);
 
 		double score2 = poa_getReferenceNodeTotalMatchWeight(poa2) - poa_getTotalErrorWeight(poa2);
 
@@ -2526,21 +2696,39 @@ Poa *poa_realignIterative3(Poa *poa, stList *bamChunkReads,
 		// Stop if score decreases (greedy stopping)
 		if(score2 <= score && i >= minIterations) {
 			poa_destruct(poa2);
+			if(readMatches != NULL) {
+				stList_destruct(roundMatches);
+				stList_destruct(roundInserts);
+				stList_destruct(roundDeletes);
+			}
 			break;
 		}
 
 		poa_destruct(poa);
 		poa = poa2;
 		score = score2;
+		if(readMatches != NULL) {
+			replacePosteriors(readMatches, roundMatches);
+			replacePosteriors(readInserts, roundInserts);
+			replacePosteriors(readDeletes, roundDeletes);
+		}
 	}
 
 	st_logInfo(" %s Took %3d seconds to realign iterative using algorithm: %s through %" PRIi64 " iterations, got final score : %6.4f\n",
 			logIdentifier, (int)(time(NULL) - startTime), hmmMNotRealign ? "consensus" : "polish", i, score/PAIR_ALIGNMENT_PROB_1);
 
 	free(logIdentifier);
+	*iterations = i;
 	return poa;
 }
 
+Poa *poa_realignIterative4(Poa *poa, stList *bamChunkReads,
+						   PolishParams *polishParams, bool hmmMNotRealign,
+						   int64_t minIterations, int64_t maxIterations, int64_t *iterations) {
+	return poa_realignIterative5(poa, bamChunkReads, polishParams, hmmMNotRealign, minIterations, maxIterations,
+			iterations, NULL, NULL, NULL);
+}
+
 Poa *poa_realignIterative2(stList *bamChunkReads,
 						   stList *anchorAlignments, char *reference,
 						   PolishParams *polishParams, bool hmmMNotRealign,
@@ -2561,9 +2749,33 @@ Poa *poa_realignIterative(stList *bamChunkReads, stList *anchorAlignments, char
 
 Poa *poa_realignAll(stList *bamChunkReads, stList *anchorAlignments, char *reference,
 						  PolishParams *polishParams) {
-	Poa *poa = poa_realignIterative2(bamChunkReads, anchorAlignments, reference, polishParams, 1,
-									 polishParams->minPoaConsensusIterations, polishParams->maxPoaConsensusIterations);
-	poa = poa_realignIterative3(poa, bamChunkReads, polishParams, 0,
-			polishParams->minRealignmentPolishIterations, polishParams->maxRealignmentPolishIterations);
+	return poa_realignAllCached(bamChunkReads, anchorAlignments, reference, polishParams, NULL);
+}
+
+Poa *poa_realignAllCached(stList *bamChunkReads, stList *anchorAlignments, char *reference,
+						  PolishParams *polishParams, AlignmentCache *cache) {
+	return poa_realignAllCached2(bamChunkReads, anchorAlignments, reference, polishParams, cache, NULL, NULL, NULL);
+}
+
+Poa *poa_realignAllCached2(stList *bamChunkReads, stList *anchorAlignments, char *reference,
+						   PolishParams *polishParams, AlignmentCache *cache,
+						   stList *readMatches, stList *readInserts, stList *readDeletes) {
+	// As poa_realignIterative2, with the initial alignment to the reference taken from the cache where possible
+	time_t startTime = time(NULL);
+	Poa *poa = poa_realign3(bamChunkReads, anchorAlignments, reference, polishParams,
+							readMatches, readInserts, readDeletes, cache);
+	char *logIdentifier = getLogIdentifier();
+	st_logInfo(" %s Took %3d seconds to generate initial POA\n", logIdentifier, (int)(time(NULL) - startTime));
+	free(logIdentifier);
+
+	int64_t iterations;
+	if(polishParams->maxPoaConsensusIterations > 0) {
+		poa = poa_realignIterative5(poa, bamChunkReads, polishParams, 1,
+				polishParams->minPoaConsensusIterations, polishParams->maxPoaConsensusIterations, &iterations,
+				readMatches, readInserts, readDeletes);
+	}
+	poa = poa_realignIterative5(poa, bamChunkReads, polishParams, 0,
+			polishParams->minRealignmentPolishIterations, polishParams->maxRealignmentPolishIterations, &iterations,
+			readMatches, readInserts, readDeletes);
 	return poa;
 }
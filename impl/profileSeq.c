@@ -143,16 +143,12 @@ void addProfileSeqIdsToSet(stSet *pSeqs, stSet *readIds) {
 }
 
 /*
- * Create profile sequence by summing over the alignment of a read to a given reference sequence,
- * giving the probability of each base for each reference position.
+ * Builds the profile from match and delete posterior probabilities. The read bases are taken from readSeq, or, if it
+ * is NULL, from read, a base at a time so that a packed read is not unpacked.
  */
-stProfileSeq *stProfileSeq_constructFromPosteriorProbs(char *refName, char *refSeq, int64_t refLength,
-													   char *readId, char *readSeq, stList *anchorAlignment,
-													   Params *params) {
-
-	// Generate the posterior probabilities
-	stList *matches = NULL, *inserts = NULL, *deletes = NULL;
-	getAlignedPairsWithIndelsCroppingReference(refSeq, refLength, readSeq, anchorAlignment, &matches, &inserts, &deletes, params->polishParams);
+static stProfileSeq *stProfileSeq_constructFromAlignedPairs2(char *refName, int64_t refLength, char *readId,
+															 char *readSeq, BamChunkRead *read, stList *matches,
+															 stList *deletes, Params *params) {
 
 	// Get min and max reference coordinates
 	int64_t refStart, refEnd;
@@ -176,7 +172,7 @@ stProfileSeq *stProfileSeq_constructFromPosteriorProbs(char *refName, char *refS
 	// Add posterior match probabilities
 	for(int64_t i=0; i<stList_length(matches); i++) {
 		stIntTuple *aPair = stList_get(matches, i);
-		char base = readSeq[stIntTuple_get(aPair, 2)];
+		char base = readSeq != NULL ? readSeq[stIntTuple_get(aPair, 2)] : bamChunkRead_getBase(read, stIntTuple_get(aPair, 2));
 		assert(stIntTuple_get(aPair, 1) >= refStart);
 		assert(stIntTuple_get(aPair, 1) <= refEnd);
 		probs[(stIntTuple_get(aPair, 1)-refStart) * ALPHABET_SIZE + stBaseMapper_getValueForChar(params->baseMapper, base)] += stIntTuple_get(aPair, 0);
@@ -209,9 +205,39 @@ stProfileSeq *stProfileSeq_constructFromPosteriorProbs(char *refName, char *refS
 
 	// Cleanup
 	free(probs);
+
+	return pSeq;
+}
+
+/*
+ * Create profile sequence by summing over the alignment of a read to a given reference sequence,
+ * giving the probability of each base for each reference position.
+ */
+stProfileSeq *stProfileSeq_constructFromPosteriorProbs(char *refName, char *refSeq, int64_t refLength,
+													   char *readId, char *readSeq, stList *anchorAlignment,
+													   Params *params) {
+
+	// Generate the posterior probabilities
+	stList *matches = NULL, *inserts = NULL, *deletes = NULL;
+	getAlignedPairsWithIndelsCroppingReference(refSeq, refLength, readSeq, anchorAlignment, &matches, &inserts, &deletes, params->polishParams);
+
+	stProfileSeq *pSeq = stProfileSeq_constructFromAlignedPairs2(refName, refLength, readId, readSeq, NULL,
+																 matches, deletes, params);
+
+	// Cleanup
 	stList_destruct(matches);
 	stList_destruct(inserts);
 	stList_destruct(deletes);
 
 	return pSeq;
 }
+
+/*
+ * As stProfileSeq_constructFromPosteriorProbs, but from match and delete posterior probabilities that have
+ * already been computed, e.g. while polishing, rather than by realigning the read.
+ */
+stProfileSeq *stProfileSeq_constructFromAlignedPairs(char *refName, int64_t refLength, char *readId,
+													 BamChunkRead *read, stList *matches, stList *deletes,
+													 Params *params) {
+	return stProfileSeq_constructFromAlignedPairs2(refName, refLength, readId, NULL, read, matches, deletes, params);
+}
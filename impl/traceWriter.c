@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "margin.h"
+#include "traceWriter.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+struct _traceWriter {
+    FILE *fh;
+    struct timespec start;
+    bool firstEvent;
+};
+
+TraceWriter *traceWriter_construct(char *traceFile) {
+    TraceWriter *trace = st_calloc(1, sizeof(TraceWriter));
+    trace->fh = fopen(traceFile, "w");
+    if (trace->fh == NULL) {
+        st_errAbort("Could not open trace file for writing: %s\n", traceFile);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &trace->start);
+    trace->firstEvent = TRUE;
+    fprintf(trace->fh, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    return trace;
+}
+
+void traceWriter_destruct(TraceWriter *trace) {
+    if (trace == NULL) {
+        return;
+    }
+    fprintf(trace->fh, "\n]}\n");
+    fclose(trace->fh);
+    free(trace);
+}
+
+static void printJsonString(FILE *fh, char *string) {
+    fputc('"', fh);
+    for (char *c = string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', fh);
+        }
+        if ((unsigned char) *c >= 0x20) {
+            fputc(*c, fh);
+        }
+    }
+    fputc('"', fh);
+}
+
+static void traceWriter_event(TraceWriter *trace, char phase, char *stage, int64_t chunkIdx, BamChunk *bamChunk,
+                              int64_t readCount) {
+    // microseconds since the trace was opened
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t timestamp = (int64_t) (now.tv_sec - trace->start.tv_sec) * 1000000 +
+                        (now.tv_nsec - trace->start.tv_nsec) / 1000;
+    int threadIdx = 0;
+    #ifdef _OPENMP
+    threadIdx = omp_get_thread_num();
+    #endif
+
+    #pragma omp critical (traceWriter)
+    {
+        fprintf(trace->fh, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRId64",\"pid\":0,\"tid\":%d",
+                trace->firstEvent ? "" : ",\n", stage, bamChunk == NULL ? "run" : "chunk", phase, timestamp,
+                threadIdx);
+        if (bamChunk != NULL || readCount >= 0) {
+            fprintf(trace->fh, ",\"args\":{");
+            if (bamChunk != NULL) {
+                fprintf(trace->fh, "\"chunk\":%"PRId64",\"contig\":", chunkIdx);
+                printJsonString(trace->fh, bamChunk->refSeqName);
+                fprintf(trace->fh, ",\"start\":%"PRId64",\"end\":%"PRId64, bamChunk->chunkBoundaryStart,
+                        bamChunk->chunkBoundaryEnd);
+            }
+            if (readCount >= 0) {
+                fprintf(trace->fh, "%s\"reads\":%"PRId64, bamChunk != NULL ? "," : "", readCount);
+            }
+            fprintf(trace->fh, "}");
+        }
+        fprintf(trace->fh, "}");
+        trace->firstEvent = FALSE;
+    }
+}
+
+void traceWriter_begin(TraceWriter *trace, char *stage, int64_t chunkIdx, BamChunk *bamChunk, int64_t readCount) {
+    if (trace != NULL) {
+        traceWriter_event(trace, 'B', stage, chunkIdx, bamChunk, readCount);
+    }
+}
+
+void traceWriter_end(TraceWriter *trace, char *stage, int64_t chunkIdx, BamChunk *bamChunk, int64_t readCount) {
+    if (trace != NULL) {
+        traceWriter_event(trace, 'E', stage, chunkIdx, bamChunk, readCount);
+    }
+}
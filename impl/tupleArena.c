@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "margin.h"
+
+#define TUPLE_ARENA_FIRST_BLOCK_SIZE 1024
+#define TUPLE_ARENA_MAX_BLOCK_SIZE 65536
+
+/*
+ * Each tuple takes four int64s: its length, as an stIntTuple keeps it, then its three values.
+ */
+#define TUPLE_ARENA_TUPLE_WIDTH 4
+
+struct _tupleArena {
+    stList *blocks; // int64_t arrays of tuples, the last one being filled
+    int64_t blockSize; // the number of tuples the last block holds
+    int64_t used; // the number of tuples used in the last block
+    int64_t tupleNumber; // the number of tuples made from the arena
+};
+
+TupleArena *tupleArena_construct() {
+    TupleArena *arena = st_calloc(1, sizeof(TupleArena));
+    arena->blocks = stList_construct3(0, free);
+    return arena;
+}
+
+void tupleArena_destruct(TupleArena *arena) {
+    stList_destruct(arena->blocks);
+    free(arena);
+}
+
+stIntTuple *tupleArena_getTuple3(TupleArena *arena, int64_t value1, int64_t value2, int64_t value3) {
+    // Blocks double in size up to a limit, so small chunks use little memory and large ones few allocations
+    if (stList_length(arena->blocks) == 0 || arena->used == arena->blockSize) {
+        arena->blockSize = arena->blockSize == 0 ? TUPLE_ARENA_FIRST_BLOCK_SIZE :
+                           (arena->blockSize * 2 > TUPLE_ARENA_MAX_BLOCK_SIZE ? TUPLE_ARENA_MAX_BLOCK_SIZE :
+                            arena->blockSize * 2);
+        stList_append(arena->blocks, st_malloc(arena->blockSize * TUPLE_ARENA_TUPLE_WIDTH * sizeof(int64_t)));
+        arena->used = 0;
+    }
+    int64_t *tuple = &((int64_t *) stList_peek(arena->blocks))[arena->used++ * TUPLE_ARENA_TUPLE_WIDTH];
+    tuple[0] = 3;
+    tuple[1] = value1;
+    tuple[2] = value2;
+    tuple[3] = value3;
+    arena->tupleNumber++;
+    return (stIntTuple *) tuple;
+}
+
+int64_t tupleArena_getTupleNumber(TupleArena *arena) {
+    return arena->tupleNumber;
+}
+
+int64_t tupleArena_getBlockNumber(TupleArena *arena) {
+    return stList_length(arena->blocks);
+}
@@ -6,7 +6,9 @@
 
 #include <getopt.h>
 #include <stdio.h>
+#include <limits.h>
 #include <htslib/vcf.h>
+#include <htslib/tbx.h>
 #include "vcfComparison.h"
 #include "htsIntegration.h"
 #include "margin.h"
@@ -1011,61 +1013,172 @@ void compareVCFsBasic(FILE *fh,
 
 
 /*
- * Test to compare a vcf to a truth vcf containing known variants for the region.
- *
- * Information about some of the results is saved in the genotypeResults struct.
+ * stPhasedFragment: the results of phasing a single hmm.
  */
-void compareVCFs(FILE *fh,
-                 stList *hmms,
-                 char *vcf_toEval,
-                 char *vcf_ref,
-                 stBaseMapper *baseMapper,
-                 stGenotypeResults *results,
-                 stRPHmmParameters *params) {
 
-    st_logInfo("> Comparing vcf files \n");
-    st_logInfo("VCF reference: %s \n", vcf_ref);
-    st_logInfo("VCF being evaluated: %s \n", vcf_toEval);
+stPhasedFragment *stPhasedFragment_construct(stRPHmm *hmm, stList *path, stGenomeFragment *gF,
+                                             stSet *reads1, stSet *reads2) {
+    stPhasedFragment *pF = st_calloc(1, sizeof(stPhasedFragment));
+    pF->hmm = hmm;
+    pF->path = path;
+    pF->gF = gF;
+    pF->reads1 = reads1;
+    pF->reads2 = reads2;
+    return pF;
+}
 
-    vcfFile *inRef = vcf_open(vcf_ref,"r"); //open vcf file
-    if (inRef == NULL) {
-        st_logCritical("ERROR: cannot open reference vcf, %s\n", vcf_ref);
-        return;
+stPhasedFragment *stPhasedFragment_constructFromHmm(stRPHmm *hmm) {
+    /*
+     * Runs forward-backward and traceback on the hmm to compute its genome fragment and bipartition.
+     */
+    stRPHmm_forwardBackward(hmm);
+    stList *path = stRPHmm_forwardTraceBack(hmm);
+    stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+    stSet *reads1 = stRPHmm_partitionSequencesByStatePath(hmm, path, 1);
+    stSet *reads2 = stRPHmm_partitionSequencesByStatePath(hmm, path, 0);
+    return stPhasedFragment_construct(hmm, path, gF, reads1, reads2);
+}
+
+void stPhasedFragment_destruct(stPhasedFragment *pF) {
+    stList_destruct(pF->path);
+    stGenomeFragment_destruct(pF->gF);
+    stSet_destruct(pF->reads1);
+    stSet_destruct(pF->reads2);
+    free(pF);
+}
+
+static bool isVerbose(stRPHmmParameters *params) {
+    return params->verboseTruePositives || params->verboseFalsePositives || params->verboseFalseNegatives;
+}
+
+/*
+ * Reader which returns the records of a vcf either in file order, or, if the vcf is indexed (bgzipped vcf
+ * with a tabix index, or bcf with a csi index), from a given position of a given contig onwards.
+ */
+
+typedef struct _vcfRecordReader {
+    char *fileName;
+    vcfFile *fp;
+    bcf_hdr_t *hdr;
+    hts_idx_t *bcfIdx;
+    tbx_t *tbxIdx;
+    hts_itr_t *itr;
+    bool noRecords; // set if the contig queried is not in the index
+    kstring_t line;
+} vcfRecordReader;
+
+static vcfRecordReader *vcfRecordReader_construct(char *fileName) {
+    vcfFile *fp = vcf_open(fileName, "r");
+    if (fp == NULL) {
+        return NULL;
     }
-    bcf_hdr_t *hdrRef = bcf_hdr_read(inRef); //read header
-    bcf1_t *refRecord = bcf_init1(); //initialize for reading
+    vcfRecordReader *reader = st_calloc(1, sizeof(vcfRecordReader));
+    reader->fileName = fileName;
+    reader->fp = fp;
+    reader->hdr = bcf_hdr_read(fp);
+
+    // load an index if there is one, otherwise records are read linearly
+    const htsFormat *format = hts_get_format(fp);
+    if (format->format == bcf) {
+        reader->bcfIdx = bcf_index_load(fileName);
+    } else if (format->format == vcf && format->compression == bgzf) {
+        reader->tbxIdx = tbx_index_load(fileName);
+    }
+    return reader;
+}
 
-    vcfFile *inEval = vcf_open(vcf_toEval,"r"); //open vcf file
-    if (inEval == NULL) {
-        st_logCritical("ERROR: cannot open vcf to evaluate, %s\n", vcf_toEval);
-        return;
+static bool vcfRecordReader_isIndexed(vcfRecordReader *reader) {
+    return reader->bcfIdx != NULL || reader->tbxIdx != NULL;
+}
+
+static void vcfRecordReader_seek(vcfRecordReader *reader, char *contig, int64_t start) {
+    /*
+     * Positions an indexed reader at the first record of the contig at or after the zero-based position start.
+     */
+    assert(vcfRecordReader_isIndexed(reader));
+    if (reader->itr != NULL) {
+        hts_itr_destroy(reader->itr);
+        reader->itr = NULL;
+    }
+    int tid = reader->bcfIdx != NULL ? bcf_hdr_name2id(reader->hdr, contig) : tbx_name2id(reader->tbxIdx, contig);
+    if (tid >= 0) {
+        reader->itr = reader->bcfIdx != NULL ? bcf_itr_queryi(reader->bcfIdx, tid, start < 0 ? 0 : start, INT_MAX)
+                                             : tbx_itr_queryi(reader->tbxIdx, tid, start < 0 ? 0 : start, INT_MAX);
+    }
+    reader->noRecords = reader->itr == NULL;
+    if (reader->noRecords) {
+        st_logInfo("\tNo records for contig %s in %s\n", contig, reader->fileName);
+    }
+}
+
+static int vcfRecordReader_next(vcfRecordReader *reader, bcf1_t *record) {
+    /*
+     * As bcf_read, returns 0 if a record was read.
+     */
+    if (!vcfRecordReader_isIndexed(reader)) {
+        return bcf_read(reader->fp, reader->hdr, record);
     }
+    if (reader->noRecords) {
+        return -1;
+    }
+    if (reader->bcfIdx != NULL) {
+        return bcf_itr_next(reader->fp, reader->itr, record);
+    }
+    int i = tbx_itr_next(reader->fp, reader->tbxIdx, reader->itr, &reader->line);
+    if (i < 0) {
+        return i;
+    }
+    return vcf_parse(&reader->line, reader->hdr, record);
+}
 
-    bcf_hdr_t *hdrEval = bcf_hdr_read(inEval); //read header
+static void vcfRecordReader_destruct(vcfRecordReader *reader) {
+    if (reader->itr != NULL) hts_itr_destroy(reader->itr);
+    if (reader->bcfIdx != NULL) hts_idx_destroy(reader->bcfIdx);
+    if (reader->tbxIdx != NULL) tbx_destroy(reader->tbxIdx);
+    free(reader->line.s);
+    bcf_hdr_destroy(reader->hdr);
+    vcf_close(reader->fp);
+    free(reader);
+}
+
+static void compareVCFsForHmms(vcfRecordReader *refReader, vcfRecordReader *evalReader,
+                               stList *hmms, stList *phasedFragments, int64_t firstHmm, int64_t lastHmm,
+                               stBaseMapper *baseMapper, stGenotypeResults *results, stRPHmmParameters *params) {
+    /*
+     * Compares the records of the two vcfs covered by the hmms in the interval [firstHmm, lastHmm).
+     * The genome fragments and read partitions are only needed for verbose output, so if they
+     * are not given in phasedFragments they are only computed when verbose output is requested.
+     */
+
+    bcf_hdr_t *hdrRef = refReader->hdr;
+    bcf_hdr_t *hdrEval = evalReader->hdr;
+    bcf1_t *refRecord = bcf_init1(); //initialize for reading
     bcf1_t *evalRecord = bcf_init1(); //initialize for reading
     int evalRecordPhased;
+    bool verbose = isVerbose(params);
 
     // Start by looking at the first hmm
-    int64_t hmmIndex = 0;
+    int64_t hmmIndex = firstHmm;
     stRPHmm *hmm = stList_get(hmms, hmmIndex);
-
-    // Inefficient, but recalculate the info relevant to the hmm to get bipartitions
-    stRPHmm_forwardBackward(hmm);
-    stList *path = stRPHmm_forwardTraceBack(hmm);
-    stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
-    stSet *reads1 = stRPHmm_partitionSequencesByStatePath(hmm, path, 1);
-    stSet *reads2 = stRPHmm_partitionSequencesByStatePath(hmm, path, 0);
+    stPhasedFragment *pF = NULL;
+    if (verbose) {
+        pF = phasedFragments != NULL ? stList_get(phasedFragments, hmmIndex) : stPhasedFragment_constructFromHmm(hmm);
+    }
+    stGenomeFragment *gF = pF == NULL ? NULL : pF->gF;
+    stSet *reads1 = pF == NULL ? NULL : pF->reads1;
+    stSet *reads2 = pF == NULL ? NULL : pF->reads2;
 
     // Iterate through the vcf being checked until getting to the start of the specified interval
     // Don't bother analyzing these records
     int64_t refStart = 0;
+    int64_t initialPositives = results->positives;
 
     // Variables for keeping track of phasing info
     float switchErrorDistance = 0;
 
     vcfRecordComparisonInfo *vcfInfo = st_calloc(1, sizeof(vcfRecordComparisonInfo));
 
-    while(bcf_read(inRef, hdrRef, refRecord) == 0) {
+    while(vcfRecordReader_next(refReader, refRecord) == 0) {
 
         // To take care of the case where a false positive may have been skipped
         // over if the previous eval location was a false negative
@@ -1093,7 +1206,7 @@ void compareVCFs(FILE *fh,
                                                         : refRecord->d.allele[vcfInfo->refPhasing2];
 
         // Skip to the first known location of variation in file being evaluated
-        if (results->positives == 0) {
+        if (results->positives == initialPositives) {
             refStart = vcfInfo->referencePos;
         }
 
@@ -1103,19 +1216,20 @@ void compareVCFs(FILE *fh,
         // If the position is beyond the end of this hmm, get the next one
         while ((hmm->refStart + hmm->refLength) < vcfInfo->referencePos) {
             hmmIndex++;
-            if (hmmIndex < stList_length(hmms)) {
-                // Cleanup old stuff
-                stList_destruct(path);
-                stGenomeFragment_destruct(gF);
-                stSet_destruct(reads1);
-                stSet_destruct(reads2);
-
-                // Get new stuff
+            if (hmmIndex < lastHmm) {
                 hmm = stList_get(hmms, hmmIndex);
-                path = stRPHmm_forwardTraceBack(hmm);
-                gF = stGenomeFragment_construct(hmm, path);
-                reads1 = stRPHmm_partitionSequencesByStatePath(hmm, path, 1);
-                reads2 = stRPHmm_partitionSequencesByStatePath(hmm, path, 0);
+                if (verbose) {
+                    // Cleanup old stuff and get new stuff
+                    if (phasedFragments == NULL) {
+                        stPhasedFragment_destruct(pF);
+                        pF = stPhasedFragment_constructFromHmm(hmm);
+                    } else {
+                        pF = stList_get(phasedFragments, hmmIndex);
+                    }
+                    gF = pF->gF;
+                    reads1 = pF->reads1;
+                    reads2 = pF->reads2;
+                }
                 vcfInfo->phasingHap1 = false;
                 vcfInfo->phasingHap2 = false;
             } else {
@@ -1123,10 +1237,12 @@ void compareVCFs(FILE *fh,
             }
         }
         // No more fragments to look through
-        if (hmmIndex == stList_length(hmms)) break;
+        if (hmmIndex == lastHmm) break;
 
-        vcfInfo->h1AlphChar = stBaseMapper_getCharForValue(baseMapper, gF->haplotypeString1[vcfInfo->referencePos - gF->refStart]);
-        vcfInfo->h2AlphChar = stBaseMapper_getCharForValue(baseMapper, gF->haplotypeString2[vcfInfo->referencePos - gF->refStart]);
+        if (verbose) {
+            vcfInfo->h1AlphChar = stBaseMapper_getCharForValue(baseMapper, gF->haplotypeString1[vcfInfo->referencePos - gF->refStart]);
+            vcfInfo->h2AlphChar = stBaseMapper_getCharForValue(baseMapper, gF->haplotypeString2[vcfInfo->referencePos - gF->refStart]);
+        }
 
         results->positives++;
         if (vcfInfo->refPhasing1 != vcfInfo->refPhasing2) {
@@ -1170,7 +1286,7 @@ void compareVCFs(FILE *fh,
         // Iterate through vcf until getting to the position of the variant
         // from the reference vcf currently being looked at
         while (vcfInfo->evalPos < vcfInfo->referencePos) {
-            if (bcf_read(inEval, hdrEval, evalRecord) != 0) {
+            if (vcfRecordReader_next(evalReader, evalRecord) != 0) {
                 break;  // can't read record - no more records in file to evaluate
             }
             // Unpack record
@@ -1312,8 +1428,8 @@ void compareVCFs(FILE *fh,
         } else if (vcfInfo->evalPos > vcfInfo->referencePos){
             // Missed the variant - False negative
 
-            double *read1BaseCounts = getProfileSequenceBaseCompositionAtPosition(reads1, vcfInfo->referencePos);
-            double *read2BaseCounts = getProfileSequenceBaseCompositionAtPosition(reads2, vcfInfo->referencePos);
+            double *read1BaseCounts = verbose ? getProfileSequenceBaseCompositionAtPosition(reads1, vcfInfo->referencePos) : NULL;
+            double *read2BaseCounts = verbose ? getProfileSequenceBaseCompositionAtPosition(reads2, vcfInfo->referencePos) : NULL;
 
             // False negative - no variation was found, but truth vcf has one
             if (vcfInfo->refPhasing1 != vcfInfo->refPhasing2){
@@ -1405,31 +1521,93 @@ void compareVCFs(FILE *fh,
             free(gt_arr);
         }
     }
-    if (results->truePositives == 0) {
-        st_logInfo("No matches between vcfs found - did you compare against the correct vcf?\n");
-    }
 
     // Remaining positions after the last variant in the reference are not currently being looked through
     // False positives in this region could therefore be missed
     // (In addition to false positives after the first variant)
-    results->negatives += (vcfInfo->referencePos - refStart - results->positives);
-    results->trueNegatives += (results->negatives - results->falsePositives);
-    results->switchErrorDistance = results->switchErrorDistance/results->switchErrors;
+    results->negatives += (vcfInfo->referencePos - refStart - (results->positives - initialPositives));
 
     // cleanup
-    vcf_close(inRef);
-    vcf_close(inEval);
-    bcf_hdr_destroy(hdrRef);
-    bcf_hdr_destroy(hdrEval);
     bcf_destroy(refRecord);
     bcf_destroy(evalRecord);
-    stSet_destruct(reads1);
-    stSet_destruct(reads2);
-    stGenomeFragment_destruct(gF);
-    stList_destruct(path);
+    if (pF != NULL && phasedFragments == NULL) {
+        stPhasedFragment_destruct(pF);
+    }
     free(vcfInfo);
 }
 
+/*
+ * Test to compare a vcf to a truth vcf containing known variants for the region.
+ *
+ * Information about some of the results is saved in the genotypeResults struct.
+ *
+ * If both vcfs are indexed (bgzipped vcf with a tabix index, or bcf with a csi index) the comparison is done
+ * separately for each contig covered by the hmms, using region queries into both files. Otherwise the files
+ * are read linearly.
+ *
+ * phasedFragments, if not NULL, is a list of stPhasedFragment parallel to hmms holding the genome fragments
+ * computed while phasing. These are only used for verbose output; if they are NULL and verbose output
+ * is requested they are recomputed from the hmms.
+ */
+void compareVCFs(FILE *fh,
+                 stList *hmms,
+                 stList *phasedFragments,
+                 char *vcf_toEval,
+                 char *vcf_ref,
+                 stBaseMapper *baseMapper,
+                 stGenotypeResults *results,
+                 stRPHmmParameters *params) {
+
+    st_logInfo("> Comparing vcf files \n");
+    st_logInfo("VCF reference: %s \n", vcf_ref);
+    st_logInfo("VCF being evaluated: %s \n", vcf_toEval);
+    assert(phasedFragments == NULL || stList_length(phasedFragments) == stList_length(hmms));
+
+    vcfRecordReader *refReader = vcfRecordReader_construct(vcf_ref);
+    if (refReader == NULL) {
+        st_logCritical("ERROR: cannot open reference vcf, %s\n", vcf_ref);
+        return;
+    }
+    vcfRecordReader *evalReader = vcfRecordReader_construct(vcf_toEval);
+    if (evalReader == NULL) {
+        st_logCritical("ERROR: cannot open vcf to evaluate, %s\n", vcf_toEval);
+        vcfRecordReader_destruct(refReader);
+        return;
+    }
+
+    if (vcfRecordReader_isIndexed(refReader) && vcfRecordReader_isIndexed(evalReader)) {
+        // Compare each contig separately, starting both files at the first hmm of the contig
+        int64_t firstHmm = 0;
+        while (firstHmm < stList_length(hmms)) {
+            stRPHmm *hmm = stList_get(hmms, firstHmm);
+            int64_t lastHmm = firstHmm + 1;
+            while (lastHmm < stList_length(hmms) &&
+                   stString_eq(((stRPHmm *) stList_get(hmms, lastHmm))->referenceName, hmm->referenceName)) {
+                lastHmm++;
+            }
+            vcfRecordReader_seek(refReader, hmm->referenceName, hmm->refStart - 1);
+            vcfRecordReader_seek(evalReader, hmm->referenceName, hmm->refStart - 1);
+            compareVCFsForHmms(refReader, evalReader, hmms, phasedFragments, firstHmm, lastHmm,
+                               baseMapper, results, params);
+            firstHmm = lastHmm;
+        }
+    } else {
+        st_logInfo("\tVCFs are not both indexed, reading them linearly\n");
+        compareVCFsForHmms(refReader, evalReader, hmms, phasedFragments, 0, stList_length(hmms),
+                           baseMapper, results, params);
+    }
+
+    if (results->truePositives == 0) {
+        st_logInfo("No matches between vcfs found - did you compare against the correct vcf?\n");
+    }
+    results->trueNegatives += (results->negatives - results->falsePositives);
+    results->switchErrorDistance = results->switchErrorDistance/results->switchErrors;
+
+    // cleanup
+    vcfRecordReader_destruct(refReader);
+    vcfRecordReader_destruct(evalReader);
+}
+
 
 /*
  * Test to compare a vcf to a truth vcf containing known variants for the region.
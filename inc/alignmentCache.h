@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef MARGINPHASE_ALIGNMENTCACHE_H
+#define MARGINPHASE_ALIGNMENTCACHE_H
+
+#include "margin.h"
+
+/*
+ * On-disk cache of the match, insert and delete posteriors of reads aligned to a reference window, so that a read
+ * whose window, sequence and anchors are unchanged from an earlier run (typically an earlier round of polishing) is
+ * not realigned.
+ *
+ * An entry is keyed by the read id and a hash of everything the alignment depends on: the cropped reference window,
+ * the read sequence and the anchors relative to the window. Together with the parameters fingerprint, checked when the
+ * cache file is loaded, this makes a cached alignment identical to a recomputed one. Positions are stored relative to
+ * the window so an entry is found again after the window has moved on the reference.
+ *
+ * One cache is used per chunk, from one thread, and only for the first alignment of the chunk's reads (see
+ * poa_realignAllCached). As reads are cropped to the chunk, an edit to the draft changes the windows of the reads of
+ * every later chunk of the contig, so the cache mostly hits for chunks before the first edit or an unchanged draft;
+ * marginPolish logs the hit rate.
+ */
+struct _alignmentCache {
+    char *cacheFile;
+    uint64_t paramsFingerprint;
+    stHash *entries; // "readId:key" to AlignmentCacheEntry
+    int64_t hits;
+    int64_t misses;
+};
+
+/*
+ * Loads the cache from cacheFile if it exists and was written with the same parameters fingerprint, else starts
+ * empty.
+ */
+AlignmentCache *alignmentCache_construct(char *cacheFile, uint64_t paramsFingerprint);
+
+void alignmentCache_destruct(AlignmentCache *cache);
+
+/*
+ * Writes the entries that were looked up or added since the cache was constructed back to the cache file, replacing
+ * it, so entries no longer used are dropped.
+ */
+void alignmentCache_write(AlignmentCache *cache);
+
+/*
+ * Hash of the inputs of an alignment: the cropped reference window, the read and the anchor pairs, as
+ * (refPos, readPos, diagonalExpansion) stIntTuples relative to the window.
+ */
+uint64_t alignmentCache_getKey(char *refWindow, char *read, stList *anchorPairs);
+
+/*
+ * If the cache has an entry for the read and key, sets matches, inserts and deletes to new lists of
+ * (prob, refPos, readPos) stIntTuples, positions relative to the window, and returns TRUE.
+ */
+bool alignmentCache_get(AlignmentCache *cache, char *readId, uint64_t key,
+                        stList **matches, stList **inserts, stList **deletes);
+
+/*
+ * Adds an entry for the read and key, copying the given lists.
+ */
+void alignmentCache_put(AlignmentCache *cache, char *readId, uint64_t key,
+                        stList *matches, stList *inserts, stList *deletes);
+
+/*
+ * Fingerprint of a parameters file, from its contents.
+ */
+uint64_t alignmentCache_getParamsFingerprint(char *paramsFile);
+
+#endif //MARGINPHASE_ALIGNMENTCACHE_H
@@ -19,9 +19,25 @@ extern "C" {
     // consensus calling function
     RleString* callConsensus(int64_t readCount, char *nucleotides[], uint8_t *runLengths[], uint8_t strands[], PolishParams *params);
 
+    // index of the read used as the initial poa backbone by callConsensus
+    int64_t getConsensusBackboneIndex(int64_t readCount, char *nucleotides[]);
+
+    // as callConsensus, but the poa starts from the read given by backboneIndex, to compare backbone choices
+    RleString* callConsensusWithBackbone(int64_t readCount, char *nucleotides[], uint8_t *runLengths[],
+                                         uint8_t strands[], int64_t backboneIndex, PolishParams *params);
+
+    // batched consensus calling function, the i-th read set is given by readCounts[i], nucleotides[i], runLengths[i]
+    // and strands[i]. sets are processed in parallel by numThreads threads, each reusing its own scratch space.
+    // the i-th returned consensus is identical to that of callConsensus on the i-th set.
+    RleString** callConsensusBatch(int64_t setCount, int64_t readCounts[], char **nucleotides[], uint8_t **runLengths[],
+                                   uint8_t *strands[], PolishParams *params, int64_t numThreads);
+
     // destructor for RLE string
     void destroyRleString(RleString *r);
 
+    // destructor for the result of callConsensusBatch
+    void destroyRleStringBatch(int64_t setCount, RleString **r);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef MARGINPHASE_CHUNKREPORT_H
+#define MARGINPHASE_CHUNKREPORT_H
+
+#include "margin.h"
+
+/*
+ * Stages of polishing a chunk, as timed in the chunk report and named in the trace.
+ */
+typedef enum {
+    CHUNK_STAGE_PARSE_READS = 0,
+    CHUNK_STAGE_DOWNSAMPLE = 1,
+    CHUNK_STAGE_RUN_LENGTH_ENCODE = 2,
+    CHUNK_STAGE_POA = 3,
+    CHUNK_STAGE_EXPAND_CONSENSUS = 4,
+    CHUNK_STAGE_HELEN_FEATURES = 5,
+    CHUNK_STAGE_COUNT = 6
+} ChunkStage;
+
+char *chunkStage_getName(ChunkStage stage);
+
+/*
+ * Resource usage of polishing one chunk. Memory figures are for the whole process (as reported by getrusage and
+ * /proc/self/statm): ru_maxrss is the high-water mark of all threads together, so with several threads a rise in the
+ * peak is shared by the chunks running at the time and can't be attributed to one of them.
+ */
+typedef struct _chunkReport {
+    int64_t chunkIdx;
+    BamChunk *bamChunk;
+    int threadIdx;
+    int64_t readsIn; // reads parsed for the chunk, -1 until parsed
+    int64_t readsKept; // reads left after downsampling, -1 until downsampled
+    int64_t poaNodes; // -1 until the poa is built
+    int64_t poaObservations; // total observations over all poa nodes, 0 until the poa is built
+    double stageSeconds[CHUNK_STAGE_COUNT];
+    double totalSeconds; // time since the chunk started, when the last line was written
+    int64_t peakRssStartKb; // process memory high-water mark when the chunk started
+    int64_t peakRssKb; // and when the last line was written
+    int64_t rssKb; // resident memory when the last line was written, -1 if not available
+    struct timespec chunkStartTime;
+    struct timespec stageStartTime;
+} ChunkReport;
+
+/*
+ * Resets the report and records the chunk's start time and memory.
+ */
+void chunkReport_start(ChunkReport *report, int64_t chunkIdx, BamChunk *bamChunk);
+
+/*
+ * Records the number of nodes of the chunk's poa and the observations over them.
+ */
+void chunkReport_setPoa(ChunkReport *report, Poa *poa);
+
+void chunkReport_startStage(ChunkReport *report, ChunkStage stage);
+
+void chunkReport_endStage(ChunkReport *report, ChunkStage stage);
+
+/*
+ * Writes tab separated lines, with a header line. Each line is flushed, so a chunk that is running when the process
+ * is killed (for example for running out of memory) has its "started" line and the line of the stage it was in.
+ */
+typedef struct _chunkReportWriter ChunkReportWriter;
+
+ChunkReportWriter *chunkReportWriter_construct(char *reportFile);
+
+void chunkReportWriter_destruct(ChunkReportWriter *writer);
+
+/*
+ * Writes a line with the report so far, after measuring the time since the chunk started and the memory now. The
+ * event is "started" when the chunk begins, the stage name as each stage begins, and "finished" at the end.
+ */
+void chunkReportWriter_write(ChunkReportWriter *writer, ChunkReport *report, char *event);
+
+#endif //MARGINPHASE_CHUNKREPORT_H
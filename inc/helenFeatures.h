@@ -5,9 +5,11 @@
 #ifndef MARGINPHASE_HELENFEATURES_H
 #define MARGINPHASE_HELENFEATURES_H
 
-#ifdef _HDF5
 #include "margin.h"
+#ifdef _HDF5
 #include <hdf5.h>
+#include <pthread.h>
+#endif
 
 #define POAFEATURE_SYMBOL_GAP_POS SYMBOL_NUMBER
 #define POAFEATURE_SIMPLE_WEIGHT_TOTAL_SIZE ((SYMBOL_NUMBER + 1) * 2) // {A,C,G,T,N,gap} x {fwd,bkwd}
@@ -43,11 +45,14 @@ struct _poaFeatureSplitRleWeight {
     int64_t labelRunLength;
     PoaFeatureSplitRleWeight* nextRunLength; //so we can model all inserts after a position
     PoaFeatureSplitRleWeight* nextInsert; //so we can model all inserts after a position
-    double* weights;
+    double* weights; // allocated with the feature, straight after it
     int64_t maxRunLength;
 };
 
 typedef struct _splitRleFeatureHDF5FileInfo SplitRleFeatureHDF5FileInfo;
+typedef struct _splitRleFeatureHDF5Writer SplitRleFeatureHDF5Writer;
+
+#ifdef _HDF5
 struct _splitRleFeatureHDF5FileInfo {
     char* filename;
     hid_t file;
@@ -61,6 +66,73 @@ SplitRleFeatureHDF5FileInfo* splitRleFeatureHDF5FileInfo_construct(char *filenam
 void splitRleFeatureHDF5FileInfo_destruct(SplitRleFeatureHDF5FileInfo* fileInfo);
 SplitRleFeatureHDF5FileInfo** openSplitRleFeatureHDF5FilesByThreadCount(char *filenameBase, int64_t threadCount);
 
+/*
+ * A single HDF5 file of split RLE weight features, written by its own thread which the polishing threads hand the
+ * features of their chunks to.
+ *
+ * Rather than a group of small datasets per window, the rows of every chunk are appended to extendable, chunked and
+ * compressed datasets ("position", "image", "normalization" and, with labels, "label_base" and "label_run_length").
+ * Each window, the unit written as a group to the per thread files, is a row of the datasets in the "windows" group:
+ * its name (as the group would be named under "images"), "contig", "contig_start", "contig_end",
+ * "feature_chunk_idx", and its first row ("row_start") and number of rows ("row_count") in the feature datasets.
+ * Windows of a chunk overlap, so the rows of a chunk are stored once and shared by its windows. Chunks are appended
+ * in the order they finish.
+ */
+struct _splitRleFeatureHDF5Writer {
+    char *filename;
+    int64_t maxRunLength;
+    int64_t imageColumnCount;
+    bool outputLabels;
+    hid_t file;
+    hid_t stringType;
+    hid_t positionDataset;
+    hid_t imageDataset;
+    hid_t normalizationDataset;
+    hid_t labelCharacterDataset;
+    hid_t labelRunLengthDataset;
+    hid_t windowNameDataset;
+    hid_t windowContigDataset;
+    hid_t windowContigStartDataset;
+    hid_t windowContigEndDataset;
+    hid_t windowChunkIndexDataset;
+    hid_t windowRowStartDataset;
+    hid_t windowRowCountDataset;
+    int64_t rowCount;
+    int64_t windowCount;
+    bool failed;
+
+    // chunks waiting to be written, added by the polishing threads and removed by the writer thread
+    stList *queue;
+    int64_t maxQueueLength;
+    bool finished;
+    pthread_mutex_t mutex;
+    pthread_cond_t queueNotEmpty;
+    pthread_cond_t queueNotFull;
+    pthread_t thread;
+};
+
+/*
+ * Creates the file and starts the writer thread. Adding a chunk blocks while maxQueueLength chunks are waiting to be
+ * written, which bounds the memory held for the writer.
+ */
+SplitRleFeatureHDF5Writer *splitRleFeatureHDF5Writer_construct(char *filename, int64_t maxRunLength,
+                                                               bool outputLabels, int64_t maxQueueLength);
+
+/*
+ * Waits for the waiting chunks to be written, stops the writer thread and closes the file. Returns FALSE if any of
+ * the features could not be written, so the file is incomplete.
+ */
+bool splitRleFeatureHDF5Writer_destruct(SplitRleFeatureHDF5Writer *writer);
+
+/*
+ * Queues the features of a chunk to be written, as writeSplitRleWeightHelenFeaturesHDF5 would write them. The
+ * features are copied so may be freed on return. Called from any thread.
+ */
+void splitRleFeatureHDF5Writer_addChunk(SplitRleFeatureHDF5Writer *writer, char *outputFileBase, BamChunk *bamChunk,
+                                        bool outputLabels, stList *features, int64_t featureStartIdx,
+                                        int64_t featureEndIdxInclusive);
+#endif
+
 int PoaFeature_SimpleWeight_charIndex(Symbol character, bool forward);
 int PoaFeature_SimpleWeight_gapIndex(bool forward);
 int PoaFeature_RleWeight_charIndex(Symbol character, int64_t runLength, bool forward);
@@ -74,21 +146,26 @@ void PoaFeature_SimpleWeight_destruct(PoaFeatureSimpleWeight *feature);
 PoaFeatureRleWeight *PoaFeature_RleWeight_construct(int64_t refPos, int64_t insPos);
 void PoaFeature_RleWeight_destruct(PoaFeatureRleWeight *feature);
 
-PoaFeatureSplitRleWeight *PoaFeature_SplitRleWeight_construct(int64_t maxRunLength, int64_t refPos, int64_t insPos, int64_t rlPos);
+PoaFeatureSplitRleWeight *PoaFeature_SplitRleWeight_construct(int64_t refPos, int64_t insPos, int64_t rlPos, int64_t maxRunLength);
 void PoaFeature_SplitRleWeight_destruct(PoaFeatureSplitRleWeight *feature);
 
 stList *poa_getSimpleWeightFeatures(Poa *poa, stList *bamChunkReads);
 stList *poa_getRleWeightFeatures(Poa *poa, stList *bamChunkReads, stList *rleStrings, RleString *consensusRleString);
 stList *poa_getSplitRleWeightFeatures(Poa *poa, stList *bamChunkReads, stList *rleStrings, int64_t maxRunLength);
 
-void handleHelenFeatures(char *outputBase, HelenFeatureType helenFeatureType, BamChunker *trueReferenceBamChunker,
-        int64_t splitWeightMaxRunLength, void **splitWeightHDF5Files, bool fullFeatureOutput, char *trueReferenceBam,
+/*
+ * Writes the HELEN features of a polished chunk. Returns FALSE if they could not all be written.
+ */
+bool handleHelenFeatures(char *outputBase, HelenFeatureType helenFeatureType, BamChunker *trueReferenceBamChunker,
+        int64_t splitWeightMaxRunLength, void **splitWeightHDF5Files, void *splitWeightHDF5Writer,
+        char *splitWeightNpyDir, bool fullFeatureOutput, char *trueReferenceBam,
         Params *params, char *logIdentifier, int64_t chunkIdx, BamChunk *bamChunk, Poa *poa, stList *rleReads,
         stList *rleNucleotides, char *polishedConsensusString, RleString *polishedRleConsensus);
 
-void poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkReads, stList *rleStrings,
+bool poa_writeHelenFeatures(HelenFeatureType type, Poa *poa, stList *bamChunkReads, stList *rleStrings,
         char *outputFileBase, BamChunk *bamChunk, stList *trueRefAlignment, RleString *consensusRleString,
-        RleString *trueRefRleString, bool fullFeatureOutput, int64_t splitWeightMaxRunLength, SplitRleFeatureHDF5FileInfo** splitWeightHDF5Files);
+        RleString *trueRefRleString, bool fullFeatureOutput, int64_t splitWeightMaxRunLength, SplitRleFeatureHDF5FileInfo** splitWeightHDF5Files,
+        SplitRleFeatureHDF5Writer *splitWeightHDF5Writer, char *splitWeightNpyDir);
 
 stList *alignConsensusAndTruth(char *consensusStr, char *truthStr);
 void poa_annotateHelenFeaturesWithTruth(stList *features, HelenFeatureType featureType, stList *trueRefAlignment,
@@ -97,6 +174,27 @@ void poa_annotateHelenFeaturesWithTruth(stList *features, HelenFeatureType featu
 
 void printMEAAlignment(char *X, char *Y, int64_t lX, int64_t lY, stList *alignedPairs, int64_t *Xrl, int64_t *Yrl);
 
+uint8_t convertTotalWeightToUInt8(double totalWeight);
+uint8_t normalizeWeightToUInt8(double totalWeight, double weight);
+
+/*
+ * Writes the split RLE weight features of a chunk without HDF5, as NumPy (.npy) arrays and a JSON manifest in
+ * outputDir, so each thread writes its chunks independently. The arrays hold all the rows of the chunk, with the
+ * columns of the HDF5 datasets: outputFileBase.position.npy (uint32, rows x 3), outputFileBase.image.npy and
+ * outputFileBase.normalization.npy (uint8, rows x image columns and rows x 1) and, with labels,
+ * outputFileBase.label_base.npy and outputFileBase.label_run_length.npy (uint8, rows x 1).
+ *
+ * outputFileBase.json holds the "name", "contig", "contig_start" and "contig_end" of the chunk, its "row_count",
+ * "image_column_count" and whether it has "labels", and its "windows": the "name", "feature_chunk_idx", "row_start"
+ * and "row_count" of the rows each group of the HDF5 output holds. The manifest is written last, so only complete
+ * chunks have one. Returns FALSE if any of the files could not be written.
+ */
+bool writeSplitRleWeightHelenFeaturesNpy(char *outputDir, char *outputFileBase, BamChunk *bamChunk,
+        bool outputLabels, stList *features, int64_t featureStartIdx, int64_t featureEndIdxInclusive,
+        int64_t maxRunLength);
+
+#ifdef _HDF5
+
 void writeSimpleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk *bamChunk, bool outputLabels, stList *features,
                                         int64_t featureStartIdx, int64_t featureEndIdxInclusive);
 
@@ -109,6 +207,6 @@ void writeNucleotideAndRleWeightHelenFeaturesHDF5(char *outputFileBase, BamChunk
 void writeSplitRleWeightHelenFeaturesHDF5(SplitRleFeatureHDF5FileInfo* hdf5FileInfo, char *outputFileBase,
         BamChunk *bamChunk, bool outputLabels, stList *features,
         int64_t featureStartIdx, int64_t featureEndIdxInclusive, int64_t maxRunLength);
+#endif
 
-#endif //_HDF5
 #endif //MARGINPHASE_HELENFEATURES_H
@@ -13,8 +13,24 @@
 #include "margin.h"
 
 
+/*
+ * Sets the reference fasta used to decode CRAM input, and stops htslib fetching references over the network.
+ */
+void setCramReferenceFasta(char *referenceFasta);
+samFile *openAlignmentFile(char *alignmentFile);
+void closeCachedAlignmentFiles();
+
 BamChunker *bamChunker_construct(char *bamFile, PolishParams *params);
 BamChunker *bamChunker_construct2(char *bamFile, char *region, PolishParams *params);
+BamChunker *bamChunker_construct3(stList *bamFiles, char *region, PolishParams *params);
+/*
+ * Checks that the region is well formed and its contig is in the first bam, and that each bam can be opened with its
+ * index and header. Returns NULL if the bamChunker_construct3 arguments are usable, else an error message for the
+ * caller to free. The files opened are kept for the chunker.
+ */
+char *bamChunker_checkInputs(stList *bamFiles, char *region);
+BamChunker *bamChunker_constructFromBed(char *bamFile, char *bedFile, PolishParams *params);
+BamChunker *bamChunker_constructFromBed2(stList *bamFiles, char *bedFile, PolishParams *params);
 BamChunker *bamChunker_copyConstruct(BamChunker *toCopy);
 void bamChunker_destruct(BamChunker *bamChunker);
 BamChunk *bamChunker_getChunk(BamChunker *bamChunker, int64_t chunkIdx);
@@ -26,6 +42,18 @@ BamChunk *bamChunk_copyConstruct(BamChunk *toCopy);
 void bamChunk_destruct(BamChunk *bamChunk);
 
 uint32_t convertToReadsAndAlignments(BamChunk *bamChunk, stList *reads, stList *alignments);
+/*
+ * As convertToReadsAndAlignments, but if arena is not NULL the aligned pairs are made from the arena and the
+ * alignments do not free them.
+ */
+uint32_t convertToReadsAndAlignments2(BamChunk *bamChunk, stList *reads, stList *alignments, TupleArena *arena);
+/*
+ * Splits the reads and alignments of a chunk into those kept and those discarded to bring the depth down to
+ * intendedDepth, returning FALSE (and leaving the output lists empty) if no read is discarded. The reads kept are
+ * drawn from a generator seeded from the downsampleSeed polish parameter and the chunk's coordinates, so are the same
+ * for every run of the same job. With the downsampleByLocalDepth parameter reads are kept to bring each position down
+ * to intendedDepth, else uniformly to bring the chunk's average depth down to it.
+ */
 bool poorMansDownsample(int64_t intendedDepth, BamChunk *bamChunk, stList *reads, stList *alignments,
                         stList *filteredReads, stList *filteredAlignments, stList *discardedReads, stList *discardedAlignments);
 
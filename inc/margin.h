@@ -58,7 +58,10 @@ typedef struct _poaInsert PoaInsert;
 typedef struct _poaDelete PoaDelete;
 typedef struct _poaBaseObservation PoaBaseObservation;
 typedef struct _rleString RleString;
+typedef struct _bamChunkRead BamChunkRead;
 typedef struct _refMsaView MsaView;
+typedef struct _alignmentCache AlignmentCache;
+typedef struct _tupleArena TupleArena;
 /*
  * Combined params object
  */
@@ -78,6 +81,16 @@ struct _params {
 Params *params_readParams(char *paramsFile);
 Params *params_readParams2(char *paramsFile, bool requirePolish, bool requirePhase);
 
+/*
+ * Precompiled (binary) params files, accepted wherever a json params file is.
+ */
+
+void params_compileBinary(char *jsonParamsFile, char *binaryParamsFile);
+
+bool params_isBinary(char *paramsFile);
+
+Params *params_readBinary(char *paramsFile, bool requirePolish, bool requirePhase);
+
 void params_destruct(Params *params);
 
 void params_printParameters(Params *params, FILE *fh);
@@ -185,6 +198,16 @@ stProfileSeq *stProfileSeq_constructFromPosteriorProbs(char *refName, char *refS
 													   char *readId, char *readSeq, stList *anchorAlignment,
 													   Params *params);
 
+/*
+ * Builds the profile sequence of a read from its match and delete posterior probabilities to the reference, each a
+ * list of (prob, refPos, readPos) stIntTuples as computed by getAlignedPairsWithIndelsCroppingReference. Gives
+ * the same profile as stProfileSeq_constructFromPosteriorProbs for the same alignment, without realigning. The
+ * bases are read from the read one at a time, so a packed read is not unpacked.
+ */
+stProfileSeq *stProfileSeq_constructFromAlignedPairs(char *refName, int64_t refLength, char *readId,
+													 BamChunkRead *read, stList *matches, stList *deletes,
+													 Params *params);
+
 void stProfileSeq_destruct(stProfileSeq *seq);
 
 void stProfileSeq_print(stProfileSeq *seq, FILE *fileHandle, bool includeProbs);
@@ -386,6 +409,16 @@ stRPHmm *stRPHmm_fuse(stRPHmm *leftHmm, stRPHmm *rightHmm);
 
 void stRPHmm_forwardBackward(stRPHmm *hmm);
 
+/*
+ * The constituent passes of stRPHmm_forwardBackward, exposed so they can be timed separately.
+ * stRPHmm_forward must follow stRPHmm_initialiseProbs, and stRPHmm_backward must follow stRPHmm_forward.
+ */
+void stRPHmm_initialiseProbs(stRPHmm *hmm);
+
+void stRPHmm_forward(stRPHmm *hmm);
+
+void stRPHmm_backward(stRPHmm *hmm);
+
 void stRPHmm_prune(stRPHmm *hmm);
 
 void stRPHmm_print(stRPHmm *hmm, FILE *fileHandle, bool includeColumns, bool includeCells);
@@ -676,6 +709,9 @@ struct _polishParams {
 	uint64_t filterReadsWhileHaveAtLeastThisCoverage; // Only filter read substrings if we have at least this coverage
 	// at a locus
 	double minAvgBaseQuality; // Minimum average base quality to include a substring for consensus finding
+	bool packReadNucleotides; // Hold the chunk reads two bits to a base (see PackedNucleotides), to save memory
+	int64_t downsampleSeed; // Seed for downsampling, combined with each chunk's coordinates (see poorMansDownsample)
+	bool downsampleByLocalDepth; // Downsample to maxDepth at each position rather than on average over the chunk
 };
 
 PolishParams *polishParams_readParams(FILE *fileHandle);
@@ -749,6 +785,29 @@ void poa_augment(Poa *poa, char *read, bool readStrand, int64_t readNo, stList *
  */
 Poa *poa_realign(stList *bamChunkReads, stList *alignments, char *reference, PolishParams *polishParams);
 
+/*
+ * As poa_realign, but if readMatches (resp. readDeletes) is not NULL appends to it, for each read in order, the list of
+ * match (resp. delete) posterior probabilities of the read to the reference, as (prob, refPos, readPos) stIntTuples.
+ * The lists are owned by the caller; they can be used to build phasing profile sequences without realigning the reads,
+ * see stProfileSeq_constructFromAlignedPairs and phaseReadsFromPosteriors.
+ */
+Poa *poa_realign2(stList *bamChunkReads, stList *alignments, char *reference, PolishParams *polishParams,
+				  stList *readMatches, stList *readDeletes);
+
+/*
+ * As poa_realign, but reads with a name and an anchor alignment are looked up in, or added to, the given alignment
+ * cache. Gives the same poa as poa_realign.
+ */
+Poa *poa_realignCached(stList *bamChunkReads, stList *alignments, char *reference, PolishParams *polishParams,
+					   AlignmentCache *cache);
+
+/*
+ * Builds the poa that poa_realign would for the reads, from the match, insert and delete posteriors of each read to
+ * the reference, such as those recorded by poa_realignAllCached2, rather than by aligning the reads.
+ */
+Poa *poa_constructFromPosteriors(char *reference, stList *bamChunkReads, stList *readMatches, stList *readInserts,
+								 stList *readDeletes);
+
 /*
  * Generates a set of anchor alignments for the reads aligned to a consensus sequence derived from the poa.
  * These anchors can be used to restrict subsequent alignments to the consensus to generate a new poa.
@@ -759,6 +818,13 @@ Poa *poa_realign(stList *bamChunkReads, stList *alignments, char *reference, Pol
 stList *poa_getAnchorAlignments(Poa *poa, int64_t *poaToConsensusMap, int64_t noOfReads,
 							    PolishParams *polishParams);
 
+/*
+ * As poa_getAnchorAlignments, but if arena is not NULL the anchor pairs are made from the arena and the anchor
+ * alignments do not free them.
+ */
+stList *poa_getAnchorAlignments2(Poa *poa, int64_t *poaToConsensusMap, int64_t noOfReads,
+							     PolishParams *polishParams, TupleArena *arena);
+
 /*
  * Generates a set of maximal expected alignments for the reads aligned to the the POA reference sequence.
  * Unlike the draft anchor alignments, these are designed to be complete, high quality alignments.
@@ -826,6 +892,13 @@ Poa *poa_realignIterative3(Poa *poa, stList *bamChunkReads,
 						   PolishParams *polishParams, bool hmmMNotRealign,
 						   int64_t minIterations, int64_t maxIterations);
 
+/*
+ * As poa_realignIterative3, but sets iterations to the number of realignment cycles run.
+ */
+Poa *poa_realignIterative4(Poa *poa, stList *bamChunkReads,
+						   PolishParams *polishParams, bool hmmMNotRealign,
+						   int64_t minIterations, int64_t maxIterations, int64_t *iterations);
+
 /*
  * Convenience function that iteratively polishes sequence using poa_consensus and then poa_polish for
  * a specified number of iterations.
@@ -833,6 +906,24 @@ Poa *poa_realignIterative3(Poa *poa, stList *bamChunkReads,
 Poa *poa_realignAll(stList *bamChunkReads, stList *anchorAlignments, char *reference,
 						  PolishParams *polishParams);
 
+/*
+ * As poa_realignAll, but the initial alignment of each read to the reference is taken from the cache (see
+ * alignmentCache.h) where the read has an entry for its window, and added to it otherwise. The cache may be NULL.
+ */
+Poa *poa_realignAllCached(stList *bamChunkReads, stList *anchorAlignments, char *reference,
+						  PolishParams *polishParams, AlignmentCache *cache);
+
+/*
+ * As poa_realignAllCached, but if readMatches, readInserts and readDeletes are not NULL they are filled, for each read
+ * in order, with the list of posteriors of the read to the returned poa's reference, as (prob, refPos, readPos)
+ * stIntTuples. These are the posteriors the returned poa was built from, so they can be used to phase the reads or
+ * build poas of subsets of the reads (see poa_constructFromPosteriors) without aligning them again. The lists own their
+ * elements and must be constructed with stList_destruct as destructor.
+ */
+Poa *poa_realignAllCached2(stList *bamChunkReads, stList *anchorAlignments, char *reference,
+						   PolishParams *polishParams, AlignmentCache *cache,
+						   stList *readMatches, stList *readInserts, stList *readDeletes);
+
 /*
  * Greedily evaluate the top scoring indels.
  */
@@ -893,6 +984,26 @@ RleString *rleString_construct(char *string);
 RleString *rleString_constructNoRLE(char *str);
 RleString *rleString_constructPreComputed(char *rleChars, uint8_t *rleCounts);
 
+/*
+ * As rleString_constructPreComputed, but fills an existing rle string, reusing its buffers. rleCapacity and
+ * nonRleCapacity are the allocated lengths of its RLE and non-RLE buffers, 0 for a zeroed rle string, and are updated
+ * when the buffers are grown. Buffers are only grown, so refilling the same rle string rarely allocates.
+ */
+void rleString_refillPreComputed(RleString *rleString, char *rleChars, uint8_t *rleCounts,
+								 int64_t *rleCapacity, int64_t *nonRleCapacity);
+
+/*
+ * As rleString_construct, or rleString_constructNoRLE if runLengthEncode is false, for the nucleotides of a read.
+ * The bases are read one at a time, so a packed read is not unpacked.
+ */
+RleString *rleString_constructFromRead(BamChunkRead *read, bool runLengthEncode);
+
+/*
+ * Frees the coordinate maps of an RLE string once its alignment has been run-length encoded. The repeat counts and
+ * RLE string are kept. Used with packReadNucleotides, where the maps are most of the memory of a chunk's reads.
+ */
+void rleString_discardCoordinateMaps(RleString *rleString);
+
 void rleString_destruct(RleString *rlString);
 
 /*
@@ -953,6 +1064,34 @@ RleString *expandRLEConsensus(Poa *poa, stList *rlReads, stList *bamChunkReads,
 stList *runLengthEncodeAlignment(stList *alignment, RleString *seqX, RleString *seqY);
 stList *runLengthEncodeAlignment2(stList *alignment, RleString *seqX, RleString *seqY,
 								  int64_t xIdx, int64_t yIdx, int64_t weightIdx);
+/*
+ * As runLengthEncodeAlignment2, but if arena is not NULL the aligned pairs are made from the arena and the returned
+ * list does not free them.
+ */
+stList *runLengthEncodeAlignment3(stList *alignment, RleString *seqX, RleString *seqY,
+								  int64_t xIdx, int64_t yIdx, int64_t weightIdx, TupleArena *arena);
+
+/*
+ * Contiguous storage for the three-value stIntTuples of alignments: aligned pairs from a bam, their run-length encoded
+ * forms and anchor pairs. A deep chunk has tens of millions of these, which made one at a time means as many mallocs
+ * and frees. Tuples from an arena are laid out as stIntTuples so can be used wherever those are, but they are only
+ * freed, all together, by tupleArena_destruct; lists holding them must not have stIntTuple_destruct as destructor.
+ * An arena is not thread safe. The match, insert and delete posteriors are not pooled: the pairwise aligner, in
+ * cPecan, makes each of them as its own stIntTuple.
+ */
+TupleArena *tupleArena_construct();
+void tupleArena_destruct(TupleArena *arena);
+
+/*
+ * Returns a new tuple of the three values.
+ */
+stIntTuple *tupleArena_getTuple3(TupleArena *arena, int64_t value1, int64_t value2, int64_t value3);
+
+/*
+ * Number of tuples made from the arena, and number of blocks they were allocated in.
+ */
+int64_t tupleArena_getTupleNumber(TupleArena *arena);
+int64_t tupleArena_getBlockNumber(TupleArena *arena);
 /*
  * Make edited string with given insert. Edit start is the index of the position to insert the string.
  */
@@ -971,6 +1110,15 @@ void getAlignedPairsWithIndelsCroppingReference(char *reference, int64_t refLeng
 		char *read, stList *anchorPairs,
 		stList **matches, stList **inserts, stList **deletes, PolishParams *polishParams);
 
+/*
+ * As getAlignedPairsWithIndelsCroppingReference, but if cache and readId are not NULL the posteriors are taken from
+ * the cache when it has them for the cropped reference, read and anchors, and added to it when it does not.
+ */
+void getAlignedPairsWithIndelsCroppingReference2(char *reference, int64_t refLength,
+		char *read, stList *anchorPairs,
+		stList **matches, stList **inserts, stList **deletes, PolishParams *polishParams,
+		AlignmentCache *cache, char *readId);
+
 /*
  * Functions for processing BAMs
  */
@@ -980,6 +1128,7 @@ void getAlignedPairsWithIndelsCroppingReference(char *reference, int64_t refLeng
 typedef struct _bamChunker {
     // file locations
     char *bamFile;
+    stList *extraBamFiles;    // further bams, whose reads are polished with those of bamFile as if merged into it
     // configuration
     uint64_t chunkSize;
     uint64_t chunkBoundary;
@@ -998,23 +1147,81 @@ typedef struct _bamChunk {
     int64_t chunkEnd;          // same for chunk end
     int64_t chunkBoundaryEnd;    // no reads should start after this position
     BamChunker *parent;        // reference to parent (may not be needed)
+    char *regionName;          // the BED interval the chunk is from, as contig:start-end, NULL if not chunked by BED
 } BamChunk;
 
-typedef struct _bamChunkRead {
+/*
+ * A nucleotide string packed two bits to a base. Positions holding anything other than A, C, G or T (N and the other
+ * ambiguity codes, lower case bases) are set in a mask and their characters kept aside, so unpacking gives back the
+ * original string exactly.
+ */
+typedef struct _packedNucleotides {
+	int64_t length;
+	uint8_t *bases;				// four bases to a byte, A=0, C=1, G=2, T=3, the first base in the low bits
+	uint64_t *mask;				// one bit per base, set where the base is masked, NULL if no base is masked
+	int64_t maskedLength;		// the number of masked bases
+	int64_t *maskedPositions;	// the positions of the masked bases, in increasing order
+	char *maskedBases;			// the characters at the masked positions
+} PackedNucleotides;
+
+PackedNucleotides *packedNucleotides_construct(char *nucleotides);
+void packedNucleotides_destruct(PackedNucleotides *packed);
+
+/*
+ * Returns the character at the given position.
+ */
+char packedNucleotides_get(PackedNucleotides *packed, int64_t i);
+
+/*
+ * Returns a new string of the length characters from start.
+ */
+char *packedNucleotides_getSubstring(PackedNucleotides *packed, int64_t start, int64_t length);
+
+char *packedNucleotides_unpack(PackedNucleotides *packed);
+
+/*
+ * Bytes held by the packed string.
+ */
+int64_t packedNucleotides_getMemory(PackedNucleotides *packed);
+
+struct _bamChunkRead {
 	char *readName;          	// read name
-	char *nucleotides;			// nucleotide string
+	char *nucleotides;			// nucleotide string, NULL if the read is packed
+	PackedNucleotides *packedNucleotides; // the nucleotides packed, NULL unless the read is packed
 	int64_t readLength;
 	uint8_t *qualities;			// quality scores. will be NULL if not given, else will be of length readLength
 	bool forwardStrand;			// whether the alignment is matched to the forward strand
 	BamChunk *parent;        	// reference to parent chunk
-} BamChunkRead;
+};
 
 
 BamChunkRead *bamChunkRead_construct();
 BamChunkRead *bamChunkRead_construct2(char *readName, char *nucleotides, uint8_t *qualities, bool forwardStrand, BamChunk *parent);
+/*
+ * Sets the fields of an existing read as bamChunkRead_construct2 does, without freeing what it held.
+ */
+void bamChunkRead_refill(BamChunkRead *r, char *readName, char *nucleotides, uint8_t *qualities, bool forwardStrand,
+                         BamChunk *parent);
+/*
+ * Copy of the read with the run length encoded nucleotides and qualities, packed if the read is packed.
+ */
 BamChunkRead *bamChunkRead_constructRLECopy(BamChunkRead  *read, RleString *rle);
 void bamChunkRead_destruct(BamChunkRead *bamChunkRead);
 
+/*
+ * Replaces the nucleotides of the read with their packed form.
+ */
+void bamChunkRead_pack(BamChunkRead *read);
+
+/*
+ * Returns the nucleotides of the read, unpacking them if the read is packed. The string must be given back with
+ * bamChunkRead_releaseNucleotides, which frees it if it was unpacked.
+ */
+char *bamChunkRead_getNucleotides(BamChunkRead *read);
+void bamChunkRead_releaseNucleotides(BamChunkRead *read, char *nucleotides);
+
+char bamChunkRead_getBase(BamChunkRead *read, int64_t i);
+
 /*
  * Remove overlap between two overlapping strings. Returns max weight of split point.
  */
@@ -1100,6 +1307,14 @@ void msaView_printRepeatCounts(MsaView *view, int64_t minInsertCoverage,
 void phaseReads(char *reference, int64_t referenceLength, stList *reads, stList *anchorAlignments,
 				stList **readsPartition1, stList **readsPartition2, Params *params);
 
+/*
+ * As phaseReads, but reuses the per-read match and delete posteriors recorded by poa_realign2 or poa_realignAllCached2
+ * rather than realigning the reads. Gives the same partition as phaseReads given the anchor alignments the posteriors
+ * were computed with.
+ */
+void phaseReadsFromPosteriors(int64_t referenceLength, stList *reads, stList *readMatches, stList *readDeletes,
+							  stList **readsPartition1, stList **readsPartition2, Params *params);
+
 /*
  * For logging while multithreading
  */
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef MARGINPHASE_TRACEWRITER_H
+#define MARGINPHASE_TRACEWRITER_H
+
+#include "margin.h"
+
+/*
+ * Writes begin/end events for chunk pipeline stages as Chrome trace-event JSON, viewable in chrome://tracing or
+ * Perfetto. Events from all threads go to the one file, tagged with the thread number. All functions accept a NULL
+ * writer and do nothing, so tracing costs a branch per stage when it is disabled.
+ */
+typedef struct _traceWriter TraceWriter;
+
+/*
+ * Opens the trace file, aborting if it can not be written.
+ */
+TraceWriter *traceWriter_construct(char *traceFile);
+
+/*
+ * Completes the JSON document and closes the file.
+ */
+void traceWriter_destruct(TraceWriter *trace);
+
+/*
+ * Records the start and end of a stage. bamChunk may be NULL for stages not specific to a chunk, in which case
+ * chunkIdx is ignored. readCount is omitted if negative.
+ */
+void traceWriter_begin(TraceWriter *trace, char *stage, int64_t chunkIdx, BamChunk *bamChunk, int64_t readCount);
+
+void traceWriter_end(TraceWriter *trace, char *stage, int64_t chunkIdx, BamChunk *bamChunk, int64_t readCount);
+
+#endif //MARGINPHASE_TRACEWRITER_H
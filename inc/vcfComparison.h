@@ -52,11 +52,30 @@ struct _stGenotypeResults {
 typedef struct _stGenotypeResults stGenotypeResults;
 void printGenotypeResults(stGenotypeResults *results);
 
+/*
+ * _stPhasedFragment
+ * The path, genome fragment and read bipartition computed for an hmm, so that they can be reused
+ * by compareVCFs rather than recomputed.
+ */
+struct _stPhasedFragment {
+    stRPHmm *hmm; // not owned
+    stList *path;
+    stGenomeFragment *gF;
+    stSet *reads1;
+    stSet *reads2;
+};
+typedef struct _stPhasedFragment stPhasedFragment;
+
+stPhasedFragment *stPhasedFragment_construct(stRPHmm *hmm, stList *path, stGenomeFragment *gF,
+                                             stSet *reads1, stSet *reads2);
+stPhasedFragment *stPhasedFragment_constructFromHmm(stRPHmm *hmm);
+void stPhasedFragment_destruct(stPhasedFragment *pF);
+
 /*
  * VCF comparison methods
  */
 
-void compareVCFs(FILE *fh, stList *hmms, char *vcf_toEval, char *vcf_ref,
+void compareVCFs(FILE *fh, stList *hmms, stList *phasedFragments, char *vcf_toEval, char *vcf_ref,
                  stBaseMapper *baseMapper, stGenotypeResults *results, stRPHmmParameters *params);
 
 void compareVCFsBasic(FILE *fh, char *vcf_toEval, char *vcf_ref, stGenotypeResults *results);
@@ -203,7 +203,7 @@ void usage() {
 
     fprintf(stderr, "\nRequired arguments:\n");
     fprintf(stderr, "    BAM is the alignment of reads.  All reads must be aligned to the same contig \n");
-    fprintf(stderr, "        and be in bam format.\n");
+    fprintf(stderr, "        and be in bam or cram format.  A cram is decoded against REFERENCE_FASTA.\n");
     fprintf(stderr, "    REFERENCE_FASTA is the reference sequence for the BAM's contig in fasta format.\n");
     fprintf(stderr, "    PARAMS is the file with marginPhase parameters.\n");
 
@@ -334,6 +334,7 @@ int main(int argc, char *argv[]) {
     }
 
     // Parse reads for interval
+    setCramReferenceFasta(referenceFastaFile);
     st_logInfo("> Parsing input reads from file: %s\n", bamInFile);
     stList *profileSequences = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
     int64_t readCount = 0;
@@ -454,6 +455,13 @@ int main(int argc, char *argv[]) {
         hdr2 = writeVcfHeader(vcfOutFP_all, hmms, referenceFastaFile);
     }
 
+    // The genome fragments are kept for the vcf comparison if it will print them
+    stList *phasedFragments = NULL;
+    if (referenceVCF != NULL && (params->verboseTruePositives || params->verboseFalsePositives ||
+                                 params->verboseFalseNegatives)) {
+        phasedFragments = stList_construct3(0, (void (*)(void *)) stPhasedFragment_destruct);
+    }
+
     // For each read partitioning HMM
     for(int64_t i=0; i<stList_length(hmms); i++) {
         stRPHmm *hmm = stList_get(hmms, i);
@@ -475,31 +483,34 @@ int main(int argc, char *argv[]) {
         // Only one haplotype found (likely a small set of reads)
         if (stSet_size(reads1) < 1 || stSet_size(reads2) < 1) {
             populateReadHaplotypePartitionTable(readHaplotypePartitions, gF, hmm, path);
-            continue;
-        }
-
-        // Refine the genome fragment by repartitoning the reads iteratively
-        if(params->roundsOfIterativeRefinement > 0) {
-            stGenomeFragment_refineGenomeFragment(gF, reads1, reads2, hmm, path, params->roundsOfIterativeRefinement);
-        }
+        } else {
+            // Refine the genome fragment by repartitoning the reads iteratively
+            if(params->roundsOfIterativeRefinement > 0) {
+                stGenomeFragment_refineGenomeFragment(gF, reads1, reads2, hmm, path, params->roundsOfIterativeRefinement);
+            }
 
-        // save bipartition
-        populateReadHaplotypePartitionTable(readHaplotypePartitions, gF, hmm, path);
+            // save bipartition
+            populateReadHaplotypePartitionTable(readHaplotypePartitions, gF, hmm, path);
 
-        // Log information about the hmm
-        logHmm(hmm, reads1, reads2, gF);
+            // Log information about the hmm
+            logHmm(hmm, reads1, reads2, gF);
 
-        // Write two vcfs, one using the reference fasta file and one not
-        writeVcfFragment(vcfOutFP, hdr, gF, referenceFastaFile, baseMapper, false);
-        if (params->writeGVCF) {
-            writeVcfFragment(vcfOutFP_all, hdr2, gF, referenceFastaFile, baseMapper, true);
+            // Write two vcfs, one using the reference fasta file and one not
+            writeVcfFragment(vcfOutFP, hdr, gF, referenceFastaFile, baseMapper, false);
+            if (params->writeGVCF) {
+                writeVcfFragment(vcfOutFP_all, hdr2, gF, referenceFastaFile, baseMapper, true);
+            }
         }
 
-        // Cleanup
-        stGenomeFragment_destruct(gF);
-        stSet_destruct(reads1);
-        stSet_destruct(reads2);
-        stList_destruct(path);
+        // Keep for the comparison or cleanup
+        if (phasedFragments != NULL) {
+            stList_append(phasedFragments, stPhasedFragment_construct(hmm, path, gF, reads1, reads2));
+        } else {
+            stGenomeFragment_destruct(gF);
+            stSet_destruct(reads1);
+            stSet_destruct(reads2);
+            stList_destruct(path);
+        }
     }
 
     // Cleanup vcf
@@ -524,7 +535,7 @@ int main(int argc, char *argv[]) {
         } else {
             // Compare the output vcf with the reference vcf
             stGenotypeResults *results = st_calloc(1, sizeof(stGenotypeResults));
-            compareVCFs(stderr, hmms, vcfOutFile, referenceVCF, baseMapper, results, params);
+            compareVCFs(stderr, hmms, phasedFragments, vcfOutFile, referenceVCF, baseMapper, results, params);
             printGenotypeResults(results);
             free(results);
         }
@@ -542,6 +553,7 @@ int main(int argc, char *argv[]) {
         writeHaplotypedSam(bamInFile, outputBase, readHaplotypePartitions, marginPhaseTag);
     }
 
+    if (phasedFragments != NULL) stList_destruct(phasedFragments);
     stList_destruct(profileSequences);
     stReadHaplotypePartitionTable_destruct(readHaplotypePartitions);
     stList_destruct(hmms);
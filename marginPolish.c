@@ -13,11 +13,19 @@
 #include <omp.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <errno.h>
 
 #include "marginVersion.h"
 #include "margin.h"
 #include "htsIntegration.h"
 #include "helenFeatures.h"
+#include "traceWriter.h"
+#include "chunkReport.h"
+#include "alignmentCache.h"
 
 
 /*
@@ -26,11 +34,14 @@
 
 void usage() {
     fprintf(stderr, "usage: marginPolish <BAM_FILE> <ASSEMBLY_FASTA> <PARAMS> [options]\n");
+    fprintf(stderr, "       marginPolish --serve <SOCKET> <PARAMS> [options]\n");
     fprintf(stderr, "Version: %s \n\n", MARGIN_POLISH_VERSION_H);
     fprintf(stderr, "Polishes the ASSEMBLY_FASTA using alignments in BAM_FILE.\n");
 
     fprintf(stderr, "\nRequired arguments:\n");
-    fprintf(stderr, "    BAM_FILE is the alignment of reads to the assembly (or reference).\n");
+    fprintf(stderr, "    BAM_FILE is the alignment of reads to the assembly (or reference).  Several BAMs may be given\n");
+    fprintf(stderr, "      separated by commas, their reads are polished as if the BAMs were merged.  CRAM files are\n");
+    fprintf(stderr, "      decoded against ASSEMBLY_FASTA.\n");
     fprintf(stderr, "    ASSEMBLY_FASTA is the reference sequence BAM file in fasta format.\n");
     fprintf(stderr, "    PARAMS is the file with marginPolish parameters.\n");
 
@@ -43,34 +54,1316 @@ void usage() {
     fprintf(stderr, "    -o --outputBase          : Name to use for output files [default = 'output']\n");
     fprintf(stderr, "    -r --region              : If set, will only compute for given chromosomal region.\n");
     fprintf(stderr, "                                 Format: chr:start_pos-end_pos (chr3:2000-3000).\n");
+    fprintf(stderr, "    -b --regionBed           : If set, will only compute for the intervals in this BED file, writing\n");
+    fprintf(stderr, "                               a sequence named chr:start_pos-end_pos for each interval.\n");
+    fprintf(stderr, "    -d --diploid             : Also phase the reads of each chunk and polish each haplotype from\n");
+    fprintf(stderr, "                               its own reads, writing OUTPUT_BASE.hap1.fa and OUTPUT_BASE.hap2.fa\n");
+    fprintf(stderr, "    -P --previousPolish      : Polished fasta of an earlier version of ASSEMBLY_FASTA.  With -E, only\n");
+    fprintf(stderr, "                               the chunks overlapping the edited intervals (and their neighbours)\n");
+    fprintf(stderr, "                               are polished again and spliced into this sequence [default = NULL]\n");
+    fprintf(stderr, "    -E --editedRegions       : BED file of the intervals of ASSEMBLY_FASTA edited since the previous\n");
+    fprintf(stderr, "                               polish given with -P [default = NULL]\n");
 
-    # ifdef _HDF5
     fprintf(stderr, "\nHELEN feature generation options:\n");
     fprintf(stderr, "    -f --produceFeatures     : output features for HELEN.\n");
     fprintf(stderr, "    -F --featureType         : output features of chunks for HELEN.  Valid types:\n");
     fprintf(stderr, "                                 splitRleWeight:  [default] run lengths split into chunks\n");
     fprintf(stderr, "                                 simpleWeight:    weighted likelihood from POA nodes (non-RLE)\n");
     fprintf(stderr, "    -L --splitRleWeightMaxRL : max run length (for 'splitRleWeight' type only) [default = %d]\n", POAFEATURE_SPLIT_MAX_RUN_LENGTH_DEFAULT);
+    fprintf(stderr, "    -H --singleFeatureFile   : write 'splitRleWeight' features to one OUTPUT_BASE.h5 from a writer\n");
+    fprintf(stderr, "                               thread, as chunked, compressed datasets with a window index, rather\n");
+    fprintf(stderr, "                               than a group of datasets per window in a file per thread\n");
+    fprintf(stderr, "    -N --npyFeatures         : write 'splitRleWeight' features of each chunk as NumPy arrays with a\n");
+    fprintf(stderr, "                               JSON manifest in the directory OUTPUT_BASE.features, written by\n");
+    fprintf(stderr, "                               each thread independently, needing no HDF5\n");
     fprintf(stderr, "    -u --trueReferenceBam    : true reference aligned to ASSEMBLY_FASTA, for HELEN\n");
     fprintf(stderr, "                               features.  Setting this parameter will include labels\n");
     fprintf(stderr, "                               in output.\n");
+
+    fprintf(stderr, "\nServer mode:\n");
+    fprintf(stderr, "    --serve SOCKET loads PARAMS once and serves polish requests on the Unix domain socket\n");
+    fprintf(stderr, "    SOCKET.  Each connection sends one tab-separated line 'BAM_FILE<TAB>ASSEMBLY_FASTA<TAB>REGION'\n");
+    fprintf(stderr, "    (REGION may be empty to polish everything, BAM_FILE may list several comma-separated bams)\n");
+    fprintf(stderr, "    and receives the polished FASTA, identical to\n");
+    fprintf(stderr, "    the output of the one-shot command, or a line starting 'ERROR'.  Each request is polished\n");
+    fprintf(stderr, "    in its own process, so one that fails gets an ERROR line and the server carries on.\n");
+    fprintf(stderr, "    Sending 'SHUTDOWN' stops the server.  Only the -a and -t options apply in server mode.\n");
+
+    fprintf(stderr, "\nMiscellaneous supplementary output options:\n");
+    fprintf(stderr, "    -i --outputRepeatCounts  : Output base to write out the repeat counts [default = NULL]\n");
+    fprintf(stderr, "    -j --outputPoaTsv        : Output base to write out the poa as TSV file [default = NULL]\n");
+    fprintf(stderr, "    -T --traceFile           : Write begin/end events for each chunk and stage to this file, in\n");
+    fprintf(stderr, "                               Chrome trace-event JSON format [default = NULL]\n");
+    fprintf(stderr, "    -R --chunkReport         : Write a tab separated report of reads, POA size, time per stage and\n");
+    fprintf(stderr, "                               memory for each chunk to this file, with a line as each chunk and\n");
+    fprintf(stderr, "                               stage starts. Memory is for the whole process [default = NULL]\n");
+    fprintf(stderr, "    -A --alignmentCache      : Directory in which to cache read alignments between runs, so reads\n");
+    fprintf(stderr, "                               whose chunk, window and anchors are unchanged are not realigned.\n");
+    fprintf(stderr, "                               Only the first round, aligning reads to the draft, is cached; later\n");
+    fprintf(stderr, "                               rounds of each chunk always realign. Chunks after an edit to a\n");
+    fprintf(stderr, "                               contig of the draft mostly miss. The hit rate is logged.\n");
+    fprintf(stderr, "                               The output is the same as without the cache [default = NULL]\n");
+    fprintf(stderr, "\n");
+}
+
+char *getFileBase(char *base, char *defawlt) {
+    struct stat fileStat;
+    int64_t rc = stat(base, &fileStat);
+    if (S_ISDIR(fileStat.st_mode)) {
+        if (optarg[strlen(base) - 1] == '/') optarg[strlen(base) - 1] = '\0';
+        return stString_print("%s/%s", base, defawlt);
+    } else {
+        return stString_copy(base);
+    }
+}
+
+
+/*
+ * Optional per chunk outputs, none of which are produced in server mode
+ */
+typedef struct _polishOutputOptions {
+    char *outputBase;
+    char *outputRepeatCountBase;
+    char *outputPoaTsvBase;
+    HelenFeatureType helenFeatureType;
+    BamChunker *trueReferenceBamChunker;
+    char *trueReferenceBam;
+    int64_t splitWeightMaxRunLength;
+    void **splitWeightHDF5Files;
+    void *splitWeightHDF5Writer; // NULL unless writing features to a single file
+    char *splitWeightNpyDir; // NULL unless writing features as NumPy arrays
+    bool fullFeatureOutput;
+    TraceWriter *trace; // NULL unless tracing
+    ChunkReportWriter *chunkReportWriter; // NULL unless reporting
+    bool diploid; // polish each haplotype separately too
+    char *alignmentCacheDir; // NULL unless caching alignments
+    uint64_t paramsFingerprint; // of the params file, to invalidate the alignment cache
+    bool featuresWritten; // set FALSE by any chunk whose HELEN features could not be written
+    int64_t alignmentCacheHits; // read alignments reused from the alignment cache, summed over chunks
+    int64_t alignmentCacheLookups; // read alignments looked up in the alignment cache, summed over chunks
+} PolishOutputOptions;
+
+/*
+ * Per chunk output of diploid polishing
+ */
+typedef struct _diploidChunkResult {
+    char *polishedHaplotypes[2]; // polished sequence of each haplotype
+    stSet *haplotypeReadNames[2]; // names of the reads assigned to each haplotype, used to phase adjacent chunks
+} DiploidChunkResult;
+
+static void startChunkStage(PolishOutputOptions *options, ChunkReport *report, ChunkStage stage, int64_t chunkIdx,
+                            BamChunk *bamChunk, int64_t readCount) {
+    traceWriter_begin(options->trace, chunkStage_getName(stage), chunkIdx, bamChunk, readCount);
+    if (report != NULL) {
+        chunkReportWriter_write(options->chunkReportWriter, report, chunkStage_getName(stage));
+        chunkReport_startStage(report, stage);
+    }
+}
+
+static void endChunkStage(PolishOutputOptions *options, ChunkReport *report, ChunkStage stage, int64_t chunkIdx,
+                          BamChunk *bamChunk, int64_t readCount) {
+    if (report != NULL) {
+        chunkReport_endStage(report, stage);
+    }
+    traceWriter_end(options->trace, chunkStage_getName(stage), chunkIdx, bamChunk, readCount);
+}
+
+stHash *parseReferenceSequences(char *referenceFastaFile) {
+    // Parse reference as map of header string to nucleotide sequences
+    st_logInfo("> Parsing reference sequences from file: %s\n", referenceFastaFile);
+    FILE *fh = fopen(referenceFastaFile, "r");
+    stHash *referenceSequences = fastaReadToMap(fh);  //valgrind says blocks from this allocation are "still reachable"
+    fclose(fh);
+    // log names and transform (if necessary)
+    stList *refSeqNames = stHash_getKeys(referenceSequences);
+    int64_t origRefSeqLen = stList_length(refSeqNames);
+    st_logDebug("\tReference contigs: \n");
+    for (int64_t i = 0; i < origRefSeqLen; ++i) {
+        char *fullRefSeqName = (char *) stList_get(refSeqNames, i);
+        st_logDebug("\t\t%s\n", fullRefSeqName);
+        char refSeqName[128] = "";
+        if (sscanf(fullRefSeqName, "%s", refSeqName) == 1 && !stString_eq(fullRefSeqName, refSeqName)) {
+            // this transformation is necessary for cases where the reference has metadata after the contig name:
+            // >contig001 length=1000 date=1999-12-31
+            char *newKey = stString_copy(refSeqName);
+            char *refSeq = stHash_search(referenceSequences, fullRefSeqName);
+            stHash_insert(referenceSequences, newKey, refSeq);
+            stHash_removeAndFreeKey(referenceSequences, fullRefSeqName);
+            st_logDebug("\t\t\t-> %s\n", newKey);
+        }
+    }
+    stList_destruct(refSeqNames);
+
+    return referenceSequences;
+}
+
+static Poa *realignHaplotype(Poa *poa, stList *reads, PolishParams *polishParams, int64_t *rounds) {
+    /*
+     * Runs the rounds of consensus finding and realignment polishing that polishParams configures for the haploid
+     * POA on the POA of a haplotype, which is destroyed, setting rounds to the number of realignment rounds run.
+     */
+    if (polishParams->maxPoaConsensusIterations > 0) {
+        poa = poa_realignIterative3(poa, reads, polishParams, 1, polishParams->minPoaConsensusIterations,
+                                    polishParams->maxPoaConsensusIterations);
+    }
+    return poa_realignIterative4(poa, reads, polishParams, 0, polishParams->minRealignmentPolishIterations,
+                                 polishParams->maxRealignmentPolishIterations, rounds);
+}
+
+static void polishHaplotypes(Poa *poa, stList *rleReads, stList *rleNucleotides, stList *readMatches,
+                             stList *readInserts, stList *readDeletes, char *polishedConsensusString, Params *params,
+                             char *logIdentifier, DiploidChunkResult *diploidResult) {
+    /*
+     * Partitions the reads between two haplotypes and polishes each haplotype, starting from the haploid consensus of
+     * the poa, using only its own reads and the rounds of realignment the haploid polish is configured with. The
+     * reads are not aligned to the haploid consensus again: the posteriors the poa was built from (see
+     * poa_realignAllCached2) are used both to phase and to build the poa of each haplotype.
+     */
+    for (int64_t h = 0; h < 2; h++) {
+        diploidResult->haplotypeReadNames[h] = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, free);
+        diploidResult->polishedHaplotypes[h] = NULL;
+    }
+    int64_t readCount = stList_length(rleReads);
+    if (readCount < 2) {
+        // nothing to phase
+        diploidResult->polishedHaplotypes[0] = stString_copy(polishedConsensusString);
+        diploidResult->polishedHaplotypes[1] = stString_copy(polishedConsensusString);
+        return;
+    }
+
+    // Phase
+    stList *readsPartition1, *readsPartition2;
+    phaseReadsFromPosteriors(stList_length(poa->nodes) - 1, rleReads, readMatches, readDeletes,
+                             &readsPartition1, &readsPartition2, params);
+    stSet *haplotype1Reads = stList_getSet(readsPartition1);
+
+    // Split the reads, run lengths and posteriors by haplotype, keeping the read order
+    stList *haplotypeReads[2], *haplotypeNucleotides[2], *haplotypeMatches[2], *haplotypeInserts[2],
+            *haplotypeDeletes[2];
+    for (int64_t h = 0; h < 2; h++) {
+        haplotypeReads[h] = stList_construct();
+        haplotypeNucleotides[h] = stList_construct();
+        haplotypeMatches[h] = stList_construct();
+        haplotypeInserts[h] = stList_construct();
+        haplotypeDeletes[h] = stList_construct();
+    }
+    for (int64_t i = 0; i < readCount; i++) {
+        BamChunkRead *read = stList_get(rleReads, i);
+        int64_t h = stSet_search(haplotype1Reads, read) != NULL ? 0 : 1;
+        stList_append(haplotypeReads[h], read);
+        stList_append(haplotypeNucleotides[h], stList_get(rleNucleotides, i));
+        stList_append(haplotypeMatches[h], stList_get(readMatches, i));
+        stList_append(haplotypeInserts[h], stList_get(readInserts, i));
+        stList_append(haplotypeDeletes[h], stList_get(readDeletes, i));
+        if (read->readName != NULL) {
+            stSet_insert(diploidResult->haplotypeReadNames[h], stString_copy(read->readName));
+        }
+    }
+
+    // Polish each haplotype
+    for (int64_t h = 0; h < 2; h++) {
+        st_logInfo(">%s Polishing haplotype %"PRId64" with %"PRId64" reads\n", logIdentifier, h + 1,
+                   stList_length(haplotypeReads[h]));
+        if (stList_length(haplotypeReads[h]) == 0) {
+            diploidResult->polishedHaplotypes[h] = stString_copy(polishedConsensusString);
+            continue;
+        }
+        int64_t rounds;
+        Poa *haplotypePoa = realignHaplotype(poa_constructFromPosteriors(poa->refString, haplotypeReads[h],
+                                                                         haplotypeMatches[h], haplotypeInserts[h],
+                                                                         haplotypeDeletes[h]),
+                                             haplotypeReads[h], params->polishParams, &rounds);
+        st_logInfo(">%s Polished haplotype %"PRId64" in %"PRId64" rounds of realignment\n", logIdentifier, h + 1,
+                   rounds);
+        RleString *polishedRleHaplotype = expandRLEConsensus(haplotypePoa, haplotypeNucleotides[h],
+                                                             haplotypeReads[h], params->polishParams->repeatSubMatrix);
+        diploidResult->polishedHaplotypes[h] = rleString_expand(polishedRleHaplotype);
+        rleString_destruct(polishedRleHaplotype);
+        poa_destruct(haplotypePoa);
+    }
+
+    // Cleanup
+    for (int64_t h = 0; h < 2; h++) {
+        stList_destruct(haplotypeReads[h]);
+        stList_destruct(haplotypeNucleotides[h]);
+        stList_destruct(haplotypeMatches[h]);
+        stList_destruct(haplotypeInserts[h]);
+        stList_destruct(haplotypeDeletes[h]);
+    }
+    stSet_destruct(haplotype1Reads);
+    stList_destruct(readsPartition1);
+    stList_destruct(readsPartition2);
+}
+
+char *polishChunk(BamChunker *bamChunker, int64_t chunkIdx, stHash *referenceSequences, Params *params,
+                  PolishOutputOptions *options, DiploidChunkResult *diploidResult) {
+    /*
+     * Polishes a single chunk, returning the polished sequence or NULL if the chunk's reference sequence is missing.
+     * If diploidResult is not NULL the haplotypes of the chunk are also polished into it.
+     */
+
+    // Time all chunks
+    time_t start = time(NULL);
+
+    // Get chunk
+    BamChunk *bamChunk = bamChunker_getChunk(bamChunker, chunkIdx);
+    traceWriter_begin(options->trace, "chunk", chunkIdx, bamChunk, -1);
+    ChunkReport chunkReport;
+    ChunkReport *report = NULL;
+    if (options->chunkReportWriter != NULL) {
+        report = &chunkReport;
+        chunkReport_start(report, chunkIdx, bamChunk);
+        chunkReportWriter_write(options->chunkReportWriter, report, "started");
+    }
+    char *logIdentifier;
+    # ifdef _OPENMP
+    logIdentifier = stString_print(" T%02d_C%05"PRId64, omp_get_thread_num(), chunkIdx);
+    # else
+    logIdentifier = stString_copy("");
     # endif
 
-    fprintf(stderr, "\nMiscellaneous supplementary output options:\n");
-    fprintf(stderr, "    -i --outputRepeatCounts  : Output base to write out the repeat counts [default = NULL]\n");
-    fprintf(stderr, "    -j --outputPoaTsv        : Output base to write out the poa as TSV file [default = NULL]\n");
-    fprintf(stderr, "\n");
+    // Get reference string for chunk of alignment
+    char *fullReferenceString = stHash_search(referenceSequences, bamChunk->refSeqName);
+    if (fullReferenceString == NULL) {
+        st_logCritical("> ERROR: Reference sequence missing from reference map: %s \n", bamChunk->refSeqName);
+        free(logIdentifier);
+        traceWriter_end(options->trace, "chunk", chunkIdx, bamChunk, -1);
+        return NULL;
+    }
+    int64_t fullRefLen = strlen(fullReferenceString);
+    assert(bamChunk->chunkBoundaryStart <= fullRefLen);
+    char *referenceString = stString_getSubString(fullReferenceString, bamChunk->chunkBoundaryStart,
+                                                  (fullRefLen < bamChunk->chunkBoundaryEnd ? fullRefLen
+                                                                                       : bamChunk->chunkBoundaryEnd) -
+                                                  bamChunk->chunkBoundaryStart);
+
+
+    st_logInfo(">%s Going to process a chunk for reference sequence: %s, starting at: %i and ending at: %i\n",
+               logIdentifier, bamChunk->refSeqName, (int) bamChunk->chunkBoundaryStart,
+               (int) (fullRefLen < bamChunk->chunkBoundaryEnd ? fullRefLen : bamChunk->chunkBoundaryEnd));
+
+    // Convert bam lines into corresponding reads and alignments
+    st_logInfo(">%s Parsing input reads from file: %s%s\n", logIdentifier, bamChunker->bamFile,
+               stList_length(bamChunker->extraBamFiles) > 0 ? " (and further bams)" : "");
+    stList *reads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
+    stList *alignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    TupleArena *alignmentArena = tupleArena_construct(); // holds the aligned pairs of alignments
+    startChunkStage(options, report, CHUNK_STAGE_PARSE_READS, chunkIdx, bamChunk, -1);
+    convertToReadsAndAlignments2(bamChunk, reads, alignments, alignmentArena);
+    endChunkStage(options, report, CHUNK_STAGE_PARSE_READS, chunkIdx, bamChunk, stList_length(reads));
+    if (report != NULL) {
+        report->readsIn = stList_length(reads);
+    }
+
+    // do downsampling if appropriate
+    if (params->polishParams->maxDepth > 0) {
+        startChunkStage(options, report, CHUNK_STAGE_DOWNSAMPLE, chunkIdx, bamChunk, stList_length(reads));
+        // get downsampling structures
+        stList *filteredReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
+        stList *discardedReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
+        stList *filteredAlignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
+        stList *discardedAlignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
+
+        bool didDownsample = poorMansDownsample(params->polishParams->maxDepth, bamChunk, reads, alignments,
+                filteredReads, filteredAlignments, discardedReads, discardedAlignments);
+
+        // we need to destroy the discarded reads and structures
+        if (didDownsample) {
+            st_logInfo(" %s Downsampled from %"PRId64" to %"PRId64" reads\n", logIdentifier,
+                    stList_length(reads), stList_length(filteredReads));
+            // free all reads and alignments not used
+            stList_destruct(discardedReads);
+            stList_destruct(discardedAlignments);
+            // still has all the old reads, need to not free these
+            stList_setDestructor(reads, NULL);
+            stList_setDestructor(alignments, NULL);
+            stList_destruct(reads);
+            stList_destruct(alignments);
+            // and keep the filtered reads
+            reads = filteredReads;
+            alignments = filteredAlignments;
+        }
+        // no downsampling, we just need to free the (empty) objects
+        else {
+            stList_destruct(filteredReads);
+            stList_destruct(filteredAlignments);
+            stList_destruct(discardedReads);
+            stList_destruct(discardedAlignments);
+        }
+        endChunkStage(options, report, CHUNK_STAGE_DOWNSAMPLE, chunkIdx, bamChunk, stList_length(reads));
+    }
+
+    Poa *poa = NULL; // The poa alignment
+    char *polishedConsensusString = NULL; // The polished reference string
+
+
+    // prep for RLE work
+    RleString *rleReference = NULL;
+    stList *rleNucleotides = stList_construct3(0, (void (*)(void *)) rleString_destruct);
+    stList *rleReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
+    stList *rleAlignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    TupleArena *rleAlignmentArena = tupleArena_construct(); // holds the aligned pairs of rleAlignments
+    uint64_t totalNucleotides = 0;
+
+    if (report != NULL) {
+        report->readsKept = stList_length(reads);
+    }
+
+    // Note RLE status (and handle reference)
+    startChunkStage(options, report, CHUNK_STAGE_RUN_LENGTH_ENCODE, chunkIdx, bamChunk, stList_length(reads));
+    if (params->polishParams->useRunLengthEncoding) {
+        st_logInfo(">%s Applying RLE\n", logIdentifier);
+        rleReference = rleString_construct(referenceString);
+    } else {
+        st_logInfo(">%s Skipping RLE\n", logIdentifier);
+        rleReference = rleString_constructNoRLE(referenceString);
+    }
+
+    // RLE the reads
+    for (int64_t j = 0; j < stList_length(reads); j++) {
+        BamChunkRead *read = stList_get(reads, j);
+        stList *alignment = stList_get(alignments, j);
+        RleString *rleNucleotideString = NULL;
+
+        // Perform or skip RLE, the RLE read is packed if the read is
+        rleNucleotideString = rleString_constructFromRead(read, params->polishParams->useRunLengthEncoding);
+        totalNucleotides += rleNucleotideString->length;
+
+        // Do RLE follow up regardless of whether RLE is applied
+        stList_append(rleNucleotides, rleNucleotideString);
+        stList_append(rleReads, bamChunkRead_constructRLECopy(read, rleNucleotideString));
+        stList_append(rleAlignments, runLengthEncodeAlignment3(alignment, rleReference, rleNucleotideString, 0, 1, 2,
+                                                               rleAlignmentArena));
+
+        // Only the repeat counts of the read's RLE string are used from here on
+        if (params->polishParams->packReadNucleotides) {
+            rleString_discardCoordinateMaps(rleNucleotideString);
+        }
+    }
+    st_logInfo(">%s Made %"PRId64" aligned pairs in %"PRId64" allocations\n", logIdentifier,
+               tupleArena_getTupleNumber(alignmentArena) + tupleArena_getTupleNumber(rleAlignmentArena),
+               tupleArena_getBlockNumber(alignmentArena) + tupleArena_getBlockNumber(rleAlignmentArena));
+
+    // The alignments in read space are not needed after this
+    stList_destruct(alignments);
+    tupleArena_destruct(alignmentArena);
+    endChunkStage(options, report, CHUNK_STAGE_RUN_LENGTH_ENCODE, chunkIdx, bamChunk, stList_length(reads));
+
+
+    // Run the polishing method
+    st_logInfo(">%s Running polishing algorithm with %"PRId64" reads and %"PRIu64"K nucleotides\n",
+            logIdentifier, stList_length(reads), totalNucleotides >> 10);
+
+    // Generate partial order alignment (POA) (destroys rleAlignments in the process)
+    startChunkStage(options, report, CHUNK_STAGE_POA, chunkIdx, bamChunk, stList_length(reads));
+    AlignmentCache *alignmentCache = NULL;
+    if (options->alignmentCacheDir != NULL) {
+        char *alignmentCacheFile = stString_print("%s/%s.%"PRId64"-%"PRId64".cache", options->alignmentCacheDir,
+                                                  bamChunk->refSeqName, bamChunk->chunkBoundaryStart,
+                                                  bamChunk->chunkBoundaryEnd);
+        alignmentCache = alignmentCache_construct(alignmentCacheFile, options->paramsFingerprint);
+        free(alignmentCacheFile);
+    }
+    // for diploid polishing keep the posteriors of the reads to the final poa, to phase and split it by
+    stList *readMatches = NULL, *readInserts = NULL, *readDeletes = NULL;
+    if (diploidResult != NULL) {
+        readMatches = stList_construct3(0, (void (*)(void *)) stList_destruct);
+        readInserts = stList_construct3(0, (void (*)(void *)) stList_destruct);
+        readDeletes = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    }
+    poa = poa_realignAllCached2(rleReads, rleAlignments, rleReference->rleString, params->polishParams,
+                                alignmentCache, readMatches, readInserts, readDeletes);
+    if (alignmentCache != NULL) {
+        st_logInfo(">%s Reused %"PRId64" of %"PRId64" read alignments from the alignment cache\n", logIdentifier,
+                   alignmentCache->hits, alignmentCache->hits + alignmentCache->misses);
+        #pragma omp critical (alignmentCacheCounts)
+        {
+            options->alignmentCacheHits += alignmentCache->hits;
+            options->alignmentCacheLookups += alignmentCache->hits + alignmentCache->misses;
+        }
+        alignmentCache_write(alignmentCache);
+        alignmentCache_destruct(alignmentCache);
+    }
+    endChunkStage(options, report, CHUNK_STAGE_POA, chunkIdx, bamChunk, stList_length(reads));
+    if (report != NULL) {
+        chunkReport_setPoa(report, poa);
+    }
+
+    // get polished reference string and expand RLE (regardless of whether RLE was applied)
+    startChunkStage(options, report, CHUNK_STAGE_EXPAND_CONSENSUS, chunkIdx, bamChunk, stList_length(reads));
+    RleString *polishedRleConsensus = expandRLEConsensus(poa, rleNucleotides, rleReads,
+                                                         params->polishParams->repeatSubMatrix);
+    polishedConsensusString = rleString_expand(polishedRleConsensus);
+    endChunkStage(options, report, CHUNK_STAGE_EXPAND_CONSENSUS, chunkIdx, bamChunk, stList_length(reads));
+
+    // Now optionally do phasing and haplotype specific polishing
+    if (diploidResult != NULL) {
+        traceWriter_begin(options->trace, "polishHaplotypes", chunkIdx, bamChunk, stList_length(reads));
+        polishHaplotypes(poa, rleReads, rleNucleotides, readMatches, readInserts, readDeletes,
+                         polishedConsensusString, params, logIdentifier, diploidResult);
+        traceWriter_end(options->trace, "polishHaplotypes", chunkIdx, bamChunk, stList_length(reads));
+        stList_destruct(readMatches);
+        stList_destruct(readInserts);
+        stList_destruct(readDeletes);
+    }
+
+    // Log info about the POA
+    if (st_getLogLevel() >= info) {
+        st_logInfo(">%s Summary stats for POA:\t", logIdentifier);
+        poa_printSummaryStats(poa, stderr);
+    }
+    if (st_getLogLevel() >= debug) {
+        poa_print(poa, stderr, rleReads, 5, 5);
+    }
+
+    // Write any optional outputs about repeat count and POA, etc.
+    if(options->outputPoaTsvBase != NULL) {
+        char *outputPoaTsvFilename = stString_print("%s.poa.C%05"PRId64".%s-%"PRId64"-%"PRId64".tsv",
+                                                    options->outputPoaTsvBase, chunkIdx, bamChunk->refSeqName,
+                                                    bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
+        FILE *outputPoaTsvFileHandle = fopen(outputPoaTsvFilename, "w");
+        poa_printTSV(poa, outputPoaTsvFileHandle, rleReads, 5, 0);
+        fclose(outputPoaTsvFileHandle);
+        free(outputPoaTsvFilename);
+    }
+    if(options->outputRepeatCountBase != NULL) {
+        char *outputRepeatCountFilename = stString_print("%s.repeatCount.C%05"PRId64".%s-%"PRId64"-%"PRId64".tsv",
+                                                         options->outputRepeatCountBase, chunkIdx, bamChunk->refSeqName,
+                                                         bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
+        FILE *outputRepeatCountFileHandle = fopen(outputRepeatCountFilename, "w");
+        poa_printRepeatCounts(poa, outputRepeatCountFileHandle, rleNucleotides, rleReads);
+        fclose(outputRepeatCountFileHandle);
+        free(outputRepeatCountFilename);
+    }
+
+
+    // HELEN feature outputs
+
+    if (options->helenFeatureType != HFEAT_NONE) {
+        startChunkStage(options, report, CHUNK_STAGE_HELEN_FEATURES, chunkIdx, bamChunk, stList_length(reads));
+        bool featuresWritten = handleHelenFeatures(options->outputBase, options->helenFeatureType,
+                options->trueReferenceBamChunker, options->splitWeightMaxRunLength, options->splitWeightHDF5Files,
+                options->splitWeightHDF5Writer, options->splitWeightNpyDir, options->fullFeatureOutput,
+                options->trueReferenceBam, params, logIdentifier, chunkIdx, bamChunk, poa, rleReads, rleNucleotides,
+                polishedConsensusString, polishedRleConsensus);
+        if (!featuresWritten) {
+            #pragma omp critical (featuresWritten)
+            options->featuresWritten = FALSE;
+        }
+        endChunkStage(options, report, CHUNK_STAGE_HELEN_FEATURES, chunkIdx, bamChunk, stList_length(reads));
+    }
+
+    // report timing
+    st_logInfo(">%s Chunk with %"PRId64" reads and %"PRIu64"K nucleotides processed in %d sec\n",
+               logIdentifier, stList_length(reads), totalNucleotides >> 10, (int) (time(NULL) - start));
+
+    // Cleanup
+    stList_destruct(rleNucleotides);
+    stList_destruct(rleReads);
+    stList_destruct(rleAlignments);
+    tupleArena_destruct(rleAlignmentArena);
+    rleString_destruct(rleReference);
+    rleString_destruct(polishedRleConsensus);
+    poa_destruct(poa);
+    stList_destruct(reads);
+    free(referenceString);
+    free(logIdentifier);
+
+    if (report != NULL) {
+        chunkReportWriter_write(options->chunkReportWriter, report, "finished");
+    }
+    traceWriter_end(options->trace, "chunk", chunkIdx, bamChunk, -1);
+    return polishedConsensusString;
+}
+
+static char *getMissingChunkSpacer(BamChunker *bamChunker) {
+    int64_t spacerSize = (bamChunker->chunkBoundary == 0 ? 50 : bamChunker->chunkBoundary * 3);
+    char *missingChunkSpacer = st_calloc(spacerSize + 1, sizeof(char));
+    for (int64_t i = 0; i < spacerSize; i++) {
+        missingChunkSpacer[i] = 'N';
+    }
+    missingChunkSpacer[spacerSize] = '\0';
+    return missingChunkSpacer;
+}
+
+static char *stitchPolishedChunks(BamChunker *bamChunker, char **chunkResults, int64_t firstChunkIdx,
+                                  int64_t endChunkIdx, Params *params, char *missingChunkSpacer) {
+    /*
+     * Stitches the polished chunks from firstChunkIdx (inclusive) to endChunkIdx (exclusive), which must be consecutive
+     * chunks of one reference sequence, trimming the overlap between neighbours. Consumes the chunk results.
+     */
+    stList *polishedReferenceStrings = stList_construct3(0, free); // The polished reference strings, one for each chunk
+    for (int64_t chunkIdx = firstChunkIdx; chunkIdx < endChunkIdx; chunkIdx++) {
+        // Get polished chunk, chunks without a reference sequence were not polished
+        char* polishedReferenceString = chunkResults[chunkIdx] == NULL ? stString_copy("") : chunkResults[chunkIdx];
+        chunkResults[chunkIdx] = NULL;
+        int64_t prsLen = strlen(polishedReferenceString);
+        st_logInfo(" T%02d_C%05"PRId64" (%.3f): consensus sequence length %"PRId64"\n",
+                omp_get_thread_num(), chunkIdx, 1.0 * chunkIdx / bamChunker->chunkCount, prsLen);
+
+		// If there was a previous chunk then trim it's polished reference sequence
+		// to remove overlap with the current chunk's polished reference sequence
+		if(stList_length(polishedReferenceStrings) > 0) {
+			char *previousPolishedReferenceString = stList_peek(polishedReferenceStrings);
+
+			// Trim the currrent and previous polished reference strings to remove overlap
+			int64_t prefixStringCropEnd, suffixStringCropStart;
+			int64_t overlapMatchWeight = removeOverlap(previousPolishedReferenceString, polishedReferenceString,
+													   bamChunker->chunkBoundary * 2, params->polishParams,
+													   &prefixStringCropEnd, &suffixStringCropStart);
+
+			// we have an overlap
+			if (overlapMatchWeight > 0) {
+                st_logInfo(
+                        "  Removed overlap between neighbouring chunks. Approx overlap size: %i, overlap-match weight: %f, "
+                        "left-trim: %i, right-trim: %i:\n", (int) bamChunker->chunkBoundary * 2,
+                        (float) overlapMatchWeight / PAIR_ALIGNMENT_PROB_1,
+                        strlen(previousPolishedReferenceString) - prefixStringCropEnd, suffixStringCropStart);
+
+                // Crop the suffix of the previous chunk's polished reference string
+                previousPolishedReferenceString[prefixStringCropEnd] = '\0';
+
+                // Crop the the prefix of the current chunk's polished reference string
+                char *c = polishedReferenceString;
+                polishedReferenceString = stString_copy(&(polishedReferenceString[suffixStringCropStart]));
+                free(c);
+
+            // no good alignment, could be missing chunks
+            } else {
+                if (prsLen == 0) {
+                    st_logInfo("  No overlap found. Filling empty chunk with Ns.\n");
+                    char *c = polishedReferenceString;
+                    polishedReferenceString = stString_copy(missingChunkSpacer);
+                    free(c);
+                } else {
+                    st_logInfo("  No overlap found. Filling Ns in stitch position.\n");
+                    stList_append(polishedReferenceStrings, stString_copy("NNNNNNNNNN"));
+                }
+			}
+		}
+
+		// Add the polished sequence to the list of polished reference sequence chunks
+		stList_append(polishedReferenceStrings, polishedReferenceString);
+    }
+
+    char *s = stString_join2("", polishedReferenceStrings);
+    stList_destruct(polishedReferenceStrings);
+    return s;
+}
+
+static char *getPolishedSequenceName(BamChunk *bamChunk) {
+    // Chunks from a BED interval are polished into a sequence per interval, else into a sequence per contig
+    return bamChunk->regionName != NULL ? bamChunk->regionName : bamChunk->refSeqName;
+}
+
+static int64_t getReferenceSequenceEndChunk(BamChunker *bamChunker, int64_t firstChunkIdx) {
+    // Returns the index after the last chunk of the polished sequence starting at firstChunkIdx
+    char *sequenceName = getPolishedSequenceName(bamChunker_getChunk(bamChunker, firstChunkIdx));
+    int64_t endChunkIdx = firstChunkIdx + 1;
+    while (endChunkIdx < bamChunker->chunkCount &&
+           stString_eq(getPolishedSequenceName(bamChunker_getChunk(bamChunker, endChunkIdx)), sequenceName)) {
+        endChunkIdx++;
+    }
+    return endChunkIdx;
+}
+
+void writePolishedReferenceSequences(BamChunker *bamChunker, char **chunkResults, Params *params,
+                                     FILE *polishedReferenceOutFh) {
+    /*
+     * Stitches the polished chunks together and writes one fasta record per reference sequence. Consumes the chunk
+     * results.
+     */
+    st_logInfo("> Merging polished reference strings from %"PRIu64" chunks.\n", bamChunker->chunkCount);
+    char *missingChunkSpacer = getMissingChunkSpacer(bamChunker);
+    for (int64_t chunkIdx = 0; chunkIdx < bamChunker->chunkCount;) {
+        int64_t endChunkIdx = getReferenceSequenceEndChunk(bamChunker, chunkIdx);
+        char *s = stitchPolishedChunks(bamChunker, chunkResults, chunkIdx, endChunkIdx, params, missingChunkSpacer);
+        fastaWrite(s, getPolishedSequenceName(bamChunker_getChunk(bamChunker, chunkIdx)), polishedReferenceOutFh);
+        free(s);
+        chunkIdx = endChunkIdx;
+    }
+    free(missingChunkSpacer);
+}
+
+static int64_t getSharedReadCount(stSet *readNames1, stSet *readNames2) {
+    int64_t sharedReads = 0;
+    stSetIterator *it = stSet_getIterator(readNames1);
+    char *readName;
+    while ((readName = stSet_getNext(it)) != NULL) {
+        if (stSet_search(readNames2, readName) != NULL) {
+            sharedReads++;
+        }
+    }
+    stSet_destructIterator(it);
+    return sharedReads;
+}
+
+static void phaseDiploidChunkResults(BamChunker *bamChunker, DiploidChunkResult *diploidResults) {
+    /*
+     * The haplotype labels of each chunk are arbitrary. Swaps them where needed so that, along each reference sequence,
+     * each chunk's haplotypes share the most reads with the same labelled haplotypes of the previous chunk.
+     */
+    for (int64_t chunkIdx = 1; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
+        DiploidChunkResult *previous = &diploidResults[chunkIdx - 1], *current = &diploidResults[chunkIdx];
+        if (previous->haplotypeReadNames[0] == NULL || current->haplotypeReadNames[0] == NULL ||
+            !stString_eq(getPolishedSequenceName(bamChunker_getChunk(bamChunker, chunkIdx - 1)),
+                         getPolishedSequenceName(bamChunker_getChunk(bamChunker, chunkIdx)))) {
+            continue;
+        }
+        int64_t cis = getSharedReadCount(previous->haplotypeReadNames[0], current->haplotypeReadNames[0]) +
+                      getSharedReadCount(previous->haplotypeReadNames[1], current->haplotypeReadNames[1]);
+        int64_t trans = getSharedReadCount(previous->haplotypeReadNames[0], current->haplotypeReadNames[1]) +
+                        getSharedReadCount(previous->haplotypeReadNames[1], current->haplotypeReadNames[0]);
+        if (trans > cis) {
+            char *polishedHaplotype = current->polishedHaplotypes[0];
+            current->polishedHaplotypes[0] = current->polishedHaplotypes[1];
+            current->polishedHaplotypes[1] = polishedHaplotype;
+            stSet *haplotypeReadNames = current->haplotypeReadNames[0];
+            current->haplotypeReadNames[0] = current->haplotypeReadNames[1];
+            current->haplotypeReadNames[1] = haplotypeReadNames;
+        }
+    }
+}
+
+static void writePolishedHaplotypeSequences(BamChunker *bamChunker, DiploidChunkResult *diploidResults,
+                                            Params *params, char *outputBase) {
+    /*
+     * Stitches and writes each haplotype to OUTPUT_BASE.hapN.fa. Consumes the diploid chunk results.
+     */
+    phaseDiploidChunkResults(bamChunker, diploidResults);
+    for (int64_t h = 0; h < 2; h++) {
+        char **chunkResults = st_calloc(bamChunker->chunkCount, sizeof(char*));
+        for (int64_t chunkIdx = 0; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
+            chunkResults[chunkIdx] = diploidResults[chunkIdx].polishedHaplotypes[h];
+            if (diploidResults[chunkIdx].haplotypeReadNames[h] != NULL) {
+                stSet_destruct(diploidResults[chunkIdx].haplotypeReadNames[h]);
+            }
+        }
+        char *haplotypeOutFile = stString_print("%s.hap%"PRId64".fa", outputBase, h + 1);
+        st_logInfo("> Going to write polished haplotype %"PRId64" in : %s\n", h + 1, haplotypeOutFile);
+        FILE *haplotypeOutFh = fopen(haplotypeOutFile, "w");
+        if (haplotypeOutFh == NULL) {
+            st_errAbort("Could not write to file: %s\n", haplotypeOutFile);
+        }
+        writePolishedReferenceSequences(bamChunker, chunkResults, params, haplotypeOutFh);
+        fclose(haplotypeOutFh);
+        free(haplotypeOutFile);
+        free(chunkResults);
+    }
+}
+
+void polishChunks(BamChunker *bamChunker, stHash *referenceSequences, Params *params, PolishOutputOptions *options,
+                  FILE *polishedReferenceOutFh) {
+    // Polish chunks
+    // Each chunk produces a char* as output which is saved here
+    char **chunkResults = st_calloc(bamChunker->chunkCount, sizeof(char*));
+    DiploidChunkResult *diploidResults = options->diploid ?
+            st_calloc(bamChunker->chunkCount, sizeof(DiploidChunkResult)) : NULL;
+
+    // multiproccess the chunks, save to results
+    int64_t chunkIdx;
+    #pragma omp parallel for schedule(dynamic,1)
+    for (chunkIdx = 0; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
+        chunkResults[chunkIdx] = polishChunk(bamChunker, chunkIdx, referenceSequences, params, options,
+                                             diploidResults == NULL ? NULL : &diploidResults[chunkIdx]);
+    }
+
+    // merge chunks
+    traceWriter_begin(options->trace, "stitch", -1, NULL, -1);
+    writePolishedReferenceSequences(bamChunker, chunkResults, params, polishedReferenceOutFh);
+    if (diploidResults != NULL) {
+        writePolishedHaplotypeSequences(bamChunker, diploidResults, params, options->outputBase);
+    }
+    traceWriter_end(options->trace, "stitch", -1, NULL, -1);
+    free(chunkResults);
+    free(diploidResults);
+}
+
+/*
+ * Incremental re-polishing of the chunks of a patched draft that overlap edited intervals
+ */
+
+#define SPLICE_KMER_LENGTH 64
+#define SPLICE_KMER_ATTEMPTS 8
+
+stHash *parseEditedIntervals(char *bedFile) {
+    /*
+     * Parses a BED file of edited intervals on the draft, as a map from reference sequence name to a list of
+     * (start, end) stIntTuples, zero based and end exclusive.
+     */
+    FILE *fh = fopen(bedFile, "r");
+    if (fh == NULL) {
+        st_errAbort("Could not read from file: %s\n", bedFile);
+    }
+    stHash *editedIntervals = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free,
+                                                (void (*)(void *)) stList_destruct);
+    char *line;
+    int64_t lineNo = 0;
+    while ((line = stFile_getLineFromFile(fh)) != NULL) {
+        lineNo++;
+        stList *tokens = stString_split(line);
+        if (stList_length(tokens) > 0 && ((char *) stList_get(tokens, 0))[0] != '#' &&
+            !stString_eq(stList_get(tokens, 0), "track") && !stString_eq(stList_get(tokens, 0), "browser")) {
+            int64_t start, end;
+            if (stList_length(tokens) < 3 || sscanf(stList_get(tokens, 1), "%" SCNd64, &start) != 1 ||
+                sscanf(stList_get(tokens, 2), "%" SCNd64, &end) != 1 || start < 0 || end < start) {
+                st_errAbort("Malformed interval on line %" PRId64 " of %s: %s\n", lineNo, bedFile, line);
+            }
+            stList *intervals = stHash_search(editedIntervals, stList_get(tokens, 0));
+            if (intervals == NULL) {
+                intervals = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
+                stHash_insert(editedIntervals, stString_copy(stList_get(tokens, 0)), intervals);
+            }
+            stList_append(intervals, stIntTuple_construct2(start, end));
+        }
+        stList_destruct(tokens);
+        free(line);
+    }
+    fclose(fh);
+    return editedIntervals;
+}
+
+static bool chunkOverlapsIntervals(BamChunk *bamChunk, stList *intervals) {
+    for (int64_t i = 0; intervals != NULL && i < stList_length(intervals); i++) {
+        stIntTuple *interval = stList_get(intervals, i);
+        if (bamChunk->chunkBoundaryStart < stIntTuple_get(interval, 1) &&
+            stIntTuple_get(interval, 0) < bamChunk->chunkBoundaryEnd) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void polishChunkSubset(BamChunker *bamChunker, stHash *referenceSequences, Params *params,
+                              PolishOutputOptions *options, bool *toPolish, bool *polished, char **chunkResults) {
+    /*
+     * Polishes, in parallel, the chunks marked in toPolish that are not yet marked as polished.
+     */
+    int64_t *chunkIdxs = st_calloc(bamChunker->chunkCount, sizeof(int64_t));
+    int64_t chunkIdxCount = 0;
+    for (int64_t chunkIdx = 0; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
+        if (toPolish[chunkIdx] && !polished[chunkIdx]) {
+            chunkIdxs[chunkIdxCount++] = chunkIdx;
+            polished[chunkIdx] = TRUE;
+        }
+    }
+    int64_t i;
+    #pragma omp parallel for schedule(dynamic,1)
+    for (i = 0; i < chunkIdxCount; i++) {
+        chunkResults[chunkIdxs[i]] = polishChunk(bamChunker, chunkIdxs[i], referenceSequences, params, options,
+                                                 NULL);
+    }
+    free(chunkIdxs);
+}
+
+static int64_t findUniqueOccurrence(char *sequence, int64_t from, char *kmer) {
+    // Returns the position of the only occurrence of kmer in sequence at or after from, else -1
+    char *hit = strstr(&sequence[from], kmer);
+    if (hit == NULL || strstr(hit + 1, kmer) != NULL) {
+        return -1;
+    }
+    return hit - sequence;
+}
+
+static int64_t findSpliceKmer(char *polishedChunk, char *previousPolished, int64_t from, int64_t overlap,
+                              int64_t *previousPosition) {
+    /*
+     * Looks for a k-mer of a polished flanking chunk, away from the ends the chunk shares with its neighbours, that
+     * occurs exactly once in the previous polished sequence at or after from. Returns its offset in the chunk and sets
+     * previousPosition to its position in the previous polished sequence, or returns -1.
+     */
+    if (polishedChunk == NULL) {
+        return -1;
+    }
+    int64_t minOffset = overlap, maxOffset = (int64_t) strlen(polishedChunk) - overlap - SPLICE_KMER_LENGTH;
+    if (maxOffset < minOffset || from >= (int64_t) strlen(previousPolished)) {
+        return -1;
+    }
+    char kmer[SPLICE_KMER_LENGTH + 1];
+    kmer[SPLICE_KMER_LENGTH] = '\0';
+    // Try k-mers from the middle of the chunk outwards
+    int64_t middle = (minOffset + maxOffset) / 2;
+    for (int64_t attempt = 0; attempt < SPLICE_KMER_ATTEMPTS; attempt++) {
+        int64_t offset = middle + (attempt % 2 == 0 ? 1 : -1) * ((attempt + 1) / 2) * SPLICE_KMER_LENGTH;
+        if (offset < minOffset || offset > maxOffset) {
+            continue;
+        }
+        memcpy(kmer, &polishedChunk[offset], SPLICE_KMER_LENGTH);
+        int64_t position = findUniqueOccurrence(previousPolished, from, kmer);
+        if (position != -1) {
+            *previousPosition = position;
+            return offset;
+        }
+    }
+    return -1;
+}
+
+static char *splicePolishedChunks(BamChunker *bamChunker, char **chunkResults, char **scratchResults,
+                                  bool *repolish, int64_t firstChunkIdx, int64_t endChunkIdx,
+                                  char *previousPolished, Params *params, char *missingChunkSpacer) {
+    /*
+     * Splices the re-polished chunks of one reference sequence into its previous polished sequence, returning the
+     * result, or NULL if a splice point could not be found.
+     *
+     * Each run of re-polished chunks starts and ends with an unedited flanking chunk (except at the ends of the
+     * sequence), whose polished sequence is, away from its ends, also in the previous polished sequence. A run is
+     * spliced in at a k-mer in the middle of each flank that occurs once in the previous polished sequence, so between
+     * the flanks the result is the chunks stitched exactly as in a full re-polish. The chunk results are consumed only
+     * if the splice succeeds.
+     */
+    int64_t overlap = bamChunker->chunkBoundary * 2; // the approximate overlap trimmed when stitching
+    int64_t previousLength = strlen(previousPolished);
+    stList *pieces = stList_construct3(0, free);
+    int64_t cursor = 0; // the previous polished sequence is copied up to here
+    bool spliced = TRUE;
+    for (int64_t chunkIdx = firstChunkIdx; chunkIdx < endChunkIdx && spliced;) {
+        if (!repolish[chunkIdx]) {
+            chunkIdx++;
+            continue;
+        }
+        int64_t runEndChunkIdx = chunkIdx;
+        while (runEndChunkIdx < endChunkIdx && repolish[runEndChunkIdx]) {
+            runEndChunkIdx++;
+        }
+
+        // Work on copies, so the chunk results are kept if the splice fails
+        for (int64_t i = chunkIdx; i < runEndChunkIdx; i++) {
+            scratchResults[i] = chunkResults[i] == NULL ? NULL : stString_copy(chunkResults[i]);
+        }
+
+        // Left flank, the run replaces the previous polished sequence from the k-mer
+        int64_t runPosition = cursor;
+        if (chunkIdx > firstChunkIdx) {
+            int64_t offset = findSpliceKmer(scratchResults[chunkIdx], previousPolished, cursor, overlap, &runPosition);
+            if (offset == -1) {
+                spliced = FALSE;
+            } else {
+                stList_append(pieces, stString_getSubString(previousPolished, cursor, runPosition - cursor));
+                char *flank = scratchResults[chunkIdx];
+                scratchResults[chunkIdx] = stString_copy(&flank[offset]);
+                free(flank);
+            }
+        }
+
+        // Right flank, the previous polished sequence resumes from the k-mer
+        int64_t resumeOffset = -1, resumePosition = previousLength, rightFlankLength = 0;
+        if (spliced && runEndChunkIdx < endChunkIdx) {
+            char *flank = scratchResults[runEndChunkIdx - 1];
+            rightFlankLength = flank == NULL ? 0 : strlen(flank);
+            resumeOffset = findSpliceKmer(flank, previousPolished, runPosition + SPLICE_KMER_LENGTH, overlap,
+                                          &resumePosition);
+            spliced = resumeOffset != -1;
+        }
+
+        if (spliced) {
+            char *run = stitchPolishedChunks(bamChunker, scratchResults, chunkIdx, runEndChunkIdx, params,
+                                             missingChunkSpacer);
+            if (resumeOffset != -1) {
+                // The stitching only trims the ends of the flank, so the k-mer is where it was relative to the end
+                int64_t runEnd = (int64_t) strlen(run) - (rightFlankLength - resumeOffset);
+                if (runEnd < 0 || strncmp(&run[runEnd], &previousPolished[resumePosition], SPLICE_KMER_LENGTH) != 0) {
+                    spliced = FALSE;
+                } else {
+                    run[runEnd] = '\0';
+                }
+            }
+            stList_append(pieces, run);
+            cursor = resumePosition;
+        }
+        for (int64_t i = chunkIdx; i < runEndChunkIdx; i++) {
+            free(scratchResults[i]);
+            scratchResults[i] = NULL;
+        }
+        chunkIdx = runEndChunkIdx;
+    }
+
+    if (!spliced) {
+        stList_destruct(pieces);
+        return NULL;
+    }
+    stList_append(pieces, stString_copy(&previousPolished[cursor]));
+    char *s = stString_join2("", pieces);
+    stList_destruct(pieces);
+    for (int64_t chunkIdx = firstChunkIdx; chunkIdx < endChunkIdx; chunkIdx++) {
+        free(chunkResults[chunkIdx]);
+        chunkResults[chunkIdx] = NULL;
+    }
+    return s;
+}
+
+void polishChunksIncrementally(BamChunker *bamChunker, stHash *referenceSequences, stHash *previousPolishedSequences,
+                               stHash *editedIntervals, Params *params, PolishOutputOptions *options,
+                               FILE *polishedReferenceOutFh) {
+    /*
+     * Re-polishes only the chunks overlapping the edited intervals, and their neighbours, splicing the results into
+     * the previous polished sequences. Sequences without edits are copied from the previous polished sequences,
+     * sequences missing from them are polished in full, as are sequences where the splice fails.
+     */
+    char **chunkResults = st_calloc(bamChunker->chunkCount, sizeof(char*));
+    char **scratchResults = st_calloc(bamChunker->chunkCount, sizeof(char*));
+    bool *repolish = st_calloc(bamChunker->chunkCount, sizeof(bool));
+    bool *polished = st_calloc(bamChunker->chunkCount, sizeof(bool));
+
+    // Mark the chunks to re-polish: edited chunks and the unedited chunks flanking them
+    for (int64_t firstChunkIdx = 0; firstChunkIdx < bamChunker->chunkCount;) {
+        int64_t endChunkIdx = getReferenceSequenceEndChunk(bamChunker, firstChunkIdx);
+        BamChunk *firstChunk = bamChunker_getChunk(bamChunker, firstChunkIdx);
+        stList *intervals = stHash_search(editedIntervals, firstChunk->refSeqName);
+        bool missing = stHash_search(previousPolishedSequences, getPolishedSequenceName(firstChunk)) == NULL;
+        for (int64_t chunkIdx = firstChunkIdx; chunkIdx < endChunkIdx; chunkIdx++) {
+            if (missing || chunkOverlapsIntervals(bamChunker_getChunk(bamChunker, chunkIdx), intervals)) {
+                for (int64_t i = chunkIdx - 1; i <= chunkIdx + 1; i++) {
+                    if (i >= firstChunkIdx && i < endChunkIdx) {
+                        repolish[i] = TRUE;
+                    }
+                }
+            }
+        }
+        firstChunkIdx = endChunkIdx;
+    }
+    int64_t repolishCount = 0;
+    for (int64_t chunkIdx = 0; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
+        repolishCount += repolish[chunkIdx] ? 1 : 0;
+    }
+    st_logInfo("> Re-polishing %"PRId64" of %"PRId64" chunks overlapping or flanking edited intervals\n",
+               repolishCount, bamChunker->chunkCount);
+    polishChunkSubset(bamChunker, referenceSequences, params, options, repolish, polished, chunkResults);
+
+    // Splice, marking every chunk of a sequence that could not be spliced for polishing in full
+    traceWriter_begin(options->trace, "stitch", -1, NULL, -1);
+    char *missingChunkSpacer = getMissingChunkSpacer(bamChunker);
+    stHash *splicedSequences = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, free);
+    for (int64_t firstChunkIdx = 0; firstChunkIdx < bamChunker->chunkCount;) {
+        int64_t endChunkIdx = getReferenceSequenceEndChunk(bamChunker, firstChunkIdx);
+        char *sequenceName = getPolishedSequenceName(bamChunker_getChunk(bamChunker, firstChunkIdx));
+        char *previousPolished = stHash_search(previousPolishedSequences, sequenceName);
+        bool fullyRepolished = TRUE;
+        for (int64_t chunkIdx = firstChunkIdx; chunkIdx < endChunkIdx; chunkIdx++) {
+            fullyRepolished = fullyRepolished && repolish[chunkIdx];
+        }
+        if (previousPolished != NULL && !fullyRepolished) {
+            char *spliced = splicePolishedChunks(bamChunker, chunkResults, scratchResults, repolish, firstChunkIdx,
+                                                 endChunkIdx, previousPolished, params, missingChunkSpacer);
+            if (spliced != NULL) {
+                stHash_insert(splicedSequences, sequenceName, spliced);
+            } else {
+                st_logInfo("> Could not splice the re-polished chunks into %s, polishing it in full\n", sequenceName);
+                for (int64_t chunkIdx = firstChunkIdx; chunkIdx < endChunkIdx; chunkIdx++) {
+                    repolish[chunkIdx] = TRUE;
+                }
+            }
+        }
+        firstChunkIdx = endChunkIdx;
+    }
+    traceWriter_end(options->trace, "stitch", -1, NULL, -1);
+    polishChunkSubset(bamChunker, referenceSequences, params, options, repolish, polished, chunkResults);
+
+    // Write the sequences in order
+    traceWriter_begin(options->trace, "stitch", -1, NULL, -1);
+    for (int64_t firstChunkIdx = 0; firstChunkIdx < bamChunker->chunkCount;) {
+        int64_t endChunkIdx = getReferenceSequenceEndChunk(bamChunker, firstChunkIdx);
+        char *sequenceName = getPolishedSequenceName(bamChunker_getChunk(bamChunker, firstChunkIdx));
+        char *spliced = stHash_search(splicedSequences, sequenceName);
+        if (spliced != NULL) {
+            fastaWrite(spliced, sequenceName, polishedReferenceOutFh);
+        } else if (repolish[firstChunkIdx]) {
+            char *s = stitchPolishedChunks(bamChunker, chunkResults, firstChunkIdx, endChunkIdx, params,
+                                           missingChunkSpacer);
+            fastaWrite(s, sequenceName, polishedReferenceOutFh);
+            free(s);
+        } else {
+            // unedited
+            fastaWrite(stHash_search(previousPolishedSequences, sequenceName), sequenceName, polishedReferenceOutFh);
+        }
+        firstChunkIdx = endChunkIdx;
+    }
+    traceWriter_end(options->trace, "stitch", -1, NULL, -1);
+
+    // Cleanup
+    stHash_destruct(splicedSequences);
+    free(missingChunkSpacer);
+    free(chunkResults);
+    free(scratchResults);
+    free(repolish);
+    free(polished);
 }
 
-char *getFileBase(char *base, char *defawlt) {
+/*
+ * Server mode
+ *
+ * The params are parsed once, and the references of recent requests are kept between requests. Each request is
+ * polished in a child process forked from the server, so an error that aborts polishing ends only that request: the
+ * server replies with an ERROR line carrying the last line the child logged. The alignment files, indexes and all
+ * other memory of a request go with its child. The server itself never starts OpenMP threads, which do not survive a
+ * fork, so each child starts its own.
+ */
+
+#define SERVER_MAX_REFERENCES 4 // most recently used references kept between requests
+
+typedef struct _servedReference {
+    time_t modificationTime;
+    int64_t lastRequest; // number of the last request that used the reference
+    stHash *referenceSequences;
+} ServedReference;
+
+static void servedReference_destruct(ServedReference *servedReference) {
+    stHash_destruct(servedReference->referenceSequences);
+    free(servedReference);
+}
+
+static void evictLeastRecentlyServedReference(stHash *servedReferences) {
+    char *oldestFile = NULL;
+    ServedReference *oldest = NULL;
+    stHashIterator *it = stHash_getIterator(servedReferences);
+    char *file;
+    while ((file = stHash_getNext(it)) != NULL) {
+        ServedReference *servedReference = stHash_search(servedReferences, file);
+        if (oldest == NULL || servedReference->lastRequest < oldest->lastRequest) {
+            oldestFile = file;
+            oldest = servedReference;
+        }
+    }
+    stHash_destructIterator(it);
+    st_logInfo("> Releasing reference %s, the least recently used\n", oldestFile);
+    stHash_removeAndFreeKey(servedReferences, oldestFile);
+    servedReference_destruct(oldest);
+}
+
+static stHash *getServedReferenceSequences(stHash *servedReferences, char *referenceFastaFile, int64_t requestNo) {
+    // references are kept between requests, and only reloaded if the file has changed
     struct stat fileStat;
-    int64_t rc = stat(base, &fileStat);
-    if (S_ISDIR(fileStat.st_mode)) {
-        if (optarg[strlen(base) - 1] == '/') optarg[strlen(base) - 1] = '\0';
-        return stString_print("%s/%s", base, defawlt);
+    if (stat(referenceFastaFile, &fileStat) != 0) {
+        return NULL;
+    }
+    ServedReference *servedReference = stHash_search(servedReferences, referenceFastaFile);
+    if (servedReference != NULL && servedReference->modificationTime == fileStat.st_mtime) {
+        servedReference->lastRequest = requestNo;
+        return servedReference->referenceSequences;
+    }
+    if (servedReference != NULL) {
+        stHash_removeAndFreeKey(servedReferences, referenceFastaFile);
+        servedReference_destruct(servedReference);
+    }
+    while (stHash_size(servedReferences) >= SERVER_MAX_REFERENCES) {
+        evictLeastRecentlyServedReference(servedReferences);
+    }
+    servedReference = st_calloc(1, sizeof(ServedReference));
+    servedReference->modificationTime = fileStat.st_mtime;
+    servedReference->lastRequest = requestNo;
+    servedReference->referenceSequences = parseReferenceSequences(referenceFastaFile);
+    stHash_insert(servedReferences, stString_copy(referenceFastaFile), servedReference);
+    return servedReference->referenceSequences;
+}
+
+static char *getRequestField(char **request) {
+    // splits off the next tab separated field of the request
+    char *field = *request;
+    char *tab = strchr(field, '\t');
+    if (tab == NULL) {
+        *request = field + strlen(field);
     } else {
-        return stString_copy(base);
+        *tab = '\0';
+        *request = tab + 1;
+    }
+    return field;
+}
+
+static void polishRequest(stList *bamInFiles, char *referenceFastaFile, char *regionStr, stHash *referenceSequences,
+                          Params *params, FILE *responseFh) {
+    /*
+     * Polishes a request, in the child process serving it.
+     */
+
+    // a bad region, contig, index or header is reported with the reason
+    setCramReferenceFasta(referenceFastaFile);
+    char *inputError = bamChunker_checkInputs(bamInFiles, regionStr);
+    if (inputError != NULL) {
+        fprintf(responseFh, "ERROR %s\n", inputError);
+        free(inputError);
+        return;
+    }
+
+    BamChunker *bamChunker = bamChunker_construct3(bamInFiles, regionStr, params->polishParams);
+    PolishOutputOptions options = {
+            .helenFeatureType = HFEAT_NONE,
+            .splitWeightMaxRunLength = POAFEATURE_SPLIT_MAX_RUN_LENGTH_DEFAULT,
+            .featuresWritten = TRUE
+    };
+    polishChunks(bamChunker, referenceSequences, params, &options, responseFh);
+    bamChunker_destruct(bamChunker);
+}
+
+static char *getLastLine(FILE *fh) {
+    // the last non-empty line of the file, or NULL if there is none
+    char *lastLine = NULL, *line;
+    rewind(fh);
+    while ((line = stFile_getLineFromFile(fh)) != NULL) {
+        if (strlen(line) > 0) {
+            free(lastLine);
+            lastLine = line;
+        } else {
+            free(line);
+        }
+    }
+    return lastLine;
+}
+
+static void copyFile(FILE *fromFh, FILE *toFh) {
+    char buffer[65536];
+    size_t n;
+    rewind(fromFh);
+    while ((n = fread(buffer, 1, sizeof(buffer), fromFh)) > 0) {
+        fwrite(buffer, 1, n, toFh);
+    }
+    fflush(toFh);
+}
+
+static bool serveRequest(char *request, stHash *servedReferences, int64_t requestNo, Params *params,
+                         FILE *responseFh) {
+    /*
+     * Handles a single request, writing the polished fasta (or an error line) to responseFh. Returns FALSE if the
+     * server should shut down.
+     */
+    int64_t requestLength = strlen(request);
+    while (requestLength > 0 && (request[requestLength - 1] == '\n' || request[requestLength - 1] == '\r')) {
+        request[--requestLength] = '\0';
+    }
+    if (stString_eq(request, "SHUTDOWN")) {
+        fprintf(responseFh, "OK\n");
+        return FALSE;
+    }
+
+    char *remaining = request;
+    char *bamInFile = getRequestField(&remaining);
+    char *referenceFastaFile = getRequestField(&remaining);
+    char *regionStr = getRequestField(&remaining);
+    if (strlen(regionStr) == 0) {
+        regionStr = NULL;
+    }
+    if (strlen(bamInFile) == 0 || strlen(referenceFastaFile) == 0) {
+        fprintf(responseFh, "ERROR Malformed request, expected BAM_FILE<TAB>ASSEMBLY_FASTA<TAB>REGION\n");
+        return TRUE;
+    }
+
+    // sanity check (verify files exist), the bams are comma separated as on the command line
+    stList *bamInFiles = stString_splitByString(bamInFile, ",");
+    char *unreadableFile = access(referenceFastaFile, R_OK) != 0 ? referenceFastaFile : NULL;
+    for (int64_t i = 0; i < stList_length(bamInFiles) && unreadableFile == NULL; i++) {
+        if (access(stList_get(bamInFiles, i), R_OK) != 0) {
+            unreadableFile = stList_get(bamInFiles, i);
+        }
+    }
+    if (unreadableFile != NULL) {
+        fprintf(responseFh, "ERROR Could not read from file: %s\n", unreadableFile);
+        stList_destruct(bamInFiles);
+        return TRUE;
+    }
+
+    st_logInfo("> Serving request %"PRId64" for %s against %s (for region=%s)\n", requestNo, bamInFile,
+               referenceFastaFile, regionStr == NULL ? "all" : regionStr);
+    time_t start = time(NULL);
+    stHash *referenceSequences = getServedReferenceSequences(servedReferences, referenceFastaFile, requestNo);
+
+    // polish in a child, which writes the response and its log to files the server then passes on
+    FILE *childResponseFh = tmpfile();
+    FILE *childLogFh = tmpfile();
+    if (childResponseFh == NULL || childLogFh == NULL) {
+        fprintf(responseFh, "ERROR Could not create temporary files: %s\n", strerror(errno));
+        if (childResponseFh != NULL) fclose(childResponseFh);
+        if (childLogFh != NULL) fclose(childLogFh);
+        stList_destruct(bamInFiles);
+        return TRUE;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fileno(childLogFh), STDERR_FILENO);
+        polishRequest(bamInFiles, referenceFastaFile, regionStr, referenceSequences, params, childResponseFh);
+        fflush(NULL);
+        _exit(0);
+    }
+    int status = 0;
+    if (pid < 0) {
+        fprintf(responseFh, "ERROR Could not start polishing: %s\n", strerror(errno));
+    } else {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+        copyFile(childLogFh, stderr);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            copyFile(childResponseFh, responseFh);
+        } else {
+            char *lastLine = getLastLine(childLogFh);
+            if (WIFSIGNALED(status)) {
+                fprintf(responseFh, "ERROR Polishing was killed by signal %d%s%s\n", WTERMSIG(status),
+                        lastLine == NULL ? "" : ", after: ", lastLine == NULL ? "" : lastLine);
+            } else {
+                fprintf(responseFh, "ERROR Polishing failed%s%s\n", lastLine == NULL ? "" : ": ",
+                        lastLine == NULL ? "" : lastLine);
+            }
+            free(lastLine);
+        }
+    }
+    fclose(childResponseFh);
+    fclose(childLogFh);
+    stList_destruct(bamInFiles);
+
+    st_logInfo("> Served request %"PRId64" in %d sec\n", requestNo, (int) (time(NULL) - start));
+    return TRUE;
+}
+
+int servePolishRequests(char *socketPath, Params *params) {
+    /*
+     * Listens on a Unix domain socket, handling one request per connection until a shutdown request is received.
+     */
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        st_errAbort("Socket path is too long: %s\n", socketPath);
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (serverFd < 0) {
+        st_errAbort("Could not create socket: %s\n", strerror(errno));
+    }
+    unlink(socketPath);
+    if (bind(serverFd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(serverFd, 16) != 0) {
+        st_errAbort("Could not listen on socket %s: %s\n", socketPath, strerror(errno));
+    }
+
+    // a client hanging up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    stHash *servedReferences = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free,
+                                                 (void (*)(void *)) servedReference_destruct);
+    st_logInfo("> Listening for polish requests on %s\n", socketPath);
+    bool running = TRUE;
+    for (int64_t requestNo = 0; running; requestNo++) {
+        int clientFd = accept(serverFd, NULL, NULL);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            st_errAbort("Could not accept connection on socket %s: %s\n", socketPath, strerror(errno));
+        }
+        FILE *requestFh = fdopen(clientFd, "r");
+        FILE *responseFh = fdopen(dup(clientFd), "w");
+
+        char *request = stFile_getLineFromFile(requestFh);
+        if (request != NULL) {
+            running = serveRequest(request, servedReferences, requestNo, params, responseFh);
+            free(request);
+        }
+
+        fclose(responseFh);
+        fclose(requestFh);
     }
+
+    // Cleanup
+    stHash_destruct(servedReferences);
+    close(serverFd);
+    unlink(socketPath);
+    st_logInfo("> Polish server shut down.\n");
+
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -82,9 +1375,17 @@ int main(int argc, char *argv[]) {
     char *referenceFastaFile = NULL;
     char *outputBase = stString_copy("output");
     char *regionStr = NULL;
+    char *regionBedFile = NULL;
     int numThreads = 1;
     char *outputRepeatCountBase = NULL;
     char *outputPoaTsvBase = NULL;
+    char *socketPath = NULL;
+    char *traceFile = NULL;
+    char *chunkReportFile = NULL;
+    bool diploid = FALSE;
+    char *alignmentCacheDir = NULL;
+    char *previousPolishFile = NULL;
+    char *editedRegionsFile = NULL;
 
     // for feature generation
     HelenFeatureType helenFeatureType = HFEAT_NONE;
@@ -93,6 +1394,11 @@ int main(int argc, char *argv[]) {
     bool fullFeatureOutput = FALSE;
     int64_t splitWeightMaxRunLength = POAFEATURE_SPLIT_MAX_RUN_LENGTH_DEFAULT;
     void **splitWeightHDF5Files = NULL;
+    void *splitWeightHDF5Writer = NULL;
+    bool singleFeatureFile = FALSE;
+    bool npyFeatures = FALSE;
+    char *splitWeightNpyDir = NULL;
+    bool featuresWritten = TRUE; // FALSE if any of the features could not be written, to exit with an error
 
     if(argc < 4) {
         free(outputBase);
@@ -101,8 +1407,13 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
-    bamInFile = stString_copy(argv[1]);
-    referenceFastaFile = stString_copy(argv[2]);
+    // server mode takes a socket in place of the bam and reference, these are given with each request
+    if (stString_eq(argv[1], "--serve")) {
+        socketPath = stString_copy(argv[2]);
+    } else {
+        bamInFile = stString_copy(argv[1]);
+        referenceFastaFile = stString_copy(argv[2]);
+    }
     paramsFile = stString_copy(argv[3]);
 
     // Parse the options
@@ -115,16 +1426,25 @@ int main(int argc, char *argv[]) {
                 #endif
                 { "outputBase", required_argument, 0, 'o'},
                 { "region", required_argument, 0, 'r'},
+                { "regionBed", required_argument, 0, 'b'},
+                { "diploid", no_argument, 0, 'd'},
                 { "produceFeatures", no_argument, 0, 'f'},
                 { "featureType", required_argument, 0, 'F'},
                 { "trueReferenceBam", required_argument, 0, 'u'},
                 { "splitRleWeightMaxRL", required_argument, 0, 'L'},
+                { "singleFeatureFile", no_argument, 0, 'H'},
+                { "npyFeatures", no_argument, 0, 'N'},
 				{ "outputRepeatCounts", required_argument, 0, 'i'},
 				{ "outputPoaTsv", required_argument, 0, 'j'},
+                { "traceFile", required_argument, 0, 'T'},
+                { "chunkReport", required_argument, 0, 'R'},
+                { "alignmentCache", required_argument, 0, 'A'},
+                { "previousPolish", required_argument, 0, 'P'},
+                { "editedRegions", required_argument, 0, 'E'},
                 { 0, 0, 0, 0 } };
 
         int option_index = 0;
-        int key = getopt_long(argc-2, &argv[2], "a:o:v:r:fF:u:hL:i:j:t:", long_options, &option_index);
+        int key = getopt_long(argc-2, &argv[2], "a:o:v:r:b:dfF:u:hL:HNi:j:t:T:R:A:P:E:", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -145,12 +1465,33 @@ int main(int argc, char *argv[]) {
         case 'r':
             regionStr = stString_copy(optarg);
             break;
+        case 'b':
+            regionBedFile = stString_copy(optarg);
+            break;
+        case 'd':
+            diploid = TRUE;
+            break;
         case 'i':
             outputRepeatCountBase = getFileBase(optarg, "repeatCount");
             break;
         case 'j':
             outputPoaTsvBase = getFileBase(optarg, "poa");
             break;
+        case 'T':
+            traceFile = stString_copy(optarg);
+            break;
+        case 'R':
+            chunkReportFile = stString_copy(optarg);
+            break;
+        case 'A':
+            alignmentCacheDir = stString_copy(optarg);
+            break;
+        case 'P':
+            previousPolishFile = stString_copy(optarg);
+            break;
+        case 'E':
+            editedRegionsFile = stString_copy(optarg);
+            break;
         case 'F':
             if (stString_eq(optarg, "simpleWeight")) {
                 helenFeatureType = HFEAT_SIMPLE_WEIGHT;
@@ -174,6 +1515,12 @@ int main(int argc, char *argv[]) {
                 st_errAbort("Invalid splitRleWeightMaxRL: %d", splitWeightMaxRunLength);
             }
             break;
+        case 'H':
+            singleFeatureFile = TRUE;
+            break;
+        case 'N':
+            npyFeatures = TRUE;
+            break;
         case 't':
             numThreads = atoi(optarg);
             if (numThreads <= 0) {
@@ -184,26 +1531,44 @@ int main(int argc, char *argv[]) {
             usage();
             free(outputBase);
             free(logLevelString);
-            free(bamInFile);
-            free(referenceFastaFile);
+            if (bamInFile != NULL) free(bamInFile);
+            if (referenceFastaFile != NULL) free(referenceFastaFile);
+            if (socketPath != NULL) free(socketPath);
             free(paramsFile);
             if (trueReferenceBam != NULL) free(trueReferenceBam);
+            if (traceFile != NULL) free(traceFile);
+            if (chunkReportFile != NULL) free(chunkReportFile);
+            if (alignmentCacheDir != NULL) free(alignmentCacheDir);
+            if (previousPolishFile != NULL) free(previousPolishFile);
+            if (editedRegionsFile != NULL) free(editedRegionsFile);
+            if (regionBedFile != NULL) free(regionBedFile);
             return 0;
         }
     }
 
+    // BAM_FILE may be a comma separated list of bams, polished as if they were merged
+    stList *bamInFiles = bamInFile == NULL ? NULL : stString_splitByString(bamInFile, ",");
+
     // sanity check (verify files exist)
-    if (access(bamInFile, R_OK ) != 0) {
-        st_errAbort("Could not read from file: %s\n", bamInFile);
-        char *idx = stString_print("%s.bai", bamInFile);
-        if (access(idx, R_OK ) != 0 ) {
-            st_errAbort("BAM does not appear to be indexed: %s\n", bamInFile);
+    for (int64_t i = 0; bamInFiles != NULL && i < stList_length(bamInFiles); i++) {
+        if (access(stList_get(bamInFiles, i), R_OK ) != 0) {
+            st_errAbort("Could not read from file: %s\n", (char *) stList_get(bamInFiles, i));
+        }
+    }
+    if (socketPath != NULL) {
+        if (access(paramsFile, R_OK ) != 0 ) {
+            st_errAbort("Could not read from file: %s\n", paramsFile);
         }
-        free(idx);
     } else if (access(referenceFastaFile, R_OK ) != 0 ) {
         st_errAbort("Could not read from file: %s\n", referenceFastaFile);
     } else if (access(paramsFile, R_OK ) != 0 ) {
         st_errAbort("Could not read from file: %s\n", paramsFile);
+    } else if (regionBedFile != NULL && access(regionBedFile, R_OK ) != 0 ) {
+        st_errAbort("Could not read from file: %s\n", regionBedFile);
+    } else if (previousPolishFile != NULL && access(previousPolishFile, R_OK ) != 0 ) {
+        st_errAbort("Could not read from file: %s\n", previousPolishFile);
+    } else if (editedRegionsFile != NULL && access(editedRegionsFile, R_OK ) != 0 ) {
+        st_errAbort("Could not read from file: %s\n", editedRegionsFile);
     } else if (trueReferenceBam != NULL && access(trueReferenceBam, R_OK ) != 0 ) {
         st_errAbort("Could not read from file: %s\n", trueReferenceBam);
         char *idx = stString_print("%s.bai", trueReferenceBam);
@@ -213,6 +1578,16 @@ int main(int argc, char *argv[]) {
         free(idx);
     }
 
+    if (regionStr != NULL && regionBedFile != NULL) {
+        st_errAbort("Only one of a region (-r) and a region BED file (-b) may be given\n");
+    }
+    if ((previousPolishFile == NULL) != (editedRegionsFile == NULL)) {
+        st_errAbort("The previous polish (-P) and edited regions (-E) must be given together\n");
+    }
+    if (previousPolishFile != NULL && (diploid || socketPath != NULL)) {
+        st_errAbort("Incremental polishing (-P and -E) cannot be used with diploid polishing or server mode\n");
+    }
+
     // Initialization from arguments
     st_setLogLevelFromString(logLevelString);
     free(logLevelString);
@@ -239,36 +1614,43 @@ int main(int argc, char *argv[]) {
             st_errAbort("Invalid runLengthEncoding parameter because of HELEN feature type.\n");
         }
     }
+    if (singleFeatureFile && helenFeatureType != HFEAT_SPLIT_RLE_WEIGHT) {
+        st_errAbort("A single feature file (-H) can only be written for the splitRleWeight feature type.\n");
+    }
+    if (npyFeatures && (helenFeatureType != HFEAT_SPLIT_RLE_WEIGHT || singleFeatureFile)) {
+        st_errAbort("NumPy features (-N) can only be written for the splitRleWeight feature type, and not with -H.\n");
+    }
+    # ifndef _HDF5
+    if (helenFeatureType != HFEAT_NONE && !npyFeatures) {
+        st_errAbort("HELEN features can only be written as NumPy arrays (-N), HDF5 is not built.\n");
+    }
+    # endif
 
     // Print a report of the parsed parameters
     if(st_getLogLevel() == debug) {
     	params_printParameters(params, stderr);
     }
 
-    // Parse reference as map of header string to nucleotide sequences
-    st_logInfo("> Parsing reference sequences from file: %s\n", referenceFastaFile);
-    FILE *fh = fopen(referenceFastaFile, "r");
-    stHash *referenceSequences = fastaReadToMap(fh);  //valgrind says blocks from this allocation are "still reachable"
-    fclose(fh);
-    // log names and transform (if necessary)
-    stList *refSeqNames = stHash_getKeys(referenceSequences);
-    int64_t origRefSeqLen = stList_length(refSeqNames);
-    st_logDebug("\tReference contigs: \n");
-    for (int64_t i = 0; i < origRefSeqLen; ++i) {
-        char *fullRefSeqName = (char *) stList_get(refSeqNames, i);
-        st_logDebug("\t\t%s\n", fullRefSeqName);
-        char refSeqName[128] = "";
-        if (sscanf(fullRefSeqName, "%s", refSeqName) == 1 && !stString_eq(fullRefSeqName, refSeqName)) {
-            // this transformation is necessary for cases where the reference has metadata after the contig name:
-            // >contig001 length=1000 date=1999-12-31
-            char *newKey = stString_copy(refSeqName);
-            char *refSeq = stHash_search(referenceSequences, fullRefSeqName);
-            stHash_insert(referenceSequences, newKey, refSeq);
-            stHash_removeAndFreeKey(referenceSequences, fullRefSeqName);
-            st_logDebug("\t\t\t-> %s\n", newKey);
-        }
+    // Serve polish requests until shut down, reusing the parsed parameters
+    if (socketPath != NULL) {
+        int rc = servePolishRequests(socketPath, params);
+        params_destruct(params);
+        if (trueReferenceBam != NULL) free(trueReferenceBam);
+        if (regionStr != NULL) free(regionStr);
+        if (regionBedFile != NULL) free(regionBedFile);
+        if (outputRepeatCountBase != NULL) free(outputRepeatCountBase);
+        if (outputPoaTsvBase != NULL) free(outputPoaTsvBase);
+        if (traceFile != NULL) free(traceFile);
+        if (chunkReportFile != NULL) free(chunkReportFile);
+        if (alignmentCacheDir != NULL) free(alignmentCacheDir);
+        free(outputBase);
+        free(socketPath);
+        free(paramsFile);
+        return rc;
     }
-    stList_destruct(refSeqNames);
+
+    stHash *referenceSequences = parseReferenceSequences(referenceFastaFile);
+    setCramReferenceFasta(referenceFastaFile);
 
     // Open output files
     char *polishedReferenceOutFile = stString_print("%s.fa", outputBase);
@@ -277,10 +1659,15 @@ int main(int argc, char *argv[]) {
     free(polishedReferenceOutFile);
 
     // get chunker for bam.  if regionStr is NULL, it will be ignored
-    BamChunker *bamChunker = bamChunker_construct2(bamInFile, regionStr, params->polishParams);
+    BamChunker *bamChunker = regionBedFile != NULL ?
+            bamChunker_constructFromBed2(bamInFiles, regionBedFile, params->polishParams) :
+            bamChunker_construct3(bamInFiles, regionStr, params->polishParams);
+    if (stList_length(bamInFiles) > 1) {
+        st_logInfo("> Polishing from the reads of %"PRId64" bams, as if merged\n", stList_length(bamInFiles));
+    }
     st_logInfo("> Set up bam chunker with chunk size %i and overlap %i (for region=%s), resulting in %i total chunks\n",
-    		   (int)bamChunker->chunkSize, (int)bamChunker->chunkBoundary, regionStr == NULL ? "all" : regionStr,
-    		   bamChunker->chunkCount);
+    		   (int)bamChunker->chunkSize, (int)bamChunker->chunkBoundary,
+    		   regionBedFile != NULL ? regionBedFile : (regionStr == NULL ? "all" : regionStr), bamChunker->chunkCount);
 
     // for feature generation
     BamChunker *trueReferenceBamChunker = NULL;
@@ -288,321 +1675,86 @@ int main(int argc, char *argv[]) {
         trueReferenceBamChunker = bamChunker_copyConstruct(bamChunker);
         free(trueReferenceBamChunker->bamFile);
         trueReferenceBamChunker->bamFile = stString_copy(trueReferenceBam);
+        stList_destruct(trueReferenceBamChunker->extraBamFiles);
+        trueReferenceBamChunker->extraBamFiles = stList_construct3(0, free);
+    }
+    if (npyFeatures) {
+        splitWeightNpyDir = stString_print("%s.features", outputBase);
+        struct stat npyDirStat;
+        if (stat(splitWeightNpyDir, &npyDirStat) != 0 && mkdir(splitWeightNpyDir, 0755) != 0) {
+            st_errAbort("Could not create feature directory: %s\n", splitWeightNpyDir);
+        }
+        st_logInfo("> Writing HELEN features as NumPy arrays in: %s\n", splitWeightNpyDir);
     }
     #ifdef _HDF5
-    if (helenFeatureType == HFEAT_SPLIT_RLE_WEIGHT) {
+    if (helenFeatureType == HFEAT_SPLIT_RLE_WEIGHT && singleFeatureFile) {
+        char *featureFile = stString_print("%s.h5", outputBase);
+        splitWeightHDF5Writer = splitRleFeatureHDF5Writer_construct(featureFile, splitWeightMaxRunLength,
+                                                                    trueReferenceBam != NULL, 2 * numThreads);
+        free(featureFile);
+    } else if (helenFeatureType == HFEAT_SPLIT_RLE_WEIGHT && !npyFeatures) {
         splitWeightHDF5Files = (void**) openSplitRleFeatureHDF5FilesByThreadCount(outputBase, numThreads);
     }
     #endif
 
-
-    // Polish chunks
-    // Each chunk produces a char* as output which is saved here
-    char **chunkResults = st_calloc(bamChunker->chunkCount, sizeof(char*));
-
-    // multiproccess the chunks, save to results
-    int64_t chunkIdx;
-    #pragma omp parallel for schedule(dynamic,1)
-    for (chunkIdx = 0; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
-        // Time all chunks
-        time_t start = time(NULL);
-
-        // Get chunk
-        BamChunk *bamChunk = bamChunker_getChunk(bamChunker, chunkIdx);
-        char *logIdentifier;
-        # ifdef _OPENMP
-        logIdentifier = stString_print(" T%02d_C%05"PRId64, omp_get_thread_num(), chunkIdx);
-        # else
-        logIdentifier = stString_copy("");
-        # endif
-
-        // Get reference string for chunk of alignment
-        char *fullReferenceString = stHash_search(referenceSequences, bamChunk->refSeqName);
-        if (fullReferenceString == NULL) {
-            st_logCritical("> ERROR: Reference sequence missing from reference map: %s \n", bamChunk->refSeqName);
-            continue;
-        }
-        int64_t fullRefLen = strlen(fullReferenceString);
-        assert(bamChunk->chunkBoundaryStart <= fullRefLen);
-        char *referenceString = stString_getSubString(fullReferenceString, bamChunk->chunkBoundaryStart,
-                                                      (fullRefLen < bamChunk->chunkBoundaryEnd ? fullRefLen
-                                                                                           : bamChunk->chunkBoundaryEnd) -
-                                                      bamChunk->chunkBoundaryStart);
-
-
-        st_logInfo(">%s Going to process a chunk for reference sequence: %s, starting at: %i and ending at: %i\n",
-                   logIdentifier, bamChunk->refSeqName, (int) bamChunk->chunkBoundaryStart,
-                   (int) (fullRefLen < bamChunk->chunkBoundaryEnd ? fullRefLen : bamChunk->chunkBoundaryEnd));
-
-        // Convert bam lines into corresponding reads and alignments
-        st_logInfo(">%s Parsing input reads from file: %s\n", logIdentifier, bamInFile);
-        stList *reads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
-        stList *alignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
-        convertToReadsAndAlignments(bamChunk, reads, alignments);
-
-        // do downsampling if appropriate
-        if (params->polishParams->maxDepth > 0) {
-            // get downsampling structures
-            stList *filteredReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
-            stList *discardedReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
-            stList *filteredAlignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
-            stList *discardedAlignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
-
-            bool didDownsample = poorMansDownsample(params->polishParams->maxDepth, bamChunk, reads, alignments,
-                    filteredReads, filteredAlignments, discardedReads, discardedAlignments);
-
-            // we need to destroy the discarded reads and structures
-            if (didDownsample) {
-                st_logInfo(" %s Downsampled from %"PRId64" to %"PRId64" reads\n", logIdentifier,
-                        stList_length(reads), stList_length(filteredReads));
-                // free all reads and alignments not used
-                stList_destruct(discardedReads);
-                stList_destruct(discardedAlignments);
-                // still has all the old reads, need to not free these
-                stList_setDestructor(reads, NULL);
-                stList_setDestructor(alignments, NULL);
-                stList_destruct(reads);
-                stList_destruct(alignments);
-                // and keep the filtered reads
-                reads = filteredReads;
-                alignments = filteredAlignments;
-            }
-            // no downsampling, we just need to free the (empty) objects
-            else {
-                stList_destruct(filteredReads);
-                stList_destruct(filteredAlignments);
-                stList_destruct(discardedReads);
-                stList_destruct(discardedAlignments);
-            }
-
-        }
-
-        Poa *poa = NULL; // The poa alignment
-        char *polishedConsensusString = NULL; // The polished reference string
-
-
-        // prep for RLE work
-        RleString *rleReference = NULL;
-        stList *rleNucleotides = stList_construct3(0, (void (*)(void *)) rleString_destruct);
-        stList *rleReads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
-        stList *rleAlignments = stList_construct3(0, (void (*)(void *)) stList_destruct);
-        uint64_t totalNucleotides = 0;
-
-        // Note RLE status (and handle reference)
-        if (params->polishParams->useRunLengthEncoding) {
-            st_logInfo(">%s Applying RLE\n", logIdentifier);
-            rleReference = rleString_construct(referenceString);
-        } else {
-            st_logInfo(">%s Skipping RLE\n", logIdentifier);
-            rleReference = rleString_constructNoRLE(referenceString);
-        }
-
-        // RLE the reads
-        for (int64_t j = 0; j < stList_length(reads); j++) {
-            BamChunkRead *read = stList_get(reads, j);
-            stList *alignment = stList_get(alignments, j);
-            RleString *rleNucleotideString = NULL;
-
-            // Perform or skip RLE
-            if (params->polishParams->useRunLengthEncoding) {
-                rleNucleotideString = rleString_construct(read->nucleotides);
-            } else {
-                rleNucleotideString = rleString_constructNoRLE(read->nucleotides);
-            }
-            totalNucleotides += rleNucleotideString->length;
-
-            // Do RLE follow up regardless of whether RLE is applied
-            stList_append(rleNucleotides, rleNucleotideString);
-            stList_append(rleReads, bamChunkRead_constructRLECopy(read, rleNucleotideString));
-            stList_append(rleAlignments, runLengthEncodeAlignment(alignment, rleReference, rleNucleotideString));
-        }
-
-
-        // Run the polishing method
-        st_logInfo(">%s Running polishing algorithm with %"PRId64" reads and %"PRIu64"K nucleotides\n",
-                logIdentifier, stList_length(reads), totalNucleotides >> 10);
-
-        // Generate partial order alignment (POA) (destroys rleAlignments in the process)
-        poa = poa_realignAll(rleReads, rleAlignments, rleReference->rleString, params->polishParams);
-
-        // Now optionally do phasing and haplotype specific polishing
-
-        /*TODO needs to be implemented
-        stList *anchorAlignments = poa_getAnchorAlignments(poa, NULL, stList_length(reads), params->polishParams);
-        stList *reads1, *reads2;
-        phaseReads(poa->refString, stList_length(poa->nodes)-1, l, anchorAlignments, &reads1, &reads2, params);
-        */
-
-        // get polished reference string and expand RLE (regardless of whether RLE was applied)
-        RleString *polishedRleConsensus = expandRLEConsensus(poa, rleNucleotides, rleReads,
-                                                             params->polishParams->repeatSubMatrix);
-        polishedConsensusString = rleString_expand(polishedRleConsensus);
-
-        // Log info about the POA
-        if (st_getLogLevel() >= info) {
-            st_logInfo(">%s Summary stats for POA:\t", logIdentifier);
-            poa_printSummaryStats(poa, stderr);
+    // for the alignment cache
+    uint64_t paramsFingerprint = 0;
+    if (alignmentCacheDir != NULL) {
+        struct stat cacheDirStat;
+        if (stat(alignmentCacheDir, &cacheDirStat) != 0 && mkdir(alignmentCacheDir, 0755) != 0) {
+            st_errAbort("Could not create alignment cache directory: %s\n", alignmentCacheDir);
         }
-        if (st_getLogLevel() >= debug) {
-            poa_print(poa, stderr, rleReads, 5, 5);
-        }
-
-        // Write any optional outputs about repeat count and POA, etc.
-        if(outputPoaTsvBase != NULL) {
-            char *outputPoaTsvFilename = stString_print("%s.poa.C%05"PRId64".%s-%"PRId64"-%"PRId64".tsv",
-                                                        outputPoaTsvBase, chunkIdx, bamChunk->refSeqName,
-                                                        bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
-            FILE *outputPoaTsvFileHandle = fopen(outputPoaTsvFilename, "w");
-            poa_printTSV(poa, outputPoaTsvFileHandle, rleReads, 5, 0);
-            fclose(outputPoaTsvFileHandle);
-            free(outputPoaTsvFilename);
-        }
-        if(outputRepeatCountBase != NULL) {
-            char *outputRepeatCountFilename = stString_print("%s.repeatCount.C%05"PRId64".%s-%"PRId64"-%"PRId64".tsv",
-                                                             outputRepeatCountBase, chunkIdx, bamChunk->refSeqName,
-                                                             bamChunk->chunkBoundaryStart, bamChunk->chunkBoundaryEnd);
-            FILE *outputRepeatCountFileHandle = fopen(outputRepeatCountFilename, "w");
-            poa_printRepeatCounts(poa, outputRepeatCountFileHandle, rleNucleotides, rleReads);
-            fclose(outputRepeatCountFileHandle);
-            free(outputRepeatCountFilename);
-        }
-
-
-        // save polished reference string to chunk output array
-        chunkResults[chunkIdx] = polishedConsensusString;
-
-        // HELEN feature outputs
-
-        #ifdef _HDF5
-        if (helenFeatureType != HFEAT_NONE) {
-            handleHelenFeatures(outputBase, helenFeatureType, trueReferenceBamChunker, splitWeightMaxRunLength,
-                    splitWeightHDF5Files, fullFeatureOutput, trueReferenceBam, params, logIdentifier, chunkIdx,
-                    bamChunk, poa, rleReads, rleNucleotides, polishedConsensusString, polishedRleConsensus);
-
-        }
-        #endif
-
-        // report timing
-        st_logInfo(">%s Chunk with %"PRId64" reads and %"PRIu64"K nucleotides processed in %d sec\n",
-                   logIdentifier, stList_length(reads), totalNucleotides >> 10, (int) (time(NULL) - start));
-
-        // Cleanup
-        stList_destruct(rleNucleotides);
-        stList_destruct(rleReads);
-        stList_destruct(rleAlignments);
-        rleString_destruct(rleReference);
-        rleString_destruct(polishedRleConsensus);
-        poa_destruct(poa);
-        stList_destruct(reads);
-        stList_destruct(alignments);
-        free(referenceString);
-        free(logIdentifier);
-    }
-
-    // merge chunks
-    st_logInfo("> Merging polished reference strings from %"PRIu64" chunks.\n", bamChunker->chunkCount);
-    stList *polishedReferenceStrings = NULL; // The polished reference strings, one for each chunk
-    char *referenceSequenceName = NULL;
-    int64_t spacerSize = (bamChunker->chunkBoundary == 0 ? 50 : bamChunker->chunkBoundary * 3);
-    char *missingChunkSpacer = st_calloc(spacerSize + 1, sizeof(char));
-    for (int64_t i = 0; i < spacerSize; i++) {
-        missingChunkSpacer[i] = 'N';
-    }
-    missingChunkSpacer[spacerSize] = '\0';
-    for (chunkIdx = 0; chunkIdx < bamChunker->chunkCount; chunkIdx++) {
-        // Get chunk and polished
-        BamChunk *bamChunk = bamChunker_getChunk(bamChunker, chunkIdx);
-        char* polishedReferenceString = chunkResults[chunkIdx];
-        int64_t prsLen = strlen(polishedReferenceString);
-        st_logInfo(" T%02d_C%05"PRId64" (%.3f): consensus sequence length %"PRId64"\n",
-                omp_get_thread_num(), chunkIdx, 1.0 * chunkIdx / bamChunker->chunkCount, prsLen);
-
-		// If there is no prior chunk for this contig
-		if(referenceSequenceName == NULL) {
-			polishedReferenceStrings = stList_construct3(0, free);
-			referenceSequenceName = stString_copy(bamChunk->refSeqName);
-		}
-		// Else, print the prior reference sequence if current chunk not part of that sequence
-		else if(!stString_eq(bamChunk->refSeqName, referenceSequenceName)) {
-			assert(stList_length(polishedReferenceStrings) > 0);
-
-			// Write the previous polished reference string out
-			char *s = stString_join2("", polishedReferenceStrings);
-			fastaWrite(s, referenceSequenceName, polishedReferenceOutFh);
-
-			// Clean up
-			free(s);
-			stList_destruct(polishedReferenceStrings);
-			free(referenceSequenceName);
-
-			// Reset for next reference sequence
-			polishedReferenceStrings = stList_construct3(0, free);
-			referenceSequenceName = stString_copy(bamChunk->refSeqName);
-		}
-		// If there was a previous chunk then trim it's polished reference sequence
-		// to remove overlap with the current chunk's polished reference sequence
-		else if(stList_length(polishedReferenceStrings) > 0) {
-			char *previousPolishedReferenceString = stList_peek(polishedReferenceStrings);
-			int64_t pprsLen = strlen(previousPolishedReferenceString);
-
-			// Trim the currrent and previous polished reference strings to remove overlap
-			int64_t prefixStringCropEnd, suffixStringCropStart;
-			int64_t overlapMatchWeight = removeOverlap(previousPolishedReferenceString, polishedReferenceString,
-													   bamChunker->chunkBoundary * 2, params->polishParams,
-													   &prefixStringCropEnd, &suffixStringCropStart);
-
-			// we have an overlap
-			if (overlapMatchWeight > 0) {
-                st_logInfo(
-                        "  Removed overlap between neighbouring chunks. Approx overlap size: %i, overlap-match weight: %f, "
-                        "left-trim: %i, right-trim: %i:\n", (int) bamChunker->chunkBoundary * 2,
-                        (float) overlapMatchWeight / PAIR_ALIGNMENT_PROB_1,
-                        strlen(previousPolishedReferenceString) - prefixStringCropEnd, suffixStringCropStart);
-
-                // Crop the suffix of the previous chunk's polished reference string
-                previousPolishedReferenceString[prefixStringCropEnd] = '\0';
-
-                // Crop the the prefix of the current chunk's polished reference string
-                char *c = polishedReferenceString;
-                polishedReferenceString = stString_copy(&(polishedReferenceString[suffixStringCropStart]));
-                free(c);
-
-            // no good alignment, could be missing chunks
-            } else {
-                if (prsLen == 0) {
-                    st_logInfo("  No overlap found. Filling empty chunk with Ns.\n");
-                    char *c = polishedReferenceString;
-                    polishedReferenceString = stString_copy(missingChunkSpacer);
-                    free(c);
-                } else {
-                    st_logInfo("  No overlap found. Filling Ns in stitch position.\n");
-                    stList_append(polishedReferenceStrings, stString_copy("NNNNNNNNNN"));
-                }
-			}
-		}
-
-		// Add the polished sequence to the list of polished reference sequence chunks
-		stList_append(polishedReferenceStrings, polishedReferenceString);
-
+        paramsFingerprint = alignmentCache_getParamsFingerprint(paramsFile);
+        st_logInfo("> Caching read alignments in: %s\n", alignmentCacheDir);
     }
 
-    // Write out the last chunk
-    if(referenceSequenceName != NULL) {
-    	// Write the previous polished reference string out
-    	char *s = stString_join2("", polishedReferenceStrings);
-    	fastaWrite(s, referenceSequenceName, polishedReferenceOutFh);
-
-    	// Clean up
-    	free(s);
-    	stList_destruct(polishedReferenceStrings);
-    	free(referenceSequenceName);
+    // polish and write out the chunks
+    PolishOutputOptions options = {
+            .outputBase = outputBase,
+            .outputRepeatCountBase = outputRepeatCountBase,
+            .outputPoaTsvBase = outputPoaTsvBase,
+            .helenFeatureType = helenFeatureType,
+            .trueReferenceBamChunker = trueReferenceBamChunker,
+            .trueReferenceBam = trueReferenceBam,
+            .splitWeightMaxRunLength = splitWeightMaxRunLength,
+            .splitWeightHDF5Files = splitWeightHDF5Files,
+            .splitWeightHDF5Writer = splitWeightHDF5Writer,
+            .splitWeightNpyDir = splitWeightNpyDir,
+            .fullFeatureOutput = fullFeatureOutput,
+            .trace = traceFile == NULL ? NULL : traceWriter_construct(traceFile),
+            .chunkReportWriter = chunkReportFile == NULL ? NULL : chunkReportWriter_construct(chunkReportFile),
+            .diploid = diploid,
+            .alignmentCacheDir = alignmentCacheDir,
+            .paramsFingerprint = paramsFingerprint,
+            .featuresWritten = TRUE
+    };
+    if (previousPolishFile != NULL) {
+        st_logInfo("> Re-polishing the intervals in %s, splicing them into: %s\n", editedRegionsFile,
+                   previousPolishFile);
+        stHash *previousPolishedSequences = parseReferenceSequences(previousPolishFile);
+        stHash *editedIntervals = parseEditedIntervals(editedRegionsFile);
+        polishChunksIncrementally(bamChunker, referenceSequences, previousPolishedSequences, editedIntervals, params,
+                                  &options, polishedReferenceOutFh);
+        stHash_destruct(previousPolishedSequences);
+        stHash_destruct(editedIntervals);
+    } else {
+        polishChunks(bamChunker, referenceSequences, params, &options, polishedReferenceOutFh);
     }
     fclose(polishedReferenceOutFh);
-    free(missingChunkSpacer);
+    traceWriter_destruct(options.trace);
+    chunkReportWriter_destruct(options.chunkReportWriter);
+    featuresWritten = options.featuresWritten;
+    if (alignmentCacheDir != NULL) {
+        st_logInfo("> Alignment cache hit rate: %"PRId64" of %"PRId64" read alignments reused (%.1f%%)\n",
+                   options.alignmentCacheHits, options.alignmentCacheLookups,
+                   options.alignmentCacheLookups == 0 ? 0.0 :
+                   100.0 * options.alignmentCacheHits / options.alignmentCacheLookups);
+    }
 
     // Cleanup
     st_logInfo("> Finished polishing.\n");
     bamChunker_destruct(bamChunker);
+    closeCachedAlignmentFiles();
     stHash_destruct(referenceSequences);
     params_destruct(params);
 
@@ -610,22 +1762,37 @@ int main(int argc, char *argv[]) {
     if (trueReferenceBamChunker != NULL) bamChunker_destruct(trueReferenceBamChunker);
 
     if (regionStr != NULL) free(regionStr);
+    if (regionBedFile != NULL) free(regionBedFile);
     #ifdef _HDF5
     if (splitWeightHDF5Files != NULL) {
         for (int64_t i = 0; i < numThreads; i++) {
             splitRleFeatureHDF5FileInfo_destruct((SplitRleFeatureHDF5FileInfo*) splitWeightHDF5Files[i]);
         }
     }
+    if (splitWeightHDF5Writer != NULL) {
+        featuresWritten = splitRleFeatureHDF5Writer_destruct((SplitRleFeatureHDF5Writer*) splitWeightHDF5Writer)
+                && featuresWritten;
+    }
     #endif
-    free(chunkResults);
+    if (splitWeightNpyDir != NULL) free(splitWeightNpyDir);
     free(outputBase);
     free(bamInFile);
+    stList_destruct(bamInFiles);
     free(referenceFastaFile);
     free(paramsFile);
+    if (traceFile != NULL) free(traceFile);
+    if (chunkReportFile != NULL) free(chunkReportFile);
+    if (alignmentCacheDir != NULL) free(alignmentCacheDir);
+    if (previousPolishFile != NULL) free(previousPolishFile);
+    if (editedRegionsFile != NULL) free(editedRegionsFile);
 
 
 //    while(1); // Use this for testing for memory leaks
 
+    if (!featuresWritten) {
+        st_logCritical("> Some HELEN features could not be written, the feature output is incomplete\n");
+        return 1;
+    }
     return 0;
 }
 
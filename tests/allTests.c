@@ -15,6 +15,7 @@ CuSuite* viewTestSuite(void);
 CuSuite* chunkingTestSuite(void);
 CuSuite* callConsensusTestSuite(void);
 CuSuite* featureTestSuite(void);
+CuSuite* performanceTestSuite(void);
 
 
 // New tests for marginPhase interface
@@ -29,9 +30,29 @@ int marginPhaseTests(void) {
 	CuSuiteAddSuite(suite, viewTestSuite());
 	CuSuiteAddSuite(suite, chunkingTestSuite());
 	CuSuiteAddSuite(suite, callConsensusTestSuite());
-    #ifdef _HDF5
 	CuSuiteAddSuite(suite, featureTestSuite());
-    #endif
+
+	// timed regression cases only run for a named machine profile
+	if (getenv("MARGIN_PERF_PROFILE") != NULL) {
+		CuSuiteAddSuite(suite, performanceTestSuite());
+	}
+
+	CuSuiteRun(suite);
+	CuSuiteSummary(suite, output);
+	CuSuiteDetails(suite, output);
+	printf("%s\n", output->buffer);
+	int i = suite->failCount > 0;
+	CuSuiteDelete(suite);
+	CuStringDelete(output);
+	return i;
+}
+
+// Only the timed regression cases, see tests/performanceTest.c
+int performanceTests(void) {
+	CuString *output = CuStringNew();
+	CuSuite* suite = CuSuiteNew();
+
+	CuSuiteAddSuite(suite, performanceTestSuite());
 
 	CuSuiteRun(suite);
 	CuSuiteSummary(suite, output);
@@ -44,8 +65,17 @@ int marginPhaseTests(void) {
 }
 
 int main(int argc, char *argv[]) {
-    if(argc == 2) {
-        st_setLogLevelFromString(argv[1]);
+    // usage: allTests [--performance] [logLevel]
+    bool performanceOnly = argc >= 2 && stString_eq(argv[1], "--performance");
+    if(argc == 2 + performanceOnly) {
+        st_setLogLevelFromString(argv[1 + performanceOnly]);
+    }
+    if(performanceOnly) {
+        if(getenv("MARGIN_PERF_PROFILE") == NULL) {
+            fprintf(stderr, "Set MARGIN_PERF_PROFILE to the machine profile to compare against\n");
+            return 1;
+        }
+        return performanceTests();
     }
 	int i = marginPhaseTests();
 
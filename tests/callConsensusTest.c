@@ -11,6 +11,101 @@
 static char *polishParamsFile = "../params/allParams.np.json";
 
 
+static char *readSet1[] = {
+        "CATTTTTCTCCTCCACCTGCAACAGAAGATAAAAACGCGCATCACAAACTACTTTATTG",
+        "CATTTTTCTCTCCGTCACGTAATAGGAAAACAGATGAAAATGTGCACCATAAAACGCATTTTTATTT",
+        "CATTTTCTCTCTCCGTCACGACAGGAAACAGATGAAAATGGGCACAAGACCACAAACGCATTTTGAT",
+        "CATTTTTCTCCGGTCATTTAATGAAAACAGATGGTACTGCGTATGTGACATAAACGCATTTTTATTT",
+        "CATTTCCTCCGTCACTGCACAGGAAAACAGATGAAAATGCAAGTATGGACCCACAAAACGCATTTTATTT",
+        "CATTTTTTCTCTCTCCGTCAGCTGCATTGAAAATGATGAAATGCGGGTATGACTATAAACGCATTTATTT",
+        "CATTTTTTTTCTCTCCTCCACACACAGGAAACAGATGAAAAATGTATGTGACCATAAAACGCATTTTATTT",
+        "TATTTTCTCCGTCATTGCAGGAAAACAGATGAAATGTAAAGTATGTGAATTACAAACGGTTTTTTTTATTT",
+        "CATTTTTCTCCTCCGTCATTGCACAGGAGTCAGATGAAAATGCGCATGTGACCATAACGCATTTTTTTATTT",
+        "CATTTTTCTCCTCCGTCATACCGTGAAACAGATGAAAAATGCGGGCATGGGACCATAAAACGCATTTTTATTT",
+        "CATTTTTCTCCTCCGTCATTGCACAGGAAAACAGATGAAAACGTGGGGCATGTGACCATAAACGCATTTTTATT",
+        "CATTTTCTCTCCTCGTGTTGCACAGGAAAACAGATGAAAAATGCGAGATATGTGATCCACAAACATTTTTATTT",
+        "CATTTTTCTCCTCCGTCATTGCACAGGAAAATGATGAAAATGCGGGGCATGTGACCATAAAACGCATTTTTATTT",
+        "CATTTTCTCTCTCCCTCGTCATTGCACAGGAAAACAGATGAAAATGCAGGGCATGTGACCATAAAACGCATTTTTT",
+        "CATTTTCTCTCCTCCACATTGCACAGGAAAACAGATGAAAATGCGGCATGTGACCATAAAACGCATTTCTTTATTT",
+        "CATTTTCTCCGTCAGTCAACAATATGAAAACAGATGAAACGCGGGCACGTGACCATAAAACGCATTTTTTTTATTT",
+        "CATTTTTCTCCTCCGTCATTGCATTGTGGAACAGATGAAAATGCGGGGTATGTGAATCATAAAACGCATTTTATTT",
+        "CATTTTTCTCTCCGTCATTGCATTAGAAAACAGGGATGAAAATGCGGGCATGTGACCATAAAAACGCATTTTTATTT",
+        "CATTTTTCTCTCTCCTCCGTCATTGCACAGGAAAACAGATGAAAAATGCGCGTGACTATAAAACGCATTTTTATTTT",
+        "CATTTTCCTCTCCCTCCGTCATTTGCACAGGAAAACAGATGAAAAAATGCGGAATGGCTATTATAAACATTTTTAACT",
+        "CATTTTTTTCTCCTCTGTCATTGCACAGGAAAACAGATGAAAAATGCGTATGTGACCATAAAATCCATTTCTTTTATTT",
+        "CATTTTTCTCCTCCGTCATTGCACAGGAAAATGATGAAAAAATGCGGGCATGTGACCATAAAACGTGCATTTTTTATTT",
+        "CATTTTCTCTCTCCTCCGTGTTGCACAGGAAAACCAGATGAAAATGCGGAACATGTGTTCATAAAACGCATTTTTATTT",
+        "CATTTTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAATGCAGGGCAATAATGACCATAAAACGCATTTTTATTT",
+        "CATTTTCTCTCCTCTCGTCATTTGCACAGGAAGAGCAGATGAAAATGCAGGGCATGTGACCATAAAACGCATTTTTATTT",
+        "CCATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAAGCAGATGAAAAATGCGGGCATGTGACCATAAAACGCATTTTATTT",
+        "CATTTTTTTCTCTCCTGTCATTGCACAGGAAACAAAGAGATGAAAAATGCGGGCATGTGACCATAAAACGCATTTTTATTT",
+        "CATTTTTCTCTCCCTCCGTCATTGCATAGGAAAACAGATGAAAATGCGGGGTATGTGGACCATAAAACGCATTTTTTATTT",
+        "CATTTTCTCTCTCCCTCCGTCATTGCACAGGGAAAACAGATGAAAATTGCGGGGCATGTGACCATAAAACGCATTTTTATTT",
+        "CATTTTCTCTCTCCCTCCGTCATTTGCACAGGAAAACAGATGAAAAATGCGGGGCATGTGACCATAAAACGCATTTTTTATTT",
+        "CATTTTTCTCTCCCTCCGTCACTGCACAGGAAAAACAGATGAAAATGCGGGGCATGCATCATAAAACGTATTTTTATTGAATTT",
+        "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATAAGAAAAATGCAGGGGCATGTGACCATAAAACGCATTTTTATTT",
+        "CATTTTTTCACTACTCTCCCTCCGTCGTACTGGAAAACAAACAGATAAATGCAGGGCATGTGACCATAAAACATTTTTTTATTT",
+        "CATTTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATAAAAAAAAATGCAGGGGCATGTGACCATAAAACATTTTTATTT",
+        "CATTTTTTCTCTCTCTCGTGTTGCACACAGGAAAACAGATGAAAAATGCCGGGGCATCATGACCATAAAACGCGTTTTTTTATTT",
+        "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAAATGCAGGGGCGTAACTGACCATAAAACGCATTTTTTATTT",
+        "CATTTTTTCTCTCCTCCGTCATTGCACAGGAAAAATGTGATGAAAATGCGGGGTATGTGACCATAAAACGCATTTTTATGCTTCT",
+        "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAAATGCGAGGACATGTGACCATAAAACGCATTTTTTTTATTT",
+        "CATTTTCTCTCTCCCTCCGTCCATTGCACAGGAAAACAGATATAAAAAATGCAGGGCATCAAACCATAAAACATTTTTTTTATTT",
+        "CATTTTTCTCTCCCTCCGTCATTGCAATAGGAAAACAGATATTTTGGTGTACCGCAAGTATGTGACCATAAAACGTATTTTTATTT",
+        "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACCAGATAGAAAAAATACAGGGCATGTGTTCATAAAGCACGCATTTTTATTT",
+        "CATTTTTTTCTCTCTCCTCCGCTTTCACACACAGGAGTAAACAGATGAAAAATGTGGGCATGTGACCATAAAACGCATTTTTTATTT",
+        "CATTTTCTCTCTCCCTCAAAATCATTTGCACAGGAAAACAGATAGAAAAATGCAACGGGGCATGTGATATAAAACGCATTTTTTATTT",
+        "CATTTTCTACTCTCTCCCTCCGTCATTGCAGGAAAACAGATGAAAATGCAGGGAACATATATGACCATAAAACGCATTTTTTTTTATTT",
+        "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAAAAGAGCTGGCATGCGGGGCATGTGACCATAAAACGCATTTTTTTGT"
+};
+static int readSet1Count = 45;
+
+static char *readSet2[] = {
+        "GATGTAAAAATGACTGAGTTAGAACAGGCATAAATACATCTGT",
+        "GATGTAAAAAAAAATGACAGAGAATAAAACTATCCTTATCTATT",
+        "GATGTAAAAAGAAGCGGAAGTTAGAACAGGCATAAATACATCTGT",
+        "GATGTAAAAAGAAATGACGGAAGAACAGAGCATAACACACATCTGT",
+        "GATGTAAAAAAAGAATGATTTAGTTGAACAGAGCATAAATATCTGT",
+        "GATGTAAAAAAAAGAAATGACGGAAGAACAGAGCATAACACATCTGT",
+        "GATGTAAAAGAAATGGAGGTTAGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAGAAATGATTTGGAAGAACAGAGCATAAATATCTGT",
+        "GATGTAAAAGAAATGACGGAAGTTAGAATATATATAACACACATCTGT",
+        "GATGTAAAAAAAGAATGGACGGTTAGAACAGAGCACAACACACATCTGT",
+        "GATGTAAAAAAGAATGATAAAGTTAGAATAGAGCATAAATAACATCTGT",
+        "GATGTAAAAGAAATGTGGAAGTTAGAACAGAGCATAAATACACATCTAT",
+        "GATGTAAAAAAAAAGAAATGAAGCTAGAACAGAGCATAAATACATCTGT",
+        "GATGTAAAAAAAAAATGACCCGGAAGTTGAACAGAGCATAATACATCTGT",
+        "GATGTAAAAAAGAAATGATTTAAAGGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAAGTGACGGAAGTTAAGACAGGCATAAATACACATCTGT",
+        "GATGTAAAAAAGAAATGATTTGCTAGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAGAAATGATGGGTTAGAATAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAAGAAATGACGAGTTAGAACCAGAGCACCATCTACATCAT",
+        "GATGTAAAAAAAAAAATGACGGAAGTTAGACAAGCATAAATACACATCTAT",
+        "GATGTAAAAAAAAGAATGATTTGAAGTTAGAACAGAGCATAACACATCTGT",
+        "GATGTAAAAGAAAATCGACTGAAGTTAGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAGAATGACGGAAGTTAGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAGAAATGACGGAGTTAGAACAGAGCATAAATACACATCTAT",
+        "GATGTAAAAAAAAAGAAATGTGTGAGTTAAGACAGAGCATAAATACATCTAT",
+        "GATGTAAAAAAGAAATGACGGAAGTTAAGACAGAGCATAAATACACATCTATT",
+        "GATGTAAAAAAAAAAATGTGGAAGTTAAAACAGAGCATAAATACACATCTATT",
+        "GATGCAAAAAAAAAGAAATGACGGAAGTTAAATTAGAGCATAAATACATCTGT",
+        "GATGTAAAAAAAAGAAATGATTTGGAAGTTACAGAGCATAAATACACATCTGT",
+        "GATGTAAAGAAAATGATTTTAGAAGTTAGAACAGAGCATAACACAATATCTGT",
+        "GATAAAAAAAAAGGAATGATTGGAAGCTAGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAAGAAATGACGGAAGTTAAGACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAAATGACGGAAGTTCTGAAACAGGCATAAATACACATCTGTAT",
+        "GATGTAAAAAGAATGATTTGAAGTTAGAACAGAGTATATTAAATACACATCTGT",
+        "GATGTAAAAAAAAAGAAATGACGGAAGTTAAGACAGAGCATAAATACACATCTATT",
+        "GATGTAAAAAAAAAGAAATGATTTGAAGCAGAACAGAGCATAAATACAAGATCTGT",
+        "GATGTAAAAAAAAGAAGAAATGACGGAAGTTAAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAAAAGAAATGATTGAAGTTAGAAATATACATAAATACACATCTGT",
+        "GATGTAAAAAAAAAGAAATGATTTTAAAGTGAACAGAGCATAAATACACACCTTGGT",
+        "GATGTAAAAAAAAAAAAGAAATGACGGAAGTTGAACTAGGCTTATAAATACATCTGT",
+        "GATGCCAAAAAAAAAAAGAAATGGCCAGAGTTAGAACAGAGCATAAATACACATCTGT",
+        "GATGTAAAAAAAAAGAAATGCGGATTTGGAAGTTAGAACAGTATATAAAGCACACATCCGT"
+};
+static int readSet2Count = 42;
+
 void getCallConsensusDataFromReads(char *rawReads[], int readCount, char**rleReads[], uint8_t**rleCounts[], uint8_t *strands[]) {
     *rleReads = st_calloc(readCount, sizeof(char*));
     *rleCounts = st_calloc(readCount, sizeof(uint8_t*));
@@ -33,54 +128,8 @@ void getCallConsensusDataFromReads(char *rawReads[], int readCount, char**rleRea
 
 
 void test_readSet1(CuTest *testCase) {
-	char *rawReads[] = {
-            "CATTTTTCTCCTCCACCTGCAACAGAAGATAAAAACGCGCATCACAAACTACTTTATTG",
-            "CATTTTTCTCTCCGTCACGTAATAGGAAAACAGATGAAAATGTGCACCATAAAACGCATTTTTATTT",
-            "CATTTTCTCTCTCCGTCACGACAGGAAACAGATGAAAATGGGCACAAGACCACAAACGCATTTTGAT",
-            "CATTTTTCTCCGGTCATTTAATGAAAACAGATGGTACTGCGTATGTGACATAAACGCATTTTTATTT",
-            "CATTTCCTCCGTCACTGCACAGGAAAACAGATGAAAATGCAAGTATGGACCCACAAAACGCATTTTATTT",
-            "CATTTTTTCTCTCTCCGTCAGCTGCATTGAAAATGATGAAATGCGGGTATGACTATAAACGCATTTATTT",
-            "CATTTTTTTTCTCTCCTCCACACACAGGAAACAGATGAAAAATGTATGTGACCATAAAACGCATTTTATTT",
-            "TATTTTCTCCGTCATTGCAGGAAAACAGATGAAATGTAAAGTATGTGAATTACAAACGGTTTTTTTTATTT",
-            "CATTTTTCTCCTCCGTCATTGCACAGGAGTCAGATGAAAATGCGCATGTGACCATAACGCATTTTTTTATTT",
-            "CATTTTTCTCCTCCGTCATACCGTGAAACAGATGAAAAATGCGGGCATGGGACCATAAAACGCATTTTTATTT",
-            "CATTTTTCTCCTCCGTCATTGCACAGGAAAACAGATGAAAACGTGGGGCATGTGACCATAAACGCATTTTTATT",
-            "CATTTTCTCTCCTCGTGTTGCACAGGAAAACAGATGAAAAATGCGAGATATGTGATCCACAAACATTTTTATTT",
-            "CATTTTTCTCCTCCGTCATTGCACAGGAAAATGATGAAAATGCGGGGCATGTGACCATAAAACGCATTTTTATTT",
-            "CATTTTCTCTCTCCCTCGTCATTGCACAGGAAAACAGATGAAAATGCAGGGCATGTGACCATAAAACGCATTTTTT",
-            "CATTTTCTCTCCTCCACATTGCACAGGAAAACAGATGAAAATGCGGCATGTGACCATAAAACGCATTTCTTTATTT",
-            "CATTTTCTCCGTCAGTCAACAATATGAAAACAGATGAAACGCGGGCACGTGACCATAAAACGCATTTTTTTTATTT",
-            "CATTTTTCTCCTCCGTCATTGCATTGTGGAACAGATGAAAATGCGGGGTATGTGAATCATAAAACGCATTTTATTT",
-            "CATTTTTCTCTCCGTCATTGCATTAGAAAACAGGGATGAAAATGCGGGCATGTGACCATAAAAACGCATTTTTATTT",
-            "CATTTTTCTCTCTCCTCCGTCATTGCACAGGAAAACAGATGAAAAATGCGCGTGACTATAAAACGCATTTTTATTTT",
-            "CATTTTCCTCTCCCTCCGTCATTTGCACAGGAAAACAGATGAAAAAATGCGGAATGGCTATTATAAACATTTTTAACT",
-            "CATTTTTTTCTCCTCTGTCATTGCACAGGAAAACAGATGAAAAATGCGTATGTGACCATAAAATCCATTTCTTTTATTT",
-            "CATTTTTCTCCTCCGTCATTGCACAGGAAAATGATGAAAAAATGCGGGCATGTGACCATAAAACGTGCATTTTTTATTT",
-            "CATTTTCTCTCTCCTCCGTGTTGCACAGGAAAACCAGATGAAAATGCGGAACATGTGTTCATAAAACGCATTTTTATTT",
-            "CATTTTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAATGCAGGGCAATAATGACCATAAAACGCATTTTTATTT",
-            "CATTTTCTCTCCTCTCGTCATTTGCACAGGAAGAGCAGATGAAAATGCAGGGCATGTGACCATAAAACGCATTTTTATTT",
-            "CCATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAAGCAGATGAAAAATGCGGGCATGTGACCATAAAACGCATTTTATTT",
-            "CATTTTTTTCTCTCCTGTCATTGCACAGGAAACAAAGAGATGAAAAATGCGGGCATGTGACCATAAAACGCATTTTTATTT",
-            "CATTTTTCTCTCCCTCCGTCATTGCATAGGAAAACAGATGAAAATGCGGGGTATGTGGACCATAAAACGCATTTTTTATTT",
-            "CATTTTCTCTCTCCCTCCGTCATTGCACAGGGAAAACAGATGAAAATTGCGGGGCATGTGACCATAAAACGCATTTTTATTT",
-            "CATTTTCTCTCTCCCTCCGTCATTTGCACAGGAAAACAGATGAAAAATGCGGGGCATGTGACCATAAAACGCATTTTTTATTT",
-            "CATTTTTCTCTCCCTCCGTCACTGCACAGGAAAAACAGATGAAAATGCGGGGCATGCATCATAAAACGTATTTTTATTGAATTT",
-            "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATAAGAAAAATGCAGGGGCATGTGACCATAAAACGCATTTTTATTT",
-            "CATTTTTTCACTACTCTCCCTCCGTCGTACTGGAAAACAAACAGATAAATGCAGGGCATGTGACCATAAAACATTTTTTTATTT",
-            "CATTTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATAAAAAAAAATGCAGGGGCATGTGACCATAAAACATTTTTATTT",
-            "CATTTTTTCTCTCTCTCGTGTTGCACACAGGAAAACAGATGAAAAATGCCGGGGCATCATGACCATAAAACGCGTTTTTTTATTT",
-            "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAAATGCAGGGGCGTAACTGACCATAAAACGCATTTTTTATTT",
-            "CATTTTTTCTCTCCTCCGTCATTGCACAGGAAAAATGTGATGAAAATGCGGGGTATGTGACCATAAAACGCATTTTTATGCTTCT",
-            "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAAATGCGAGGACATGTGACCATAAAACGCATTTTTTTTATTT",
-            "CATTTTCTCTCTCCCTCCGTCCATTGCACAGGAAAACAGATATAAAAAATGCAGGGCATCAAACCATAAAACATTTTTTTTATTT",
-            "CATTTTTCTCTCCCTCCGTCATTGCAATAGGAAAACAGATATTTTGGTGTACCGCAAGTATGTGACCATAAAACGTATTTTTATTT",
-            "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACCAGATAGAAAAAATACAGGGCATGTGTTCATAAAGCACGCATTTTTATTT",
-            "CATTTTTTTCTCTCTCCTCCGCTTTCACACACAGGAGTAAACAGATGAAAAATGTGGGCATGTGACCATAAAACGCATTTTTTATTT",
-            "CATTTTCTCTCTCCCTCAAAATCATTTGCACAGGAAAACAGATAGAAAAATGCAACGGGGCATGTGATATAAAACGCATTTTTTATTT",
-            "CATTTTCTACTCTCTCCCTCCGTCATTGCAGGAAAACAGATGAAAATGCAGGGAACATATATGACCATAAAACGCATTTTTTTTTATTT",
-            "CATTTTCTCTCTCCCTCCGTCATTGCACAGGAAAACAGATGAAAAAAGAGCTGGCATGCGGGGCATGTGACCATAAAACGCATTTTTTTGT"
-    };
-    int readCount = 45;
+    char **rawReads = readSet1;
+    int readCount = readSet1Count;
 
     char **rleReads = NULL;
     uint8_t **rleCounts = NULL;
@@ -108,51 +157,8 @@ void test_readSet1(CuTest *testCase) {
 
 
 void test_readSet2(CuTest *testCase) {
-	char *rawReads[] = {
-            "GATGTAAAAATGACTGAGTTAGAACAGGCATAAATACATCTGT",
-            "GATGTAAAAAAAAATGACAGAGAATAAAACTATCCTTATCTATT",
-            "GATGTAAAAAGAAGCGGAAGTTAGAACAGGCATAAATACATCTGT",
-            "GATGTAAAAAGAAATGACGGAAGAACAGAGCATAACACACATCTGT",
-            "GATGTAAAAAAAGAATGATTTAGTTGAACAGAGCATAAATATCTGT",
-            "GATGTAAAAAAAAGAAATGACGGAAGAACAGAGCATAACACATCTGT",
-            "GATGTAAAAGAAATGGAGGTTAGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAGAAATGATTTGGAAGAACAGAGCATAAATATCTGT",
-            "GATGTAAAAGAAATGACGGAAGTTAGAATATATATAACACACATCTGT",
-            "GATGTAAAAAAAGAATGGACGGTTAGAACAGAGCACAACACACATCTGT",
-            "GATGTAAAAAAGAATGATAAAGTTAGAATAGAGCATAAATAACATCTGT",
-            "GATGTAAAAGAAATGTGGAAGTTAGAACAGAGCATAAATACACATCTAT",
-            "GATGTAAAAAAAAAGAAATGAAGCTAGAACAGAGCATAAATACATCTGT",
-            "GATGTAAAAAAAAAATGACCCGGAAGTTGAACAGAGCATAATACATCTGT",
-            "GATGTAAAAAAGAAATGATTTAAAGGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAAGTGACGGAAGTTAAGACAGGCATAAATACACATCTGT",
-            "GATGTAAAAAAGAAATGATTTGCTAGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAGAAATGATGGGTTAGAATAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAAGAAATGACGAGTTAGAACCAGAGCACCATCTACATCAT",
-            "GATGTAAAAAAAAAAATGACGGAAGTTAGACAAGCATAAATACACATCTAT",
-            "GATGTAAAAAAAAGAATGATTTGAAGTTAGAACAGAGCATAACACATCTGT",
-            "GATGTAAAAGAAAATCGACTGAAGTTAGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAGAATGACGGAAGTTAGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAGAAATGACGGAGTTAGAACAGAGCATAAATACACATCTAT",
-            "GATGTAAAAAAAAAGAAATGTGTGAGTTAAGACAGAGCATAAATACATCTAT",
-            "GATGTAAAAAAGAAATGACGGAAGTTAAGACAGAGCATAAATACACATCTATT",
-            "GATGTAAAAAAAAAAATGTGGAAGTTAAAACAGAGCATAAATACACATCTATT",
-            "GATGCAAAAAAAAAGAAATGACGGAAGTTAAATTAGAGCATAAATACATCTGT",
-            "GATGTAAAAAAAAGAAATGATTTGGAAGTTACAGAGCATAAATACACATCTGT",
-            "GATGTAAAGAAAATGATTTTAGAAGTTAGAACAGAGCATAACACAATATCTGT",
-            "GATAAAAAAAAAGGAATGATTGGAAGCTAGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAAGAAATGACGGAAGTTAAGACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAAATGACGGAAGTTCTGAAACAGGCATAAATACACATCTGTAT",
-            "GATGTAAAAAGAATGATTTGAAGTTAGAACAGAGTATATTAAATACACATCTGT",
-            "GATGTAAAAAAAAAGAAATGACGGAAGTTAAGACAGAGCATAAATACACATCTATT",
-            "GATGTAAAAAAAAAGAAATGATTTGAAGCAGAACAGAGCATAAATACAAGATCTGT",
-            "GATGTAAAAAAAAGAAGAAATGACGGAAGTTAAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAAAAGAAATGATTGAAGTTAGAAATATACATAAATACACATCTGT",
-            "GATGTAAAAAAAAAGAAATGATTTTAAAGTGAACAGAGCATAAATACACACCTTGGT",
-            "GATGTAAAAAAAAAAAAGAAATGACGGAAGTTGAACTAGGCTTATAAATACATCTGT",
-            "GATGCCAAAAAAAAAAAGAAATGGCCAGAGTTAGAACAGAGCATAAATACACATCTGT",
-            "GATGTAAAAAAAAAGAAATGCGGATTTGGAAGTTAGAACAGTATATAAAGCACACATCCGT"
-    };
-    int readCount = 42;
+    char **rawReads = readSet2;
+    int readCount = readSet2Count;
 
     char **rleReads = NULL;
     uint8_t **rleCounts = NULL;
@@ -179,11 +185,127 @@ void test_readSet2(CuTest *testCase) {
 }
 
 
+static RleString *callConsensusPerCluster(int64_t readCount, char *nucleotides[], uint8_t *runLengths[],
+                                          uint8_t strands[], PolishParams *params) {
+    // the per cluster code path callConsensus had before the batched API and its scratch space, each read built
+    // afresh, with the backbone getConsensusBackboneIndex picks rather than the first read
+    stList *rleReads = stList_construct3(0, (void (*)(void*)) bamChunkRead_destruct);
+    stList *rleStrings = stList_construct3(0, (void (*)(void *)) rleString_destruct);
+    for (int64_t i = 0; i < readCount; i++) {
+        RleString *rleString = rleString_constructPreComputed(nucleotides[i], runLengths[i]);
+        stList_append(rleStrings, rleString);
+        stList_append(rleReads, bamChunkRead_construct2(stString_print("read_%d", i),
+                stString_copy(rleString->rleString), NULL, (strands[i] == 0 ? TRUE : FALSE), NULL));
+    }
+    RleString *rleReference = stList_get(rleStrings, getConsensusBackboneIndex(readCount, nucleotides));
+    Poa *poa = poa_realignAll(rleReads, NULL, rleReference->rleString, params);
+    RleString *consensusRleString = expandRLEConsensus(poa, rleStrings, rleReads, params->repeatSubMatrix);
+
+    stList_destruct(rleStrings);
+    stList_destruct(rleReads);
+    poa_destruct(poa);
+    return consensusRleString;
+}
+
+static void assertRleStringsEqual(CuTest *testCase, RleString *expected, RleString *actual) {
+    CuAssertTrue(testCase, actual != NULL);
+    CuAssertStrEquals(testCase, expected->rleString, actual->rleString);
+    CuAssertIntEquals(testCase, expected->length, actual->length);
+    CuAssertIntEquals(testCase, expected->nonRleLength, actual->nonRleLength);
+    for (int64_t j = 0; j < expected->length; j++) {
+        CuAssertIntEquals(testCase, expected->repeatCounts[j], actual->repeatCounts[j]);
+    }
+}
+
+void test_batchMatchesSingle(CuTest *testCase) {
+    // alternate the two read sets, so scratch space is reused by sets of differing sizes
+    int64_t setCount = 8;
+    int64_t *readCounts = st_calloc(setCount, sizeof(int64_t));
+    char ***rleReads = st_calloc(setCount, sizeof(char**));
+    uint8_t ***rleCounts = st_calloc(setCount, sizeof(uint8_t**));
+    uint8_t **strands = st_calloc(setCount, sizeof(uint8_t*));
+    for (int64_t i = 0; i < setCount; i++) {
+        readCounts[i] = i % 2 == 0 ? readSet1Count : readSet2Count;
+        getCallConsensusDataFromReads(i % 2 == 0 ? readSet1 : readSet2, (int) readCounts[i], &rleReads[i],
+                &rleCounts[i], &strands[i]);
+        for (int64_t j = 0; j < readCounts[i]; j++) {
+            strands[i][j] = (uint8_t) ((i + j) % 2);
+        }
+    }
+    PolishParams *params = getConsensusParameters(polishParamsFile);
+
+    // get consensus strings
+    RleString **consensuses = callConsensusBatch(setCount, readCounts, rleReads, rleCounts, strands, params, 4);
+
+    // both the batched and the single call, which share the scratch code path, must give what the per cluster code
+    // path does
+    for (int64_t i = 0; i < setCount; i++) {
+        RleString *expected = callConsensusPerCluster(readCounts[i], rleReads[i], rleCounts[i], strands[i], params);
+        RleString *consensus = callConsensus(readCounts[i], rleReads[i], rleCounts[i], strands[i], params);
+        assertRleStringsEqual(testCase, expected, consensuses[i]);
+        assertRleStringsEqual(testCase, expected, consensus);
+        destroyRleString(consensus);
+        rleString_destruct(expected);
+    }
+
+    // cleanup
+    destroyRleStringBatch(setCount, consensuses);
+    destroyConsensusParameters(params);
+    for (int64_t i = 0; i < setCount; i++) {
+        for (int64_t j = 0; j < readCounts[i]; j++) {
+            free(rleReads[i][j]);
+            free(rleCounts[i][j]);
+        }
+        free(rleReads[i]);
+        free(rleCounts[i]);
+        free(strands[i]);
+    }
+    free(readCounts);
+    free(rleReads);
+    free(rleCounts);
+    free(strands);
+}
+
+
+void test_backboneSkipsTruncatedRead(CuTest *testCase) {
+    // a truncated first read must not be used as the backbone
+    char **rawReads = st_calloc(readSet1Count, sizeof(char*));
+    for (int64_t i = 0; i < readSet1Count; i++) {
+        rawReads[i] = readSet1[i];
+    }
+    rawReads[0] = "CATTTTTCTCCTCCGTC";
+
+    char **rleReads = NULL;
+    uint8_t **rleCounts = NULL;
+    uint8_t *strands = NULL;
+    getCallConsensusDataFromReads(rawReads, readSet1Count, &rleReads, &rleCounts, &strands);
+
+    int64_t backbone = getConsensusBackboneIndex(readSet1Count, rleReads);
+    CuAssertTrue(testCase, backbone > 0 && backbone < readSet1Count);
+    CuAssertTrue(testCase, strlen(rleReads[backbone]) > strlen(rleReads[0]));
+
+    // a single read is its own backbone
+    CuAssertIntEquals(testCase, 0, getConsensusBackboneIndex(1, rleReads));
+
+    // cleanup
+    for (int64_t i = 0; i < readSet1Count; i++) {
+        free(rleReads[i]);
+        free(rleCounts[i]);
+    }
+    free(rleReads);
+    free(rleCounts);
+    free(strands);
+    free(rawReads);
+}
+
+
 CuSuite* callConsensusTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
 
     SUITE_ADD_TEST(suite, test_readSet1);
     SUITE_ADD_TEST(suite, test_readSet2);
+    SUITE_ADD_TEST(suite, test_batchMatchesSingle);
+    SUITE_ADD_TEST(suite, test_backboneSkipsTruncatedRead);
 
     return suite;
 }
@@ -50,6 +50,180 @@ static void test_getRegionChunker(CuTest *testCase) {
     bamChunker_destruct(chunker);
 }
 
+static void test_getBedChunker(CuTest *testCase) {
+    // intervals are chunked as regions are, in the order of the bed file, skipping contigs not in the bam
+    char *bedFile = "chunkingTest.bed";
+    FILE *fh = fopen(bedFile, "w");
+    fprintf(fh, "# targets\ncontig_2\t100000\t100010\ncontig_1\t100000\t110000\nno_contig\t0\t100\n"
+                "contig_1\t0\t3000000\n");
+    fclose(fh);
+    PolishParams *params = getParameters(0,0,FALSE);
+    BamChunker *chunker = bamChunker_constructFromBed(INPUT_BAM, bedFile, params);
+    CuAssertTrue(testCase, chunker->chunkCount == 3);
+    BamChunk *chunk = bamChunker_getChunk(chunker, 0);
+    CuAssertTrue(testCase, stString_eq(chunk->refSeqName, "contig_2"));
+    CuAssertTrue(testCase, stString_eq(chunk->regionName, "contig_2:100000-100010"));
+    CuAssertTrue(testCase, chunk->chunkBoundaryStart == 100000);
+    CuAssertTrue(testCase, chunk->chunkBoundaryEnd == 100010);
+    chunk = bamChunker_getChunk(chunker, 1);
+    CuAssertTrue(testCase, stString_eq(chunk->regionName, "contig_1:100000-110000"));
+    CuAssertTrue(testCase, chunk->chunkBoundaryStart == 100000);
+    CuAssertTrue(testCase, chunk->chunkBoundaryEnd == 100008);
+    chunk = bamChunker_getChunk(chunker, 2);
+    CuAssertTrue(testCase, stString_eq(chunk->regionName, "contig_1:0-3000000"));
+    CuAssertTrue(testCase, chunk->chunkBoundaryStart == 100000);
+    CuAssertTrue(testCase, chunk->chunkBoundaryEnd == 2100008);
+    bamChunker_destruct(chunker);
+    free(params);
+
+    // each interval keeps the chunk size and boundary semantics of a region
+    params = getParameters(100000,0,FALSE);
+    fh = fopen(bedFile, "w");
+    fprintf(fh, "contig_1\t100000\t300000\n");
+    fclose(fh);
+    chunker = bamChunker_constructFromBed(INPUT_BAM, bedFile, params);
+    BamChunker *regionChunker = bamChunker_construct2(INPUT_BAM, "contig_1:100000-300000", params);
+    CuAssertTrue(testCase, chunker->chunkCount == regionChunker->chunkCount);
+    for (int64_t i = 0; i < chunker->chunkCount; i++) {
+        BamChunk *bedChunk = bamChunker_getChunk(chunker, i), *regionChunk = bamChunker_getChunk(regionChunker, i);
+        CuAssertTrue(testCase, regionChunk->regionName == NULL);
+        CuAssertTrue(testCase, bedChunk->chunkBoundaryStart == regionChunk->chunkBoundaryStart);
+        CuAssertTrue(testCase, bedChunk->chunkStart == regionChunk->chunkStart);
+        CuAssertTrue(testCase, bedChunk->chunkEnd == regionChunk->chunkEnd);
+        CuAssertTrue(testCase, bedChunk->chunkBoundaryEnd == regionChunk->chunkBoundaryEnd);
+    }
+    bamChunker_destruct(chunker);
+    bamChunker_destruct(regionChunker);
+    free(params);
+}
+
+static int cmpReadNames(const void *a, const void *b) {
+    return strcmp(((BamChunkRead *) a)->readName, ((BamChunkRead *) b)->readName);
+}
+
+static void test_getChunksFromSeveralBams(CuTest *testCase) {
+    // the same bam twice chunks as the bam does, and gives each of its reads twice in a row, as the merged bam would;
+    // each listing is read through its own file handle, so the two iterators do not move each other's file position.
+    // Reads at the same position are merged by strand and name, so they need not keep the order of the bam
+    PolishParams *params = getParameters(10000, 0, FALSE);
+    stList *bamFiles = stList_construct();
+    stList_append(bamFiles, INPUT_BAM);
+    stList_append(bamFiles, INPUT_BAM);
+    BamChunker *chunker = bamChunker_construct(INPUT_BAM, params);
+    BamChunker *mergedChunker = bamChunker_construct3(bamFiles, NULL, params);
+    CuAssertTrue(testCase, stList_length(mergedChunker->extraBamFiles) == 1);
+    CuAssertTrue(testCase, chunker->chunkCount == mergedChunker->chunkCount);
+
+    for (int64_t chunkIdx = 0; chunkIdx < chunker->chunkCount; chunkIdx++) {
+        BamChunk *chunk = bamChunker_getChunk(chunker, chunkIdx);
+        BamChunk *mergedChunk = bamChunker_getChunk(mergedChunker, chunkIdx);
+        CuAssertTrue(testCase, stString_eq(chunk->refSeqName, mergedChunk->refSeqName));
+        CuAssertTrue(testCase, chunk->chunkBoundaryStart == mergedChunk->chunkBoundaryStart);
+        CuAssertTrue(testCase, chunk->chunkBoundaryEnd == mergedChunk->chunkBoundaryEnd);
+
+        stList *reads = stList_construct3(0, (void (*)(void *))bamChunkRead_destruct);
+        stList *alignments = stList_construct3(0, (void (*)(void*))stList_destruct);
+        stList *mergedReads = stList_construct3(0, (void (*)(void *))bamChunkRead_destruct);
+        stList *mergedAlignments = stList_construct3(0, (void (*)(void*))stList_destruct);
+        convertToReadsAndAlignments(chunk, reads, alignments);
+        convertToReadsAndAlignments(mergedChunk, mergedReads, mergedAlignments);
+        CuAssertTrue(testCase, 2 * stList_length(reads) == stList_length(mergedReads));
+        for (int64_t i = 0; i < stList_length(mergedReads); i += 2) {
+            BamChunkRead *mergedRead = stList_get(mergedReads, i), *mergedCopy = stList_get(mergedReads, i + 1);
+            CuAssertStrEquals(testCase, mergedRead->readName, mergedCopy->readName);
+            CuAssertStrEquals(testCase, mergedRead->nucleotides, mergedCopy->nucleotides);
+            CuAssertTrue(testCase, stList_length(stList_get(mergedAlignments, i)) ==
+                                   stList_length(stList_get(mergedAlignments, i + 1)));
+        }
+        stList *sortedReads = stList_copy(reads, NULL);
+        stList *sortedMergedReads = stList_construct();
+        for (int64_t i = 0; i < stList_length(mergedReads); i += 2) {
+            stList_append(sortedMergedReads, stList_get(mergedReads, i));
+        }
+        stList_sort(sortedReads, cmpReadNames);
+        stList_sort(sortedMergedReads, cmpReadNames);
+        for (int64_t i = 0; i < stList_length(sortedReads); i++) {
+            BamChunkRead *read = stList_get(sortedReads, i), *mergedRead = stList_get(sortedMergedReads, i);
+            CuAssertStrEquals(testCase, read->readName, mergedRead->readName);
+            CuAssertStrEquals(testCase, read->nucleotides, mergedRead->nucleotides);
+        }
+        stList_destruct(sortedReads);
+        stList_destruct(sortedMergedReads);
+        stList_destruct(reads);
+        stList_destruct(alignments);
+        stList_destruct(mergedReads);
+        stList_destruct(mergedAlignments);
+    }
+
+    bamChunker_destruct(chunker);
+    bamChunker_destruct(mergedChunker);
+    stList_destruct(bamFiles);
+    free(params);
+}
+
+static void writeBam(char *bamFile, char *samRecords) {
+    // Writes the sam records, which must be sorted, to an indexed bam of one 1kb contig
+    char *samTextFile = stString_print("%s.sam", bamFile);
+    FILE *fh = fopen(samTextFile, "w");
+    fprintf(fh, "@HD\tVN:1.6\tSO:coordinate\n@SQ\tSN:contig_1\tLN:1000\n%s", samRecords);
+    fclose(fh);
+    samFile *in = hts_open(samTextFile, "r");
+    bam_hdr_t *bamHdr = sam_hdr_read(in);
+    samFile *out = hts_open(bamFile, "wb");
+    if (out == NULL || sam_hdr_write(out, bamHdr) != 0) {
+        st_errAbort("Could not write bam: %s\n", bamFile);
+    }
+    bam1_t *aln = bam_init1();
+    while (sam_read1(in, bamHdr, aln) >= 0) {
+        if (sam_write1(out, bamHdr, aln) < 0) {
+            st_errAbort("Could not write bam: %s\n", bamFile);
+        }
+    }
+    bam_destroy1(aln);
+    bam_hdr_destroy(bamHdr);
+    sam_close(in);
+    sam_close(out);
+    if (sam_index_build(bamFile, 0) != 0) {
+        st_errAbort("Could not index bam: %s\n", bamFile);
+    }
+    free(samTextFile);
+}
+
+static void test_mergeBamsSharingPositions(CuTest *testCase) {
+    // reads of two bams at the same position are merged as samtools merge does: forward strand first, then by name
+    char *bamFile1 = "mergeSharedPositions1.bam", *bamFile2 = "mergeSharedPositions2.bam";
+    writeBam(bamFile1, "read_c\t0\tcontig_1\t101\t60\t8M\t*\t0\t0\tACGTACGT\t*\n"
+                       "read_d\t16\tcontig_1\t101\t60\t8M\t*\t0\t0\tACGTACGT\t*\n"
+                       "read_e\t0\tcontig_1\t201\t60\t8M\t*\t0\t0\tACGTACGT\t*\n");
+    writeBam(bamFile2, "read_b\t0\tcontig_1\t101\t60\t8M\t*\t0\t0\tACGTACGT\t*\n"
+                       "read_a\t16\tcontig_1\t101\t60\t8M\t*\t0\t0\tACGTACGT\t*\n"
+                       "read_f\t0\tcontig_1\t201\t60\t8M\t*\t0\t0\tACGTACGT\t*\n");
+    char *expectedNames[6] = { "read_b", "read_c", "read_a", "read_d", "read_e", "read_f" };
+
+    PolishParams *params = getParameters(10000, 0, FALSE);
+    stList *bamFiles = stList_construct();
+    stList_append(bamFiles, bamFile1);
+    stList_append(bamFiles, bamFile2);
+    BamChunker *chunker = bamChunker_construct3(bamFiles, NULL, params);
+    CuAssertTrue(testCase, chunker->chunkCount == 1);
+
+    stList *reads = stList_construct3(0, (void (*)(void *))bamChunkRead_destruct);
+    stList *alignments = stList_construct3(0, (void (*)(void*))stList_destruct);
+    convertToReadsAndAlignments(bamChunker_getChunk(chunker, 0), reads, alignments);
+    CuAssertIntEquals(testCase, 6, stList_length(reads));
+    for (int64_t i = 0; i < 6; i++) {
+        BamChunkRead *read = stList_get(reads, i);
+        CuAssertStrEquals(testCase, expectedNames[i], read->readName);
+        CuAssertTrue(testCase, read->forwardStrand == (i != 2 && i != 3));
+    }
+
+    stList_destruct(reads);
+    stList_destruct(alignments);
+    bamChunker_destruct(chunker);
+    stList_destruct(bamFiles);
+    free(params);
+}
+
 static void test_getChunksByChrom(CuTest *testCase) {
     BamChunker *chunker = bamChunker_construct(INPUT_BAM, getParameters(0,0,FALSE));
     CuAssertTrue(testCase, chunker->chunkCount == 2);
@@ -139,6 +313,87 @@ static void test_getQualityScores(CuTest *testCase) {
 
 }
 
+static stList *getDownsampledReadNames(BamChunk *chunk, stList *reads, stList *alignments, int64_t depth) {
+    // Returns the names of the reads kept, or of all the reads if none were discarded
+    stList *filteredReads = stList_construct(), *filteredAlignments = stList_construct();
+    stList *discardedReads = stList_construct(), *discardedAlignments = stList_construct();
+    bool didDownsample = poorMansDownsample(depth, chunk, reads, alignments, filteredReads, filteredAlignments,
+                                            discardedReads, discardedAlignments);
+    stList *keptReads = didDownsample ? filteredReads : reads;
+    stList *names = stList_construct();
+    for (int64_t i = 0; i < stList_length(keptReads); i++) {
+        stList_append(names, ((BamChunkRead *) stList_get(keptReads, i))->readName);
+    }
+    stList_destruct(filteredReads);
+    stList_destruct(filteredAlignments);
+    stList_destruct(discardedReads);
+    stList_destruct(discardedAlignments);
+    return names;
+}
+
+static void test_downsampleIsDeterministic(CuTest *testCase) {
+    PolishParams *params = getParameters(10000, 0, FALSE);
+    params->downsampleSeed = 7;
+    BamChunker *chunker = bamChunker_construct(INPUT_BAM, params);
+
+    // has 9 reads of 8 characters aligned to position 100 000 and every 4 bases after (last read aligned to 100 032)
+    for (int64_t chunkIdx = 0; chunkIdx < chunker->chunkCount; chunkIdx++) {
+        BamChunk *chunk = bamChunker_getChunk(chunker, chunkIdx);
+        if (!stString_eq(chunk->refSeqName, "contig_2")) continue;
+        stList *reads = stList_construct3(0, (void (*)(void *))bamChunkRead_destruct);
+        stList *alignments = stList_construct3(0, (void (*)(void*))stList_destruct);
+        convertToReadsAndAlignments(chunk, reads, alignments);
+
+        for (int64_t local = 0; local < 2; local++) {
+            params->downsampleByLocalDepth = local;
+
+            // the same reads are kept whatever the state of the global generator
+            st_randomSeed(1);
+            stList *names1 = getDownsampledReadNames(chunk, reads, alignments, 1);
+            st_randomSeed(2);
+            stList *names2 = getDownsampledReadNames(chunk, reads, alignments, 1);
+            CuAssertIntEquals(testCase, stList_length(names1), stList_length(names2));
+            for (int64_t i = 0; i < stList_length(names1); i++) {
+                CuAssertStrEquals(testCase, stList_get(names1, i), stList_get(names2, i));
+            }
+
+            // downsampling by local depth leaves every position covered
+            if (local) {
+                stSet *kept = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, NULL);
+                for (int64_t i = 0; i < stList_length(names1); i++) {
+                    stSet_insert(kept, stList_get(names1, i));
+                }
+                int64_t chunkLength = chunk->chunkBoundaryEnd - chunk->chunkBoundaryStart;
+                int64_t *depths = st_calloc(chunkLength, sizeof(int64_t));
+                int64_t *keptDepths = st_calloc(chunkLength, sizeof(int64_t));
+                for (int64_t i = 0; i < stList_length(reads); i++) {
+                    stList *alignment = stList_get(alignments, i);
+                    bool isKept = stSet_search(kept, ((BamChunkRead *) stList_get(reads, i))->readName) != NULL;
+                    for (int64_t j = 0; j < stList_length(alignment); j++) {
+                        int64_t refPos = stIntTuple_get(stList_get(alignment, j), 0);
+                        depths[refPos]++;
+                        keptDepths[refPos] += isKept ? 1 : 0;
+                    }
+                }
+                for (int64_t j = 0; j < chunkLength; j++) {
+                    CuAssertTrue(testCase, keptDepths[j] >= (depths[j] < 1 ? depths[j] : 1));
+                }
+                free(depths);
+                free(keptDepths);
+                stSet_destruct(kept);
+            }
+
+            stList_destruct(names1);
+            stList_destruct(names2);
+        }
+
+        stList_destruct(reads);
+        stList_destruct(alignments);
+    }
+    free(chunker->params);
+    bamChunker_destruct(chunker);
+}
+
 static void test_getChunksWithBoundary(CuTest *testCase) {
     BamChunker *chunker = bamChunker_construct(INPUT_BAM, getParameters(8, 4, FALSE));
 
@@ -920,9 +1175,13 @@ CuSuite* chunkingTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
 
     SUITE_ADD_TEST(suite, test_getRegionChunker);
+    SUITE_ADD_TEST(suite, test_getBedChunker);
+    SUITE_ADD_TEST(suite, test_getChunksFromSeveralBams);
+    SUITE_ADD_TEST(suite, test_mergeBamsSharingPositions);
     SUITE_ADD_TEST(suite, test_getChunksByChrom);
     SUITE_ADD_TEST(suite, test_getChunksBy100kb);
     SUITE_ADD_TEST(suite, test_getQualityScores);
+    SUITE_ADD_TEST(suite, test_downsampleIsDeterministic);
     SUITE_ADD_TEST(suite, test_getChunksWithBoundary);
     SUITE_ADD_TEST(suite, test_getChunksWithoutBoundary);
     SUITE_ADD_TEST(suite, test_getReadsWithSoftClipping);
@@ -320,11 +320,354 @@ void test_RleWeightIndex(CuTest *testCase) {
     PoaFeature_RleWeight_destruct(feature);
 }
 
+static void setSplitRleTestFeature(PoaFeatureSplitRleWeight *feature, int64_t seed, int64_t maxRunLength) {
+    int64_t columnCount = ((SYMBOL_NUMBER - 1) * (maxRunLength + 1) + 1) * 2;
+    for (int64_t j = 0; j < columnCount; j++) {
+        feature->weights[j] = (double) ((seed * 31 + j * 7) % 13);
+    }
+    feature->labelChar = "ACGT"[seed % 4];
+    feature->labelRunLength = 1 + seed % maxRunLength;
+}
+
+static stList *getSplitRleTestFeatures(int64_t refLength, int64_t maxRunLength) {
+    // a second run length at every fifth position and an insert at every seventh
+    stList *features = stList_construct3(0, (void (*)(void *)) PoaFeature_SplitRleWeight_destruct);
+    for (int64_t i = 0; i < refLength; i++) {
+        PoaFeatureSplitRleWeight *feature = PoaFeature_SplitRleWeight_construct(i, 0, 0, maxRunLength);
+        setSplitRleTestFeature(feature, i, maxRunLength);
+        if (i % 5 == 0) {
+            feature->nextRunLength = PoaFeature_SplitRleWeight_construct(i, 0, 1, maxRunLength);
+            setSplitRleTestFeature(feature->nextRunLength, i + 1, maxRunLength);
+        }
+        if (i % 7 == 0) {
+            feature->nextInsert = PoaFeature_SplitRleWeight_construct(i, 1, 0, maxRunLength);
+            setSplitRleTestFeature(feature->nextInsert, i + 2, maxRunLength);
+        }
+        stList_append(features, feature);
+    }
+    return features;
+}
+
+#ifdef _HDF5
+static void readHDF5Rows(hid_t file, char *datasetName, hid_t type, int64_t rowStart, int64_t rowCount,
+                         int64_t columnCount, void *rows) {
+    hid_t dataset = H5Dopen(file, datasetName, H5P_DEFAULT);
+    hid_t fileSpace = H5Dget_space(dataset);
+    hsize_t start[2] = {(hsize_t) rowStart, 0};
+    hsize_t count[2] = {(hsize_t) rowCount, (hsize_t) columnCount};
+    H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, NULL, count, NULL);
+    hid_t memorySpace = H5Screate_simple(H5Sget_simple_extent_ndims(fileSpace), count, NULL);
+    H5Dread(dataset, type, memorySpace, fileSpace, H5P_DEFAULT, rows);
+    H5Sclose(memorySpace);
+    H5Sclose(fileSpace);
+    H5Dclose(dataset);
+}
+
+static void assertWindowDatasetEquals(CuTest *testCase, hid_t perThreadFile, hid_t singleFile, char *windowName,
+                                      char *datasetName, hid_t type, size_t typeSize, int64_t rowStart,
+                                      int64_t rowCount, int64_t columnCount) {
+    void *expected = st_calloc(rowCount * columnCount, typeSize);
+    void *actual = st_calloc(rowCount * columnCount, typeSize);
+    char *groupDatasetName = stString_print("images/%s/%s", windowName, datasetName);
+    readHDF5Rows(perThreadFile, groupDatasetName, type, 0, rowCount, columnCount, expected);
+    readHDF5Rows(singleFile, datasetName, type, rowStart, rowCount, columnCount, actual);
+    CuAssertTrue(testCase, memcmp(expected, actual, rowCount * columnCount * typeSize) == 0);
+    free(groupDatasetName);
+    free(expected);
+    free(actual);
+}
+
+void test_splitRleFeatureHDF5Writer(CuTest *testCase) {
+    // the single file must hold the same windows and values as the per thread files
+    int64_t maxRunLength = 3;
+    int64_t columnCount = ((SYMBOL_NUMBER - 1) * (maxRunLength + 1) + 1) * 2;
+    char *perThreadFilename = "featureTest.perThread.h5";
+    char *singleFilename = "featureTest.single.h5";
+    BamChunk bamChunk = { "contig_1", 100, 100, 2600, 2600, NULL, NULL };
+    stList *features = getSplitRleTestFeatures(2500, maxRunLength);
+
+    // two chunks, 3358 and 1611 rows, so four and two windows
+    SplitRleFeatureHDF5FileInfo *perThreadFile = splitRleFeatureHDF5FileInfo_construct(perThreadFilename);
+    writeSplitRleWeightHelenFeaturesHDF5(perThreadFile, "chunkA", &bamChunk, TRUE, features, 0, 2499, maxRunLength);
+    writeSplitRleWeightHelenFeaturesHDF5(perThreadFile, "chunkB", &bamChunk, TRUE, features, 100, 1299, maxRunLength);
+    splitRleFeatureHDF5FileInfo_destruct(perThreadFile);
+
+    // a queue of one, so adding the second chunk waits for the writer thread
+    SplitRleFeatureHDF5Writer *writer = splitRleFeatureHDF5Writer_construct(singleFilename, maxRunLength, TRUE, 1);
+    splitRleFeatureHDF5Writer_addChunk(writer, "chunkA", &bamChunk, TRUE, features, 0, 2499);
+    splitRleFeatureHDF5Writer_addChunk(writer, "chunkB", &bamChunk, TRUE, features, 100, 1299);
+    CuAssertTrue(testCase, splitRleFeatureHDF5Writer_destruct(writer));
+
+    hid_t perThread = H5Fopen(perThreadFilename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t single = H5Fopen(singleFilename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t stringType = H5Tcopy(H5T_C_S1);
+    H5Tset_size(stringType, H5T_VARIABLE);
+
+    hid_t rowStartDataset = H5Dopen(single, "windows/row_start", H5P_DEFAULT);
+    hid_t rowStartSpace = H5Dget_space(rowStartDataset);
+    hsize_t windowCount;
+    H5Sget_simple_extent_dims(rowStartSpace, &windowCount, NULL);
+    H5Sclose(rowStartSpace);
+    H5Dclose(rowStartDataset);
+    CuAssertIntEquals(testCase, 6, (int) windowCount);
+
+    for (int64_t w = 0; w < windowCount; w++) {
+        char *windowName = NULL;
+        int64_t rowStart, rowCount, featureChunkIdx, contigStart, expectedFeatureChunkIdx, expectedContigStart;
+        readHDF5Rows(single, "windows/name", stringType, w, 1, 1, &windowName);
+        readHDF5Rows(single, "windows/row_start", H5T_NATIVE_INT64, w, 1, 1, &rowStart);
+        readHDF5Rows(single, "windows/row_count", H5T_NATIVE_INT64, w, 1, 1, &rowCount);
+        readHDF5Rows(single, "windows/feature_chunk_idx", H5T_NATIVE_INT64, w, 1, 1, &featureChunkIdx);
+        readHDF5Rows(single, "windows/contig_start", H5T_NATIVE_INT64, w, 1, 1, &contigStart);
+        CuAssertIntEquals(testCase, 1000, (int) rowCount);
+
+        // the metadata and rows of the window match its group in the per thread file
+        char *groupName = stString_print("images/%s", windowName);
+        CuAssertTrue(testCase, H5Lexists(perThread, groupName, H5P_DEFAULT) > 0);
+        char *chunkIdxName = stString_print("%s/feature_chunk_idx", groupName);
+        char *contigStartName = stString_print("%s/contig_start", groupName);
+        readHDF5Rows(perThread, chunkIdxName, H5T_NATIVE_INT64, 0, 1, 1, &expectedFeatureChunkIdx);
+        readHDF5Rows(perThread, contigStartName, H5T_NATIVE_INT64, 0, 1, 1, &expectedContigStart);
+        CuAssertIntEquals(testCase, (int) expectedFeatureChunkIdx, (int) featureChunkIdx);
+        CuAssertIntEquals(testCase, (int) expectedContigStart, (int) contigStart);
+        assertWindowDatasetEquals(testCase, perThread, single, windowName, "position", H5T_NATIVE_UINT32,
+                                  sizeof(uint32_t), rowStart, rowCount, 3);
+        assertWindowDatasetEquals(testCase, perThread, single, windowName, "image", H5T_NATIVE_UINT8,
+                                  sizeof(uint8_t), rowStart, rowCount, columnCount);
+        assertWindowDatasetEquals(testCase, perThread, single, windowName, "normalization", H5T_NATIVE_UINT8,
+                                  sizeof(uint8_t), rowStart, rowCount, 1);
+        assertWindowDatasetEquals(testCase, perThread, single, windowName, "label_base", H5T_NATIVE_UINT8,
+                                  sizeof(uint8_t), rowStart, rowCount, 1);
+        assertWindowDatasetEquals(testCase, perThread, single, windowName, "label_run_length", H5T_NATIVE_UINT8,
+                                  sizeof(uint8_t), rowStart, rowCount, 1);
+
+        free(groupName);
+        free(chunkIdxName);
+        free(contigStartName);
+        H5free_memory(windowName);
+    }
+
+    H5Tclose(stringType);
+    H5Fclose(perThread);
+    H5Fclose(single);
+    remove(perThreadFilename);
+    remove(singleFilename);
+    stList_destruct(features);
+}
+#endif
+
+static void *readNpyArray(CuTest *testCase, char *filename, char *expectedDescr, size_t typeSize, int64_t *rowCount,
+                          int64_t *columnCount) {
+    FILE *fh = fopen(filename, "rb");
+    CuAssertTrue(testCase, fh != NULL);
+    uint8_t prefix[10];
+    CuAssertIntEquals(testCase, 10, (int) fread(prefix, sizeof(uint8_t), 10, fh));
+    CuAssertTrue(testCase, memcmp(prefix, "\x93NUMPY", 6) == 0);
+    CuAssertIntEquals(testCase, 1, prefix[6]);
+
+    // the data starts aligned to 64 bytes
+    int64_t headerLength = prefix[8] | (prefix[9] << 8);
+    CuAssertIntEquals(testCase, 0, (int) ((10 + headerLength) % 64));
+    char *header = st_calloc(headerLength + 1, sizeof(char));
+    CuAssertIntEquals(testCase, (int) headerLength, (int) fread(header, sizeof(char), headerLength, fh));
+    CuAssertTrue(testCase, header[headerLength - 1] == '\n');
+    char descr[8];
+    CuAssertIntEquals(testCase, 3, sscanf(header, "{'descr': '%7[^']', 'fortran_order': False, 'shape': (%"SCNd64
+                                                  ", %"SCNd64"), }", descr, rowCount, columnCount));
+    CuAssertStrEquals(testCase, expectedDescr, descr);
+
+    void *data = st_calloc(*rowCount * *columnCount + 1, typeSize);
+    CuAssertIntEquals(testCase, (int) (*rowCount * *columnCount),
+                      (int) fread(data, typeSize, *rowCount * *columnCount, fh));
+    CuAssertTrue(testCase, fgetc(fh) == EOF);
+    fclose(fh);
+    free(header);
+    return data;
+}
+
+static void *readSplitRleNpyArray(CuTest *testCase, char *arrayBase, char *arrayName, char *expectedDescr,
+                                  size_t typeSize, int64_t expectedRowCount, int64_t expectedColumnCount) {
+    char *filename = stString_print("%s.%s.npy", arrayBase, arrayName);
+    int64_t rowCount, columnCount;
+    void *data = readNpyArray(testCase, filename, expectedDescr, typeSize, &rowCount, &columnCount);
+    CuAssertIntEquals(testCase, (int) expectedRowCount, (int) rowCount);
+    CuAssertIntEquals(testCase, (int) expectedColumnCount, (int) columnCount);
+    remove(filename);
+    free(filename);
+    return data;
+}
+
+static void assertSplitRleNpyManifest(CuTest *testCase, char *arrayBase, BamChunk *bamChunk, bool outputLabels,
+                                      int64_t rowCount, int64_t columnCount, int64_t windowCount,
+                                      int64_t *windowRowStarts) {
+    char *manifestFile = stString_print("%s.json", arrayBase);
+    FILE *fh = fopen(manifestFile, "r");
+    CuAssertTrue(testCase, fh != NULL);
+    fseek(fh, 0, SEEK_END);
+    size_t length = (size_t) ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    char *buf = st_calloc(length + 1, sizeof(char));
+    CuAssertIntEquals(testCase, (int) length, (int) fread(buf, sizeof(char), length, fh));
+    fclose(fh);
+
+    jsmntok_t *tokens;
+    char *js;
+    int64_t tokenNumber = stJson_setupParser(buf, length, &tokens, &js);
+    int64_t windowsSeen = 0;
+    for (int64_t tokenIndex = 1; tokenIndex < tokenNumber; tokenIndex++) {
+        char *keyString = stJson_token_tostr(js, &(tokens[tokenIndex]));
+        if (strcmp(keyString, "contig") == 0) {
+            CuAssertStrEquals(testCase, bamChunk->refSeqName, stJson_token_tostr(js, &(tokens[++tokenIndex])));
+        } else if (strcmp(keyString, "contig_start") == 0) {
+            CuAssertIntEquals(testCase, (int) bamChunk->chunkBoundaryStart,
+                              (int) stJson_parseInt(js, tokens, ++tokenIndex));
+        } else if (strcmp(keyString, "contig_end") == 0) {
+            CuAssertIntEquals(testCase, (int) bamChunk->chunkBoundaryEnd,
+                              (int) stJson_parseInt(js, tokens, ++tokenIndex));
+        } else if (strcmp(keyString, "row_count") == 0) {
+            CuAssertIntEquals(testCase, (int) rowCount, (int) stJson_parseInt(js, tokens, ++tokenIndex));
+        } else if (strcmp(keyString, "image_column_count") == 0) {
+            CuAssertIntEquals(testCase, (int) columnCount, (int) stJson_parseInt(js, tokens, ++tokenIndex));
+        } else if (strcmp(keyString, "labels") == 0) {
+            CuAssertTrue(testCase, stJson_parseBool(js, tokens, ++tokenIndex) == outputLabels);
+        } else if (strcmp(keyString, "windows") == 0) {
+            // an array of objects, each of four keys and their values
+            CuAssertIntEquals(testCase, (int) windowCount, tokens[++tokenIndex].size);
+            for (int64_t w = 0; w < windowCount; w++) {
+                int64_t objectIndex = ++tokenIndex;
+                CuAssertIntEquals(testCase, 4, tokens[objectIndex].size);
+                for (int64_t k = 0; k < 4; k++) {
+                    char *windowKey = stJson_token_tostr(js, &(tokens[++tokenIndex]));
+                    if (strcmp(windowKey, "name") == 0) {
+                        char *expectedName = stString_print("%s.%"PRId64, strrchr(arrayBase, '/') + 1, w);
+                        CuAssertStrEquals(testCase, expectedName, stJson_token_tostr(js, &(tokens[++tokenIndex])));
+                        free(expectedName);
+                    } else if (strcmp(windowKey, "feature_chunk_idx") == 0) {
+                        CuAssertIntEquals(testCase, (int) w, (int) stJson_parseInt(js, tokens, ++tokenIndex));
+                    } else if (strcmp(windowKey, "row_start") == 0) {
+                        CuAssertIntEquals(testCase, (int) windowRowStarts[w],
+                                          (int) stJson_parseInt(js, tokens, ++tokenIndex));
+                    } else {
+                        CuAssertStrEquals(testCase, "row_count", windowKey);
+                        CuAssertIntEquals(testCase, 1000, (int) stJson_parseInt(js, tokens, ++tokenIndex));
+                    }
+                }
+                windowsSeen++;
+            }
+        } else {
+            CuAssertStrEquals(testCase, "name", keyString);
+            tokenIndex++;
+        }
+    }
+    CuAssertIntEquals(testCase, (int) windowCount, (int) windowsSeen);
+
+    remove(manifestFile);
+    free(manifestFile);
+    free(buf);
+    free(js);
+    free(tokens);
+}
+
+static void assertSplitRleNpyRoundTrip(CuTest *testCase, stList *features, int64_t featureStartIdx,
+                                       int64_t featureEndIdxInclusive, int64_t maxRunLength, bool outputLabels,
+                                       int64_t rowCount, int64_t windowCount, int64_t *windowRowStarts) {
+    char *outputFileBase = outputLabels ? "featureTest.npyLabelled" : "featureTest.npyUnlabelled";
+    char *arrayBase = stString_print("./%s", outputFileBase);
+    int64_t columnCount = ((SYMBOL_NUMBER - 1) * (maxRunLength + 1) + 1) * 2;
+    BamChunk bamChunk = { "contig_1", 100, 100, 2600, 2600, NULL, NULL };
+    CuAssertTrue(testCase, writeSplitRleWeightHelenFeaturesNpy(".", outputFileBase, &bamChunk, outputLabels,
+                                                                features, featureStartIdx, featureEndIdxInclusive,
+                                                                maxRunLength));
+
+    assertSplitRleNpyManifest(testCase, arrayBase, &bamChunk, outputLabels, rowCount, columnCount, windowCount,
+                              windowRowStarts);
+    uint32_t *position = readSplitRleNpyArray(testCase, arrayBase, "position", "<u4", sizeof(uint32_t), rowCount, 3);
+    uint8_t *image = readSplitRleNpyArray(testCase, arrayBase, "image", "|u1", sizeof(uint8_t), rowCount,
+                                          columnCount);
+    uint8_t *normalization = readSplitRleNpyArray(testCase, arrayBase, "normalization", "|u1", sizeof(uint8_t),
+                                                  rowCount, 1);
+    uint8_t *labelBase = NULL, *labelRunLength = NULL;
+    char *labelBaseFile = stString_print("%s.label_base.npy", arrayBase);
+    if (outputLabels) {
+        labelBase = readSplitRleNpyArray(testCase, arrayBase, "label_base", "|u1", sizeof(uint8_t), rowCount, 1);
+        labelRunLength = readSplitRleNpyArray(testCase, arrayBase, "label_run_length", "|u1", sizeof(uint8_t),
+                                              rowCount, 1);
+    } else {
+        CuAssertTrue(testCase, access(labelBaseFile, F_OK) != 0);
+    }
+
+    // the rows are the features in order, normalized by the total weight of their reference position
+    int64_t row = 0;
+    for (int64_t i = featureStartIdx; i <= featureEndIdxInclusive; i++) {
+        PoaFeatureSplitRleWeight *refFeature = stList_get(features, i);
+        double totalWeight = 0;
+        for (int64_t j = 0; j < columnCount; j++) {
+            totalWeight += refFeature->weights[j];
+        }
+        PoaFeatureSplitRleWeight *insFeature = refFeature;
+        while (insFeature != NULL) {
+            PoaFeatureSplitRleWeight *rlFeature = insFeature;
+            while (rlFeature != NULL) {
+                CuAssertIntEquals(testCase, (int) rlFeature->refPosition, (int) position[row * 3 + 0]);
+                CuAssertIntEquals(testCase, (int) rlFeature->insertPosition, (int) position[row * 3 + 1]);
+                CuAssertIntEquals(testCase, (int) rlFeature->runLengthPosition, (int) position[row * 3 + 2]);
+                CuAssertIntEquals(testCase, convertTotalWeightToUInt8(totalWeight), normalization[row]);
+                for (int64_t j = 0; j < columnCount; j++) {
+                    CuAssertIntEquals(testCase, normalizeWeightToUInt8(totalWeight, rlFeature->weights[j]),
+                                      image[row * columnCount + j]);
+                }
+                if (outputLabels) {
+                    CuAssertIntEquals(testCase, symbol_convertCharToSymbol(rlFeature->labelChar) + 1, labelBase[row]);
+                    CuAssertIntEquals(testCase, (int) rlFeature->labelRunLength, labelRunLength[row]);
+                }
+                row++;
+                rlFeature = rlFeature->nextRunLength;
+            }
+            insFeature = insFeature->nextInsert;
+        }
+    }
+    CuAssertIntEquals(testCase, (int) rowCount, (int) row);
+
+    free(labelBaseFile);
+    free(arrayBase);
+    free(position);
+    free(image);
+    free(normalization);
+    free(labelBase);
+    free(labelRunLength);
+}
+
+void test_splitRleFeatureNpy(CuTest *testCase) {
+    // the arrays and manifest read back as the rows and windows of the chunk
+    int64_t maxRunLength = 3;
+    stList *features = getSplitRleTestFeatures(2500, maxRunLength);
+
+    // 3358 rows in four windows, spread evenly with the last ending at the last row
+    int64_t labelledWindowRowStarts[4] = {0, 786, 1572, 2358};
+    assertSplitRleNpyRoundTrip(testCase, features, 0, 2499, maxRunLength, TRUE, 3358, 4, labelledWindowRowStarts);
+
+    // 1611 rows in two windows, without labels
+    int64_t unlabelledWindowRowStarts[2] = {0, 611};
+    assertSplitRleNpyRoundTrip(testCase, features, 100, 1299, maxRunLength, FALSE, 1611, 2, unlabelledWindowRowStarts);
+
+    // a directory that does not exist fails the write, and no manifest claims the chunk is complete
+    BamChunk bamChunk = { "contig_1", 100, 100, 2600, 2600, NULL, NULL };
+    CuAssertTrue(testCase, !writeSplitRleWeightHelenFeaturesNpy("./featureTest.missingDirectory", "chunk", &bamChunk,
+                                                                FALSE, features, 0, 2499, maxRunLength));
+    CuAssertTrue(testCase, access("./featureTest.missingDirectory/chunk.json", F_OK) != 0);
+
+    stList_destruct(features);
+}
+
 CuSuite* featureTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
 
     SUITE_ADD_TEST(suite, test_simpleWeightIndex);
     SUITE_ADD_TEST(suite, test_RleWeightIndex);
+    #ifdef _HDF5
+    SUITE_ADD_TEST(suite, test_splitRleFeatureHDF5Writer);
+    #endif
+    SUITE_ADD_TEST(suite, test_splitRleFeatureNpy);
 //    SUITE_ADD_TEST(suite, test_simpleWeightFeatureGeneration);
 //    SUITE_ADD_TEST(suite, test_rleWeightFeatureGeneration);
 
@@ -4,8 +4,11 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+#include <htslib/bgzf.h>
+#include <htslib/tbx.h>
 #include "CuTest.h"
 #include "margin.h"
+#include "vcfComparison.h"
 
 int64_t genotypingTest2(char *paramsFile, char *bamFile, char *outputBase, char *referenceFile, char *vcfReference,
                         char* singleNuclProbDir, bool verbose) {
@@ -241,6 +244,163 @@ void test_multiple100kbGenotyping_nanopore(CuTest *testCase) {
     CuAssertTrue(testCase, i == 0);
 }
 
+/*
+ * A truth vcf and a vcf to evaluate against it over one 200bp contig, with a missed genotype, a false positive, a
+ * switch of phase, an insertion, a false negative deletion and homozygous variants.
+ */
+static char *vcfComparisonHeader = "##fileformat=VCFv4.2\n"
+                                   "##contig=<ID=ref,length=200>\n"
+                                   "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n"
+                                   "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tSAMPLE\n";
+static char *vcfComparisonTruth = "ref\t20\t.\tA\tG\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t40\t.\tC\tT\t.\tPASS\t.\tGT\t1|1\n"
+                                  "ref\t60\t.\tG\tA\t.\tPASS\t.\tGT\t1|0\n"
+                                  "ref\t80\t.\tT\tTA\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t100\t.\tCA\tC\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t120\t.\tA\tC\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t160\t.\tG\tT\t.\tPASS\t.\tGT\t1|1\n";
+static char *vcfComparisonQuery = "ref\t20\t.\tA\tG\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t40\t.\tC\tT\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t50\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t60\t.\tG\tA\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t80\t.\tT\tTA\t.\tPASS\t.\tGT\t0|1\n"
+                                  "ref\t120\t.\tA\tC\t.\tPASS\t.\tGT\t1|0\n"
+                                  "ref\t160\t.\tG\tT\t.\tPASS\t.\tGT\t1|1\n";
+
+static void writeVcf(char *vcfFile, char *records, bool indexed) {
+    // Writes a plain vcf, or a bgzipped vcf with a tabix index
+    char *text = stString_print("%s%s", vcfComparisonHeader, records);
+    if (indexed) {
+        BGZF *fp = bgzf_open(vcfFile, "w");
+        if (fp == NULL || bgzf_write(fp, text, strlen(text)) < 0 || bgzf_close(fp) != 0 ||
+            tbx_index_build(vcfFile, 0, &tbx_conf_vcf) != 0) {
+            st_errAbort("Could not write indexed vcf: %s\n", vcfFile);
+        }
+    } else {
+        FILE *fh = fopen(vcfFile, "w");
+        fprintf(fh, "%s", text);
+        fclose(fh);
+    }
+    free(text);
+}
+
+static stGenotypeResults *compareVCFsWithVerbosity(stList *hmms, bool indexed, bool verbose, bool reuseFragments,
+                                                   Params *params) {
+    char *truthFile = indexed ? "vcfComparisonTruth.vcf.gz" : "vcfComparisonTruth.vcf";
+    char *queryFile = indexed ? "vcfComparisonQuery.vcf.gz" : "vcfComparisonQuery.vcf";
+    writeVcf(truthFile, vcfComparisonTruth, indexed);
+    writeVcf(queryFile, vcfComparisonQuery, indexed);
+
+    setVerbosity(params->phaseParams, verbose ? LOG_TRUE_POSITIVES | LOG_FALSE_POSITIVES | LOG_FALSE_NEGATIVES : 0);
+    stList *phasedFragments = NULL;
+    if (reuseFragments) {
+        phasedFragments = stList_construct3(0, (void (*)(void *)) stPhasedFragment_destruct);
+        for (int64_t i = 0; i < stList_length(hmms); i++) {
+            stList_append(phasedFragments, stPhasedFragment_constructFromHmm(stList_get(hmms, i)));
+        }
+    }
+    stGenotypeResults *results = st_calloc(1, sizeof(stGenotypeResults));
+    compareVCFs(stderr, hmms, phasedFragments, queryFile, truthFile, params->baseMapper, results,
+                params->phaseParams);
+    setVerbosity(params->phaseParams, 0);
+
+    if (phasedFragments != NULL) {
+        stList_destruct(phasedFragments);
+    }
+    return results;
+}
+
+static void assertGenotypeResultsEqual(CuTest *testCase, stGenotypeResults *expected, stGenotypeResults *results) {
+    CuAssertIntEquals(testCase, expected->negatives, results->negatives);
+    CuAssertIntEquals(testCase, expected->positives, results->positives);
+    CuAssertIntEquals(testCase, expected->homozygousVariantsInRef, results->homozygousVariantsInRef);
+    CuAssertIntEquals(testCase, expected->homozygousVariantsInRef_Insertions,
+                      results->homozygousVariantsInRef_Insertions);
+    CuAssertIntEquals(testCase, expected->homozygousVariantsInRef_Deletions, results->homozygousVariantsInRef_Deletions);
+    CuAssertIntEquals(testCase, expected->hetsInRef, results->hetsInRef);
+    CuAssertIntEquals(testCase, expected->hetsInRef_Insertions, results->hetsInRef_Insertions);
+    CuAssertIntEquals(testCase, expected->hetsInRef_Deletions, results->hetsInRef_Deletions);
+    CuAssertIntEquals(testCase, expected->truePositives, results->truePositives);
+    CuAssertIntEquals(testCase, expected->falsePositives, results->falsePositives);
+    CuAssertIntEquals(testCase, expected->trueNegatives, results->trueNegatives);
+    CuAssertIntEquals(testCase, expected->falseNegatives, results->falseNegatives);
+    CuAssertIntEquals(testCase, expected->truePositiveIndels, results->truePositiveIndels);
+    CuAssertIntEquals(testCase, expected->falsePositiveIndels, results->falsePositiveIndels);
+    CuAssertIntEquals(testCase, expected->truePositiveHomozygous, results->truePositiveHomozygous);
+    CuAssertIntEquals(testCase, expected->truePositiveHet, results->truePositiveHet);
+    CuAssertIntEquals(testCase, expected->truePositiveHomozygousIndels, results->truePositiveHomozygousIndels);
+    CuAssertIntEquals(testCase, expected->truePositiveHetIndels, results->truePositiveHetIndels);
+    CuAssertIntEquals(testCase, expected->error_missedHet, results->error_missedHet);
+    CuAssertIntEquals(testCase, expected->error_missedHet_Insertions, results->error_missedHet_Insertions);
+    CuAssertIntEquals(testCase, expected->error_missedHet_Deletions, results->error_missedHet_Deletions);
+    CuAssertIntEquals(testCase, expected->error_homozygousInRef, results->error_homozygousInRef);
+    CuAssertIntEquals(testCase, expected->error_homozygous_Insertions, results->error_homozygous_Insertions);
+    CuAssertIntEquals(testCase, expected->error_homozygous_Deletions, results->error_homozygous_Deletions);
+    CuAssertIntEquals(testCase, expected->switchErrors, results->switchErrors);
+    // the distance is 0/0 if there are no switch errors
+    CuAssertTrue(testCase, expected->switchErrorDistance == results->switchErrorDistance ||
+                           (expected->switchErrorDistance != expected->switchErrorDistance &&
+                            results->switchErrorDistance != results->switchErrorDistance));
+    CuAssertIntEquals(testCase, expected->uncertainPhasing, results->uncertainPhasing);
+}
+
+/*
+ * The comparison gives the same stats with verbose output on, which computes the genome fragments and read
+ * partitions, as with it off, which skips them, whether the vcfs are read linearly or through their indexes.
+ */
+void test_compareVCFsVerbosity(CuTest *testCase) {
+    Params *params = params_readParams("../params/allParams.np.json");
+
+    // An hmm over the contig, from reads of two haplotypes
+    int64_t depth = 20, length = 200;
+    st_randomSeed(1);
+    char *haplotypes[2] = { st_malloc(length), st_malloc(length) };
+    for (int64_t i = 0; i < length; i++) {
+        haplotypes[0][i] = "ACGT"[st_randomInt(0, 4)];
+        haplotypes[1][i] = i % 20 == 0 ? "ACGT"[st_randomInt(0, 4)] : haplotypes[0][i];
+    }
+    stList *profileSeqs = stList_construct3(0, (void (*)(void *)) stProfileSeq_destruct);
+    for (int64_t i = 0; i < depth; i++) {
+        char *readId = stString_print("read_%" PRIi64, i);
+        stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile("ref", readId, 0, length);
+        for (int64_t j = 0; j < length; j++) {
+            uint8_t base = stBaseMapper_getValueForChar(params->baseMapper, haplotypes[i % 2][j]);
+            pSeq->profileProbs[j * ALPHABET_SIZE + base] = ALPHABET_MAX_PROB;
+        }
+        stList_append(profileSeqs, pSeq);
+        free(readId);
+    }
+    stHash *referenceNamesToReferencePriors = createEmptyReferencePriorProbabilities(profileSeqs);
+    stList *hmms = getRPHmms(profileSeqs, referenceNamesToReferencePriors, params->phaseParams);
+    CuAssertIntEquals(testCase, 1, stList_length(hmms));
+
+    stGenotypeResults *expected = compareVCFsWithVerbosity(hmms, FALSE, FALSE, FALSE, params);
+    CuAssertIntEquals(testCase, 7, expected->positives);
+    CuAssertIntEquals(testCase, 5, expected->hetsInRef);
+    CuAssertIntEquals(testCase, 2, expected->homozygousVariantsInRef);
+    CuAssertIntEquals(testCase, 1, expected->hetsInRef_Insertions);
+    CuAssertIntEquals(testCase, 1, expected->hetsInRef_Deletions);
+    CuAssertTrue(testCase, expected->truePositives > 0);
+    for (int64_t indexed = 0; indexed < 2; indexed++) {
+        for (int64_t verbose = 0; verbose < 2; verbose++) {
+            for (int64_t reuseFragments = 0; reuseFragments <= verbose; reuseFragments++) {
+                stGenotypeResults *results = compareVCFsWithVerbosity(hmms, indexed, verbose, reuseFragments,
+                                                                      params);
+                assertGenotypeResultsEqual(testCase, expected, results);
+                free(results);
+            }
+        }
+    }
+
+    free(expected);
+    stList_destruct(hmms);
+    stHash_destruct(referenceNamesToReferencePriors);
+    stList_destruct(profileSeqs);
+    free(haplotypes[0]);
+    free(haplotypes[1]);
+    params_destruct(params);
+}
+
 
 CuSuite *marginPhaseTestSuite(void) {
 
@@ -250,6 +410,7 @@ CuSuite *marginPhaseTestSuite(void) {
     SUITE_ADD_TEST(suite, test_5kbGenotyping_singleNuclProb);
     SUITE_ADD_TEST(suite, test_100kbGenotyping_pacbio);
     SUITE_ADD_TEST(suite, test_100kbGenotyping_nanopore);
+    SUITE_ADD_TEST(suite, test_compareVCFsVerbosity);
 
 //    SUITE_ADD_TEST(suite, test_multiple100kbGenotyping_pacbio);
 //    SUITE_ADD_TEST(suite, test_multiple100kbGenotyping_nanopore);
@@ -255,12 +255,123 @@ void test_jsmnParsing(CuTest *testCase) {
     }
 }
 
+void test_binaryParams(CuTest *testCase) {
+    /*
+     * Compiling a json params file to a binary one and loading it must give identical parameters.
+     */
+    char *jsonParamsFile = "../params/allParams.np.json";
+    char *binaryParamsFile = "./binaryParamsTest.bin";
+
+    params_compileBinary(jsonParamsFile, binaryParamsFile);
+    CuAssertTrue(testCase, params_isBinary(binaryParamsFile));
+    CuAssertTrue(testCase, !params_isBinary(jsonParamsFile));
+
+    Params *jsonParams = params_readParams(jsonParamsFile);
+    Params *binaryParams = params_readParams(binaryParamsFile);
+
+    // polish params
+    PolishParams *pp1 = jsonParams->polishParams, *pp2 = binaryParams->polishParams;
+    CuAssertIntEquals(testCase, pp1->useRunLengthEncoding, pp2->useRunLengthEncoding);
+    CuAssertDblEquals(testCase, pp1->referenceBasePenalty, pp2->referenceBasePenalty, 0);
+    CuAssertIntEquals(testCase, pp1->minPosteriorProbForAlignmentAnchorsLength, pp2->minPosteriorProbForAlignmentAnchorsLength);
+    for (int64_t i = 0; i < pp1->minPosteriorProbForAlignmentAnchorsLength; i++) {
+        CuAssertDblEquals(testCase, pp1->minPosteriorProbForAlignmentAnchors[i], pp2->minPosteriorProbForAlignmentAnchors[i], 0);
+    }
+    CuAssertDblEquals(testCase, pp1->p->threshold, pp2->p->threshold, 0);
+    CuAssertIntEquals(testCase, pp1->p->minDiagsBetweenTraceBack, pp2->p->minDiagsBetweenTraceBack);
+    CuAssertIntEquals(testCase, pp1->p->traceBackDiagonals, pp2->p->traceBackDiagonals);
+    CuAssertIntEquals(testCase, pp1->p->diagonalExpansion, pp2->p->diagonalExpansion);
+    CuAssertIntEquals(testCase, pp1->p->constraintDiagonalTrim, pp2->p->constraintDiagonalTrim);
+    CuAssertIntEquals(testCase, pp1->p->anchorMatrixBiggerThanThis, pp2->p->anchorMatrixBiggerThanThis);
+    CuAssertIntEquals(testCase, pp1->p->repeatMaskMatrixBiggerThanThis, pp2->p->repeatMaskMatrixBiggerThanThis);
+    CuAssertIntEquals(testCase, pp1->p->splitMatrixBiggerThanThis, pp2->p->splitMatrixBiggerThanThis);
+    CuAssertDblEquals(testCase, pp1->p->gapGamma, pp2->p->gapGamma, 0);
+    CuAssertIntEquals(testCase, pp1->p->alignAmbiguityCharacters, pp2->p->alignAmbiguityCharacters);
+    CuAssertTrue(testCase, pp2->hmm != NULL && pp2->sM != NULL);
+    CuAssertIntEquals(testCase, pp1->repeatSubMatrix->maximumRepeatLength, pp2->repeatSubMatrix->maximumRepeatLength);
+    CuAssertIntEquals(testCase, pp1->repeatSubMatrix->maxEntry, pp2->repeatSubMatrix->maxEntry);
+    CuAssertTrue(testCase, memcmp(pp1->repeatSubMatrix->logProbabilities, pp2->repeatSubMatrix->logProbabilities,
+                                  pp1->repeatSubMatrix->maxEntry * sizeof(double)) == 0);
+    CuAssertIntEquals(testCase, pp1->includeSoftClipping, pp2->includeSoftClipping);
+    CuAssertIntEquals(testCase, pp1->chunkSize, pp2->chunkSize);
+    CuAssertIntEquals(testCase, pp1->chunkBoundary, pp2->chunkBoundary);
+    CuAssertIntEquals(testCase, pp1->maxDepth, pp2->maxDepth);
+    CuAssertDblEquals(testCase, pp1->candidateVariantWeight, pp2->candidateVariantWeight, 0);
+    CuAssertIntEquals(testCase, pp1->columnAnchorTrim, pp2->columnAnchorTrim);
+    CuAssertIntEquals(testCase, pp1->maxConsensusStrings, pp2->maxConsensusStrings);
+    CuAssertIntEquals(testCase, pp1->maxPoaConsensusIterations, pp2->maxPoaConsensusIterations);
+    CuAssertIntEquals(testCase, pp1->minPoaConsensusIterations, pp2->minPoaConsensusIterations);
+    CuAssertIntEquals(testCase, pp1->maxRealignmentPolishIterations, pp2->maxRealignmentPolishIterations);
+    CuAssertIntEquals(testCase, pp1->minRealignmentPolishIterations, pp2->minRealignmentPolishIterations);
+    CuAssertIntEquals(testCase, pp1->minReadsToCallConsensus, pp2->minReadsToCallConsensus);
+    CuAssertIntEquals(testCase, pp1->filterReadsWhileHaveAtLeastThisCoverage, pp2->filterReadsWhileHaveAtLeastThisCoverage);
+    CuAssertDblEquals(testCase, pp1->minAvgBaseQuality, pp2->minAvgBaseQuality, 0);
+    CuAssertIntEquals(testCase, pp1->packReadNucleotides, pp2->packReadNucleotides);
+    CuAssertIntEquals(testCase, pp1->downsampleSeed, pp2->downsampleSeed);
+    CuAssertIntEquals(testCase, pp1->downsampleByLocalDepth, pp2->downsampleByLocalDepth);
+
+    // phase params
+    stRPHmmParameters *hp1 = jsonParams->phaseParams, *hp2 = binaryParams->phaseParams;
+    int64_t subModelSize = ALPHABET_SIZE * ALPHABET_SIZE;
+    CuAssertTrue(testCase, memcmp(hp1->hetSubModel, hp2->hetSubModel, subModelSize * sizeof(uint16_t)) == 0);
+    CuAssertTrue(testCase, memcmp(hp1->readErrorSubModel, hp2->readErrorSubModel, subModelSize * sizeof(uint16_t)) == 0);
+    CuAssertTrue(testCase, memcmp(hp1->hetSubModelSlow, hp2->hetSubModelSlow, subModelSize * sizeof(double)) == 0);
+    CuAssertTrue(testCase, memcmp(hp1->readErrorSubModelSlow, hp2->readErrorSubModelSlow, subModelSize * sizeof(double)) == 0);
+    CuAssertIntEquals(testCase, hp1->maxNotSumTransitions, hp2->maxNotSumTransitions);
+    CuAssertIntEquals(testCase, hp1->minPartitionsInAColumn, hp2->minPartitionsInAColumn);
+    CuAssertIntEquals(testCase, hp1->maxPartitionsInAColumn, hp2->maxPartitionsInAColumn);
+    CuAssertDblEquals(testCase, hp1->minPosteriorProbabilityForPartition, hp2->minPosteriorProbabilityForPartition, 0);
+    CuAssertIntEquals(testCase, hp1->maxCoverageDepth, hp2->maxCoverageDepth);
+    CuAssertIntEquals(testCase, hp1->minReadCoverageToSupportPhasingBetweenHeterozygousSites,
+                      hp2->minReadCoverageToSupportPhasingBetweenHeterozygousSites);
+    CuAssertIntEquals(testCase, hp1->trainingIterations, hp2->trainingIterations);
+    CuAssertDblEquals(testCase, hp1->offDiagonalReadErrorPseudoCount, hp2->offDiagonalReadErrorPseudoCount, 0);
+    CuAssertDblEquals(testCase, hp1->onDiagonalReadErrorPseudoCount, hp2->onDiagonalReadErrorPseudoCount, 0);
+    CuAssertIntEquals(testCase, hp1->estimateReadErrorProbsEmpirically, hp2->estimateReadErrorProbsEmpirically);
+    CuAssertIntEquals(testCase, hp1->filterBadReads, hp2->filterBadReads);
+    CuAssertDblEquals(testCase, hp1->filterMatchThreshold, hp2->filterMatchThreshold, 0);
+    CuAssertIntEquals(testCase, hp1->useReferencePrior, hp2->useReferencePrior);
+    CuAssertIntEquals(testCase, hp1->verboseTruePositives, hp2->verboseTruePositives);
+    CuAssertIntEquals(testCase, hp1->verboseFalsePositives, hp2->verboseFalsePositives);
+    CuAssertIntEquals(testCase, hp1->verboseFalseNegatives, hp2->verboseFalseNegatives);
+    CuAssertIntEquals(testCase, hp1->includeInvertedPartitions, hp2->includeInvertedPartitions);
+    CuAssertIntEquals(testCase, hp1->filterLikelyHomozygousSites, hp2->filterLikelyHomozygousSites);
+    CuAssertDblEquals(testCase, hp1->minSecondMostFrequentBaseFilter, hp2->minSecondMostFrequentBaseFilter, 0);
+    CuAssertDblEquals(testCase, hp1->minSecondMostFrequentBaseLogProbFilter, hp2->minSecondMostFrequentBaseLogProbFilter, 0);
+    CuAssertIntEquals(testCase, hp1->gapCharactersForDeletions, hp2->gapCharactersForDeletions);
+    CuAssertIntEquals(testCase, hp1->filterAReadWithAnyOneOfTheseSamFlagsSet, hp2->filterAReadWithAnyOneOfTheseSamFlagsSet);
+    CuAssertIntEquals(testCase, hp1->mapqFilter, hp2->mapqFilter);
+    CuAssertIntEquals(testCase, hp1->roundsOfIterativeRefinement, hp2->roundsOfIterativeRefinement);
+    CuAssertIntEquals(testCase, hp1->writeGVCF, hp2->writeGVCF);
+    CuAssertIntEquals(testCase, hp1->writeSplitSams, hp2->writeSplitSams);
+    CuAssertIntEquals(testCase, hp1->writeUnifiedSam, hp2->writeUnifiedSam);
+
+    // base mapper
+    stBaseMapper *bm1 = jsonParams->baseMapper, *bm2 = binaryParams->baseMapper;
+    CuAssertIntEquals(testCase, bm1->size, bm2->size);
+    CuAssertStrEquals(testCase, bm1->wildcard, bm2->wildcard);
+    CuAssertTrue(testCase, memcmp(bm1->charToNum, bm2->charToNum, 256 * sizeof(uint8_t)) == 0);
+    CuAssertTrue(testCase, memcmp(bm1->numToChar, bm2->numToChar, ALPHABET_SIZE * sizeof(char)) == 0);
+
+    // sections which are not required are not loaded
+    Params *polishOnlyParams = params_readParams2(binaryParamsFile, TRUE, FALSE);
+    CuAssertTrue(testCase, polishOnlyParams->polishParams != NULL);
+    CuAssertTrue(testCase, polishOnlyParams->phaseParams == NULL);
+
+    // cleanup
+    params_destruct(jsonParams);
+    params_destruct(binaryParams);
+    params_destruct(polishOnlyParams);
+    remove(binaryParamsFile);
+}
+
 CuSuite *parserTestSuite(void) {
     st_setLogLevelFromString("debug");
     CuSuite* suite = CuSuiteNew();
 
     SUITE_ADD_TEST(suite, test_jsmnParsing);
     SUITE_ADD_TEST(suite, test_bamReadParsing);
+    SUITE_ADD_TEST(suite, test_binaryParams);
 
     return suite;
 }
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2019 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "CuTest.h"
+#include "margin.h"
+
+/*
+ * Timed regression cases, opt-in with the MARGIN_PERF_PROFILE environment variable (see allTests --performance).
+ *
+ * Each case is timed as the minimum over a few repeats and compared with the baseline recorded for the machine
+ * profile named by MARGIN_PERF_PROFILE. A case fails if it is more than MARGIN_PERF_RATIO (default 2.0) times slower
+ * than its baseline. A case fails if the profile has no measured baseline for it, so a run on a machine that has not
+ * been profiled is not silently passed. With MARGIN_PERF_UPDATE=1 the baselines of the profile are rewritten from the
+ * measured times instead.
+ */
+
+static char *polishParamsFile = "../params/allParams.np.json";
+#define TEST_POLISH_FILES_DIR "../tests/data/polishTestExamples/"
+#define PERFORMANCE_BASELINE_FILE "../tests/data/performance/baselines.tsv"
+#define PERFORMANCE_DEFAULT_RATIO 2.0
+#define PERFORMANCE_REPEATS 3
+
+static double getTimeSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+static stList *readBaselineLines() {
+    stList *lines = stList_construct3(0, free);
+    FILE *fh = fopen(PERFORMANCE_BASELINE_FILE, "r");
+    if (fh != NULL) {
+        char *line;
+        while ((line = stFile_getLineFromFile(fh)) != NULL) {
+            stList_append(lines, line);
+        }
+        fclose(fh);
+    }
+    return lines;
+}
+
+static bool isBaselineLineFor(char *line, char *profile, char *caseName) {
+    // lines are "profile<TAB>case<TAB>seconds", anything starting with '#' is a comment
+    char *prefix = stString_print("%s\t%s\t", profile, caseName);
+    bool matches = line[0] != '#' && strncmp(line, prefix, strlen(prefix)) == 0;
+    free(prefix);
+    return matches;
+}
+
+static void updateBaseline(char *profile, char *caseName, double seconds) {
+    stList *lines = readBaselineLines();
+    char *newLine = stString_print("%s\t%s\t%f", profile, caseName, seconds);
+    bool replaced = FALSE;
+    for (int64_t i = 0; i < stList_length(lines); i++) {
+        if (isBaselineLineFor(stList_get(lines, i), profile, caseName)) {
+            free(stList_get(lines, i));
+            stList_set(lines, i, newLine);
+            replaced = TRUE;
+            break;
+        }
+    }
+    if (!replaced) {
+        stList_append(lines, newLine);
+    }
+
+    FILE *fh = fopen(PERFORMANCE_BASELINE_FILE, "w");
+    if (fh == NULL) {
+        st_errAbort("Could not write performance baselines: %s\n", PERFORMANCE_BASELINE_FILE);
+    }
+    for (int64_t i = 0; i < stList_length(lines); i++) {
+        fprintf(fh, "%s\n", (char *) stList_get(lines, i));
+    }
+    fclose(fh);
+    stList_destruct(lines);
+}
+
+static double getBaseline(char *profile, char *caseName) {
+    // Returns the baseline in seconds, or -1 if there is none
+    stList *lines = readBaselineLines();
+    double seconds = -1;
+    for (int64_t i = 0; i < stList_length(lines); i++) {
+        char *line = stList_get(lines, i);
+        if (isBaselineLineFor(line, profile, caseName)) {
+            seconds = atof(strrchr(line, '\t') + 1);
+            break;
+        }
+    }
+    stList_destruct(lines);
+    return seconds;
+}
+
+static void checkPerformance(CuTest *testCase, char *caseName, double seconds) {
+    char *profile = getenv("MARGIN_PERF_PROFILE");
+    if (profile == NULL) {
+        return;
+    }
+    char *update = getenv("MARGIN_PERF_UPDATE");
+    if (update != NULL && stString_eq(update, "1")) {
+        updateBaseline(profile, caseName, seconds);
+        st_logInfo("Recorded baseline for %s on profile %s: %f sec\n", caseName, profile, seconds);
+        return;
+    }
+
+    double baseline = getBaseline(profile, caseName);
+    char *ratioString = getenv("MARGIN_PERF_RATIO");
+    double ratio = ratioString == NULL ? PERFORMANCE_DEFAULT_RATIO : atof(ratioString);
+    if (baseline < 0) {
+        char *message = stString_print("No measured performance baseline for %s on profile %s in %s (took %f sec). "
+                                       "Record one on this machine with MARGIN_PERF_PROFILE=%s MARGIN_PERF_UPDATE=1",
+                                       caseName, profile, PERFORMANCE_BASELINE_FILE, seconds, profile);
+        CuAssert(testCase, message, FALSE);
+        free(message);
+        return;
+    }
+    st_logInfo("%s on profile %s: %f sec, baseline %f sec (%.2fx)\n", caseName, profile, seconds, baseline,
+               seconds / baseline);
+    char *message = stString_print("%s took %f sec, more than %.2f times its baseline of %f sec on profile %s",
+                                   caseName, seconds, ratio, baseline, profile);
+    CuAssert(testCase, message, seconds <= ratio * baseline);
+    free(message);
+}
+
+/*
+ * Cases
+ */
+
+static stList *readPolishExample(char *readFile, char **reference) {
+    // First sequence is the draft reference, the rest are reads with a strand as the last character of the header
+    struct List *seqs = constructEmptyList(0, free);
+    struct List *seqLengths = constructEmptyList(0, free);
+    struct List *headers = constructEmptyList(0, free);
+    FILE *fh = fopen(readFile, "r");
+    fastaRead(fh, seqs, seqLengths, headers);
+    fclose(fh);
+
+    *reference = stString_copy(seqs->list[0]);
+    stList *reads = stList_construct3(0, (void (*)(void *)) bamChunkRead_destruct);
+    for (int64_t i = 1; i < seqs->length; i++) {
+        char *header = headers->list[i];
+        RleString *rleString = rleString_construct(seqs->list[i]);
+        stList_append(reads, bamChunkRead_construct2(stString_print("read_%d", (int) i),
+                                                     stString_copy(rleString->rleString), NULL,
+                                                     header[strlen(header) - 1] == 'F', NULL));
+        rleString_destruct(rleString);
+    }
+
+    destructList(seqs);
+    destructList(seqLengths);
+    destructList(headers);
+    return reads;
+}
+
+static void test_performance_poaRealignAll(CuTest *testCase) {
+    // poa_realignAll over the 20 ecoli windows, in run length space as marginPolish runs it
+    Params *params = params_readParams(polishParamsFile);
+    int64_t exampleNo = 20;
+    stList *readSets = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    stList *references = stList_construct3(0, free);
+    for (int64_t i = 0; i < exampleNo; i++) {
+        char *readFile = stString_print(TEST_POLISH_FILES_DIR"20_random_100bp_windows_directional_ecoli_guppy/%i.fasta",
+                                        (int) i);
+        char *reference;
+        stList_append(readSets, readPolishExample(readFile, &reference));
+        RleString *rleReference = rleString_construct(reference);
+        stList_append(references, stString_copy(rleReference->rleString));
+        rleString_destruct(rleReference);
+        free(reference);
+        free(readFile);
+    }
+
+    double minSeconds = -1;
+    for (int64_t repeat = 0; repeat < PERFORMANCE_REPEATS; repeat++) {
+        double start = getTimeSeconds();
+        for (int64_t i = 0; i < exampleNo; i++) {
+            poa_destruct(poa_realignAll(stList_get(readSets, i), NULL, stList_get(references, i),
+                                        params->polishParams));
+        }
+        double seconds = getTimeSeconds() - start;
+        minSeconds = minSeconds < 0 || seconds < minSeconds ? seconds : minSeconds;
+    }
+    checkPerformance(testCase, "poa_realignAll", minSeconds);
+
+    stList_destruct(readSets);
+    stList_destruct(references);
+    params_destruct(params);
+}
+
+static void test_performance_stRPHmmForward(CuTest *testCase) {
+    // forward pass of an hmm of 32 full length reads over 2000 positions, from a fixed seed
+    Params *params = params_readParams(polishParamsFile);
+    int64_t depth = 32, length = 2000;
+    st_randomSeed(1);
+    uint8_t *haplotypes[2] = { st_malloc(length), st_malloc(length) };
+    for (int64_t i = 0; i < length; i++) {
+        haplotypes[0][i] = st_randomInt(0, ALPHABET_SIZE);
+        haplotypes[1][i] = st_random() < 0.01 ? st_randomInt(0, ALPHABET_SIZE) : haplotypes[0][i];
+    }
+    stList *profileSeqs = stList_construct3(0, (void (*)(void *)) stProfileSeq_destruct);
+    for (int64_t i = 0; i < depth; i++) {
+        char *readId = stString_print("read_%" PRIi64, i);
+        stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile("ref", readId, 0, length);
+        for (int64_t j = 0; j < length; j++) {
+            int64_t base = st_random() < 0.05 ? st_randomInt(0, ALPHABET_SIZE) : haplotypes[i % 2][j];
+            pSeq->profileProbs[j * ALPHABET_SIZE + base] = ALPHABET_MAX_PROB;
+        }
+        stList_append(profileSeqs, pSeq);
+        free(readId);
+    }
+    stHash *referenceNamesToReferencePriors = createEmptyReferencePriorProbabilities(profileSeqs);
+    stList *hmms = getRPHmms(profileSeqs, referenceNamesToReferencePriors, params->phaseParams);
+    CuAssertIntEquals(testCase, 1, stList_length(hmms));
+    stRPHmm *hmm = stList_get(hmms, 0);
+
+    double minSeconds = -1;
+    for (int64_t repeat = 0; repeat < PERFORMANCE_REPEATS; repeat++) {
+        stRPHmm_initialiseProbs(hmm);
+        double start = getTimeSeconds();
+        stRPHmm_forward(hmm);
+        double seconds = getTimeSeconds() - start;
+        minSeconds = minSeconds < 0 || seconds < minSeconds ? seconds : minSeconds;
+    }
+    checkPerformance(testCase, "stRPHmm_forward", minSeconds);
+
+    stList_destruct(hmms);
+    stHash_destruct(referenceNamesToReferencePriors);
+    stList_destruct(profileSeqs);
+    free(haplotypes[0]);
+    free(haplotypes[1]);
+    params_destruct(params);
+}
+
+CuSuite* performanceTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+
+    SUITE_ADD_TEST(suite, test_performance_poaRealignAll);
+    SUITE_ADD_TEST(suite, test_performance_stRPHmmForward);
+
+    return suite;
+}
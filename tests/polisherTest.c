@@ -6,6 +6,9 @@
 
 #include "CuTest.h"
 #include "margin.h"
+#include "alignmentCache.h"
+#include "htsIntegration.h"
+#include "chunkReport.h"
 
 static char *polishParamsFile = "../params/allParams.np.json";
 static char *polishParamsNoRleFile = "../params/allParams.np.no_rle.json";
@@ -853,6 +856,179 @@ static void test_rleString_construct2(CuTest *testCase) {
 
 }
 
+static void test_packedNucleotides(CuTest *testCase) {
+	// Random strings with the odd N, ambiguity code or lower case base unpack to themselves
+	st_randomSeed(1);
+	for(int64_t test=0; test<100; test++) {
+		int64_t length = st_randomInt(0, 1000);
+		char *nucleotides = st_malloc(length+1);
+		for(int64_t i=0; i<length; i++) {
+			nucleotides[i] = st_random() < 0.02 ? "NRYacgtn"[st_randomInt(0, 8)] : "ACGT"[st_randomInt(0, 4)];
+		}
+		nucleotides[length] = '\0';
+
+		PackedNucleotides *packed = packedNucleotides_construct(nucleotides);
+		CuAssertIntEquals(testCase, length, packed->length);
+		char *unpacked = packedNucleotides_unpack(packed);
+		CuAssertStrEquals(testCase, nucleotides, unpacked);
+		for(int64_t i=0; i<length; i++) {
+			CuAssertIntEquals(testCase, nucleotides[i], packedNucleotides_get(packed, i));
+		}
+		int64_t start = st_randomInt(0, length+1);
+		int64_t subLength = st_randomInt(0, length-start+1);
+		char *substring = packedNucleotides_getSubstring(packed, start, subLength);
+		char *expectedSubstring = stString_getSubString(nucleotides, start, subLength);
+		CuAssertStrEquals(testCase, expectedSubstring, substring);
+
+		free(substring);
+		free(expectedSubstring);
+		free(unpacked);
+		packedNucleotides_destruct(packed);
+		free(nucleotides);
+	}
+
+	// Without masked bases a read takes a quarter of the memory
+	char *nucleotides = st_malloc(10001);
+	for(int64_t i=0; i<10000; i++) {
+		nucleotides[i] = "ACGT"[st_randomInt(0, 4)];
+	}
+	nucleotides[10000] = '\0';
+	BamChunkRead *read = bamChunkRead_construct2(stString_copy("read"), nucleotides, NULL, TRUE, NULL);
+	char *copy = stString_copy(nucleotides);
+	bamChunkRead_pack(read);
+	CuAssertTrue(testCase, read->nucleotides == NULL);
+	CuAssertTrue(testCase, read->packedNucleotides->mask == NULL);
+	CuAssertIntEquals(testCase, 10000, read->readLength);
+	CuAssertTrue(testCase, packedNucleotides_getMemory(read->packedNucleotides) < 10000 / 3.9);
+	char *unpacked = bamChunkRead_getNucleotides(read);
+	CuAssertStrEquals(testCase, copy, unpacked);
+	bamChunkRead_releaseNucleotides(read, unpacked);
+	free(copy);
+	bamChunkRead_destruct(read);
+}
+
+static void test_rleString_constructFromRead(CuTest *testCase) {
+	// The RLE string of a packed read, with masked bases and a run longer than a byte, is that of its nucleotides
+	st_randomSeed(1);
+	char *nucleotides = st_malloc(2001);
+	for(int64_t i=0; i<2000; i++) {
+		nucleotides[i] = i >= 1000 && i < 1600 ? 'T' : i == 999 || i == 1600 ? 'A' :
+				st_random() < 0.02 ? 'N' : "ACGT"[st_randomInt(0, 4)];
+	}
+	nucleotides[2000] = '\0';
+	BamChunkRead *read = bamChunkRead_construct2(NULL, stString_copy(nucleotides), NULL, TRUE, NULL);
+	bamChunkRead_pack(read);
+	for(int64_t runLengthEncode=0; runLengthEncode<2; runLengthEncode++) {
+		RleString *expected = runLengthEncode ? rleString_construct(nucleotides) : rleString_constructNoRLE(nucleotides);
+		RleString *rleString = rleString_constructFromRead(read, runLengthEncode);
+		CuAssertStrEquals(testCase, expected->rleString, rleString->rleString);
+		CuAssertIntEquals(testCase, expected->length, rleString->length);
+		CuAssertIntEquals(testCase, expected->nonRleLength, rleString->nonRleLength);
+		for(int64_t i=0; i<expected->length; i++) {
+			CuAssertIntEquals(testCase, expected->repeatCounts[i], rleString->repeatCounts[i]);
+			CuAssertIntEquals(testCase, expected->rleToNonRleCoordinateMap[i], rleString->rleToNonRleCoordinateMap[i]);
+		}
+		for(int64_t i=0; i<expected->nonRleLength; i++) {
+			CuAssertIntEquals(testCase, expected->nonRleToRleCoordinateMap[i], rleString->nonRleToRleCoordinateMap[i]);
+		}
+
+		// The long run is one position
+		CuAssertIntEquals(testCase, runLengthEncode ? 600 : 1,
+				rleString->repeatCounts[rleString->nonRleToRleCoordinateMap[1000]]);
+
+		// Discarding the coordinate maps keeps the string and repeat counts
+		rleString_discardCoordinateMaps(rleString);
+		CuAssertTrue(testCase, rleString->nonRleToRleCoordinateMap == NULL);
+		char *expanded = rleString_expand(rleString);
+		CuAssertStrEquals(testCase, nucleotides, expanded);
+		free(expanded);
+
+		rleString_destruct(expected);
+		rleString_destruct(rleString);
+	}
+	bamChunkRead_destruct(read);
+	free(nucleotides);
+}
+
+static void test_rleString_refillPreComputed(CuTest *testCase) {
+	// Refilling an rle string, as it grows and shrinks, gives the rle string constructed from the same runs
+	char *rleChars[3] = { "ACGTA", "ACGTACGTAC", "GT" };
+	uint8_t rleCounts[3][10] = { { 1, 2, 3, 1, 1 }, { 5, 1, 1, 2, 1, 1, 4, 1, 1, 2 }, { 1, 3 } };
+	RleString rleString;
+	memset(&rleString, 0, sizeof(RleString));
+	int64_t rleCapacity = 0, nonRleCapacity = 0;
+	for(int64_t j=0; j<3; j++) {
+		RleString *expected = rleString_constructPreComputed(rleChars[j], rleCounts[j]);
+		rleString_refillPreComputed(&rleString, rleChars[j], rleCounts[j], &rleCapacity, &nonRleCapacity);
+		CuAssertStrEquals(testCase, expected->rleString, rleString.rleString);
+		CuAssertIntEquals(testCase, expected->length, rleString.length);
+		CuAssertIntEquals(testCase, expected->nonRleLength, rleString.nonRleLength);
+		CuAssertTrue(testCase, rleCapacity > rleString.length && nonRleCapacity > rleString.nonRleLength);
+		for(int64_t i=0; i<expected->length; i++) {
+			CuAssertIntEquals(testCase, expected->repeatCounts[i], rleString.repeatCounts[i]);
+			CuAssertIntEquals(testCase, expected->rleToNonRleCoordinateMap[i], rleString.rleToNonRleCoordinateMap[i]);
+		}
+		for(int64_t i=0; i<expected->nonRleLength; i++) {
+			CuAssertIntEquals(testCase, expected->nonRleToRleCoordinateMap[i], rleString.nonRleToRleCoordinateMap[i]);
+		}
+		rleString_destruct(expected);
+	}
+	free(rleString.rleString);
+	free(rleString.repeatCounts);
+	free(rleString.rleToNonRleCoordinateMap);
+	free(rleString.nonRleToRleCoordinateMap);
+}
+
+static void test_poa_realignAll_packed(CuTest *testCase) {
+	// Polishing from packed reads gives the consensus from unpacked reads
+	Params *params = params_readParams(polishParamsFile);
+	for(int64_t example=0; example<5; example++) {
+		char *readFile = stString_print(TEST_POLISH_FILES_DIR"20_random_100bp_windows_directional_ecoli_guppy/%i.fasta",
+				(int)example);
+		struct List *readHeaders;
+		struct List *nucleotides = readSequences(readFile, &readHeaders);
+		RleString *rleReference = rleString_construct(nucleotides->list[0]);
+
+		stList *rleStrings = stList_construct3(0, (void (*)(void *))rleString_destruct);
+		stList *rleReads[2] = { stList_construct3(0, (void (*)(void *))bamChunkRead_destruct),
+				stList_construct3(0, (void (*)(void *))bamChunkRead_destruct) };
+		for(int64_t i=1; i<readHeaders->length; i++) {
+			char *header = readHeaders->list[i];
+			BamChunkRead *read = bamChunkRead_construct2(stString_print("read_%d", (int)i),
+					stString_copy(nucleotides->list[i]), NULL, header[strlen(header)-1] == 'F', NULL);
+			RleString *rleString = rleString_construct(read->nucleotides);
+			stList_append(rleStrings, rleString);
+			stList_append(rleReads[0], bamChunkRead_constructRLECopy(read, rleString));
+			bamChunkRead_pack(read);
+			stList_append(rleReads[1], bamChunkRead_constructRLECopy(read, rleString));
+			CuAssertTrue(testCase, ((BamChunkRead *)stList_peek(rleReads[1]))->packedNucleotides != NULL);
+			bamChunkRead_destruct(read);
+		}
+
+		char *consensus[2];
+		for(int64_t j=0; j<2; j++) {
+			Poa *poa = poa_realignAll(rleReads[j], NULL, rleReference->rleString, params->polishParams);
+			RleString *consensusRleString = expandRLEConsensus(poa, rleStrings, rleReads[j],
+					params->polishParams->repeatSubMatrix);
+			consensus[j] = rleString_expand(consensusRleString);
+			rleString_destruct(consensusRleString);
+			poa_destruct(poa);
+		}
+		CuAssertStrEquals(testCase, consensus[0], consensus[1]);
+
+		free(consensus[0]);
+		free(consensus[1]);
+		stList_destruct(rleReads[0]);
+		stList_destruct(rleReads[1]);
+		stList_destruct(rleStrings);
+		rleString_destruct(rleReference);
+		destructList(nucleotides);
+		destructList(readHeaders);
+		free(readFile);
+	}
+	params_destruct(params);
+}
+
 void checkStringsAndFree(CuTest *testCase, const char *expected, char *temp) {
 	CuAssertStrEquals(testCase, expected, temp);
 	free(temp);
@@ -969,6 +1145,208 @@ void test_removeOverlap_RandomExamples(CuTest *testCase) {
 	params_destruct(params);
 }
 
+static void assertPoasEqual(CuTest *testCase, Poa *poa1, Poa *poa2) {
+	CuAssertStrEquals(testCase, poa1->refString, poa2->refString);
+	CuAssertIntEquals(testCase, stList_length(poa1->nodes), stList_length(poa2->nodes));
+	for(int64_t i=0; i<stList_length(poa1->nodes); i++) {
+		PoaNode *node1 = stList_get(poa1->nodes, i), *node2 = stList_get(poa2->nodes, i);
+		for(int64_t j=0; j<SYMBOL_NUMBER; j++) {
+			CuAssertDblEquals(testCase, node1->baseWeights[j], node2->baseWeights[j], 0.0);
+		}
+		CuAssertIntEquals(testCase, stList_length(node1->observations), stList_length(node2->observations));
+		CuAssertIntEquals(testCase, stList_length(node1->inserts), stList_length(node2->inserts));
+		CuAssertIntEquals(testCase, stList_length(node1->deletes), stList_length(node2->deletes));
+	}
+}
+
+static void test_poa_realignAllCached(CuTest *testCase) {
+	// A run reusing cached alignments must give the same poa as an uncached run
+	char *cacheFile = "alignmentCacheTest.cache";
+	Params *params = params_readParams(polishParamsFile);
+	uint64_t paramsFingerprint = alignmentCache_getParamsFingerprint(polishParamsFile);
+
+	for(int64_t example=0; example<20; example++) {
+		char *readFile = stString_print(TEST_POLISH_FILES_DIR"20_random_100bp_windows_directional_ecoli_guppy/%i.fasta",
+				(int)example);
+		struct List *readHeaders;
+		struct List *nucleotides = readSequences(readFile, &readHeaders);
+		stList *reads = stList_construct3(0, (void (*)(void*))bamChunkRead_destruct);
+		for(int64_t i=1; i<readHeaders->length; i++) {
+			char *header = readHeaders->list[i];
+			stList_append(reads, bamChunkRead_construct2(stString_print("read_%d", i),
+					stString_copy(nucleotides->list[i]), NULL, header[strlen(header)-1] == 'F', NULL));
+		}
+		char *reference = nucleotides->list[0];
+
+		// Anchors from a first pass, as marginPolish has from the bam
+		Poa *poa = poa_realign(reads, NULL, reference, params->polishParams);
+		stList *anchorAlignments = poa_getAnchorAlignments(poa, NULL, stList_length(reads), params->polishParams);
+		poa_destruct(poa);
+
+		Poa *uncachedPoa = poa_realignAll(reads, anchorAlignments, reference, params->polishParams);
+
+		// Fill the cache
+		remove(cacheFile);
+		AlignmentCache *cache = alignmentCache_construct(cacheFile, paramsFingerprint);
+		Poa *cachedPoa = poa_realignAllCached(reads, anchorAlignments, reference, params->polishParams, cache);
+		CuAssertIntEquals(testCase, 0, cache->hits);
+		CuAssertIntEquals(testCase, stList_length(reads), cache->misses);
+		alignmentCache_write(cache);
+		alignmentCache_destruct(cache);
+		assertPoasEqual(testCase, uncachedPoa, cachedPoa);
+		poa_destruct(cachedPoa);
+
+		// Reuse it
+		cache = alignmentCache_construct(cacheFile, paramsFingerprint);
+		cachedPoa = poa_realignAllCached(reads, anchorAlignments, reference, params->polishParams, cache);
+		CuAssertIntEquals(testCase, stList_length(reads), cache->hits);
+		CuAssertIntEquals(testCase, 0, cache->misses);
+		alignmentCache_destruct(cache);
+		assertPoasEqual(testCase, uncachedPoa, cachedPoa);
+		poa_destruct(cachedPoa);
+
+		// Recording the posteriors leaves the poa unchanged, and they rebuild it without realigning
+		stList *readMatches = stList_construct3(0, (void (*)(void *))stList_destruct);
+		stList *readInserts = stList_construct3(0, (void (*)(void *))stList_destruct);
+		stList *readDeletes = stList_construct3(0, (void (*)(void *))stList_destruct);
+		Poa *recordedPoa = poa_realignAllCached2(reads, anchorAlignments, reference, params->polishParams, NULL,
+				readMatches, readInserts, readDeletes);
+		assertPoasEqual(testCase, uncachedPoa, recordedPoa);
+		CuAssertIntEquals(testCase, stList_length(reads), stList_length(readMatches));
+		Poa *rebuiltPoa = poa_constructFromPosteriors(recordedPoa->refString, reads, readMatches, readInserts,
+				readDeletes);
+		assertPoasEqual(testCase, recordedPoa, rebuiltPoa);
+		poa_destruct(rebuiltPoa);
+		poa_destruct(recordedPoa);
+		stList_destruct(readMatches);
+		stList_destruct(readInserts);
+		stList_destruct(readDeletes);
+
+		// A different fingerprint invalidates it
+		cache = alignmentCache_construct(cacheFile, paramsFingerprint + 1);
+		poa_destruct(poa_realignAllCached(reads, anchorAlignments, reference, params->polishParams, cache));
+		CuAssertIntEquals(testCase, 0, cache->hits);
+		alignmentCache_destruct(cache);
+
+		// Cleanup
+		remove(cacheFile);
+		poa_destruct(uncachedPoa);
+		stList_destruct(anchorAlignments);
+		stList_destruct(reads);
+		destructList(nucleotides);
+		destructList(readHeaders);
+		free(readFile);
+	}
+
+	params_destruct(params);
+}
+
+static void test_chunkReport_poaCounters(CuTest *testCase) {
+	// The report counts the nodes of a small chunk's poa and every observation over them
+	Params *params = params_readParams(polishParamsFile);
+	char *readFile = TEST_POLISH_FILES_DIR"20_random_100bp_windows_directional_ecoli_guppy/0.fasta";
+	struct List *readHeaders;
+	struct List *nucleotides = readSequences(readFile, &readHeaders);
+	stList *reads = stList_construct3(0, (void (*)(void*))bamChunkRead_destruct);
+	for(int64_t i=1; i<readHeaders->length; i++) {
+		char *header = readHeaders->list[i];
+		stList_append(reads, bamChunkRead_construct2(stString_print("read_%d", i),
+				stString_copy(nucleotides->list[i]), NULL, header[strlen(header)-1] == 'F', NULL));
+	}
+	Poa *poa = poa_realignAll(reads, NULL, nucleotides->list[0], params->polishParams);
+
+	ChunkReport report;
+	chunkReport_start(&report, 0, NULL);
+	CuAssertIntEquals(testCase, -1, report.poaNodes);
+	CuAssertIntEquals(testCase, 0, report.poaObservations);
+	chunkReport_setPoa(&report, poa);
+
+	int64_t observations = 0;
+	for(int64_t i=0; i<stList_length(poa->nodes); i++) {
+		observations += stList_length(((PoaNode *)stList_get(poa->nodes, i))->observations);
+	}
+	CuAssertTrue(testCase, observations > 0);
+	CuAssertIntEquals(testCase, stList_length(poa->nodes), report.poaNodes);
+	CuAssertIntEquals(testCase, observations, report.poaObservations);
+
+	// Setting the poa again counts it afresh
+	chunkReport_setPoa(&report, poa);
+	CuAssertIntEquals(testCase, observations, report.poaObservations);
+
+	poa_destruct(poa);
+	stList_destruct(reads);
+	destructList(nucleotides);
+	destructList(readHeaders);
+	params_destruct(params);
+}
+
+static void test_tupleArena(CuTest *testCase) {
+	// Tuples from an arena read back as stIntTuples, across several blocks
+	TupleArena *arena = tupleArena_construct();
+	stList *tuples = stList_construct();
+	for(int64_t i=0; i<10000; i++) {
+		stList_append(tuples, tupleArena_getTuple3(arena, i, -i, 2*i));
+	}
+	CuAssertIntEquals(testCase, 10000, tupleArena_getTupleNumber(arena));
+	CuAssertTrue(testCase, tupleArena_getBlockNumber(arena) > 1 && tupleArena_getBlockNumber(arena) < 10);
+	for(int64_t i=0; i<10000; i++) {
+		stIntTuple *tuple = stList_get(tuples, i);
+		CuAssertIntEquals(testCase, 3, stIntTuple_length(tuple));
+		CuAssertIntEquals(testCase, i, stIntTuple_get(tuple, 0));
+		CuAssertIntEquals(testCase, -i, stIntTuple_get(tuple, 1));
+		CuAssertIntEquals(testCase, 2*i, stIntTuple_get(tuple, 2));
+	}
+	stList_destruct(tuples);
+	tupleArena_destruct(arena);
+
+	// Anchors made from an arena give the same anchors and realignment as those made one by one
+	Params *params = params_readParams(polishParamsFile);
+	for(int64_t example=0; example<5; example++) {
+		char *readFile = stString_print(TEST_POLISH_FILES_DIR"20_random_100bp_windows_directional_ecoli_guppy/%i.fasta",
+				(int)example);
+		struct List *readHeaders;
+		struct List *nucleotides = readSequences(readFile, &readHeaders);
+		stList *reads = stList_construct3(0, (void (*)(void*))bamChunkRead_destruct);
+		for(int64_t i=1; i<readHeaders->length; i++) {
+			char *header = readHeaders->list[i];
+			stList_append(reads, bamChunkRead_construct2(stString_print("read_%d", i),
+					stString_copy(nucleotides->list[i]), NULL, header[strlen(header)-1] == 'F', NULL));
+		}
+		char *reference = nucleotides->list[0];
+
+		Poa *poa = poa_realign(reads, NULL, reference, params->polishParams);
+		stList *anchorAlignments = poa_getAnchorAlignments(poa, NULL, stList_length(reads), params->polishParams);
+		arena = tupleArena_construct();
+		stList *arenaAnchorAlignments = poa_getAnchorAlignments2(poa, NULL, stList_length(reads),
+				params->polishParams, arena);
+		poa_destruct(poa);
+		CuAssertIntEquals(testCase, stList_length(anchorAlignments), stList_length(arenaAnchorAlignments));
+		for(int64_t i=0; i<stList_length(anchorAlignments); i++) {
+			stList *anchorPairs = stList_get(anchorAlignments, i);
+			stList *arenaAnchorPairs = stList_get(arenaAnchorAlignments, i);
+			CuAssertIntEquals(testCase, stList_length(anchorPairs), stList_length(arenaAnchorPairs));
+			for(int64_t j=0; j<stList_length(anchorPairs); j++) {
+				CuAssertTrue(testCase, stIntTuple_cmpFn(stList_get(anchorPairs, j), stList_get(arenaAnchorPairs, j)) == 0);
+			}
+		}
+
+		Poa *poa1 = poa_realign(reads, anchorAlignments, reference, params->polishParams);
+		Poa *poa2 = poa_realign(reads, arenaAnchorAlignments, reference, params->polishParams);
+		assertPoasEqual(testCase, poa1, poa2);
+
+		poa_destruct(poa1);
+		poa_destruct(poa2);
+		stList_destruct(anchorAlignments);
+		stList_destruct(arenaAnchorAlignments);
+		tupleArena_destruct(arena);
+		stList_destruct(reads);
+		destructList(nucleotides);
+		destructList(readHeaders);
+		free(readFile);
+	}
+	params_destruct(params);
+}
+
 int64_t polishingTest(char *bamFile, char *referenceFile, char *paramsFile, char *region, bool verbose) {
 
     // Run margin phase
@@ -1026,6 +1404,263 @@ void test_polish100kb(CuTest *testCase) {
 	CuAssertTrue(testCase, i == 0);
 }
 
+static char getBaseAfterFlank(CuTest *testCase, char *sequence, char *flank) {
+	// The base following the only occurrence of flank in sequence
+	char *match = strstr(sequence, flank);
+	CuAssertTrue(testCase, match != NULL);
+	CuAssertTrue(testCase, strstr(match + 1, flank) == NULL);
+	return match[strlen(flank)];
+}
+
+void test_polish5kb_diploid(CuTest *testCase) {
+	char *referenceFile = "../tests/data/realData/hg19.chr3.9mb.fa";
+	char *bamFile = "../tests/data/realData/NA12878.np.chr3.5kb.bam";
+	char *command = stString_print("./marginPolish %s %s %s --region chr3:2150000-2155000 --diploid --logLevel INFO",
+			bamFile, referenceFile, polishParamsFile);
+	st_logInfo("> Running command: %s\n", command);
+	int64_t i = st_system(command);
+	free(command);
+	CuAssertTrue(testCase, i == 0);
+
+	// Each haplotype is written as its own polished chr3
+	char *haplotypeFiles[2] = { "output.hap1.fa", "output.hap2.fa" };
+	stHash *haplotypeSequences[2];
+	char *haplotypes[2];
+	for(int64_t h=0; h<2; h++) {
+		FILE *fh = fopen(haplotypeFiles[h], "r");
+		CuAssertTrue(testCase, fh != NULL);
+		haplotypeSequences[h] = fastaReadToMap(fh);
+		fclose(fh);
+		haplotypes[h] = stHash_search(haplotypeSequences[h], "chr3");
+		CuAssertTrue(testCase, haplotypes[h] != NULL);
+		CuAssertTrue(testCase, strlen(haplotypes[h]) > 4000 && strlen(haplotypes[h]) < 6000);
+	}
+
+	// Heterozygous SNVs of the region in NA12878.PG.chr3.100kb.1.vcf, each found by the 12 reference bases before
+	// it: the haplotypes are labelled arbitrarily, so each allele must be in one haplotype and the other in the other
+	char *flanks[2] = { "CAAGGTCAGTAT", "GGTAAATGAACC" }; // chr3:2150895 T/C and chr3:2152057 G/C
+	char alleles[2][2] = { { 'T', 'C' }, { 'G', 'C' } };
+	for(int64_t i=0; i<2; i++) {
+		char base1 = getBaseAfterFlank(testCase, haplotypes[0], flanks[i]);
+		char base2 = getBaseAfterFlank(testCase, haplotypes[1], flanks[i]);
+		st_logInfo("Heterozygous site %s: %c in haplotype 1, %c in haplotype 2\n", flanks[i], base1, base2);
+		CuAssertTrue(testCase, (base1 == alleles[i][0] && base2 == alleles[i][1]) ||
+				(base1 == alleles[i][1] && base2 == alleles[i][0]));
+	}
+	for(int64_t h=0; h<2; h++) {
+		stHash_destruct(haplotypeSequences[h]);
+	}
+}
+
+static void writeCram(char *bamFile, char *referenceFile, char *cramFile) {
+	// Converts the bam to an indexed cram, compressed against the reference
+	samFile *in = hts_open(bamFile, "r");
+	bam_hdr_t *bamHdr = sam_hdr_read(in);
+	samFile *out = hts_open(cramFile, "wc");
+	if (out == NULL || hts_set_fai_filename(out, referenceFile) != 0 || sam_hdr_write(out, bamHdr) != 0) {
+		st_errAbort("Could not write cram: %s\n", cramFile);
+	}
+	bam1_t *aln = bam_init1();
+	while (sam_read1(in, bamHdr, aln) >= 0) {
+		if (sam_write1(out, bamHdr, aln) < 0) {
+			st_errAbort("Could not write cram: %s\n", cramFile);
+		}
+	}
+	bam_destroy1(aln);
+	bam_hdr_destroy(bamHdr);
+	sam_close(in);
+	sam_close(out);
+	if (sam_index_build(cramFile, 0) != 0) {
+		st_errAbort("Could not index cram: %s\n", cramFile);
+	}
+}
+
+void test_polish5kb_cram(CuTest *testCase) {
+	char *referenceFile = "../tests/data/realData/hg19.chr3.9mb.fa";
+	char *bamFile = "../tests/data/realData/NA12878.np.chr3.5kb.bam";
+	char *cramFile = "NA12878.np.chr3.5kb.cram";
+	writeCram(bamFile, referenceFile, cramFile);
+
+	// Polishing from the cram gives the polish from the bam
+	char *inputFiles[2] = { bamFile, cramFile };
+	char *outputBases[2] = { "cramTestFromBam", "cramTestFromCram" };
+	stHash *outputs[2];
+	for(int64_t i=0; i<2; i++) {
+		char *command = stString_print("./marginPolish %s %s %s --region chr3:2150000-2155000 --logLevel INFO -o %s",
+				inputFiles[i], referenceFile, polishParamsFile, outputBases[i]);
+		st_logInfo("> Running command: %s\n", command);
+		CuAssertTrue(testCase, st_system(command) == 0);
+		free(command);
+		char *outputFile = stString_print("%s.fa", outputBases[i]);
+		FILE *fh = fopen(outputFile, "r");
+		CuAssertTrue(testCase, fh != NULL);
+		outputs[i] = fastaReadToMap(fh);
+		fclose(fh);
+		free(outputFile);
+	}
+	char *fromBam = stHash_search(outputs[0], "chr3");
+	char *fromCram = stHash_search(outputs[1], "chr3");
+	CuAssertTrue(testCase, fromBam != NULL && fromCram != NULL);
+	CuAssertStrEquals(testCase, fromBam, fromCram);
+	stHash_destruct(outputs[0]);
+	stHash_destruct(outputs[1]);
+}
+
+void test_polish5kb_incremental(CuTest *testCase) {
+	char *referenceFile = "../tests/data/realData/hg19.chr3.9mb.fa";
+	char *bamFile = "../tests/data/realData/NA12878.np.chr3.5kb.bam";
+	char *region = "chr3:2150000-2155000";
+
+	// Polish in full, then re-polish an interval of the same draft, splicing it into the full polish
+	char *command = stString_print("./marginPolish %s %s %s --region %s --logLevel INFO -o incrementalFull",
+			bamFile, referenceFile, polishParamsFile, region);
+	st_logInfo("> Running command: %s\n", command);
+	CuAssertTrue(testCase, st_system(command) == 0);
+	free(command);
+
+	FILE *fh = fopen("incrementalEdits.bed", "w");
+	fprintf(fh, "# edited intervals\nchr3\t2152400\t2152600\n");
+	fclose(fh);
+	command = stString_print("./marginPolish %s %s %s --region %s --logLevel INFO -o incrementalSpliced "
+			"--previousPolish incrementalFull.fa --editedRegions incrementalEdits.bed",
+			bamFile, referenceFile, polishParamsFile, region);
+	st_logInfo("> Running command: %s\n", command);
+	CuAssertTrue(testCase, st_system(command) == 0);
+	free(command);
+
+	// Nothing was edited, so the spliced polish is the full polish
+	char *outputFiles[2] = { "incrementalFull.fa", "incrementalSpliced.fa" };
+	stHash *outputs[2];
+	for(int64_t i=0; i<2; i++) {
+		fh = fopen(outputFiles[i], "r");
+		CuAssertTrue(testCase, fh != NULL);
+		outputs[i] = fastaReadToMap(fh);
+		fclose(fh);
+	}
+	char *full = stHash_search(outputs[0], "chr3");
+	char *spliced = stHash_search(outputs[1], "chr3");
+	CuAssertTrue(testCase, full != NULL && spliced != NULL);
+	CuAssertStrEquals(testCase, full, spliced);
+	stHash_destruct(outputs[0]);
+	stHash_destruct(outputs[1]);
+}
+
+static char *polishToString(CuTest *testCase, char *bamFile, char *referenceFile, char *region, char *outputBase,
+		char *extraOptions) {
+	// Runs marginPolish and returns the polished chr3
+	char *command = stString_print("./marginPolish %s %s %s --region %s --logLevel INFO -o %s %s",
+			bamFile, referenceFile, polishParamsFile, region, outputBase, extraOptions);
+	st_logInfo("> Running command: %s\n", command);
+	CuAssertTrue(testCase, st_system(command) == 0);
+	free(command);
+	char *outputFile = stString_print("%s.fa", outputBase);
+	FILE *fh = fopen(outputFile, "r");
+	CuAssertTrue(testCase, fh != NULL);
+	stHash *output = fastaReadToMap(fh);
+	fclose(fh);
+	char *polished = stHash_search(output, "chr3");
+	CuAssertTrue(testCase, polished != NULL);
+	polished = stString_copy(polished);
+	stHash_destruct(output);
+	free(outputFile);
+	return polished;
+}
+
+static stList *getStartedChunks(char *chunkReportFile) {
+	// The "chunk start end" of each chunk with a started line in a chunk report, as a list of int tuples
+	stList *chunks = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
+	FILE *fh = fopen(chunkReportFile, "r");
+	if (fh == NULL) {
+		return chunks;
+	}
+	char *line;
+	while ((line = stFile_getLineFromFile(fh)) != NULL) {
+		stList *tokens = stString_splitByString(line, "\t");
+		if (stList_length(tokens) > 4 && stString_eq(stList_get(tokens, 1), "started")) {
+			stList_append(chunks, stIntTuple_construct3(atol(stList_get(tokens, 0)), atol(stList_get(tokens, 3)),
+					atol(stList_get(tokens, 4))));
+		}
+		stList_destruct(tokens);
+		free(line);
+	}
+	fclose(fh);
+	return chunks;
+}
+
+void test_polish5kb_incrementalEdited(CuTest *testCase) {
+	char *referenceFile = "../tests/data/realData/hg19.chr3.9mb.fa";
+	char *bamFile = "../tests/data/realData/NA12878.np.chr3.5kb.bam";
+	char *region = "chr3:2150000-2155000";
+	int64_t editStart = 2152400, editEnd = 2152600;
+
+	// Edit the draft with an insertion and a deletion of the same length in one interval, so the alignments of the
+	// reads outside the interval still hold
+	FILE *fh = fopen(referenceFile, "r");
+	stHash *draft = fastaReadToMap(fh);
+	fclose(fh);
+	char *chr3 = stHash_search(draft, "chr3");
+	char *insertion = "ACGTTGCAACGTTGCA";
+	int64_t insertAt = editStart + 50, deleteAt = editStart + 150, editLength = strlen(insertion);
+	char *prefix = stString_getSubString(chr3, 0, insertAt);
+	char *middle = stString_getSubString(chr3, insertAt, deleteAt - insertAt);
+	char *edited = stString_print("%s%s%s%s", prefix, insertion, middle, &chr3[deleteAt + editLength]);
+	CuAssertIntEquals(testCase, strlen(chr3), strlen(edited));
+	char *editedReferenceFile = "incrementalEditedDraft.fa";
+	fh = fopen(editedReferenceFile, "w");
+	fastaWrite(edited, "chr3", fh);
+	fclose(fh);
+	fh = fopen("incrementalEditedRegions.bed", "w");
+	fprintf(fh, "chr3\t%" PRId64 "\t%" PRId64 "\n", editStart, editEnd);
+	fclose(fh);
+
+	// Polish the original draft, then the edited draft in full, and incrementally from the original's polish
+	char *previous = polishToString(testCase, bamFile, referenceFile, region, "incrementalOriginal", "");
+	remove("incrementalEditedFull.tsv");
+	remove("incrementalEditedSpliced.tsv");
+	char *full = polishToString(testCase, bamFile, editedReferenceFile, region, "incrementalEditedFull",
+			"--chunkReport incrementalEditedFull.tsv");
+	char *spliced = polishToString(testCase, bamFile, editedReferenceFile, region, "incrementalEditedSpliced",
+			"--previousPolish incrementalOriginal.fa --editedRegions incrementalEditedRegions.bed "
+			"--chunkReport incrementalEditedSpliced.tsv");
+
+	// The incremental polish is the full polish of the edited draft
+	CuAssertStrEquals(testCase, full, spliced);
+
+	// Only the chunks overlapping the edit, and one flanking chunk each side, were polished again
+	stList *allChunks = getStartedChunks("incrementalEditedFull.tsv");
+	stList *repolishedChunks = getStartedChunks("incrementalEditedSpliced.tsv");
+	int64_t firstEdited = -1, lastEdited = -1;
+	for(int64_t i=0; i<stList_length(allChunks); i++) {
+		stIntTuple *chunk = stList_get(allChunks, i);
+		if (stIntTuple_get(chunk, 1) < editEnd && editStart < stIntTuple_get(chunk, 2)) {
+			firstEdited = firstEdited == -1 || stIntTuple_get(chunk, 0) < firstEdited ? stIntTuple_get(chunk, 0) : firstEdited;
+			lastEdited = stIntTuple_get(chunk, 0) > lastEdited ? stIntTuple_get(chunk, 0) : lastEdited;
+		}
+	}
+	CuAssertTrue(testCase, firstEdited != -1);
+	int64_t expectedCount = 0;
+	for(int64_t i=0; i<stList_length(allChunks); i++) {
+		int64_t chunkIdx = stIntTuple_get(stList_get(allChunks, i), 0);
+		expectedCount += chunkIdx >= firstEdited - 1 && chunkIdx <= lastEdited + 1 ? 1 : 0;
+	}
+	CuAssertTrue(testCase, expectedCount < stList_length(allChunks));
+	CuAssertIntEquals(testCase, expectedCount, stList_length(repolishedChunks));
+	for(int64_t i=0; i<stList_length(repolishedChunks); i++) {
+		int64_t chunkIdx = stIntTuple_get(stList_get(repolishedChunks, i), 0);
+		CuAssertTrue(testCase, chunkIdx >= firstEdited - 1 && chunkIdx <= lastEdited + 1);
+	}
+
+	stList_destruct(allChunks);
+	stList_destruct(repolishedChunks);
+	free(previous);
+	free(full);
+	free(spliced);
+	free(prefix);
+	free(middle);
+	free(edited);
+	stHash_destruct(draft);
+}
+
 void checkLargeGapOutput(CuTest *testCase) {
 	//read output file, find non-n sequence
 	char *outputFile = "output.fa";
@@ -1082,15 +1717,26 @@ CuSuite* polisherTestSuite(void) {
     SUITE_ADD_TEST(suite, test_getShift);
     SUITE_ADD_TEST(suite, test_rleString_examples);
     SUITE_ADD_TEST(suite, test_rleString_construct2);
+    SUITE_ADD_TEST(suite, test_packedNucleotides);
+    SUITE_ADD_TEST(suite, test_rleString_constructFromRead);
+    SUITE_ADD_TEST(suite, test_rleString_refillPreComputed);
     SUITE_ADD_TEST(suite, test_addInsert);
     SUITE_ADD_TEST(suite, test_removeDelete);
     SUITE_ADD_TEST(suite, test_polishParams);
     SUITE_ADD_TEST(suite, test_removeOverlapExample);
     SUITE_ADD_TEST(suite, test_removeOverlap_RandomExamples);
+    SUITE_ADD_TEST(suite, test_poa_realignAllCached);
+    SUITE_ADD_TEST(suite, test_chunkReport_poaCounters);
+    SUITE_ADD_TEST(suite, test_poa_realignAll_packed);
+    SUITE_ADD_TEST(suite, test_tupleArena);
 
     SUITE_ADD_TEST(suite, test_polish5kb_rle);
     SUITE_ADD_TEST(suite, test_polish5kb_no_rle);
     SUITE_ADD_TEST(suite, test_polish5kb_no_region);
+    SUITE_ADD_TEST(suite, test_polish5kb_diploid);
+    SUITE_ADD_TEST(suite, test_polish5kb_incremental);
+    SUITE_ADD_TEST(suite, test_polish5kb_incrementalEdited);
+    SUITE_ADD_TEST(suite, test_polish5kb_cram);
     SUITE_ADD_TEST(suite, test_polish100kb);
 
     SUITE_ADD_TEST(suite, test_poa_realign_ecoli_examples_rle);
@@ -1367,6 +1367,72 @@ void test_stProfileSeq_constructFromPosteriorProbs(CuTest *testCase) {
 	}
 }
 
+void test_stProfileSeq_constructFromAlignedPairs(CuTest *testCase) {
+	// Profile sequences built from the posteriors recorded while polishing must equal those built by realigning
+	Params *params = params_readParams(polishParamsFile);
+	params->phaseParams->gapCharactersForDeletions = 1;
+
+	for(int64_t example=0; example<20; example++) {
+		char *readFile = stString_print("../tests/data/polishTestExamples/20_random_100bp_windows_directional_ecoli_guppy/%i.fasta",
+				(int)example);
+		struct List *seqs = constructEmptyList(0, free);
+		struct List *seqLengths = constructEmptyList(0, free);
+		struct List *headers = constructEmptyList(0, free);
+		FILE *fh = fopen(readFile, "r");
+		fastaRead(fh, seqs, seqLengths, headers);
+		fclose(fh);
+
+		// First sequence is the reference, the rest are reads with their strand as the last character of the header
+		char *reference = seqs->list[0];
+		int64_t refLength = strlen(reference);
+		stList *reads = stList_construct3(0, (void (*)(void *))bamChunkRead_destruct);
+		for(int64_t i=1; i<seqs->length; i++) {
+			char *header = headers->list[i];
+			stList_append(reads, bamChunkRead_construct2(stString_print("read_%i", (int)i), stString_copy(seqs->list[i]),
+					NULL, header[strlen(header)-1] == 'F', NULL));
+		}
+
+		// Polish as marginPolish does, realigning to anchors from a first pass, recording the posteriors
+		Poa *poa = poa_realign(reads, NULL, reference, params->polishParams);
+		stList *anchorAlignments = poa_getAnchorAlignments(poa, NULL, stList_length(reads), params->polishParams);
+		stList *readMatches = stList_construct3(0, (void (*)(void *))stList_destruct);
+		stList *readDeletes = stList_construct3(0, (void (*)(void *))stList_destruct);
+		Poa *poa2 = poa_realign2(reads, anchorAlignments, reference, params->polishParams, readMatches, readDeletes);
+		CuAssertIntEquals(testCase, stList_length(reads), stList_length(readMatches));
+		CuAssertIntEquals(testCase, stList_length(reads), stList_length(readDeletes));
+
+		for(int64_t i=0; i<stList_length(reads); i++) {
+			BamChunkRead *read = stList_get(reads, i);
+			stProfileSeq *pSeq = stProfileSeq_constructFromPosteriorProbs("ref", reference, refLength,
+					read->readName, read->nucleotides, stList_get(anchorAlignments, i), params);
+			stProfileSeq *pSeq2 = stProfileSeq_constructFromAlignedPairs("ref", refLength, read->readName,
+					read, stList_get(readMatches, i), stList_get(readDeletes, i), params);
+
+			CuAssertIntEquals(testCase, pSeq->refStart, pSeq2->refStart);
+			CuAssertIntEquals(testCase, pSeq->length, pSeq2->length);
+			CuAssertTrue(testCase, memcmp(pSeq->profileProbs, pSeq2->profileProbs,
+					pSeq->length * ALPHABET_SIZE * sizeof(uint8_t)) == 0);
+
+			stProfileSeq_destruct(pSeq);
+			stProfileSeq_destruct(pSeq2);
+		}
+
+		// cleanup
+		poa_destruct(poa);
+		poa_destruct(poa2);
+		stList_destruct(anchorAlignments);
+		stList_destruct(readMatches);
+		stList_destruct(readDeletes);
+		stList_destruct(reads);
+		destructList(seqs);
+		destructList(seqLengths);
+		destructList(headers);
+		free(readFile);
+	}
+
+	params_destruct(params);
+}
+
 CuSuite *stRPHmmTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
 
@@ -1387,6 +1453,7 @@ CuSuite *stRPHmmTestSuite(void) {
     SUITE_ADD_TEST(suite, test_stProfileSeq_constructFromPosteriorProbs_example);
 
     SUITE_ADD_TEST(suite, test_stProfileSeq_constructFromPosteriorProbs);
+    SUITE_ADD_TEST(suite, test_stProfileSeq_constructFromAlignedPairs);
 
     return suite;
 }